@@ -0,0 +1,87 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+/**
+ * BoundedQueue connects the stages of the image pipeline.
+ * push blocks while the queue is full, so a fast stage can not run ahead of a slow one by more than
+ * the capacity, and pop blocks while it is empty. Once closed, pushes fail and pops drain the
+ * remaining items before failing.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    /**
+     * Creates the queue.
+     *
+     * @param capacity Maximal number of items waiting in the queue, at least 1.
+     */
+    explicit BoundedQueue(size_t capacity) : m_capacity(capacity > 0 ? capacity : 1) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /**
+     * Adds an item, waiting for room if the queue is full.
+     *
+     * @param item The item to add.
+     * @return true if the item was added, false if the queue was closed.
+     */
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFullCondition.wait(lock, [this] { return m_isClosed || m_items.size() < m_capacity; });
+
+        if (m_isClosed)
+            return false;
+
+        m_items.push_back(std::move(item));
+        lock.unlock();
+        m_notEmptyCondition.notify_one();
+        return true;
+    }
+
+    /**
+     * Removes the oldest item, waiting for one if the queue is empty.
+     *
+     * @param out_item Receives the removed item.
+     * @return true if an item was removed, false if the queue is closed and empty.
+     */
+    bool pop(T* out_item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmptyCondition.wait(lock, [this] { return m_isClosed || !m_items.empty(); });
+
+        if (m_items.empty())
+            return false;
+
+        *out_item = std::move(m_items.front());
+        m_items.pop_front();
+        lock.unlock();
+        m_notFullCondition.notify_one();
+        return true;
+    }
+
+    /**
+     * Closes the queue, waking up all the waiting threads.
+     */
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_isClosed = true;
+        }
+        m_notFullCondition.notify_all();
+        m_notEmptyCondition.notify_all();
+    }
+
+private:
+    std::deque<T> m_items;
+    size_t m_capacity;
+    std::mutex m_mutex;
+    std::condition_variable m_notFullCondition;
+    std::condition_variable m_notEmptyCondition;
+    bool m_isClosed = false;
+};
@@ -0,0 +1,217 @@
+#include "BufferPool.h"
+#include <cstring>
+#include <new>
+
+// every buffer starts with a header of BUFFER_POOL_ALIGNMENT bytes, so the pixels after it keep the alignment
+struct BufferHeader {
+    size_t capacity;  // usable bytes after the header
+    int bucketIndex;  // size class, -1 for a buffer that is not pooled
+};
+
+static_assert(sizeof(BufferHeader) <= BUFFER_POOL_ALIGNMENT, "the buffer header must fit in the alignment");
+
+static BufferHeader* GetBufferHeader(void* buffer)
+{
+    return reinterpret_cast<BufferHeader*>(static_cast<unsigned char*>(buffer) - BUFFER_POOL_ALIGNMENT);
+}
+
+// returns the size class of a size and the size of its buffers, or -1 when the size is not pooled.
+// the classes above 16 KB split each power of two in 4 steps : a size in (2^b, 2^(b+1)] is rounded up to 5, 6, 7 or 8 steps of 2^(b-2)
+static int GetBucketIndex(size_t size, size_t* out_bucketSize)
+{
+    size_t minSize = static_cast<size_t>(1) << BUFFER_POOL_MIN_SIZE_SHIFT;
+    if (size < minSize)
+        return -1;
+
+    if (size == minSize)
+    {
+        *out_bucketSize = minSize;
+        return 0;
+    }
+
+    int highestBit = BUFFER_POOL_MIN_SIZE_SHIFT;
+    while (((size - 1) >> (highestBit + 1)) != 0)
+        ++highestBit;
+
+    size_t step = static_cast<size_t>(1) << (highestBit - 2);
+    size_t stepCount = (size - 1) / step + 1;
+    int bucketIndex = (highestBit - BUFFER_POOL_MIN_SIZE_SHIFT) * 4 + static_cast<int>(stepCount) - 4;
+    if (bucketIndex >= BUFFER_POOL_BUCKET_COUNT)
+        return -1;
+
+    *out_bucketSize = stepCount * step;
+    return bucketIndex;
+}
+
+BufferPool& BufferPool::getInstance()
+{
+    static BufferPool bufferPool;
+    return bufferPool;
+}
+
+BufferPool::BufferPool()
+{
+}
+
+BufferPool::~BufferPool()
+{
+    for (vector<void*>& bucket : m_buckets)
+    {
+        for (void* buffer : bucket)
+            freeBuffer(buffer);
+    }
+}
+
+// the cache of a thread is shared with nobody, so it is used without locking
+BufferPool::ThreadCache& BufferPool::getThreadCache()
+{
+    thread_local ThreadCache threadCache;
+    return threadCache;
+}
+
+BufferPool::ThreadCache::~ThreadCache()
+{
+    BufferPool& bufferPool = BufferPool::getInstance();
+    std::lock_guard<std::mutex> lock(bufferPool.m_mutex);
+
+    for (int i = 0; i < BUFFER_POOL_BUCKET_COUNT; ++i)
+        bufferPool.m_buckets[i].insert(bufferPool.m_buckets[i].end(), buckets[i].begin(), buckets[i].end());
+}
+
+void BufferPool::setCapacity(size_t capacity)
+{
+    m_capacity.store(capacity, std::memory_order_relaxed);
+}
+
+void* BufferPool::allocateBuffer(size_t capacity, int bucketIndex)
+{
+    unsigned char* memory = static_cast<unsigned char*>(::operator new(capacity + BUFFER_POOL_ALIGNMENT, std::align_val_t(BUFFER_POOL_ALIGNMENT)));
+
+    BufferHeader* header = reinterpret_cast<BufferHeader*>(memory);
+    header->capacity = capacity;
+    header->bucketIndex = bucketIndex;
+
+    if (bucketIndex >= 0)
+    {
+        long long heldBytes = m_heldBytes.fetch_add(capacity, std::memory_order_relaxed) + capacity;
+        long long peakBytes = m_peakBytes.load(std::memory_order_relaxed);
+        while (heldBytes > peakBytes && !m_peakBytes.compare_exchange_weak(peakBytes, heldBytes, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    return memory + BUFFER_POOL_ALIGNMENT;
+}
+
+void BufferPool::freeBuffer(void* buffer)
+{
+    BufferHeader* header = GetBufferHeader(buffer);
+    if (header->bucketIndex >= 0)
+        m_heldBytes.fetch_sub(header->capacity, std::memory_order_relaxed);
+
+    ::operator delete(header, std::align_val_t(BUFFER_POOL_ALIGNMENT));
+}
+
+// idle buffers are taken from the cache of the thread first, then from the shared lists
+void* BufferPool::acquire(size_t size)
+{
+    size_t bucketSize = 0;
+    int bucketIndex = GetBucketIndex(size, &bucketSize);
+    if (bucketIndex < 0)
+        return allocateBuffer(size, -1);
+
+    m_acquireCount.fetch_add(1, std::memory_order_relaxed);
+
+    void* buffer = nullptr;
+    vector<void*>& threadBucket = getThreadCache().buckets[bucketIndex];
+    if (!threadBucket.empty())
+    {
+        buffer = threadBucket.back();
+        threadBucket.pop_back();
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_buckets[bucketIndex].empty())
+        {
+            buffer = m_buckets[bucketIndex].back();
+            m_buckets[bucketIndex].pop_back();
+        }
+    }
+
+    if (buffer)
+    {
+        m_hitCount.fetch_add(1, std::memory_order_relaxed);
+        m_idleBytes.fetch_sub(bucketSize, std::memory_order_relaxed);
+    }
+    else
+    {
+        buffer = allocateBuffer(bucketSize, bucketIndex);
+    }
+
+    m_usedBytes.fetch_add(bucketSize, std::memory_order_relaxed);
+    return buffer;
+}
+
+void* BufferPool::resize(void* buffer, size_t size)
+{
+    if (!buffer)
+        return acquire(size);
+
+    size_t capacity = GetBufferHeader(buffer)->capacity;
+    if (size <= capacity)
+        return buffer;
+
+    void* resizedBuffer = acquire(size);
+    std::memcpy(resizedBuffer, buffer, capacity);
+    release(buffer);
+    return resizedBuffer;
+}
+
+// a released buffer is kept while the idle buffers fit in the capacity, in the cache of the thread while it has room
+void BufferPool::release(void* buffer)
+{
+    if (!buffer)
+        return;
+
+    BufferHeader* header = GetBufferHeader(buffer);
+    int bucketIndex = header->bucketIndex;
+    long long capacity = static_cast<long long>(header->capacity);
+
+    if (bucketIndex < 0)
+    {
+        freeBuffer(buffer);
+        return;
+    }
+
+    m_usedBytes.fetch_sub(capacity, std::memory_order_relaxed);
+
+    long long idleBytes = m_idleBytes.fetch_add(capacity, std::memory_order_relaxed) + capacity;
+    if (idleBytes > static_cast<long long>(m_capacity.load(std::memory_order_relaxed)))
+    {
+        m_idleBytes.fetch_sub(capacity, std::memory_order_relaxed);
+        freeBuffer(buffer);
+        return;
+    }
+
+    vector<void*>& threadBucket = getThreadCache().buckets[bucketIndex];
+    if (threadBucket.size() < BUFFER_POOL_THREAD_CACHE_SIZE)
+    {
+        threadBucket.push_back(buffer);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_buckets[bucketIndex].push_back(buffer);
+}
+
+BufferPoolStats BufferPool::getStats() const
+{
+    BufferPoolStats stats;
+    stats.acquireCount = m_acquireCount.load(std::memory_order_relaxed);
+    stats.hitCount = m_hitCount.load(std::memory_order_relaxed);
+    stats.usedBytes = m_usedBytes.load(std::memory_order_relaxed);
+    stats.idleBytes = m_idleBytes.load(std::memory_order_relaxed);
+    stats.peakBytes = m_peakBytes.load(std::memory_order_relaxed);
+    return stats;
+}
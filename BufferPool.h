@@ -0,0 +1,144 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using std::vector;  // Make vector available as 'vector'
+
+// alignment in bytes of the buffers of the pool, a multiple of IMAGE_ROW_ALIGNMENT
+#define BUFFER_POOL_ALIGNMENT 64
+
+// buffers smaller than 1 << BUFFER_POOL_MIN_SIZE_SHIFT bytes (16 KB) are not pooled
+#define BUFFER_POOL_MIN_SIZE_SHIFT 14
+
+// number of size classes : 16 KB, then 4 per power of two up to 4 GB
+#define BUFFER_POOL_BUCKET_COUNT 73
+
+// number of idle buffers of each size class a thread keeps for itself before returning them to the shared lists
+#define BUFFER_POOL_THREAD_CACHE_SIZE 2
+
+// default number of idle bytes the pool keeps
+#define DEFAULT_BUFFER_POOL_CAPACITY (256ull << 20)
+
+/**
+ * Counters of the buffer pool since the start of the process.
+ */
+struct BufferPoolStats {
+    long long acquireCount = 0;  // pooled buffers requested
+    long long hitCount = 0;      // requests served by an idle buffer instead of the allocator
+    long long usedBytes = 0;     // bytes of the buffers currently handed out
+    long long idleBytes = 0;     // bytes of the idle buffers kept for reuse
+    long long peakBytes = 0;     // highest sum of used and idle bytes, the most memory the pool held
+};
+
+/**
+ * BufferPool recycles the large buffers of the image processing : decoded images, the aligned copies the effects work on,
+ * the scratch copies of the kernels and the buffers of the PNG encoder. Batch runs allocate buffers of the same few sizes
+ * over and over, so a released buffer is kept and handed out again for a request of its size class instead of going
+ * back to the allocator.
+ * Sizes are rounded up to classes 4 per power of two apart, which wastes at most a quarter of a buffer. Every thread keeps
+ * a few idle buffers of each class for itself, the rest are shared under a lock. The idle buffers are bounded by the
+ * capacity of the pool, buffers released past it are freed.
+ * stb_image and stb_image_write allocate from the pool as well (see StbImage.cpp). Buffers are aligned on BUFFER_POOL_ALIGNMENT bytes.
+ */
+class BufferPool {
+public:
+    /**
+     * Returns the buffer pool of the process.
+     */
+    static BufferPool& getInstance();
+
+    ~BufferPool();
+
+    /**
+     * Sets the number of idle bytes the pool may keep, 0 frees every released buffer.
+     * Idle buffers past the new capacity are freed as they are released.
+     */
+    void setCapacity(size_t capacity);
+
+    /**
+     * Returns an uninitialized buffer of at least size bytes, to release with release or resize.
+     */
+    void* acquire(size_t size);
+
+    /**
+     * Returns a buffer of at least size bytes holding the bytes of buffer, like realloc.
+     * The buffer itself is returned when its size class holds size bytes already.
+     *
+     * @param buffer A buffer of the pool, or nullptr to acquire a new one.
+     * @param size The size in bytes the buffer needs to hold.
+     */
+    void* resize(void* buffer, size_t size);
+
+    /**
+     * Gives a buffer back to the pool, nullptr is ignored.
+     */
+    void release(void* buffer);
+
+    /**
+     * Returns the counters of the pool.
+     */
+    BufferPoolStats getStats() const;
+
+private:
+    BufferPool();
+
+    // idle buffers a thread keeps for itself, returned to the shared lists when the thread exits
+    struct ThreadCache {
+        ~ThreadCache();
+
+        vector<void*> buckets[BUFFER_POOL_BUCKET_COUNT];
+    };
+
+    /**
+     * Returns the idle buffers of the calling thread.
+     */
+    static ThreadCache& getThreadCache();
+
+    /**
+     * Frees the memory of a buffer.
+     */
+    void freeBuffer(void* buffer);
+
+    /**
+     * Allocates a buffer from the system.
+     *
+     * @param capacity The size of the buffer.
+     * @param bucketIndex The size class of the buffer, -1 for a buffer that is not pooled.
+     */
+    void* allocateBuffer(size_t capacity, int bucketIndex);
+
+    std::atomic<size_t> m_capacity{ DEFAULT_BUFFER_POOL_CAPACITY };
+    std::mutex m_mutex;
+    vector<void*> m_buckets[BUFFER_POOL_BUCKET_COUNT];
+
+    std::atomic<long long> m_acquireCount{ 0 };
+    std::atomic<long long> m_hitCount{ 0 };
+    std::atomic<long long> m_usedBytes{ 0 };
+    std::atomic<long long> m_idleBytes{ 0 };
+    std::atomic<long long> m_heldBytes{ 0 };  // used and idle bytes, only changed by allocations and frees
+    std::atomic<long long> m_peakBytes{ 0 };
+};
+
+/**
+ * Releases a buffer of the pool, for a unique_ptr owning it.
+ */
+struct BufferPoolDeleter {
+    void operator()(void* buffer) const
+    {
+        BufferPool::getInstance().release(buffer);
+    }
+};
+
+// a scratch buffer of the pool, given back when it goes out of scope
+typedef std::unique_ptr<unsigned char[], BufferPoolDeleter> PooledBuffer;
+
+/**
+ * Acquires an uninitialized scratch buffer of size bytes from the pool.
+ */
+inline PooledBuffer AcquirePooledBuffer(size_t size)
+{
+    return PooledBuffer(static_cast<unsigned char*>(BufferPool::getInstance().acquire(size)));
+}
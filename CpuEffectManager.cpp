@@ -0,0 +1,217 @@
+#include "CpuEffectManager.h"
+#include "CpuFeatures.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// minimal number of rows in a band, smaller bands cost more in scheduling than they gain in balance
+#define MIN_ROWS_PER_BAND 8
+
+// number of bands per thread, more than one so faster threads can pick up the slack of slower ones
+#define BANDS_PER_THREAD 4
+
+// cache size tiles are sized for when the processor does not report its L2 size
+#define DEFAULT_TILE_CACHE_SIZE (256 * 1024)
+
+// minimal width and height of a tile, smaller tiles spend more time on their halo than on their pixels
+#define MIN_TILE_SIZE 32
+
+CpuEffectManager::CpuEffectManager()
+{
+}
+
+CpuEffectManager::~CpuEffectManager()
+{
+}
+
+// initialize the CPU effect manager by creating its scheduler and worker threads
+bool CpuEffectManager::initializeCpuEffectManager(int threadCount, string* out_error)
+{
+    if (threadCount < 0)
+    {
+        *out_error = "Invalid CPU thread count.";
+        std::cout << "Invalid CPU thread count.";
+        return false;
+    }
+
+    // use all hardware threads by default
+    if (threadCount == 0)
+        threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    m_scheduler.reset(new TaskScheduler(threadCount));
+    return true;
+}
+
+bool CpuEffectManager::isInitialized() const
+{
+    return m_scheduler != nullptr;
+}
+
+int CpuEffectManager::getThreadCount() const
+{
+    return m_scheduler ? m_scheduler->getThreadCount() : 1;
+}
+
+void CpuEffectManager::setShaderEmulation(bool isEnabled)
+{
+    m_isShaderEmulationEnabled = isEnabled;
+}
+
+bool CpuEffectManager::isShaderEmulationEnabled() const
+{
+    return m_isShaderEmulationEnabled;
+}
+
+// splits the rows into bands and runs the kernel on each band using the scheduler
+void CpuEffectManager::parallelForRows(int rowCount, const std::function<void(int rowBegin, int rowEnd)>& kernel)
+{
+    if (rowCount <= 0)
+        return;
+
+    int threadCount = getThreadCount();
+    int bandCount = std::max(1, std::min(threadCount * BANDS_PER_THREAD, rowCount / MIN_ROWS_PER_BAND));
+    int rowsPerBand = (rowCount + bandCount - 1) / bandCount;
+    bandCount = (rowCount + rowsPerBand - 1) / rowsPerBand;
+
+    if (!m_scheduler || bandCount == 1)
+    {
+        PROFILE_SCOPE("cpu.band");
+        kernel(0, rowCount);
+        return;
+    }
+
+    m_scheduler->parallelFor(bandCount, [&](int bandIndex) {
+        PROFILE_SCOPE("cpu.band");
+        int rowBegin = bandIndex * rowsPerBand;
+        int rowEnd = std::min(rowCount, rowBegin + rowsPerBand);
+        kernel(rowBegin, rowEnd);
+    });
+}
+
+// runs the tasks on the scheduler, or on the calling thread when the manager is not initialized
+void CpuEffectManager::parallelFor(int taskCount, const std::function<void(int taskIndex)>& task)
+{
+    if (taskCount <= 0)
+        return;
+
+    if (!m_scheduler)
+    {
+        for (int i = 0; i < taskCount; ++i)
+            task(i);
+        return;
+    }
+
+    m_scheduler->parallelFor(taskCount, task);
+}
+
+// runs the task on a worker, or on the calling thread when the manager is not initialized
+void CpuEffectManager::submit(std::function<void()> task)
+{
+    if (!m_scheduler)
+    {
+        task();
+        return;
+    }
+
+    m_scheduler->submit(std::move(task));
+}
+
+bool CpuEffectManager::runQueuedTask()
+{
+    return m_scheduler && m_scheduler->runQueuedTask();
+}
+
+// returns the first pixel of a tile along a dimension of the given size split into tileCount even tiles
+static int GetTileStart(int tileIndex, int size, int tileCount)
+{
+    return static_cast<int>(static_cast<long long>(tileIndex) * size / tileCount);
+}
+
+// the source and target scratch images of a tile take half of the L2 cache, the other half is left to the kernel's own buffers
+// and to the rows being copied. the tiles of a row or column of tiles are made even, so the last ones are not slivers
+void CpuEffectManager::parallelForTiles(const ImageView& image, int haloSize, const std::function<void(const ImageTile& tile)>& kernel)
+{
+    int width = image.getWidth();
+    int height = image.getHeight();
+    int channels = image.getChannels();
+
+    if (image.isEmpty())
+        return;
+
+    int cacheSize = GetCpuFeatures().l2CacheSize > 0 ? GetCpuFeatures().l2CacheSize : DEFAULT_TILE_CACHE_SIZE;
+    int scratchSize = static_cast<int>(std::sqrt(cacheSize / 2.0 / (2 * channels)));
+    int tileSize = std::max(scratchSize - 2 * haloSize, std::max(MIN_TILE_SIZE, 2 * haloSize));
+
+    int tileColumns = (width + tileSize - 1) / tileSize;
+    int tileRows = (height + tileSize - 1) / tileSize;
+
+    // a tile is written back over the pixels the halos of its neighbours read, so the pixels on both sides of the edges between
+    // the tiles are saved first : the rows [y - halo, y + halo) of every row of tiles but the first, and the columns of every
+    // column of tiles. a tile then reads its own pixels from the image, as only the tile itself writes them, and its halo from the
+    // saved edges. the tiles are at least a halo wide and high, so the edges are inside the image and only reach the next tile
+    std::vector<Image> rowEdges(tileRows);
+    std::vector<Image> columnEdges(tileColumns);
+
+    if (haloSize > 0)
+    {
+        parallelFor(tileRows + tileColumns, [&](int edgeIndex) {
+            if (edgeIndex < tileRows && edgeIndex > 0)
+            {
+                int y = GetTileStart(edgeIndex, height, tileRows);
+                rowEdges[edgeIndex] = Image(width, 2 * haloSize, channels);
+                image.getRegion(0, y - haloSize, width, 2 * haloSize).copyTo(rowEdges[edgeIndex].getView());
+            }
+            else if (edgeIndex > tileRows)
+            {
+                int column = edgeIndex - tileRows;
+                int x = GetTileStart(column, width, tileColumns);
+                columnEdges[column] = Image(2 * haloSize, height, channels);
+                image.getRegion(x - haloSize, 0, 2 * haloSize, height).copyTo(columnEdges[column].getView());
+            }
+        });
+    }
+
+    parallelFor(tileColumns * tileRows, [&](int tileIndex) {
+        PROFILE_SCOPE("cpu.tile");
+        int column = tileIndex % tileColumns;
+        int row = tileIndex / tileColumns;
+        int x = GetTileStart(column, width, tileColumns);
+        int y = GetTileStart(row, height, tileRows);
+        int innerWidth = GetTileStart(column + 1, width, tileColumns) - x;
+        int innerHeight = GetTileStart(row + 1, height, tileRows) - y;
+
+        int haloLeft = column > 0 ? haloSize : 0;
+        int haloTop = row > 0 ? haloSize : 0;
+        int haloRight = column + 1 < tileColumns ? haloSize : 0;
+        int haloBottom = row + 1 < tileRows ? haloSize : 0;
+        int scratchWidth = haloLeft + innerWidth + haloRight;
+        int scratchHeight = haloTop + innerHeight + haloBottom;
+
+        Image tileSource(scratchWidth, scratchHeight, channels);
+        Image tileTarget(scratchWidth, scratchHeight, channels);
+        const ImageView& scratch = tileSource.getView();
+
+        // the halo rows above and below, with the corners, then the halo columns on the sides of the tile's own rows
+        if (haloTop > 0)
+            rowEdges[row].getView().getRegion(x - haloLeft, 0, scratchWidth, haloTop).copyTo(scratch.getRegion(0, 0, scratchWidth, haloTop));
+        if (haloBottom > 0)
+            rowEdges[row + 1].getView().getRegion(x - haloLeft, haloSize, scratchWidth, haloBottom).copyTo(scratch.getRegion(0, haloTop + innerHeight, scratchWidth, haloBottom));
+        if (haloLeft > 0)
+            columnEdges[column].getView().getRegion(0, y, haloLeft, innerHeight).copyTo(scratch.getRegion(0, haloTop, haloLeft, innerHeight));
+        if (haloRight > 0)
+            columnEdges[column + 1].getView().getRegion(haloSize, y, haloRight, innerHeight).copyTo(scratch.getRegion(haloLeft + innerWidth, haloTop, haloRight, innerHeight));
+        image.getRegion(x, y, innerWidth, innerHeight).copyTo(scratch.getRegion(haloLeft, haloTop, innerWidth, innerHeight));
+
+        ImageTile tile;
+        tile.source = scratch;
+        tile.target = tileTarget.getView();
+        tile.innerX = haloLeft;
+        tile.innerY = haloTop;
+        tile.innerWidth = innerWidth;
+        tile.innerHeight = innerHeight;
+        kernel(tile);
+
+        tile.target.getRegion(haloLeft, haloTop, innerWidth, innerHeight).copyTo(image.getRegion(x, y, innerWidth, innerHeight));
+    });
+}
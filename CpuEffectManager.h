@@ -0,0 +1,119 @@
+#pragma once
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "Image.h"
+#include "TaskScheduler.h"
+
+using std::string;  // Make string available as 'string'
+
+/**
+ * A tile of an image given to the kernels of parallelForTiles : the tile's pixels and the halo around them, copied into
+ * a contiguous scratch image, and a scratch image of the same size the kernel writes the tile's pixels to.
+ * The halo is clamped to the image, so on the sides of the tile that touch the image's edges the scratch images end with the image.
+ */
+struct ImageTile {
+    ImageView source;     // the tile and its halo
+    ImageView target;     // receives the pixels of the tile, at the same positions as in source
+    int innerX = 0;       // position and size of the tile in the scratch images, the rest is halo
+    int innerY = 0;
+    int innerWidth = 0;
+    int innerHeight = 0;
+};
+
+/**
+ * CpuEffectManager is the CPU counterpart of the ShaderManager.
+ * It owns the work-stealing scheduler of the CPU backend and splits images into bands of rows
+ * (full-width tiles) and tiles that the effects' CPU kernels process in parallel. Whole images are
+ * submitted to the same scheduler, so idle threads help with the bands of the images still running.
+ * It does not depend on Direct3D, so effects can run on hosts without a GPU.
+ */
+class CpuEffectManager {
+public:
+    CpuEffectManager();
+    ~CpuEffectManager();
+
+    /**
+     * Initializes the CPU Effect Manager.
+     *
+     * @param threadCount Number of threads to process an image with, 0 to use all hardware threads.
+     * @param out_error A pointer to a string to receive error messages, if any.
+     * @return true if initialization succeeds, false otherwise.
+     */
+    bool initializeCpuEffectManager(int threadCount, string* out_error);
+
+    /**
+     * Returns true if the manager was initialized.
+     */
+    bool isInitialized() const;
+
+    /**
+     * Returns the number of threads images are processed with.
+     */
+    int getThreadCount() const;
+
+    /**
+     * Sets whether the effects run their HLSL shaders on the CPU shader engine rather than their CPU kernels,
+     * to check what the GPU backend would draw on hosts without Direct3D.
+     *
+     * @param isEnabled true to run the shaders of the effects that have some.
+     */
+    void setShaderEmulation(bool isEnabled);
+
+    /**
+     * Returns true if the effects run their HLSL shaders on the CPU shader engine.
+     */
+    bool isShaderEmulationEnabled() const;
+
+    /**
+     * Runs a kernel over all the rows of an image, split into bands processed in parallel.
+     *
+     * @param rowCount Number of rows in the image.
+     * @param kernel The kernel to run on each band of rows [rowBegin, rowEnd).
+     */
+    void parallelForRows(int rowCount, const std::function<void(int rowBegin, int rowEnd)>& kernel);
+
+    /**
+     * Runs independent tasks, such as whole images, on the worker threads.
+     * Tasks may call parallelForRows, idle threads then help with their bands.
+     *
+     * @param taskCount Number of tasks.
+     * @param task The task to run for each index in [0, taskCount).
+     */
+    void parallelFor(int taskCount, const std::function<void(int taskIndex)>& task);
+
+    /**
+     * Queues a task, such as a whole image, to run on a worker thread and returns without waiting for it.
+     * The bands and tiles the task runs in parallel are stolen by the idle threads.
+     * The task runs on the calling thread when the manager has a single thread or is not initialized.
+     *
+     * @param task The task to run, which reports its own completion.
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * Runs a queued task on the calling thread, for threads waiting on submitted tasks to help instead of sleeping.
+     *
+     * @return true if a task was run, false if no task was queued.
+     */
+    bool runQueuedTask();
+
+    /**
+     * Runs a stencil kernel over an image split into square tiles sized so that a tile, its halo and its target fit in the L2 cache.
+     * Each tile is copied with its halo into a scratch image, the kernel writes the tile into the target scratch image, and the tile
+     * is written back to the image. Tiles read the image as it was before the call, so the kernel is not affected by its neighbours.
+     * A kernel that clamps its samples to the edges of the scratch image gives the same result as over the whole image,
+     * as long as the pixels of the tile depend on pixels at most haloSize pixels away.
+     *
+     * @param image The image to process.
+     * @param haloSize Number of pixels around the tile the kernel reads, on every side.
+     * @param kernel The kernel to run on each tile.
+     */
+    void parallelForTiles(const ImageView& image, int haloSize, const std::function<void(const ImageTile& tile)>& kernel);
+
+private:
+    std::unique_ptr<TaskScheduler> m_scheduler;
+    bool m_isShaderEmulationEnabled = false;
+};
@@ -0,0 +1,98 @@
+#include "CpuFeatures.h"
+
+#ifdef SIMD_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#ifdef SIMD_X86
+
+// runs CPUID for a leaf and sub-leaf, registers are returned as { eax, ebx, ecx, edx }
+static void QueryCpuid(unsigned int leaf, unsigned int subLeaf, unsigned int registers[4])
+{
+#if defined(_MSC_VER)
+    int values[4];
+    __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subLeaf));
+    for (int i = 0; i < 4; ++i)
+        registers[i] = static_cast<unsigned int>(values[i]);
+#else
+    registers[0] = registers[1] = registers[2] = registers[3] = 0;
+    __get_cpuid_count(leaf, subLeaf, &registers[0], &registers[1], &registers[2], &registers[3]);
+#endif
+}
+
+// returns the register state enabled by the operating system (XCR0)
+static unsigned long long QueryEnabledRegisterState()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
+// XCR0 bits of the SSE and AVX registers, and of the AVX-512 mask and upper registers
+#define XCR0_AVX_STATE 0x06ULL
+#define XCR0_AVX512_STATE 0xE0ULL
+
+static CpuFeatures DetectCpuFeatures()
+{
+    CpuFeatures features;
+    unsigned int registers[4];
+
+    // the L2 size in KB is in the upper half of ECX of extended leaf 0x80000006, on both Intel and AMD processors
+    QueryCpuid(0x80000000, 0, registers);
+    if (registers[0] >= 0x80000006)
+    {
+        QueryCpuid(0x80000006, 0, registers);
+        features.l2CacheSize = static_cast<int>(registers[2] >> 16) * 1024;
+    }
+
+    QueryCpuid(0, 0, registers);
+    unsigned int maxLeaf = registers[0];
+    if (maxLeaf < 1)
+        return features;
+
+    QueryCpuid(1, 0, registers);
+    features.hasSse2 = (registers[3] & (1u << 26)) != 0;
+    features.hasSsse3 = (registers[2] & (1u << 9)) != 0;
+
+    // the wide registers are only usable if the operating system saves them on context switches
+    bool hasOsXsave = (registers[2] & (1u << 27)) != 0;
+    bool hasAvx = (registers[2] & (1u << 28)) != 0;
+    if (!hasOsXsave || !hasAvx || maxLeaf < 7)
+        return features;
+
+    unsigned long long enabledState = QueryEnabledRegisterState();
+    bool isAvxStateEnabled = (enabledState & XCR0_AVX_STATE) == XCR0_AVX_STATE;
+    bool isAvx512StateEnabled = isAvxStateEnabled && (enabledState & XCR0_AVX512_STATE) == XCR0_AVX512_STATE;
+
+    QueryCpuid(7, 0, registers);
+    features.hasAvx2 = isAvxStateEnabled && (registers[1] & (1u << 5)) != 0;
+
+    bool hasAvx512f = (registers[1] & (1u << 16)) != 0;
+    features.hasAvx512bw = isAvx512StateEnabled && hasAvx512f && (registers[1] & (1u << 30)) != 0;
+    features.hasAvx512vbmi = features.hasAvx512bw && (registers[2] & (1u << 1)) != 0;
+
+    return features;
+}
+
+#else
+
+static CpuFeatures DetectCpuFeatures()
+{
+    return CpuFeatures();
+}
+
+#endif
+
+const CpuFeatures& GetCpuFeatures()
+{
+    static const CpuFeatures features = DetectCpuFeatures();
+    return features;
+}
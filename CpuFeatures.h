@@ -0,0 +1,37 @@
+#pragma once
+
+// set when compiling for an x86 / x64 processor, SIMD kernels are only available there
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#endif
+
+// set when compiling for x64, the AVX-512 kernels need 64-bit lane masks
+#if defined(_M_X64) || defined(__x86_64__)
+#define SIMD_X64 1
+#endif
+
+// allows a function to use an instruction set the rest of the file is not compiled for.
+// MSVC allows all intrinsics anywhere, GCC and Clang need the target attribute
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SIMD_TARGET(instructionSet)
+#else
+#define SIMD_TARGET(instructionSet) __attribute__((target(instructionSet)))
+#endif
+
+/**
+ * Instruction sets supported by both the processor and the operating system, and the cache size
+ * the CPU kernels size their tiles with, detected once with CPUID on first use.
+ */
+struct CpuFeatures {
+    bool hasSse2 = false;
+    bool hasSsse3 = false;
+    bool hasAvx2 = false;
+    bool hasAvx512bw = false;
+    bool hasAvx512vbmi = false;
+    int l2CacheSize = 0;  // size in bytes of the L2 cache of a core, 0 if unknown
+};
+
+/**
+ * Returns the instruction sets available on this machine.
+ */
+const CpuFeatures& GetCpuFeatures();
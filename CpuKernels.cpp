@@ -0,0 +1,752 @@
+#include "CpuKernels.h"
+#include "PixelFormat.h"
+#include "SimdKernels.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+// number of box blurs approximating a gaussian blur
+#define BLUR_BOX_PASSES 3
+
+// fixed point precision of the box blur's division by the window size
+#define BLUR_DIVISION_SHIFT 23
+
+// fixed point precision of the area weights of the shrink filter
+#define SHRINK_WEIGHT_SHIFT 14
+
+// fractional bits of the horizontally filtered values read by the vertical pass of the shrink filter
+#define SHRINK_INTERMEDIATE_SHIFT 8
+
+// fixed point precision of the waves' sub-pixel interpolation weight, as expected by InterpolateBytes
+#define WAVES_WEIGHT_SHIFT 8
+
+// radius in texture coordinates the fish-eye keeps in place, and its largest view angle in radians, as in FishEyePixelShader.hlsl
+#define FISHEYE_RADIUS 0.5f
+#define FISHEYE_MAX_ANGLE 1.5f
+
+#define MAX_CHANNELS 4
+
+// writes a float pixel back as 8-bit values, saturating like a UNORM render target
+static inline void StorePixel(const float* pixel, unsigned char* target, int channels)
+{
+    for (int c = 0; c < channels; ++c)
+        target[c] = static_cast<unsigned char>(std::min(std::max(pixel[c], 0.0f), 255.0f) + 0.5f);
+}
+
+void SampleBilinearClamped(const ImageView& source, float x, float y, float* out_pixel)
+{
+    int width = source.getWidth();
+    int height = source.getHeight();
+    int channels = source.getChannels();
+
+    // move to pixel-center space
+    x -= 0.5f;
+    y -= 0.5f;
+
+    float floorX = std::floor(x);
+    float floorY = std::floor(y);
+    float fractionX = x - floorX;
+    float fractionY = y - floorY;
+
+    int x0 = std::min(std::max(static_cast<int>(floorX), 0), width - 1);
+    int y0 = std::min(std::max(static_cast<int>(floorY), 0), height - 1);
+    int x1 = std::min(std::max(static_cast<int>(floorX) + 1, 0), width - 1);
+    int y1 = std::min(std::max(static_cast<int>(floorY) + 1, 0), height - 1);
+
+    const unsigned char* topLeft = source.getRow(y0) + x0 * channels;
+    const unsigned char* topRight = source.getRow(y0) + x1 * channels;
+    const unsigned char* bottomLeft = source.getRow(y1) + x0 * channels;
+    const unsigned char* bottomRight = source.getRow(y1) + x1 * channels;
+
+    for (int c = 0; c < channels; ++c)
+    {
+        float top = topLeft[c] + (topRight[c] - topLeft[c]) * fractionX;
+        float bottom = bottomLeft[c] + (bottomRight[c] - bottomLeft[c]) * fractionX;
+        out_pixel[c] = top + (bottom - top) * fractionY;
+    }
+}
+
+// returns the radiuses of box blurs whose succession approximates a gaussian of the given standard deviation
+static void GetGaussianBoxRadiuses(float sigma, int* out_radiuses)
+{
+    // ideal box width so that the variance of BLUR_BOX_PASSES boxes matches sigma^2, rounded to odd widths around it
+    float idealWidth = std::sqrt(12.0f * sigma * sigma / BLUR_BOX_PASSES + 1.0f);
+    int lowerWidth = static_cast<int>(std::floor(idealWidth));
+    if (lowerWidth % 2 == 0)
+        lowerWidth--;
+    int upperWidth = lowerWidth + 2;
+
+    // number of passes using the lower width
+    float idealLowerCount = (12.0f * sigma * sigma - BLUR_BOX_PASSES * lowerWidth * lowerWidth - 4.0f * BLUR_BOX_PASSES * lowerWidth - 3.0f * BLUR_BOX_PASSES) / (-4.0f * lowerWidth - 4.0f);
+    int lowerCount = static_cast<int>(std::round(idealLowerCount));
+
+    for (int i = 0; i < BLUR_BOX_PASSES; ++i)
+        out_radiuses[i] = std::max(0, ((i < lowerCount ? lowerWidth : upperWidth) - 1) / 2);
+}
+
+// returns the fixed point multiplier replacing a division by the box window size
+static inline unsigned int GetBoxDivisionMultiplier(int radius)
+{
+    unsigned int windowSize = 2 * radius + 1;
+    return ((1u << BLUR_DIVISION_SHIFT) + windowSize / 2) / windowSize;
+}
+
+// box blur of a single row with clamped edges, as a sliding window sum per channel kept in registers
+template <int Channels>
+static void BoxBlurRow(const unsigned char* sourceRow, unsigned char* targetRow, int width, int radius)
+{
+    unsigned int multiplier = GetBoxDivisionMultiplier(radius);
+    unsigned int rounding = 1u << (BLUR_DIVISION_SHIFT - 1);
+
+    // window centered on x = 0, the left part repeats the first pixel
+    unsigned int sums[Channels];
+    for (int c = 0; c < Channels; ++c)
+    {
+        sums[c] = (radius + 1) * sourceRow[c];
+        for (int i = 1; i <= radius; ++i)
+            sums[c] += sourceRow[std::min(i, width - 1) * Channels + c];
+    }
+
+    for (int x = 0; x < width; ++x)
+    {
+        const unsigned char* addedPixel = sourceRow + std::min(x + radius + 1, width - 1) * Channels;
+        const unsigned char* removedPixel = sourceRow + std::max(x - radius, 0) * Channels;
+        unsigned char* targetPixel = targetRow + x * Channels;
+
+        for (int c = 0; c < Channels; ++c)
+        {
+            targetPixel[c] = static_cast<unsigned char>((sums[c] * multiplier + rounding) >> BLUR_DIVISION_SHIFT);
+            sums[c] += addedPixel[c] - removedPixel[c];
+        }
+    }
+}
+
+// vertical box blur of the rows [rowBegin, rowEnd) with clamped edges.
+// keeps a running sum per row element, so the image is read row by row rather than column by column
+static void BoxBlurColumns(const ImageView& source, const ImageView& target, int radius, int rowBegin, int rowEnd)
+{
+    int height = source.getHeight();
+    size_t rowSize = source.getRowSize();
+    unsigned int multiplier = GetBoxDivisionMultiplier(radius);
+    unsigned int rounding = 1u << (BLUR_DIVISION_SHIFT - 1);
+
+    // window centered on the first row of the band
+    std::vector<unsigned int> sums(rowSize, 0);
+    for (int offset = -radius; offset <= radius; ++offset)
+    {
+        const unsigned char* row = source.getRow(std::min(std::max(rowBegin + offset, 0), height - 1));
+        for (size_t i = 0; i < rowSize; ++i)
+            sums[i] += row[i];
+    }
+
+    for (int y = rowBegin; y < rowEnd; ++y)
+    {
+        unsigned char* targetRow = target.getRow(y);
+        const unsigned char* addedRow = source.getRow(std::min(y + radius + 1, height - 1));
+        const unsigned char* removedRow = source.getRow(std::max(y - radius, 0));
+
+        for (size_t i = 0; i < rowSize; ++i)
+        {
+            targetRow[i] = static_cast<unsigned char>((sums[i] * multiplier + rounding) >> BLUR_DIVISION_SHIFT);
+            sums[i] += addedRow[i] - removedRow[i];
+        }
+    }
+}
+
+// the blur of a tile : the horizontal passes run in place on every row of the tile and its halo, then the vertical passes alternate
+// between the two scratch images on the columns of the tile only, the last one on the rows of the tile only.
+// each pass clamps at the edges of the scratch images, which only reaches as far into the tile as the sum of the radiuses
+template <int Channels>
+static void BlurTile(const ImageTile& tile, const int* boxRadiuses)
+{
+    const ImageView& source = tile.source;
+    int width = source.getWidth();
+    int height = source.getHeight();
+    size_t rowSize = source.getRowSize();
+    std::vector<unsigned char> scratchRows(2 * rowSize);
+
+    for (int y = 0; y < height; ++y)
+    {
+        unsigned char* row = source.getRow(y);
+        BoxBlurRow<Channels>(row, scratchRows.data(), width, boxRadiuses[0]);
+        BoxBlurRow<Channels>(scratchRows.data(), scratchRows.data() + rowSize, width, boxRadiuses[1]);
+        BoxBlurRow<Channels>(scratchRows.data() + rowSize, row, width, boxRadiuses[2]);
+    }
+
+    ImageView sourceColumns = source.getRegion(tile.innerX, 0, tile.innerWidth, height);
+    ImageView targetColumns = tile.target.getRegion(tile.innerX, 0, tile.innerWidth, height);
+    BoxBlurColumns(sourceColumns, targetColumns, boxRadiuses[0], 0, height);
+    BoxBlurColumns(targetColumns, sourceColumns, boxRadiuses[1], 0, height);
+    BoxBlurColumns(sourceColumns, targetColumns, boxRadiuses[2], tile.innerY, tile.innerY + tile.innerHeight);
+}
+
+// the passes of a tile run while it is in cache, so the image is read and written once whatever the radius,
+// instead of once per vertical pass. the halo covers the pixels the 3 passes reach together
+void ApplyGaussianBlur(const ImageView& image, float radius, CpuEffectManager* cpuManagerRef)
+{
+    if (radius <= 0.0f)
+        return;
+
+    int boxRadiuses[BLUR_BOX_PASSES];
+    GetGaussianBoxRadiuses(radius, boxRadiuses);
+
+    int haloSize = 0;
+    for (int pass = 0; pass < BLUR_BOX_PASSES; ++pass)
+        haloSize += boxRadiuses[pass];
+
+    DispatchChannelCount(image.getChannels(), [&](auto channelCount) {
+        constexpr int Channels = decltype(channelCount)::value;
+
+        cpuManagerRef->parallelForTiles(image, haloSize, [&](const ImageTile& tile) {
+            BlurTile<Channels>(tile, boxRadiuses);
+        });
+    });
+}
+
+void InitializeIdentityTables(ChannelTables* out_tables)
+{
+    for (int i = 0; i < MAX_CHANNELS * 256; ++i)
+        (*out_tables)[i] = static_cast<unsigned char>(i & 255);
+}
+
+void ComposeChannelTables(const ChannelTables& nextTables, int channels, ChannelTables* tables)
+{
+    for (int c = 0; c < channels; ++c)
+    {
+        unsigned char* table = tables->data() + c * 256;
+        const unsigned char* nextTable = nextTables.data() + c * 256;
+        for (int v = 0; v < 256; ++v)
+            table[v] = nextTable[table[v]];
+    }
+}
+
+// the rows of a band of packed images are contiguous so they are looked up at once, padded rows one by one
+void ApplyChannelTablesKernel(const ImageView& source, const ImageView& target, const ChannelTables& tables, int rowBegin, int rowEnd)
+{
+    size_t rowSize = source.getRowSize();
+    int channels = source.getChannels();
+
+    if (source.isPacked() && target.isPacked())
+    {
+        ApplyChannelTables(source.getRow(rowBegin), target.getRow(rowBegin), (rowEnd - rowBegin) * rowSize, channels, tables.data());
+        return;
+    }
+
+    for (int y = rowBegin; y < rowEnd; ++y)
+        ApplyChannelTables(source.getRow(y), target.getRow(y), rowSize, channels, tables.data());
+}
+
+unsigned char CorrectGammaValue(unsigned char value, float gamma)
+{
+    return static_cast<unsigned char>(255.0f * std::pow(value / 255.0f, 1.0f / gamma) + 0.5f);
+}
+
+// the input range is clamped, normalized and gamma corrected, then scaled to the output range
+unsigned char AdjustLevelsValue(unsigned char value, const LevelsParameters& parameters)
+{
+    float inputRange = std::max(parameters.inputWhite - parameters.inputBlack, 1.0f);
+    float normalized = std::min(std::max((value - parameters.inputBlack) / inputRange, 0.0f), 1.0f);
+    float corrected = std::pow(normalized, 1.0f / parameters.gamma);
+    float adjusted = parameters.outputBlack + corrected * (parameters.outputWhite - parameters.outputBlack);
+    return static_cast<unsigned char>(std::min(std::max(adjusted, 0.0f), 255.0f) + 0.5f);
+}
+
+void MapMirrorSourcePosition(float x, float y, int width, int height, float* out_x, float* out_y)
+{
+    *out_x = width - x;
+    *out_y = y;
+}
+
+// horizontal flip, each texture coordinate u samples 1 - u. every row is reversed in place in the target,
+// so mirroring costs one read and one write per pixel when source and target view the same pixels
+void ApplyMirrorKernel(const ImageView& source, const ImageView& target, int rowBegin, int rowEnd)
+{
+    size_t rowSize = source.getRowSize();
+
+    for (int y = rowBegin; y < rowEnd; ++y)
+    {
+        unsigned char* targetRow = target.getRow(y);
+
+        if (source.getData() != target.getData())
+            std::copy(source.getRow(y), source.getRow(y) + rowSize, targetRow);
+
+        ReversePixels(targetRow, source.getWidth(), source.getChannels());
+    }
+}
+
+void GetShrinkDimensions(int width, int height, float factor, int* out_width, int* out_height)
+{
+    *out_width = std::max(1, static_cast<int>(width / factor + 0.5f));
+    *out_height = std::max(1, static_cast<int>(height / factor + 0.5f));
+}
+
+// the source pixels covered by each target pixel of an area downsampling, with their fixed point coverage
+struct AreaFilterTaps {
+    std::vector<int> sourceBegins;  // first source pixel of each target pixel
+    std::vector<int> tapOffsets;    // index of the first weight of each target pixel, followed by the total weight count
+    std::vector<int> weights;       // coverages of the source pixels, summing to 1 << SHRINK_WEIGHT_SHIFT per target pixel
+};
+
+// target pixel t covers the source interval [t * scale, (t + 1) * scale), partially covered pixels get partial weights
+static void GetAreaFilterTaps(int sourceSize, int targetSize, AreaFilterTaps* out_taps)
+{
+    double scale = static_cast<double>(sourceSize) / targetSize;
+    out_taps->sourceBegins.resize(targetSize);
+    out_taps->tapOffsets.resize(targetSize + 1);
+    out_taps->weights.clear();
+
+    for (int t = 0; t < targetSize; ++t)
+    {
+        double areaBegin = t * scale;
+        double areaEnd = (t + 1) * scale;
+        int sourceBegin = static_cast<int>(std::floor(areaBegin));
+        int sourceEnd = std::min(static_cast<int>(std::ceil(areaEnd)), sourceSize);
+
+        out_taps->sourceBegins[t] = sourceBegin;
+        out_taps->tapOffsets[t] = static_cast<int>(out_taps->weights.size());
+
+        size_t largestWeightIndex = out_taps->weights.size();
+        int weightSum = 0;
+        for (int s = sourceBegin; s < sourceEnd; ++s)
+        {
+            double coverage = std::min(areaEnd, s + 1.0) - std::max(areaBegin, static_cast<double>(s));
+            int weight = std::max(0, static_cast<int>(std::lround(coverage / scale * (1 << SHRINK_WEIGHT_SHIFT))));
+            out_taps->weights.push_back(weight);
+            weightSum += weight;
+
+            if (weight > out_taps->weights[largestWeightIndex])
+                largestWeightIndex = out_taps->weights.size() - 1;
+        }
+
+        // the rounding error goes to the largest weight, so flat areas stay exactly flat
+        out_taps->weights[largestWeightIndex] += (1 << SHRINK_WEIGHT_SHIFT) - weightSum;
+    }
+
+    out_taps->tapOffsets[targetSize] = static_cast<int>(out_taps->weights.size());
+}
+
+// area filters a source row into targetWidth values with SHRINK_INTERMEDIATE_SHIFT fractional bits
+template <int Channels>
+static void FilterShrinkRow(const unsigned char* sourceRow, unsigned short* targetRow, int targetWidth, const AreaFilterTaps& taps)
+{
+    const int shift = SHRINK_WEIGHT_SHIFT - SHRINK_INTERMEDIATE_SHIFT;
+
+    for (int x = 0; x < targetWidth; ++x)
+    {
+        const unsigned char* source = sourceRow + taps.sourceBegins[x] * Channels;
+        const int* weights = taps.weights.data() + taps.tapOffsets[x];
+        int tapCount = taps.tapOffsets[x + 1] - taps.tapOffsets[x];
+
+        int sums[Channels] = {};
+        for (int k = 0; k < tapCount; ++k)
+        {
+            for (int c = 0; c < Channels; ++c)
+                sums[c] += source[k * Channels + c] * weights[k];
+        }
+
+        for (int c = 0; c < Channels; ++c)
+            targetRow[x * Channels + c] = static_cast<unsigned short>((sums[c] + (1 << (shift - 1))) >> shift);
+    }
+}
+
+// separable area filter for any ratio : the source rows covered by each target row are filtered horizontally,
+// then summed with their vertical coverage. rows shared by two target rows are filtered for both
+template <int Channels>
+static void ShrinkByAreaFilter(const ImageView& source, const ImageView& target, CpuEffectManager* cpuManagerRef)
+{
+    int targetWidth = target.getWidth();
+    int targetHeight = target.getHeight();
+
+    AreaFilterTaps horizontalTaps;
+    AreaFilterTaps verticalTaps;
+    GetAreaFilterTaps(source.getWidth(), targetWidth, &horizontalTaps);
+    GetAreaFilterTaps(source.getHeight(), targetHeight, &verticalTaps);
+
+    size_t targetRowSize = target.getRowSize();
+    const int shift = SHRINK_WEIGHT_SHIFT + SHRINK_INTERMEDIATE_SHIFT;
+
+    cpuManagerRef->parallelForRows(targetHeight, [&](int rowBegin, int rowEnd) {
+        std::vector<unsigned short> filteredRow(targetRowSize);
+        std::vector<unsigned int> sums(targetRowSize);
+
+        for (int y = rowBegin; y < rowEnd; ++y)
+        {
+            const int* weights = verticalTaps.weights.data() + verticalTaps.tapOffsets[y];
+            int tapCount = verticalTaps.tapOffsets[y + 1] - verticalTaps.tapOffsets[y];
+
+            std::fill(sums.begin(), sums.end(), 0u);
+            for (int k = 0; k < tapCount; ++k)
+            {
+                FilterShrinkRow<Channels>(source.getRow(verticalTaps.sourceBegins[y] + k), filteredRow.data(), targetWidth, horizontalTaps);
+
+                unsigned int weight = static_cast<unsigned int>(weights[k]);
+                for (size_t i = 0; i < targetRowSize; ++i)
+                    sums[i] += filteredRow[i] * weight;
+            }
+
+            unsigned char* targetRow = target.getRow(y);
+            for (size_t i = 0; i < targetRowSize; ++i)
+                targetRow[i] = static_cast<unsigned char>((sums[i] + (1u << (shift - 1))) >> shift);
+        }
+    });
+}
+
+// repeats a pixel count times, doubling the filled span with each copy
+static void FillPixels(unsigned char* target, const unsigned char* pixel, int count, int channels)
+{
+    if (count <= 0)
+        return;
+
+    size_t filledSize = channels;
+    size_t totalSize = static_cast<size_t>(count) * channels;
+    std::copy(pixel, pixel + channels, target);
+    while (filledSize < totalSize)
+    {
+        size_t copySize = std::min(filledSize, totalSize - filledSize);
+        std::copy(target, target + copySize, target + filledSize);
+        filledSize += copySize;
+    }
+}
+
+// centers the shrunken image in the full size image, the border repeats its edge pixels like the clamped sampler
+static void PadShrunkImage(const ImageView& shrunkImage, const ImageView& image, CpuEffectManager* cpuManagerRef)
+{
+    int width = image.getWidth();
+    int channels = image.getChannels();
+    int shrunkWidth = shrunkImage.getWidth();
+    int shrunkHeight = shrunkImage.getHeight();
+    int left = (width - shrunkWidth) / 2;
+    int top = (image.getHeight() - shrunkHeight) / 2;
+    size_t shrunkRowSize = shrunkImage.getRowSize();
+
+    cpuManagerRef->parallelForRows(image.getHeight(), [&](int rowBegin, int rowEnd) {
+        for (int y = rowBegin; y < rowEnd; ++y)
+        {
+            const unsigned char* shrunkRow = shrunkImage.getRow(std::min(std::max(y - top, 0), shrunkHeight - 1));
+            unsigned char* targetRow = image.getRow(y);
+            const unsigned char* lastPixel = shrunkRow + shrunkRowSize - channels;
+
+            FillPixels(targetRow, shrunkRow, left, channels);
+            std::copy(shrunkRow, shrunkRow + shrunkRowSize, targetRow + left * channels);
+            FillPixels(targetRow + (left + shrunkWidth) * channels, lastPixel, width - left - shrunkWidth, channels);
+        }
+    });
+}
+
+// area averaged downsampling. exact halving averages 2x2 blocks with a vectorized row kernel,
+// other ratios use the separable area filter. both write a scratch image the result is then copied or padded from
+void ApplyAreaShrink(const ImageView& image, float factor, bool isPadded, CpuEffectManager* cpuManagerRef)
+{
+    int width = image.getWidth();
+    int height = image.getHeight();
+    int channels = image.getChannels();
+
+    int shrunkWidth, shrunkHeight;
+    GetShrinkDimensions(width, height, factor, &shrunkWidth, &shrunkHeight);
+    if (shrunkWidth == width && shrunkHeight == height)
+        return;
+
+    Image shrunkImage(shrunkWidth, shrunkHeight, channels);
+    const ImageView& shrunkView = shrunkImage.getView();
+
+    if (width == 2 * shrunkWidth && height == 2 * shrunkHeight)
+    {
+        cpuManagerRef->parallelForRows(shrunkHeight, [&](int rowBegin, int rowEnd) {
+            for (int y = rowBegin; y < rowEnd; ++y)
+                DownsampleRow2x2(image.getRow(2 * y), image.getRow(2 * y + 1), shrunkView.getRow(y), shrunkWidth, channels);
+        });
+    }
+    else
+    {
+        DispatchChannelCount(channels, [&](auto channelCount) {
+            ShrinkByAreaFilter<decltype(channelCount)::value>(image, shrunkView, cpuManagerRef);
+        });
+    }
+
+    if (isPadded)
+        PadShrunkImage(shrunkView, image, cpuManagerRef);
+    else
+        shrunkView.copyTo(image.getRegion(0, 0, shrunkWidth, shrunkHeight));
+}
+
+// BT.601 luma of a color pixel with at least 3 color channels, in 8-bit fixed point as in EdgeDetectionPixelShader.hlsl
+static inline int GetPixelLuma(const unsigned char* pixel)
+{
+    return (77 * pixel[0] + 150 * pixel[1] + 29 * pixel[2] + 128) >> 8;
+}
+
+// converts a row to luma once, with BT.601 weights in 8-bit fixed point as in EdgeDetectionPixelShader.hlsl.
+// the luma row is padded with the edge values on both sides for the sobel operator
+template <int Channels>
+static void ConvertRowToLuma(const unsigned char* sourceRow, short* lumaRow, int width)
+{
+    for (int x = 0; x < width; ++x)
+    {
+        const unsigned char* pixel = sourceRow + x * Channels;
+        lumaRow[x] = static_cast<short>(Channels >= 3 ? GetPixelLuma(pixel) : pixel[0]);
+    }
+
+    lumaRow[-1] = lumaRow[0];
+    lumaRow[width] = lumaRow[width - 1];
+}
+
+// sobel operator on the grayscale image, white where the gradient magnitude passes the threshold and black elsewhere.
+// neighbours are one texel apart for the real image size. each source row is converted to luma once, into a ring of
+// three rows that rolls down the band, and the gradients and threshold are computed together in integers
+template <int Channels>
+static void DetectEdges(const ImageView& source, const ImageView& target, float threshold, int rowBegin, int rowEnd)
+{
+    int width = source.getWidth();
+    int height = source.getHeight();
+    // the threshold is on values in [0, 1], the luma rows are in 8-bit units
+    float scaledThreshold = threshold * 255;
+    int squaredThreshold = static_cast<int>(scaledThreshold * scaledThreshold);
+
+    // padded luma rows, slot (y % 3) holds row y
+    size_t paddedWidth = static_cast<size_t>(width) + 2;
+    std::vector<short> lumaRing(3 * paddedWidth);
+    std::vector<unsigned char> edgeMask(width);
+
+    auto lumaRow = [&](int y) { return lumaRing.data() + ((y + 3) % 3) * paddedWidth + 1; };
+    auto clampRow = [&](int y) { return std::min(std::max(y, 0), height - 1); };
+
+    ConvertRowToLuma<Channels>(source.getRow(clampRow(rowBegin - 1)), lumaRow(rowBegin - 1), width);
+    ConvertRowToLuma<Channels>(source.getRow(rowBegin), lumaRow(rowBegin), width);
+
+    constexpr bool hasAlpha = GetColorChannelCount(Channels) != Channels;
+
+    for (int y = rowBegin; y < rowEnd; ++y)
+    {
+        // the row below replaces the row that is no longer needed
+        ConvertRowToLuma<Channels>(source.getRow(clampRow(y + 1)), lumaRow(y + 1), width);
+        DetectSobelEdgesRow(lumaRow(y - 1), lumaRow(y), lumaRow(y + 1), edgeMask.data(), width, squaredThreshold);
+
+        unsigned char* targetRow = target.getRow(y);
+        for (int x = 0; x < width; ++x)
+        {
+            unsigned char* targetPixel = targetRow + x * Channels;
+            for (int c = 0; c < Channels; ++c)
+                targetPixel[c] = edgeMask[x];
+            if (hasAlpha)
+                targetPixel[Channels - 1] = 255;
+        }
+    }
+}
+
+void ApplyEdgeDetectionKernel(const ImageView& source, const ImageView& target, float threshold, int rowBegin, int rowEnd)
+{
+    DispatchChannelCount(source.getChannels(), [&](auto channelCount) {
+        DetectEdges<decltype(channelCount)::value>(source, target, threshold, rowBegin, rowEnd);
+    });
+}
+
+// histograms of a band of rows : one per color channel, or a single luma histogram
+typedef std::array<std::array<unsigned int, 256>, MAX_CHANNELS> ChannelHistograms;
+
+template <int Channels>
+static void CountHistogramRows(const ImageView& image, EqualizationMode mode, int rowBegin, int rowEnd, ChannelHistograms* out_histograms)
+{
+    constexpr int colorChannels = GetColorChannelCount(Channels);
+    size_t rowSize = image.getRowSize();
+    bool isLuma = mode == EqualizationMode::Luma && colorChannels >= 3;
+
+    for (int y = rowBegin; y < rowEnd; ++y)
+    {
+        const unsigned char* row = image.getRow(y);
+
+        if (isLuma)
+        {
+            for (size_t i = 0; i < rowSize; i += Channels)
+                (*out_histograms)[0][GetPixelLuma(row + i)]++;
+            continue;
+        }
+
+        for (size_t i = 0; i < rowSize; i += Channels)
+        {
+            for (int c = 0; c < colorChannels; ++c)
+                (*out_histograms)[c][row[i + c]]++;
+        }
+    }
+}
+
+// maps each value to its rank in the cumulative histogram, stretched so the darkest present value becomes 0 and the brightest 255.
+// an image of a single value keeps it
+static void BuildEqualizationTable(const std::array<unsigned int, 256>& histogram, unsigned char* out_table)
+{
+    unsigned long long valueCount = 0;
+    unsigned long long minimalCumulativeCount = 0;
+    for (unsigned int count : histogram)
+    {
+        if (!minimalCumulativeCount)
+            minimalCumulativeCount = count;
+        valueCount += count;
+    }
+
+    unsigned long long range = valueCount - minimalCumulativeCount;
+    unsigned long long cumulativeCount = 0;
+    for (int v = 0; v < 256; ++v)
+    {
+        cumulativeCount += histogram[v];
+        if (!range)
+            out_table[v] = static_cast<unsigned char>(v);
+        else if (cumulativeCount < minimalCumulativeCount)
+            out_table[v] = 0;
+        else
+            out_table[v] = static_cast<unsigned char>(((cumulativeCount - minimalCumulativeCount) * 255 + range / 2) / range);
+    }
+}
+
+// two passes over the image : every thread counts a part of the rows into its own histograms, which are merged into the tables
+// of the channels, then the tables are applied on bands of rows
+void ApplyHistogramEqualization(const ImageView& image, EqualizationMode mode, CpuEffectManager* cpuManagerRef)
+{
+    int height = image.getHeight();
+    int channels = image.getChannels();
+    int partCount = std::max(1, std::min(cpuManagerRef->getThreadCount(), height));
+    std::vector<ChannelHistograms> partHistograms(partCount);
+
+    cpuManagerRef->parallelFor(partCount, [&](int partIndex) {
+        ChannelHistograms& histograms = partHistograms[partIndex];
+        for (std::array<unsigned int, 256>& histogram : histograms)
+            histogram.fill(0);
+
+        DispatchChannelCount(channels, [&](auto channelCount) {
+            CountHistogramRows<decltype(channelCount)::value>(image, mode, partIndex * height / partCount, (partIndex + 1) * height / partCount, &histograms);
+        });
+    });
+
+    ChannelHistograms histograms = partHistograms[0];
+    for (int part = 1; part < partCount; ++part)
+    {
+        for (int c = 0; c < MAX_CHANNELS; ++c)
+        {
+            for (int v = 0; v < 256; ++v)
+                histograms[c][v] += partHistograms[part][c][v];
+        }
+    }
+
+    // the global histogram pools the color channels, luma of gray images is their single channel
+    int colorChannels = GetColorChannelCount(channels);
+    if (mode == EqualizationMode::Global)
+    {
+        for (int c = 1; c < colorChannels; ++c)
+        {
+            for (int v = 0; v < 256; ++v)
+                histograms[0][v] += histograms[c][v];
+        }
+    }
+
+    ChannelTables tables;
+    InitializeIdentityTables(&tables);
+    for (int c = 0; c < colorChannels; ++c)
+    {
+        if (mode == EqualizationMode::PerChannel || c == 0)
+            BuildEqualizationTable(histograms[c], tables.data() + c * 256);
+        else
+            std::copy(tables.begin(), tables.begin() + 256, tables.begin() + c * 256);
+    }
+
+    cpuManagerRef->parallelForRows(height, [&](int rowBegin, int rowEnd) {
+        ApplyChannelTablesKernel(image, image, tables, rowBegin, rowEnd);
+    });
+}
+
+// horizontal shift in pixels of a row, v being the texture coordinate of the row
+static float GetWavesRowShift(float v, int width, const WavesParameters& parameters)
+{
+    return std::sin(v * parameters.frequency + parameters.phase) * parameters.amplitude * width;
+}
+
+void MapWavesSourcePosition(float x, float y, int width, int height, const WavesParameters& parameters, float* out_x, float* out_y)
+{
+    float waveShift = GetWavesRowShift(y / height, width, parameters);
+    *out_x = x + (parameters.isInterpolated ? waveShift : std::round(waveShift));
+    *out_y = y;
+}
+
+// the lens is an equidistant fish-eye over a rectilinear source : a target point at radius r from the center, r = 1 being
+// half the image in texture coordinates, views the angle r * lensAngle and samples the source at radius tan(r * lensAngle) / tan(lensAngle).
+// the center is magnified and r = 1 stays in place, angles are capped below pi / 2 where the tangent diverges
+void MapFishEyeSourcePosition(float x, float y, int width, int height, const FishEyeParameters& parameters, float* out_x, float* out_y)
+{
+    float lensAngle = std::min(std::max(parameters.strength, 0.0f), 1.0f) * FISHEYE_MAX_ANGLE;
+    float u = x / width - parameters.centerX;
+    float v = y / height - parameters.centerY;
+    float radius = std::sqrt(u * u + v * v) / FISHEYE_RADIUS;
+
+    float scale = 1.0f;
+    if (lensAngle > 0.0f && radius > 0.0f)
+        scale = std::tan(std::min(radius * lensAngle, FISHEYE_MAX_ANGLE)) / (std::tan(lensAngle) * radius);
+
+    *out_x = (parameters.centerX + u * scale) * width;
+    *out_y = (parameters.centerY + v * scale) * height;
+}
+
+// writes target pixel x as source pixel x + pixelShift blended with the next source pixel by rightWeight / 256,
+// source positions clamped to the row. pixels whose two source pixels are inside the row are a single bulk
+// copy or interpolation, only the pixels near the edges are handled one by one
+static void ShiftRow(const unsigned char* sourceRow, unsigned char* targetRow, int width, int channels, int pixelShift, int rightWeight)
+{
+    int rightOffset = rightWeight ? 1 : 0;
+    int interiorBegin = std::min(std::max(-pixelShift, 0), width);
+    int interiorEnd = std::min(std::max(width - rightOffset - pixelShift, interiorBegin), width);
+
+    auto shiftEdgePixels = [&](int pixelBegin, int pixelEnd) {
+        for (int x = pixelBegin; x < pixelEnd; ++x)
+        {
+            const unsigned char* leftPixel = sourceRow + std::min(std::max(x + pixelShift, 0), width - 1) * channels;
+            const unsigned char* rightPixel = sourceRow + std::min(std::max(x + pixelShift + 1, 0), width - 1) * channels;
+            for (int c = 0; c < channels; ++c)
+                targetRow[x * channels + c] = static_cast<unsigned char>((leftPixel[c] * (256 - rightWeight) + rightPixel[c] * rightWeight + 128) >> WAVES_WEIGHT_SHIFT);
+        }
+    };
+
+    shiftEdgePixels(0, interiorBegin);
+
+    const unsigned char* leftData = sourceRow + static_cast<size_t>(interiorBegin + pixelShift) * channels;
+    size_t interiorSize = static_cast<size_t>(interiorEnd - interiorBegin) * channels;
+    if (rightWeight)
+        InterpolateBytes(leftData, leftData + channels, targetRow + interiorBegin * channels, interiorSize, rightWeight);
+    else
+        std::copy(leftData, leftData + interiorSize, targetRow + interiorBegin * channels);
+
+    shiftEdgePixels(interiorEnd, width);
+}
+
+// horizontal sine displacement that depends only on the row, as in WavesPixelShader.hlsl.
+// every row is its source row shifted by a constant amount, so the shift is computed once per row
+void ApplyWavesKernel(const ImageView& source, const ImageView& target, const WavesParameters& parameters, int rowBegin, int rowEnd)
+{
+    int width = source.getWidth();
+    int height = source.getHeight();
+    size_t rowSize = source.getRowSize();
+    bool isInPlace = source.getData() == target.getData();
+    std::vector<unsigned char> rowCopy(isInPlace ? rowSize : 0);
+
+    for (int y = rowBegin; y < rowEnd; ++y)
+    {
+        const unsigned char* sourceRow = source.getRow(y);
+        unsigned char* targetRow = target.getRow(y);
+
+        if (isInPlace)
+        {
+            std::copy(sourceRow, sourceRow + rowSize, rowCopy.begin());
+            sourceRow = rowCopy.data();
+        }
+
+        // the shift is clamped to the width, larger shifts only repeat the edge pixel
+        float v = (y + 0.5f) / height;
+        float waveShift = std::min(std::max(GetWavesRowShift(v, width, parameters), -static_cast<float>(width)), static_cast<float>(width));
+
+        int pixelShift = static_cast<int>(parameters.isInterpolated ? std::floor(waveShift) : std::round(waveShift));
+        int rightWeight = parameters.isInterpolated ? static_cast<int>(std::round((waveShift - pixelShift) * (1 << WAVES_WEIGHT_SHIFT))) : 0;
+        if (rightWeight == (1 << WAVES_WEIGHT_SHIFT))
+        {
+            pixelShift++;
+            rightWeight = 0;
+        }
+
+        ShiftRow(sourceRow, targetRow, width, source.getChannels(), pixelShift, rightWeight);
+    }
+}
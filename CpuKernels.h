@@ -0,0 +1,106 @@
+#pragma once
+#include "CpuEffectManager.h"
+#include "Image.h"
+#include <array>
+#include <cmath>
+
+/*
+    CPU implementations of the effects' shaders.
+    All kernels work on views of interleaved 8-bit images with 1 to 4 channels, whose rows may be padded up to their stride,
+    and write the rows [rowBegin, rowEnd) of target. Kernels that sample other pixels read them from source, which must not
+    alias target, point kernels may be called with source and target viewing the same pixels.
+    Sampling follows the D3D11 default sampler : bilinear filtering and clamped texture coordinates.
+*/
+
+// returns the number of color channels of a pixel, the last channel of 2 and 4 channel images is alpha
+constexpr int GetColorChannelCount(int channels)
+{
+    return (channels == 2 || channels == 4) ? channels - 1 : channels;
+}
+
+// contrast stretch of EqualizationPixelShader.hlsl : (x - 0.5) * contrast + 0.5. in 8-bit values this is (v - 127.5) * contrast + 127.5,
+// rounded down so the default contrast 2 gives 2v - 128
+inline unsigned char StretchContrastValue(unsigned char value, float contrast)
+{
+    float stretched = std::floor((value - 127.5f) * contrast + 127.5f);
+    return static_cast<unsigned char>(stretched < 0.0f ? 0.0f : (stretched > 255.0f ? 255.0f : stretched));
+}
+
+// 256 entry tables of a point operation, one per channel back to back : channel c maps value v to tables[c * 256 + v]
+typedef std::array<unsigned char, 4 * 256> ChannelTables;
+
+// input range [inputBlack, inputWhite] of the levels effect, gamma corrected and stretched to [outputBlack, outputWhite]
+struct LevelsParameters {
+    float inputBlack;
+    float inputWhite;
+    float gamma;
+    float outputBlack;
+    float outputWhite;
+};
+
+// parameters of the waves effect, every row is shifted horizontally by sin(v * frequency + phase) * amplitude * width pixels
+struct WavesParameters {
+    float amplitude;        // in image widths
+    float frequency;        // in radians per image height
+    float phase;            // in radians
+    bool isInterpolated;    // blends the two source pixels around a sub-pixel shift, otherwise the shift is rounded to whole pixels
+};
+
+// parameters of the fish-eye effect, the lens center is in texture coordinates and strength in [0, 1] scales its field of view
+struct FishEyeParameters {
+    float strength;
+    float centerX;
+    float centerY;
+};
+
+// how the equalization effect remaps the color values
+enum class EqualizationMode {
+    ContrastStretch,    // fixed contrast stretch of EqualizationPixelShader.hlsl
+    Global,             // histogram equalization with a single histogram of all the color channels
+    PerChannel,         // histogram equalization of each color channel on its own
+    Luma                // histogram equalization of the luma, its mapping is applied to every color channel
+};
+
+// point operations on a single 8-bit value
+unsigned char CorrectGammaValue(unsigned char value, float gamma);
+unsigned char AdjustLevelsValue(unsigned char value, const LevelsParameters& parameters);
+
+// fills all the tables with the identity
+void InitializeIdentityTables(ChannelTables* out_tables);
+
+// composes the tables of the first channels with the tables of a point operation applied after them
+void ComposeChannelTables(const ChannelTables& nextTables, int channels, ChannelTables* tables);
+
+// texel space source positions sampled by the coordinate effects for a target position
+void MapMirrorSourcePosition(float x, float y, int width, int height, float* out_x, float* out_y);
+void MapWavesSourcePosition(float x, float y, int width, int height, const WavesParameters& parameters, float* out_x, float* out_y);
+void MapFishEyeSourcePosition(float x, float y, int width, int height, const FishEyeParameters& parameters, float* out_x, float* out_y);
+
+// samples the image at a texel space position (pixel centers at x + 0.5) into a float pixel
+void SampleBilinearClamped(const ImageView& source, float x, float y, float* out_pixel);
+
+// gaussian blur of the given standard deviation in pixels, approximated by 3 box blurs.
+// each box pass is a sliding window sum, so the cost per pixel does not depend on the radius
+void ApplyGaussianBlur(const ImageView& image, float radius, CpuEffectManager* cpuManagerRef);
+
+// looks every value up in the table of its channel, may be called with source and target viewing the same pixels
+void ApplyChannelTablesKernel(const ImageView& source, const ImageView& target, const ChannelTables& tables, int rowBegin, int rowEnd);
+
+// may be called with source and target viewing the same pixels
+void ApplyMirrorKernel(const ImageView& source, const ImageView& target, int rowBegin, int rowEnd);
+
+// size of the image a shrink by factor produces, rounded to whole pixels and at least 1x1
+void GetShrinkDimensions(int width, int height, float factor, int* out_width, int* out_height);
+
+// area averaged shrink by factor, each target pixel is the mean of the source area it covers.
+// padded, the result is centered in the width x height image and its edges repeat over the border as in ShrinkVertexShader.hlsl,
+// otherwise the smaller image is written in the top left region of the image
+void ApplyAreaShrink(const ImageView& image, float factor, bool isPadded, CpuEffectManager* cpuManagerRef);
+
+void ApplyEdgeDetectionKernel(const ImageView& source, const ImageView& target, float threshold, int rowBegin, int rowEnd);
+
+// histogram equalization of the whole image in the given histogram mode, alpha passes through
+void ApplyHistogramEqualization(const ImageView& image, EqualizationMode mode, CpuEffectManager* cpuManagerRef);
+
+// may be called with source and target viewing the same pixels, each row is then copied before being shifted
+void ApplyWavesKernel(const ImageView& source, const ImageView& target, const WavesParameters& parameters, int rowBegin, int rowEnd);
@@ -0,0 +1,632 @@
+#include "CpuShader.h"
+#include "BufferPool.h"
+#include "EffectCache.h"
+#include "PixelFormat.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#define LANE_COUNT CPU_SHADER_LANE_COUNT
+
+// runs an expression for every lane l of the registers of an instruction
+#define FOR_EACH_LANE(expression) for (int l = 0; l < LANE_COUNT; ++l) { expression; }
+
+// semantics the stages are linked with
+#define POSITION_SEMANTIC "POSITION0"
+#define TEXCOORD_SEMANTIC "TEXCOORD0"
+#define SV_POSITION_SEMANTIC "SV_POSITION0"
+#define SV_TARGET_SEMANTIC "SV_TARGET0"
+
+// positions between texels a sampler tells apart along each axis
+#define SUBTEXEL_STEPS 256.0f
+
+// the fullscreen quad of the GPU backend, drawn as a triangle strip : positions and texture coordinates of its vertices
+static const float QUAD_VERTEX_POSITIONS[4][4] = { { -1.0f, 1.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 0.0f, 1.0f }, { -1.0f, -1.0f, 0.0f, 1.0f }, { 1.0f, -1.0f, 0.0f, 1.0f } };
+static const float QUAD_VERTEX_TEXCOORDS[4][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 1.0f } };
+
+// returns the texel at a position clamped to the texture
+static inline const unsigned char* GetClampedTexel(const CpuShaderTexture& texture, int x, int y)
+{
+    x = std::min(std::max(x, 0), texture.width - 1);
+    y = std::min(std::max(y, 0), texture.height - 1);
+    return texture.rgbaData + (static_cast<size_t>(y) * texture.width + x) * 4;
+}
+
+// bilinear sample at texture coordinates, clamped to the edges like the default sampler of the GPU.
+// coordinates far outside of the texture are clamped before the conversion to integers, and NaN samples the first texel
+static void SampleTexture(const CpuShaderTexture& texture, float u, float v, float* out_rgba)
+{
+    float x = u * texture.width - 0.5f;
+    float y = v * texture.height - 0.5f;
+    x = x == x ? std::min(std::max(x, -1.0f), static_cast<float>(texture.width)) : 0.0f;
+    y = y == y ? std::min(std::max(y, -1.0f), static_cast<float>(texture.height)) : 0.0f;
+
+    // the weights are snapped to the 8 bits of subtexel precision of Direct3D 11 samplers, so samples at texel centers are exact
+    float left = std::floor(x);
+    float top = std::floor(y);
+    float fractionX = std::round((x - left) * SUBTEXEL_STEPS) * (1.0f / SUBTEXEL_STEPS);
+    float fractionY = std::round((y - top) * SUBTEXEL_STEPS) * (1.0f / SUBTEXEL_STEPS);
+    int column = static_cast<int>(left);
+    int row = static_cast<int>(top);
+
+    const unsigned char* topLeft = GetClampedTexel(texture, column, row);
+    const unsigned char* topRight = GetClampedTexel(texture, column + 1, row);
+    const unsigned char* bottomLeft = GetClampedTexel(texture, column, row + 1);
+    const unsigned char* bottomRight = GetClampedTexel(texture, column + 1, row + 1);
+
+    for (int c = 0; c < 4; ++c)
+    {
+        float topValue = topLeft[c] + (topRight[c] - topLeft[c]) * fractionX;
+        float bottomValue = bottomLeft[c] + (bottomRight[c] - bottomLeft[c]) * fractionX;
+        out_rgba[c] = (topValue + (bottomValue - topValue) * fractionY) / 255.0f;
+    }
+}
+
+// texel at integer coordinates, 0 outside of the texture like a GPU load
+static void LoadTexel(const CpuShaderTexture& texture, float x, float y, float* out_rgba)
+{
+    if (!(x >= 0.0f && x < texture.width && y >= 0.0f && y < texture.height))
+    {
+        std::fill(out_rgba, out_rgba + 4, 0.0f);
+        return;
+    }
+
+    const unsigned char* texel = GetClampedTexel(texture, static_cast<int>(x), static_cast<int>(y));
+    for (int c = 0; c < 4; ++c)
+        out_rgba[c] = texel[c] / 255.0f;
+}
+
+// integer value of a lane for the bitwise operations, out of range values saturate
+static inline int ToInteger(float value)
+{
+    return value == value ? static_cast<int>(std::min(std::max(value, -2147483648.0f), 2147483520.0f)) : 0;
+}
+
+// jumps are taken for all lanes at once, the other instructions run on every lane of their registers
+void RunCpuShaderInstructions(const CpuShaderInstruction* instructions, int instructionCount, float* registers, const CpuShaderTexture& texture)
+{
+    int pc = 0;
+    while (pc < instructionCount)
+    {
+        const CpuShaderInstruction& instruction = instructions[pc++];
+
+        if (instruction.opcode == CpuShaderOpcode::Jump)
+        {
+            pc = instruction.target;
+            continue;
+        }
+
+        const float* a = registers + instruction.sources[0] * LANE_COUNT;
+        const float* b = registers + instruction.sources[1] * LANE_COUNT;
+        const float* c = registers + instruction.sources[2] * LANE_COUNT;
+
+        if (instruction.opcode == CpuShaderOpcode::JumpIfNone)
+        {
+            bool isAnySet = false;
+            FOR_EACH_LANE(isAnySet |= a[l] != 0.0f);
+            if (!isAnySet)
+                pc = instruction.target;
+            continue;
+        }
+
+        float* t = registers + instruction.target * LANE_COUNT;
+
+        switch (instruction.opcode)
+        {
+        case CpuShaderOpcode::Move:
+            FOR_EACH_LANE(t[l] = a[l]);
+            break;
+        case CpuShaderOpcode::Select:
+            FOR_EACH_LANE(t[l] = a[l] != 0.0f ? b[l] : c[l]);
+            break;
+        case CpuShaderOpcode::Add:
+            FOR_EACH_LANE(t[l] = a[l] + b[l]);
+            break;
+        case CpuShaderOpcode::Subtract:
+            FOR_EACH_LANE(t[l] = a[l] - b[l]);
+            break;
+        case CpuShaderOpcode::Multiply:
+            FOR_EACH_LANE(t[l] = a[l] * b[l]);
+            break;
+        case CpuShaderOpcode::Divide:
+            FOR_EACH_LANE(t[l] = a[l] / b[l]);
+            break;
+        case CpuShaderOpcode::IntegerDivide:
+            FOR_EACH_LANE(t[l] = std::trunc(a[l] / b[l]));
+            break;
+        case CpuShaderOpcode::Modulo:
+            FOR_EACH_LANE(t[l] = std::fmod(a[l], b[l]));
+            break;
+        case CpuShaderOpcode::Negate:
+            FOR_EACH_LANE(t[l] = -a[l]);
+            break;
+        case CpuShaderOpcode::Less:
+            FOR_EACH_LANE(t[l] = a[l] < b[l] ? 1.0f : 0.0f);
+            break;
+        case CpuShaderOpcode::LessEqual:
+            FOR_EACH_LANE(t[l] = a[l] <= b[l] ? 1.0f : 0.0f);
+            break;
+        case CpuShaderOpcode::Equal:
+            FOR_EACH_LANE(t[l] = a[l] == b[l] ? 1.0f : 0.0f);
+            break;
+        case CpuShaderOpcode::NotEqual:
+            FOR_EACH_LANE(t[l] = a[l] != b[l] ? 1.0f : 0.0f);
+            break;
+        case CpuShaderOpcode::And:
+            FOR_EACH_LANE(t[l] = a[l] != 0.0f && b[l] != 0.0f ? 1.0f : 0.0f);
+            break;
+        case CpuShaderOpcode::Or:
+            FOR_EACH_LANE(t[l] = a[l] != 0.0f || b[l] != 0.0f ? 1.0f : 0.0f);
+            break;
+        case CpuShaderOpcode::Not:
+            FOR_EACH_LANE(t[l] = a[l] == 0.0f ? 1.0f : 0.0f);
+            break;
+        case CpuShaderOpcode::AndNot:
+            FOR_EACH_LANE(t[l] = a[l] != 0.0f && b[l] == 0.0f ? 1.0f : 0.0f);
+            break;
+        case CpuShaderOpcode::BitAnd:
+            FOR_EACH_LANE(t[l] = static_cast<float>(ToInteger(a[l]) & ToInteger(b[l])));
+            break;
+        case CpuShaderOpcode::BitOr:
+            FOR_EACH_LANE(t[l] = static_cast<float>(ToInteger(a[l]) | ToInteger(b[l])));
+            break;
+        case CpuShaderOpcode::BitXor:
+            FOR_EACH_LANE(t[l] = static_cast<float>(ToInteger(a[l]) ^ ToInteger(b[l])));
+            break;
+        case CpuShaderOpcode::BitNot:
+            FOR_EACH_LANE(t[l] = static_cast<float>(~ToInteger(a[l])));
+            break;
+        case CpuShaderOpcode::ShiftLeft:
+            FOR_EACH_LANE(t[l] = static_cast<float>(static_cast<int>(static_cast<unsigned int>(ToInteger(a[l])) << (ToInteger(b[l]) & 31))));
+            break;
+        case CpuShaderOpcode::ShiftRight:
+            FOR_EACH_LANE(t[l] = static_cast<float>(ToInteger(a[l]) >> (ToInteger(b[l]) & 31)));
+            break;
+        case CpuShaderOpcode::Truncate:
+            FOR_EACH_LANE(t[l] = a[l] == a[l] ? std::trunc(a[l]) : 0.0f);
+            break;
+        case CpuShaderOpcode::Abs:
+            FOR_EACH_LANE(t[l] = std::fabs(a[l]));
+            break;
+        case CpuShaderOpcode::Sign:
+            FOR_EACH_LANE(t[l] = a[l] > 0.0f ? 1.0f : (a[l] < 0.0f ? -1.0f : 0.0f));
+            break;
+        case CpuShaderOpcode::Floor:
+            FOR_EACH_LANE(t[l] = std::floor(a[l]));
+            break;
+        case CpuShaderOpcode::Ceil:
+            FOR_EACH_LANE(t[l] = std::ceil(a[l]));
+            break;
+        case CpuShaderOpcode::Frac:
+            FOR_EACH_LANE(t[l] = a[l] - std::floor(a[l]));
+            break;
+        case CpuShaderOpcode::Round:
+            FOR_EACH_LANE(t[l] = std::nearbyint(a[l]));
+            break;
+        case CpuShaderOpcode::Sqrt:
+            FOR_EACH_LANE(t[l] = std::sqrt(a[l]));
+            break;
+        case CpuShaderOpcode::Rsqrt:
+            FOR_EACH_LANE(t[l] = 1.0f / std::sqrt(a[l]));
+            break;
+        case CpuShaderOpcode::Exp:
+            FOR_EACH_LANE(t[l] = std::exp(a[l]));
+            break;
+        case CpuShaderOpcode::Exp2:
+            FOR_EACH_LANE(t[l] = std::exp2(a[l]));
+            break;
+        case CpuShaderOpcode::Log:
+            FOR_EACH_LANE(t[l] = std::log(a[l]));
+            break;
+        case CpuShaderOpcode::Log2:
+            FOR_EACH_LANE(t[l] = std::log2(a[l]));
+            break;
+        case CpuShaderOpcode::Sin:
+            FOR_EACH_LANE(t[l] = std::sin(a[l]));
+            break;
+        case CpuShaderOpcode::Cos:
+            FOR_EACH_LANE(t[l] = std::cos(a[l]));
+            break;
+        case CpuShaderOpcode::Tan:
+            FOR_EACH_LANE(t[l] = std::tan(a[l]));
+            break;
+        case CpuShaderOpcode::Asin:
+            FOR_EACH_LANE(t[l] = std::asin(a[l]));
+            break;
+        case CpuShaderOpcode::Acos:
+            FOR_EACH_LANE(t[l] = std::acos(a[l]));
+            break;
+        case CpuShaderOpcode::Atan:
+            FOR_EACH_LANE(t[l] = std::atan(a[l]));
+            break;
+        case CpuShaderOpcode::Atan2:
+            FOR_EACH_LANE(t[l] = std::atan2(a[l], b[l]));
+            break;
+        case CpuShaderOpcode::Pow:
+            FOR_EACH_LANE(t[l] = std::pow(a[l], b[l]));
+            break;
+        case CpuShaderOpcode::Min:
+            FOR_EACH_LANE(t[l] = std::fmin(a[l], b[l]));
+            break;
+        case CpuShaderOpcode::Max:
+            FOR_EACH_LANE(t[l] = std::fmax(a[l], b[l]));
+            break;
+        case CpuShaderOpcode::Saturate:
+            FOR_EACH_LANE(t[l] = a[l] > 0.0f ? std::min(a[l], 1.0f) : 0.0f);
+            break;
+        case CpuShaderOpcode::Sample:
+        case CpuShaderOpcode::Load:
+            for (int l = 0; l < LANE_COUNT; ++l)
+            {
+                float rgba[4];
+                if (instruction.opcode == CpuShaderOpcode::Sample)
+                    SampleTexture(texture, a[l], b[l], rgba);
+                else
+                    LoadTexel(texture, a[l], b[l], rgba);
+
+                for (int component = 0; component < 4; ++component)
+                    t[component * LANE_COUNT + l] = rgba[component];
+            }
+            break;
+        case CpuShaderOpcode::LoopLimit:
+        {
+            // the iteration count is the same on every lane, kept in the first one
+            float* iterationCount = registers + instruction.sources[0] * LANE_COUNT;
+            iterationCount[0] += 1.0f;
+            if (iterationCount[0] > CPU_SHADER_MAX_LOOP_ITERATIONS)
+                FOR_EACH_LANE(t[l] = 0.0f);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+// the key holds the stage and every macro on top of the file, as the programs compiled from them differ
+std::shared_ptr<const CpuShaderProgram> GetCpuShaderProgram(const string& filePath, CpuShaderStage stage, const vector<ShaderMacro>& macros, string* out_error)
+{
+    string key = (stage == CpuShaderStage::Vertex ? "vs:" : "ps:") + filePath;
+    for (const ShaderMacro& macro : macros)
+        key += ";" + macro.name + "=" + macro.value;
+
+    return EffectCache::getInstance().getEntry<CpuShaderProgram>(EffectCacheKind::CpuShaderProgram, key, [&]() {
+        PROFILE_SCOPE("cpu.compileShader");
+        return CompileCpuShader(filePath, stage, macros, out_error);
+    });
+}
+
+// allocates the registers of a program for a thread, with its constants written once
+static void InitializeRegisters(const CpuShaderProgram& program, const CpuShaderTexture& texture, vector<float>* out_registers)
+{
+    out_registers->assign(static_cast<size_t>(program.registerCount) * LANE_COUNT, 0.0f);
+    float* registers = out_registers->data();
+
+    for (const std::pair<int, float>& constant : program.constants)
+        std::fill(registers + constant.first * LANE_COUNT, registers + (constant.first + 1) * LANE_COUNT, constant.second);
+
+    std::fill(registers + program.textureWidthRegister * LANE_COUNT, registers + (program.textureWidthRegister + 1) * LANE_COUNT, static_cast<float>(texture.width));
+    std::fill(registers + program.textureHeightRegister * LANE_COUNT, registers + (program.textureHeightRegister + 1) * LANE_COUNT, static_cast<float>(texture.height));
+}
+
+static const CpuShaderVarying* FindVarying(const vector<CpuShaderVarying>& varyings, const string& semantic)
+{
+    for (const CpuShaderVarying& varying : varyings)
+    {
+        if (varying.semantic == semantic)
+            return &varying;
+    }
+    return nullptr;
+}
+
+// a vertex of the quad after the vertex stage : its position in pixels, its depth, 1 / w and its outputs divided by w,
+// so they interpolate linearly in screen space and the division by the interpolated 1 / w corrects the perspective
+struct RasterVertex {
+    float x = 0.0f;
+    float y = 0.0f;
+    float depth = 0.0f;
+    float inverseW = 0.0f;
+    vector<float> outputs;
+};
+
+// a triangle of the strip, its vertices ordered so front faces have a positive area with y going down.
+// the edge of vertex i is the one facing it, pixel centers exactly on an edge belong to the triangle if it is a top or left edge
+struct RasterTriangle {
+    const RasterVertex* vertices[3];
+    float area = 0.0f;
+    bool isTopLeftEdge[3];
+};
+
+// twice the signed area of the triangle (a, b, c), positive when it turns clockwise on the screen
+static inline float GetEdgeFunction(const RasterVertex& a, const RasterVertex& b, float x, float y)
+{
+    return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+}
+
+// a pixel shader input and where it comes from : the pixel position or an output of the vertex stage
+struct PixelInputLink {
+    const CpuShaderVarying* input = nullptr;
+    bool isPosition = false;
+    int outputOffset = 0;
+};
+
+// runs the vertex shader on the 4 vertices of the quad, one per lane
+static bool RunVertexStage(const CpuShaderProgram& vertexShader, const CpuShaderTexture& texture, int width, int height,
+    vector<RasterVertex>* out_vertices, vector<CpuShaderVarying>* out_outputs, string* out_error)
+{
+    vector<float> registers;
+    InitializeRegisters(vertexShader, texture, &registers);
+    float* laneMask = registers.data() + vertexShader.laneMaskRegister * LANE_COUNT;
+
+    for (int v = 0; v < 4; ++v)
+        laneMask[v] = 1.0f;
+
+    // the quad only has positions and texture coordinates, the components the shader reads past them default to (0, 0, 0, 1)
+    for (const CpuShaderVarying& input : vertexShader.inputs)
+    {
+        bool isPosition = input.semantic == POSITION_SEMANTIC;
+        if (!isPosition && input.semantic != TEXCOORD_SEMANTIC)
+        {
+            *out_error = "Vertex shader input " + input.semantic + " is not a vertex attribute of the quad";
+            return false;
+        }
+
+        for (int component = 0; component < input.componentCount; ++component)
+        {
+            float* lanes = registers.data() + (input.firstRegister + component) * LANE_COUNT;
+            for (int v = 0; v < 4; ++v)
+            {
+                if (isPosition)
+                    lanes[v] = component < 4 ? QUAD_VERTEX_POSITIONS[v][component] : 0.0f;
+                else
+                    lanes[v] = component < 2 ? QUAD_VERTEX_TEXCOORDS[v][component] : (component == 3 ? 1.0f : 0.0f);
+            }
+        }
+    }
+
+    RunCpuShaderInstructions(vertexShader.instructions.data(), static_cast<int>(vertexShader.instructions.size()), registers.data(), texture);
+
+    const CpuShaderVarying* position = FindVarying(vertexShader.outputs, SV_POSITION_SEMANTIC);
+    if (!position || position->componentCount != 4)
+    {
+        *out_error = "The vertex shader does not output a float4 SV_POSITION";
+        return false;
+    }
+
+    for (const CpuShaderVarying& output : vertexShader.outputs)
+    {
+        if (&output != position)
+            out_outputs->push_back(output);
+    }
+
+    out_vertices->resize(4);
+    for (int v = 0; v < 4; ++v)
+    {
+        auto lane = [&](int reg) { return registers[static_cast<size_t>(reg) * LANE_COUNT + v]; };
+        RasterVertex& vertex = (*out_vertices)[v];
+
+        // vertices behind the eye have no screen position, the triangles using them are skipped
+        float w = lane(position->firstRegister + 3);
+        vertex.inverseW = w > 0.0f ? 1.0f / w : 0.0f;
+        vertex.x = (lane(position->firstRegister) * vertex.inverseW + 1.0f) * 0.5f * width;
+        vertex.y = (1.0f - lane(position->firstRegister + 1) * vertex.inverseW) * 0.5f * height;
+        vertex.depth = lane(position->firstRegister + 2) * vertex.inverseW;
+
+        for (const CpuShaderVarying& output : *out_outputs)
+        {
+            for (int component = 0; component < output.componentCount; ++component)
+                vertex.outputs.push_back(lane(output.firstRegister + component) * vertex.inverseW);
+        }
+    }
+
+    return true;
+}
+
+// the odd triangles of a strip swap their first two vertices so both keep the winding of the first one
+static vector<RasterTriangle> SetUpTriangles(const vector<RasterVertex>& vertices)
+{
+    vector<RasterTriangle> triangles;
+
+    for (int i = 0; i + 2 < static_cast<int>(vertices.size()); ++i)
+    {
+        RasterTriangle triangle;
+        triangle.vertices[0] = &vertices[i % 2 ? i + 1 : i];
+        triangle.vertices[1] = &vertices[i % 2 ? i : i + 1];
+        triangle.vertices[2] = &vertices[i + 2];
+
+        const RasterVertex& v0 = *triangle.vertices[0];
+        const RasterVertex& v1 = *triangle.vertices[1];
+        const RasterVertex& v2 = *triangle.vertices[2];
+        if (v0.inverseW <= 0.0f || v1.inverseW <= 0.0f || v2.inverseW <= 0.0f)
+            continue;
+
+        // back faces, turning counter-clockwise, are culled like with the default rasterizer state
+        triangle.area = GetEdgeFunction(v0, v1, v2.x, v2.y);
+        if (!(triangle.area > 0.0f))
+            continue;
+
+        for (int edge = 0; edge < 3; ++edge)
+        {
+            const RasterVertex& a = *triangle.vertices[(edge + 1) % 3];
+            const RasterVertex& b = *triangle.vertices[(edge + 2) % 3];
+            triangle.isTopLeftEdge[edge] = (a.y == b.y && b.x > a.x) || b.y < a.y;
+        }
+
+        triangles.push_back(triangle);
+    }
+
+    return triangles;
+}
+
+// links every pixel shader input to the pixel position or to the vertex shader output of the same semantic
+static bool LinkPixelInputs(const CpuShaderProgram& pixelShader, const vector<CpuShaderVarying>& vertexOutputs, vector<PixelInputLink>* out_links, string* out_error)
+{
+    for (const CpuShaderVarying& input : pixelShader.inputs)
+    {
+        PixelInputLink link;
+        link.input = &input;
+        link.isPosition = input.semantic == SV_POSITION_SEMANTIC;
+
+        if (!link.isPosition)
+        {
+            const CpuShaderVarying* output = nullptr;
+            for (const CpuShaderVarying& vertexOutput : vertexOutputs)
+            {
+                if (vertexOutput.semantic == input.semantic)
+                {
+                    output = &vertexOutput;
+                    break;
+                }
+                link.outputOffset += vertexOutput.componentCount;
+            }
+
+            if (!output || output->componentCount < input.componentCount)
+            {
+                *out_error = "Pixel shader input " + input.semantic + " is not written by the vertex shader";
+                return false;
+            }
+        }
+
+        out_links->push_back(link);
+    }
+
+    return true;
+}
+
+// the output of a lane, saturated and rounded to 8 bits like the GPU writes a UNORM render target
+static inline unsigned char ToUnorm(float value)
+{
+    value = value > 0.0f ? std::min(value, 1.0f) : 0.0f;
+    return static_cast<unsigned char>(value * 255.0f + 0.5f);
+}
+
+bool ApplyCpuShaders(const ImageView& image, const CpuShaderProgram& vertexShader, const CpuShaderProgram& pixelShader, CpuEffectManager* cpuManagerRef, string* out_error)
+{
+    PROFILE_SCOPE("cpu.shaders");
+
+    int width = image.getWidth();
+    int height = image.getHeight();
+
+    const CpuShaderVarying* target = FindVarying(pixelShader.outputs, SV_TARGET_SEMANTIC);
+    if (!target || target->componentCount != 4)
+    {
+        *out_error = "The pixel shader does not output a float4 SV_Target";
+        return false;
+    }
+
+    // the shaders sample the image expanded to RGBA, like the texture of the GPU backend
+    size_t rgbaRowSize = static_cast<size_t>(width) * 4;
+    PooledBuffer rgbaData = AcquirePooledBuffer(rgbaRowSize * height);
+    ExpandPixelsToRgba(image, rgbaData.get());
+
+    CpuShaderTexture texture;
+    texture.rgbaData = rgbaData.get();
+    texture.width = width;
+    texture.height = height;
+
+    vector<RasterVertex> vertices;
+    vector<CpuShaderVarying> vertexOutputs;
+    if (!RunVertexStage(vertexShader, texture, width, height, &vertices, &vertexOutputs, out_error))
+        return false;
+
+    vector<RasterTriangle> triangles = SetUpTriangles(vertices);
+
+    vector<PixelInputLink> links;
+    if (!LinkPixelInputs(pixelShader, vertexOutputs, &links, out_error))
+        return false;
+
+    cpuManagerRef->parallelForRows(height, [&](int rowBegin, int rowEnd) {
+        vector<float> registerFile;
+        InitializeRegisters(pixelShader, texture, &registerFile);
+        float* registers = registerFile.data();
+        float* laneMask = registers + pixelShader.laneMaskRegister * LANE_COUNT;
+
+        PooledBuffer rowRgba = AcquirePooledBuffer(rgbaRowSize);
+
+        for (int y = rowBegin; y < rowEnd; ++y)
+        {
+            // the pixels outside of the triangles keep their source value
+            std::memcpy(rowRgba.get(), rgbaData.get() + y * rgbaRowSize, rgbaRowSize);
+            float pixelY = y + 0.5f;
+
+            for (int firstX = 0; firstX < width; firstX += LANE_COUNT)
+            {
+                bool isAnyCovered = false;
+
+                for (int l = 0; l < LANE_COUNT; ++l)
+                {
+                    float pixelX = firstX + l + 0.5f;
+                    const RasterTriangle* covering = nullptr;
+                    float barycentrics[3] = {};
+
+                    for (const RasterTriangle& triangle : triangles)
+                    {
+                        bool isInside = firstX + l < width;
+                        for (int edge = 0; edge < 3 && isInside; ++edge)
+                        {
+                            float edgeValue = GetEdgeFunction(*triangle.vertices[(edge + 1) % 3], *triangle.vertices[(edge + 2) % 3], pixelX, pixelY);
+                            isInside = edgeValue > 0.0f || (edgeValue == 0.0f && triangle.isTopLeftEdge[edge]);
+                            barycentrics[edge] = edgeValue / triangle.area;
+                        }
+
+                        if (isInside)
+                        {
+                            covering = &triangle;
+                            break;
+                        }
+                    }
+
+                    laneMask[l] = covering ? 1.0f : 0.0f;
+                    if (!covering)
+                        continue;
+                    isAnyCovered = true;
+
+                    const RasterVertex* const* v = covering->vertices;
+                    float inverseW = barycentrics[0] * v[0]->inverseW + barycentrics[1] * v[1]->inverseW + barycentrics[2] * v[2]->inverseW;
+
+                    for (const PixelInputLink& link : links)
+                    {
+                        float* lanes = registers + link.input->firstRegister * LANE_COUNT + l;
+                        for (int component = 0; component < link.input->componentCount; ++component)
+                        {
+                            float value;
+                            if (link.isPosition)
+                            {
+                                const float position[4] = { pixelX, pixelY,
+                                    barycentrics[0] * v[0]->depth + barycentrics[1] * v[1]->depth + barycentrics[2] * v[2]->depth, 1.0f / inverseW };
+                                value = component < 4 ? position[component] : 0.0f;
+                            }
+                            else
+                            {
+                                int offset = link.outputOffset + component;
+                                value = (barycentrics[0] * v[0]->outputs[offset] + barycentrics[1] * v[1]->outputs[offset]
+                                    + barycentrics[2] * v[2]->outputs[offset]) / inverseW;
+                            }
+                            lanes[component * LANE_COUNT] = value;
+                        }
+                    }
+                }
+
+                if (!isAnyCovered)
+                    continue;
+
+                RunCpuShaderInstructions(pixelShader.instructions.data(), static_cast<int>(pixelShader.instructions.size()), registers, texture);
+
+                for (int l = 0; l < LANE_COUNT; ++l)
+                {
+                    if (laneMask[l] == 0.0f)
+                        continue;
+
+                    unsigned char* pixel = rowRgba.get() + static_cast<size_t>(firstX + l) * 4;
+                    for (int component = 0; component < 4; ++component)
+                        pixel[component] = ToUnorm(registers[(target->firstRegister + component) * LANE_COUNT + l]);
+                }
+            }
+
+            PackRgbaRows(rowRgba.get(), rgbaRowSize, image.getRegion(0, y, width, 1));
+        }
+    });
+
+    return true;
+}
@@ -0,0 +1,178 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CpuEffectManager.h"
+#include "Image.h"
+
+using std::string;  // Make string available as 'string'
+using std::vector;  // Make vector available as 'vector'
+
+// number of pixels the CPU shader engine evaluates with each instruction, one per lane of the registers
+#define CPU_SHADER_LANE_COUNT 16
+
+// loops with constant bounds up to this many iterations are unrolled, so their counter is a constant in the body
+#define CPU_SHADER_MAX_UNROLLED_ITERATIONS 64
+
+// iterations after which a loop stops for the pixels still running it, as a GPU would stop a runaway shader
+#define CPU_SHADER_MAX_LOOP_ITERATIONS 65536
+
+// the stages of the pipeline the CPU shader engine emulates
+enum class CpuShaderStage {
+    Vertex,
+    Pixel
+};
+
+// a macro a shader is compiled with, effects define one per parameter
+struct ShaderMacro {
+    string name;
+    string value;
+};
+
+// the operations of the CPU shader bytecode. each one runs on every lane of its registers, booleans are 0 or 1
+// and the operations that test one are true for any non-zero value
+enum class CpuShaderOpcode : unsigned char {
+    Move,           // target = a
+    Select,         // target = a ? b : c
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    IntegerDivide,  // division truncated toward zero, for the int and uint types
+    Modulo,         // remainder with the sign of a, as fmod
+    Negate,
+    Less,
+    LessEqual,
+    Equal,
+    NotEqual,
+    And,
+    Or,
+    Not,
+    AndNot,         // target = a && !b, to take lanes out of a mask
+    BitAnd,         // bitwise operations on the values truncated to integers
+    BitOr,
+    BitXor,
+    BitNot,
+    ShiftLeft,
+    ShiftRight,
+    Truncate,       // conversion to the int and uint types
+    Abs,
+    Sign,
+    Floor,
+    Ceil,
+    Frac,
+    Round,
+    Sqrt,
+    Rsqrt,
+    Exp,
+    Exp2,
+    Log,
+    Log2,
+    Sin,
+    Cos,
+    Tan,
+    Asin,
+    Acos,
+    Atan,
+    Atan2,
+    Pow,
+    Min,
+    Max,
+    Saturate,
+    Sample,         // target to target + 3 = bilinear sample of the texture at the texture coordinates (a, b)
+    Load,           // target to target + 3 = texel (a, b) of the texture, 0 outside of it
+    LoopLimit,      // counts an iteration in a, and clears the mask target once a loop ran too many
+    Jump,           // continues at the instruction target
+    JumpIfNone      // continues at the instruction target if no lane of a is set
+};
+
+// an instruction of the CPU shader bytecode, its operands are register indices
+struct CpuShaderInstruction {
+    CpuShaderOpcode opcode = CpuShaderOpcode::Move;
+    int target = 0;
+    int sources[3] = { 0, 0, 0 };
+};
+
+// an input or output of a stage : its semantic in upper case with its index, like TEXCOORD0, and its registers
+struct CpuShaderVarying {
+    string semantic;
+    int firstRegister = 0;
+    int componentCount = 0;
+};
+
+/**
+ * A shader stage compiled for the CPU shader engine : a straight list of instructions on registers of CPU_SHADER_LANE_COUNT
+ * floats, which evaluates a lane per vertex or pixel. Branches run both sides under a mask of their lanes, and jump over
+ * a side only when none of the lanes takes it.
+ */
+struct CpuShaderProgram {
+    CpuShaderStage stage = CpuShaderStage::Pixel;
+    vector<CpuShaderInstruction> instructions;
+    int registerCount = 0;
+    vector<std::pair<int, float>> constants;  // registers holding a constant, only written when the registers are allocated
+    int laneMaskRegister = 0;                 // set on the lanes holding a vertex or a pixel before a run
+    int textureWidthRegister = 0;             // size of the texture, read by GetDimensions
+    int textureHeightRegister = 0;
+    vector<CpuShaderVarying> inputs;
+    vector<CpuShaderVarying> outputs;
+};
+
+// the texture the shaders sample, the source image expanded to RGBA
+struct CpuShaderTexture {
+    const unsigned char* rgbaData = nullptr;
+    int width = 0;
+    int height = 0;
+};
+
+/**
+ * Compiles the main function of an HLSL shader file for the CPU shader engine.
+ * The engine handles the subset of HLSL the effects are written in : the preprocessor's object-like macros and conditionals,
+ * structs, functions, scalar, vector, matrix and array types, the usual operators and intrinsics, if, for and while statements,
+ * and the Sample, SampleLevel, Load and GetDimensions methods of a single Texture2D. Loops with constant bounds are unrolled.
+ *
+ * @param filePath The shader file.
+ * @param stage The stage main is compiled for.
+ * @param macros The macros defined before the file.
+ * @param out_error A pointer to a string to receive error messages, if any.
+ * @return The compiled program, or nullptr if the file could not be read or uses HLSL the engine does not handle.
+ */
+std::shared_ptr<const CpuShaderProgram> CompileCpuShader(const string& filePath, CpuShaderStage stage, const vector<ShaderMacro>& macros, string* out_error);
+
+/**
+ * Returns the compiled program of a shader file with its macros from the effect cache, compiled on a miss.
+ *
+ * @param filePath The shader file.
+ * @param stage The stage main is compiled for.
+ * @param macros The macros defined before the file.
+ * @param out_error A pointer to a string to receive error messages, if any.
+ * @return The compiled program, or nullptr if it could not be compiled.
+ */
+std::shared_ptr<const CpuShaderProgram> GetCpuShaderProgram(const string& filePath, CpuShaderStage stage, const vector<ShaderMacro>& macros, string* out_error);
+
+/**
+ * Runs instructions on every lane of a register file.
+ *
+ * @param instructions The instructions to run.
+ * @param instructionCount Number of instructions.
+ * @param registers The registers, CPU_SHADER_LANE_COUNT floats each.
+ * @param texture The texture the instructions sample.
+ */
+void RunCpuShaderInstructions(const CpuShaderInstruction* instructions, int instructionCount, float* registers, const CpuShaderTexture& texture);
+
+/**
+ * Draws the fullscreen quad of the GPU backend over an image with a vertex and a pixel shader, as the GPU backend would
+ * with its default states : the vertex shader runs on the 4 vertices of the quad, the two triangles of the strip are
+ * rasterized with back faces culled, and the pixel shader runs on the pixels they cover, sampling the image through
+ * a bilinear sampler clamped to its edges. Its output is written back to the image in its own layout, the pixels
+ * outside of the triangles are kept. The rows are split into bands run in parallel by the CPU effect manager.
+ *
+ * @param image The image, overwritten with the output of the pixel shader.
+ * @param vertexShader The vertex shader program.
+ * @param pixelShader The pixel shader program.
+ * @param cpuManagerRef The CPU effect manager to run the bands with.
+ * @param out_error A pointer to a string to receive error messages, if any.
+ * @return true if the shaders ran, false if the pixel shader reads an input the vertex shader does not write.
+ */
+bool ApplyCpuShaders(const ImageView& image, const CpuShaderProgram& vertexShader, const CpuShaderProgram& pixelShader, CpuEffectManager* cpuManagerRef, string* out_error);
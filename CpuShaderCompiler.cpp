@@ -0,0 +1,3955 @@
+#include "CpuShader.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+/*
+    The CPU shader compiler turns an HLSL file into the bytecode of CpuShader.h in three steps : the preprocessor expands
+    the macros and conditionals of the file into tokens, the parser builds its syntax tree, and the code generator inlines
+    every function main calls and lowers the vector and matrix operations to operations on the registers of their components,
+    so every instruction works on a single component of CPU_SHADER_LANE_COUNT pixels. Operations on constants are folded
+    while generating the code, and loops with constant bounds are unrolled so their counter is a constant too.
+*/
+
+// formats an error at a line of a shader file like the HLSL compiler does
+static string FormatShaderError(const string& filePath, int line, const string& message)
+{
+    return filePath + "(" + std::to_string(line) + "): " + message;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// tokens
+
+enum class TokenKind {
+    Identifier,
+    Number,
+    Punctuator,
+    End
+};
+
+// a token of a shader file and the line it is on
+struct Token {
+    TokenKind kind = TokenKind::End;
+    string text;
+    float value = 0.0f;      // value of a number
+    bool isInteger = false;  // numbers without a fraction, an exponent or a float suffix
+    int line = 0;
+};
+
+// punctuators of more than one character, longest first
+static const char* MULTI_CHARACTER_PUNCTUATORS[] = { "<<=", ">>=", "++", "--", "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=",
+    "==", "!=", "<=", ">=", "&&", "||", "<<", ">>" };
+
+#define SINGLE_CHARACTER_PUNCTUATORS "{}()[];,.:+-*/%<>=!?&|^~#"
+
+// precedence of the binary operators, higher binds tighter, 0 for the tokens that are not one
+static int GetBinaryPrecedence(const string& text)
+{
+    static const std::map<string, int> precedences = { { "||", 1 }, { "&&", 2 }, { "|", 3 }, { "^", 4 }, { "&", 5 }, { "==", 6 }, { "!=", 6 },
+        { "<", 7 }, { ">", 7 }, { "<=", 7 }, { ">=", 7 }, { "<<", 8 }, { ">>", 8 }, { "+", 9 }, { "-", 9 }, { "*", 10 }, { "/", 10 }, { "%", 10 } };
+
+    auto precedence = precedences.find(text);
+    return precedence == precedences.end() ? 0 : precedence->second;
+}
+
+static bool IsDigit(char c)
+{
+    return std::isdigit(static_cast<unsigned char>(c)) != 0;
+}
+
+static bool IsIdentifierCharacter(char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+// splits a line into tokens
+static bool TokenizeLine(const string& text, int line, const string& filePath, vector<Token>* out_tokens, string* out_error)
+{
+    size_t i = 0;
+    while (i < text.size())
+    {
+        char c = text[i];
+        if (std::isspace(static_cast<unsigned char>(c)))
+        {
+            ++i;
+            continue;
+        }
+
+        Token token;
+        token.line = line;
+        size_t end = i;
+
+        if (std::isalpha(static_cast<unsigned char>(c)) || c == '_')
+        {
+            token.kind = TokenKind::Identifier;
+            while (end < text.size() && IsIdentifierCharacter(text[end]))
+                ++end;
+        }
+        else if (IsDigit(c) || (c == '.' && i + 1 < text.size() && IsDigit(text[i + 1])))
+        {
+            token.kind = TokenKind::Number;
+            token.isInteger = true;
+
+            if (c == '0' && i + 1 < text.size() && (text[i + 1] == 'x' || text[i + 1] == 'X'))
+            {
+                end = i + 2;
+                while (end < text.size() && std::isxdigit(static_cast<unsigned char>(text[end])))
+                    ++end;
+                token.value = static_cast<float>(std::strtoul(text.substr(i, end - i).c_str(), nullptr, 16));
+            }
+            else
+            {
+                while (end < text.size() && IsDigit(text[end]))
+                    ++end;
+
+                if (end < text.size() && text[end] == '.')
+                {
+                    token.isInteger = false;
+                    ++end;
+                    while (end < text.size() && IsDigit(text[end]))
+                        ++end;
+                }
+
+                if (end < text.size() && (text[end] == 'e' || text[end] == 'E'))
+                {
+                    size_t exponent = end + 1;
+                    if (exponent < text.size() && (text[exponent] == '+' || text[exponent] == '-'))
+                        ++exponent;
+                    if (exponent < text.size() && IsDigit(text[exponent]))
+                    {
+                        token.isInteger = false;
+                        end = exponent;
+                        while (end < text.size() && IsDigit(text[end]))
+                            ++end;
+                    }
+                }
+
+                token.value = std::strtof(text.substr(i, end - i).c_str(), nullptr);
+            }
+
+            // type suffixes, a float suffix makes a float of an integer
+            while (end < text.size() && std::strchr("fFhHlLuU", text[end]))
+            {
+                if (std::strchr("fFhH", text[end]))
+                    token.isInteger = false;
+                ++end;
+            }
+        }
+        else
+        {
+            token.kind = TokenKind::Punctuator;
+            for (const char* punctuator : MULTI_CHARACTER_PUNCTUATORS)
+            {
+                size_t length = std::strlen(punctuator);
+                if (text.compare(i, length, punctuator) == 0)
+                {
+                    end = i + length;
+                    break;
+                }
+            }
+
+            if (end == i)
+            {
+                if (!std::strchr(SINGLE_CHARACTER_PUNCTUATORS, c))
+                {
+                    *out_error = FormatShaderError(filePath, line, string("Unexpected character '") + c + "'");
+                    return false;
+                }
+                end = i + 1;
+            }
+        }
+
+        token.text = text.substr(i, end - i);
+        out_tokens->push_back(token);
+        i = end;
+    }
+
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// preprocessor
+
+// removes the comments of a shader, keeping their line breaks so the tokens keep their line numbers
+static string RemoveComments(const string& source)
+{
+    string result;
+    result.reserve(source.size());
+
+    size_t i = 0;
+    while (i < source.size())
+    {
+        if (source.compare(i, 2, "//") == 0)
+        {
+            while (i < source.size() && source[i] != '\n')
+                ++i;
+        }
+        else if (source.compare(i, 2, "/*") == 0)
+        {
+            i += 2;
+            while (i < source.size() && source.compare(i, 2, "*/") != 0)
+            {
+                if (source[i] == '\n')
+                    result += '\n';
+                ++i;
+            }
+            i += 2;
+        }
+        else
+        {
+            result += source[i++];
+        }
+    }
+
+    return result;
+}
+
+// evaluates the expression of an #if, the identifiers left after the expansion of the macros are 0 as in C
+class ConditionEvaluator {
+public:
+    explicit ConditionEvaluator(const vector<Token>& tokens) : m_tokens(tokens) {}
+
+    bool evaluate(double* out_value)
+    {
+        *out_value = parseBinary(1);
+        return m_isValid && m_position == m_tokens.size();
+    }
+
+private:
+    double parseUnary()
+    {
+        if (m_position >= m_tokens.size())
+        {
+            m_isValid = false;
+            return 0.0;
+        }
+
+        const Token& token = m_tokens[m_position++];
+        if (token.kind == TokenKind::Number)
+            return token.value;
+        if (token.kind == TokenKind::Identifier)
+            return token.text == "true" ? 1.0 : 0.0;
+
+        if (token.text == "(")
+        {
+            double value = parseBinary(1);
+            if (m_position >= m_tokens.size() || m_tokens[m_position].text != ")")
+                m_isValid = false;
+            ++m_position;
+            return value;
+        }
+        if (token.text == "!")
+            return parseUnary() == 0.0 ? 1.0 : 0.0;
+        if (token.text == "-")
+            return -parseUnary();
+        if (token.text == "+")
+            return parseUnary();
+        if (token.text == "~")
+            return static_cast<double>(~static_cast<long long>(parseUnary()));
+
+        m_isValid = false;
+        return 0.0;
+    }
+
+    double parseBinary(int minPrecedence)
+    {
+        double left = parseUnary();
+
+        while (m_isValid && m_position < m_tokens.size())
+        {
+            const Token& token = m_tokens[m_position];
+            int precedence = token.kind == TokenKind::Punctuator ? GetBinaryPrecedence(token.text) : 0;
+            if (precedence == 0 || precedence < minPrecedence)
+                break;
+
+            ++m_position;
+            double right = parseBinary(precedence + 1);
+            left = applyOperator(token.text, left, right);
+        }
+
+        return left;
+    }
+
+    static double applyOperator(const string& op, double left, double right)
+    {
+        long long leftInteger = static_cast<long long>(left);
+        long long rightInteger = static_cast<long long>(right);
+
+        if (op == "||") return left != 0.0 || right != 0.0;
+        if (op == "&&") return left != 0.0 && right != 0.0;
+        if (op == "|") return static_cast<double>(leftInteger | rightInteger);
+        if (op == "^") return static_cast<double>(leftInteger ^ rightInteger);
+        if (op == "&") return static_cast<double>(leftInteger & rightInteger);
+        if (op == "==") return left == right;
+        if (op == "!=") return left != right;
+        if (op == "<") return left < right;
+        if (op == ">") return left > right;
+        if (op == "<=") return left <= right;
+        if (op == ">=") return left >= right;
+        if (op == "<<") return static_cast<double>(leftInteger << (rightInteger & 63));
+        if (op == ">>") return static_cast<double>(leftInteger >> (rightInteger & 63));
+        if (op == "+") return left + right;
+        if (op == "-") return left - right;
+        if (op == "*") return left * right;
+        if (op == "/") return right != 0.0 ? left / right : 0.0;
+        return right != 0.0 ? std::fmod(left, right) : 0.0;
+    }
+
+    const vector<Token>& m_tokens;
+    size_t m_position = 0;
+    bool m_isValid = true;
+};
+
+/**
+ * Expands the object-like macros of a shader file and keeps the lines of its active conditionals, as tokens.
+ */
+class ShaderPreprocessor {
+public:
+    explicit ShaderPreprocessor(const string& filePath) : m_filePath(filePath) {}
+
+    /**
+     * Preprocesses the source of the file into tokens, ended by an End token.
+     */
+    bool preprocess(const string& source, const vector<ShaderMacro>& macros, vector<Token>* out_tokens, string* out_error);
+
+private:
+    // an #if and its #elif and #else branches
+    struct Conditional {
+        bool isActive = false;        // the lines of the current branch are kept
+        bool isParentActive = false;  // the conditional itself is in kept lines
+        bool wasTaken = false;        // a branch was taken already
+        bool hasElse = false;
+    };
+
+    bool runDirective(const string& text, int line, vector<Conditional>* conditionals, string* out_error);
+
+    void expandTokens(const vector<Token>& tokens, vector<string>* expandingNames, int line, vector<Token>* out_tokens) const;
+
+    bool evaluateCondition(const vector<Token>& tokens, int line, bool* out_value, string* out_error) const;
+
+    string m_filePath;
+    std::map<string, vector<Token>> m_macros;
+};
+
+bool ShaderPreprocessor::preprocess(const string& source, const vector<ShaderMacro>& macros, vector<Token>* out_tokens, string* out_error)
+{
+    for (const ShaderMacro& macro : macros)
+    {
+        vector<Token> tokens;
+        if (!TokenizeLine(macro.value, 0, m_filePath, &tokens, out_error))
+            return false;
+        m_macros[macro.name] = tokens;
+    }
+
+    std::istringstream lines(RemoveComments(source));
+    vector<Conditional> conditionals;
+    string physicalLine;
+    int lineNumber = 0;
+
+    while (std::getline(lines, physicalLine))
+    {
+        ++lineNumber;
+        int line = lineNumber;
+        string text = physicalLine;
+
+        // lines ending with a backslash go on in the next one
+        while (true)
+        {
+            if (!text.empty() && text.back() == '\r')
+                text.pop_back();
+            if (text.empty() || text.back() != '\\' || !std::getline(lines, physicalLine))
+                break;
+            text.back() = ' ';
+            text += physicalLine;
+            ++lineNumber;
+        }
+
+        size_t first = text.find_first_not_of(" \t");
+        if (first != string::npos && text[first] == '#')
+        {
+            if (!runDirective(text.substr(first + 1), line, &conditionals, out_error))
+                return false;
+            continue;
+        }
+
+        if (!conditionals.empty() && !conditionals.back().isActive)
+            continue;
+
+        vector<Token> tokens;
+        if (!TokenizeLine(text, line, m_filePath, &tokens, out_error))
+            return false;
+
+        vector<string> expandingNames;
+        expandTokens(tokens, &expandingNames, line, out_tokens);
+    }
+
+    if (!conditionals.empty())
+    {
+        *out_error = FormatShaderError(m_filePath, lineNumber, "Missing #endif");
+        return false;
+    }
+
+    Token end;
+    end.line = lineNumber;
+    out_tokens->push_back(end);
+    return true;
+}
+
+// the directive name is read before the rest of the line is tokenized, so skipped lines may hold anything
+bool ShaderPreprocessor::runDirective(const string& text, int line, vector<Conditional>* conditionals, string* out_error)
+{
+    size_t nameBegin = std::min(text.find_first_not_of(" \t"), text.size());
+    size_t nameEnd = nameBegin;
+    while (nameEnd < text.size() && std::isalpha(static_cast<unsigned char>(text[nameEnd])))
+        ++nameEnd;
+
+    string directive = text.substr(nameBegin, nameEnd - nameBegin);
+    string rest = text.substr(nameEnd);
+    bool isActive = conditionals->empty() || conditionals->back().isActive;
+
+    auto fail = [&](const string& message) {
+        *out_error = FormatShaderError(m_filePath, line, message);
+        return false;
+    };
+
+    vector<Token> tokens;
+    auto tokenizeRest = [&]() { return TokenizeLine(rest, line, m_filePath, &tokens, out_error); };
+
+    if (directive == "if" || directive == "ifdef" || directive == "ifndef")
+    {
+        bool value = false;
+        if (isActive)
+        {
+            if (!tokenizeRest())
+                return false;
+
+            if (directive == "if")
+            {
+                if (!evaluateCondition(tokens, line, &value, out_error))
+                    return false;
+            }
+            else
+            {
+                if (tokens.empty() || tokens[0].kind != TokenKind::Identifier)
+                    return fail("Expected a macro name after #" + directive);
+                value = (m_macros.count(tokens[0].text) != 0) == (directive == "ifdef");
+            }
+        }
+
+        Conditional conditional;
+        conditional.isParentActive = isActive;
+        conditional.isActive = isActive && value;
+        conditional.wasTaken = value;
+        conditionals->push_back(conditional);
+        return true;
+    }
+
+    if (directive == "elif" || directive == "else" || directive == "endif")
+    {
+        if (conditionals->empty())
+            return fail("#" + directive + " without #if");
+
+        if (directive == "endif")
+        {
+            conditionals->pop_back();
+            return true;
+        }
+
+        Conditional& conditional = conditionals->back();
+        if (conditional.hasElse)
+            return fail("#" + directive + " after #else");
+
+        bool value = false;
+        if (directive == "else")
+        {
+            value = true;
+            conditional.hasElse = true;
+        }
+        else if (conditional.isParentActive && !conditional.wasTaken)
+        {
+            if (!tokenizeRest() || !evaluateCondition(tokens, line, &value, out_error))
+                return false;
+        }
+
+        conditional.isActive = conditional.isParentActive && !conditional.wasTaken && value;
+        conditional.wasTaken = conditional.wasTaken || value;
+        return true;
+    }
+
+    if (!isActive)
+        return true;
+
+    if (directive == "define" || directive == "undef")
+    {
+        if (!tokenizeRest())
+            return false;
+        if (tokens.empty() || tokens[0].kind != TokenKind::Identifier)
+            return fail("Expected a macro name after #" + directive);
+
+        const string& name = tokens[0].text;
+        if (directive == "undef")
+        {
+            m_macros.erase(name);
+            return true;
+        }
+
+        // the parameters of a function-like macro follow its name without a space
+        size_t nameEndInRest = rest.find(name) + name.size();
+        if (nameEndInRest < rest.size() && rest[nameEndInRest] == '(')
+            return fail("Function-like macros are not supported");
+
+        m_macros[name] = vector<Token>(tokens.begin() + 1, tokens.end());
+        return true;
+    }
+
+    if (directive.empty() || directive == "pragma" || directive == "line")
+        return true;
+    if (directive == "error")
+        return fail("#error" + rest);
+    if (directive == "include")
+        return fail("#include is not supported");
+
+    return fail("Unknown directive #" + directive);
+}
+
+// a macro is not expanded again inside its own expansion
+void ShaderPreprocessor::expandTokens(const vector<Token>& tokens, vector<string>* expandingNames, int line, vector<Token>* out_tokens) const
+{
+    for (const Token& token : tokens)
+    {
+        auto macro = token.kind == TokenKind::Identifier ? m_macros.find(token.text) : m_macros.end();
+        if (macro == m_macros.end() || std::find(expandingNames->begin(), expandingNames->end(), token.text) != expandingNames->end())
+        {
+            out_tokens->push_back(token);
+            out_tokens->back().line = line;
+            continue;
+        }
+
+        expandingNames->push_back(token.text);
+        expandTokens(macro->second, expandingNames, line, out_tokens);
+        expandingNames->pop_back();
+    }
+}
+
+// defined is evaluated before the expansion, so the names it tests are not expanded
+bool ShaderPreprocessor::evaluateCondition(const vector<Token>& tokens, int line, bool* out_value, string* out_error) const
+{
+    vector<Token> resolvedTokens;
+
+    for (size_t i = 0; i < tokens.size(); ++i)
+    {
+        if (tokens[i].kind != TokenKind::Identifier || tokens[i].text != "defined")
+        {
+            resolvedTokens.push_back(tokens[i]);
+            continue;
+        }
+
+        bool hasParenthesis = i + 1 < tokens.size() && tokens[i + 1].text == "(";
+        size_t nameIndex = i + (hasParenthesis ? 2 : 1);
+        if (nameIndex >= tokens.size() || tokens[nameIndex].kind != TokenKind::Identifier ||
+            (hasParenthesis && (nameIndex + 1 >= tokens.size() || tokens[nameIndex + 1].text != ")")))
+        {
+            *out_error = FormatShaderError(m_filePath, line, "Invalid use of defined");
+            return false;
+        }
+
+        Token value;
+        value.kind = TokenKind::Number;
+        value.isInteger = true;
+        value.value = m_macros.count(tokens[nameIndex].text) ? 1.0f : 0.0f;
+        value.text = value.value != 0.0f ? "1" : "0";
+        value.line = line;
+        resolvedTokens.push_back(value);
+        i = nameIndex + (hasParenthesis ? 1 : 0);
+    }
+
+    vector<Token> expandedTokens;
+    vector<string> expandingNames;
+    expandTokens(resolvedTokens, &expandingNames, line, &expandedTokens);
+
+    double value = 0.0;
+    ConditionEvaluator evaluator(expandedTokens);
+    if (!evaluator.evaluate(&value))
+    {
+        *out_error = FormatShaderError(m_filePath, line, "Invalid #if expression");
+        return false;
+    }
+
+    *out_value = value != 0.0;
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// syntax tree
+
+enum class BaseType {
+    Void,
+    Bool,
+    Int,
+    Uint,
+    Float,
+    Struct,
+    Texture,
+    Sampler
+};
+
+// a type : scalars and vectors have a single row, matrices rows of columns components, and any type can be an array
+struct ShaderType {
+    BaseType base = BaseType::Void;
+    int rows = 1;
+    int columns = 1;
+    bool isMatrix = false;
+    int structIndex = -1;
+    int arrayLength = 0;  // 0 when not an array
+};
+
+static bool IsSameType(const ShaderType& a, const ShaderType& b)
+{
+    return a.base == b.base && a.rows == b.rows && a.columns == b.columns && a.isMatrix == b.isMatrix
+        && a.structIndex == b.structIndex && a.arrayLength == b.arrayLength;
+}
+
+static bool IsNumeric(const ShaderType& type)
+{
+    return type.base == BaseType::Bool || type.base == BaseType::Int || type.base == BaseType::Uint || type.base == BaseType::Float;
+}
+
+static ShaderType MakeVectorType(BaseType base, int columns)
+{
+    ShaderType type;
+    type.base = base;
+    type.columns = columns;
+    return type;
+}
+
+// parses the name of a scalar, vector or matrix type, like float, int3 or float3x3
+static bool ParseNumericTypeName(const string& name, ShaderType* out_type)
+{
+    static const std::pair<const char*, BaseType> BASE_NAMES[] = { { "min16float", BaseType::Float }, { "min10float", BaseType::Float },
+        { "min16uint", BaseType::Uint }, { "min16int", BaseType::Int }, { "min12int", BaseType::Int }, { "double", BaseType::Float },
+        { "float", BaseType::Float }, { "half", BaseType::Float }, { "dword", BaseType::Uint }, { "uint", BaseType::Uint },
+        { "bool", BaseType::Bool }, { "int", BaseType::Int } };
+
+    auto isDimension = [](char c) { return c >= '1' && c <= '4'; };
+
+    for (const auto& baseName : BASE_NAMES)
+    {
+        size_t length = std::strlen(baseName.first);
+        if (name.compare(0, length, baseName.first) != 0)
+            continue;
+
+        string suffix = name.substr(length);
+        ShaderType type;
+        type.base = baseName.second;
+
+        if (suffix.size() == 1 && isDimension(suffix[0]))
+        {
+            type.columns = suffix[0] - '0';
+        }
+        else if (suffix.size() == 3 && isDimension(suffix[0]) && suffix[1] == 'x' && isDimension(suffix[2]))
+        {
+            type.rows = suffix[0] - '0';
+            type.columns = suffix[2] - '0';
+            type.isMatrix = true;
+        }
+        else if (!suffix.empty())
+        {
+            return false;
+        }
+
+        *out_type = type;
+        return true;
+    }
+
+    return false;
+}
+
+// semantics in upper case with their index, TEXCOORD is TEXCOORD0
+static string NormalizeSemantic(const string& semantic)
+{
+    string normalized;
+    for (char c : semantic)
+        normalized += static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+
+    if (!normalized.empty() && !IsDigit(normalized.back()))
+        normalized += '0';
+    return normalized;
+}
+
+enum class ExpressionKind {
+    Literal,
+    Identifier,
+    Unary,
+    Binary,
+    Assignment,
+    Increment,
+    Ternary,
+    Call,
+    MethodCall,
+    Constructor,
+    Cast,
+    Member,
+    Index,
+    InitializerList
+};
+
+struct Expression;
+typedef std::unique_ptr<Expression> ExpressionPointer;
+
+// an expression : text holds the operator, or the name of the identifier, function, method or member
+struct Expression {
+    ExpressionKind kind = ExpressionKind::Literal;
+    int line = 0;
+    string text;
+    float value = 0.0f;              // literals
+    ShaderType type;                 // literals, constructors and casts
+    bool isPrefix = false;           // ++x rather than x++
+    vector<ExpressionPointer> operands;  // the object of a member, index or method call comes first
+};
+
+enum class StatementKind {
+    Block,
+    Declaration,
+    Expression,
+    If,
+    For,
+    While,
+    Return,
+    Break,
+    Continue,
+    Empty
+};
+
+// a variable of a declaration, an array length of -1 is given by the initializer
+struct Declarator {
+    string name;
+    int arrayLength = 0;
+    ExpressionPointer initializer;
+    int line = 0;
+};
+
+struct Statement {
+    StatementKind kind = StatementKind::Empty;
+    int line = 0;
+    ShaderType type;                  // declarations
+    bool isConst = false;
+    vector<Declarator> declarators;
+    ExpressionPointer expression;     // expression statements, conditions and return values
+    ExpressionPointer step;           // for loops
+    std::unique_ptr<Statement> init;  // for loops
+    std::unique_ptr<Statement> body;  // loops and the then branch of if
+    std::unique_ptr<Statement> elseBody;
+    vector<std::unique_ptr<Statement>> statements;  // blocks
+};
+
+struct StructMember {
+    ShaderType type;
+    string name;
+    string semantic;
+};
+
+struct StructDefinition {
+    string name;
+    vector<StructMember> members;
+};
+
+struct FunctionParameter {
+    ShaderType type;
+    string name;
+    string semantic;
+    bool isIn = true;
+    bool isOut = false;
+};
+
+struct FunctionDefinition {
+    string name;
+    ShaderType returnType;
+    string returnSemantic;
+    vector<FunctionParameter> parameters;
+    std::unique_ptr<Statement> body;
+    int line = 0;
+};
+
+// a parsed shader file
+struct ShaderModule {
+    vector<StructDefinition> structs;
+    vector<FunctionDefinition> functions;
+    vector<string> textures;
+    vector<string> samplers;
+    vector<std::unique_ptr<Statement>> globals;  // declarations of static variables
+};
+
+// calls visit on a statement and every statement in it, stopping when visit returns true. loops are not entered
+// when isEnteringLoops is false, so the break and continue statements found belong to the statement itself
+static bool FindStatement(const Statement& statement, bool isEnteringLoops, const std::function<bool(const Statement&)>& visit)
+{
+    if (visit(statement))
+        return true;
+
+    if ((statement.kind == StatementKind::For || statement.kind == StatementKind::While) && !isEnteringLoops)
+        return false;
+
+    for (const std::unique_ptr<Statement>& child : statement.statements)
+    {
+        if (FindStatement(*child, isEnteringLoops, visit))
+            return true;
+    }
+
+    for (const Statement* child : { statement.init.get(), statement.body.get(), statement.elseBody.get() })
+    {
+        if (child && FindStatement(*child, isEnteringLoops, visit))
+            return true;
+    }
+
+    return false;
+}
+
+// calls visit on an expression and every expression in it, stopping when visit returns true
+static bool FindExpression(const Expression& expression, const std::function<bool(const Expression&)>& visit)
+{
+    if (visit(expression))
+        return true;
+
+    for (const ExpressionPointer& operand : expression.operands)
+    {
+        if (FindExpression(*operand, visit))
+            return true;
+    }
+    return false;
+}
+
+// calls visit on the expressions of a statement and of every statement in it
+static bool FindExpressionInStatement(const Statement& statement, const std::function<bool(const Expression&)>& visit)
+{
+    return FindStatement(statement, true, [&](const Statement& child) {
+        if (child.expression && FindExpression(*child.expression, visit))
+            return true;
+        if (child.step && FindExpression(*child.step, visit))
+            return true;
+        for (const Declarator& declarator : child.declarators)
+        {
+            if (declarator.initializer && FindExpression(*declarator.initializer, visit))
+                return true;
+        }
+        return false;
+    });
+}
+
+// the variable an assignment writes to, under its members and indices
+static const Expression* GetRootExpression(const Expression& expression)
+{
+    const Expression* root = &expression;
+    while ((root->kind == ExpressionKind::Member || root->kind == ExpressionKind::Index) && !root->operands.empty())
+        root = root->operands[0].get();
+    return root;
+}
+
+// value of an expression made of numbers and arithmetic, as loop bounds are
+static bool EvaluateConstantExpression(const Expression& expression, float* out_value)
+{
+    float left, right;
+
+    switch (expression.kind)
+    {
+    case ExpressionKind::Literal:
+        *out_value = expression.value;
+        return true;
+    case ExpressionKind::Unary:
+        if (!EvaluateConstantExpression(*expression.operands[0], &left) || (expression.text != "-" && expression.text != "+"))
+            return false;
+        *out_value = expression.text == "-" ? -left : left;
+        return true;
+    case ExpressionKind::Binary:
+        if (!EvaluateConstantExpression(*expression.operands[0], &left) || !EvaluateConstantExpression(*expression.operands[1], &right))
+            return false;
+        if (expression.text == "+")
+            *out_value = left + right;
+        else if (expression.text == "-")
+            *out_value = left - right;
+        else if (expression.text == "*")
+            *out_value = left * right;
+        else
+            return false;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// parser
+
+/**
+ * Builds the syntax tree of a preprocessed shader file, a recursive descent parser over its tokens.
+ */
+class ShaderParser {
+public:
+    ShaderParser(const vector<Token>& tokens, const string& filePath, ShaderModule* module) : m_tokens(tokens), m_filePath(filePath), m_module(module) {}
+
+    /**
+     * Parses the whole file into the module.
+     */
+    bool parseModule(string* out_error);
+
+private:
+    const Token& peek(int offset = 0) const
+    {
+        size_t position = std::min(m_position + offset, m_tokens.size() - 1);
+        return m_tokens[position];
+    }
+
+    bool isToken(const char* text, int offset = 0) const
+    {
+        const Token& token = peek(offset);
+        return (token.kind == TokenKind::Punctuator || token.kind == TokenKind::Identifier) && token.text == text;
+    }
+
+    bool accept(const char* text)
+    {
+        if (!isToken(text))
+            return false;
+        ++m_position;
+        return true;
+    }
+
+    bool expect(const char* text)
+    {
+        if (accept(text))
+            return true;
+        return fail(string("Expected '") + text + "'" + (peek().kind == TokenKind::End ? " at the end of the file" : " before '" + peek().text + "'"));
+    }
+
+    bool fail(const string& message)
+    {
+        if (m_error.empty())
+            m_error = FormatShaderError(m_filePath, peek().line, message);
+        return false;
+    }
+
+    bool isTypeName(int offset) const;
+    bool parseType(ShaderType* out_type);
+    bool parseIdentifier(string* out_name);
+    bool parseSemantic(string* out_semantic);
+    void skipAttributes();
+    bool skipModifiers(bool* out_isStatic, bool* out_isConst);
+
+    bool parseStruct();
+    bool parseGlobal();
+    bool parseFunction(const ShaderType& returnType, const string& name);
+    bool parseDeclarators(Statement* statement);
+
+    std::unique_ptr<Statement> parseStatement();
+    std::unique_ptr<Statement> parseBlock();
+    std::unique_ptr<Statement> parseDeclaration();
+
+    ExpressionPointer parseExpression();
+    ExpressionPointer parseAssignment();
+    ExpressionPointer parseTernary();
+    ExpressionPointer parseBinary(int minPrecedence);
+    ExpressionPointer parseUnary();
+    ExpressionPointer parsePostfix();
+    ExpressionPointer parsePrimary();
+    ExpressionPointer parseInitializer();
+    bool parseArguments(Expression* expression);
+
+    ExpressionPointer makeExpression(ExpressionKind kind, const string& text, int line)
+    {
+        ExpressionPointer expression(new Expression());
+        expression->kind = kind;
+        expression->text = text;
+        expression->line = line;
+        return expression;
+    }
+
+    const vector<Token>& m_tokens;
+    size_t m_position = 0;
+    string m_filePath;
+    ShaderModule* m_module;
+    string m_error;
+};
+
+bool ShaderParser::parseModule(string* out_error)
+{
+    while (peek().kind != TokenKind::End)
+    {
+        if (accept(";"))
+            continue;
+
+        skipAttributes();
+        bool isParsed = isToken("struct") ? parseStruct() : parseGlobal();
+        if (!isParsed)
+        {
+            *out_error = m_error;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ShaderParser::isTypeName(int offset) const
+{
+    const Token& token = peek(offset);
+    if (token.kind != TokenKind::Identifier)
+        return false;
+
+    ShaderType type;
+    if (token.text == "void" || token.text == "Texture2D" || token.text == "SamplerState" || token.text == "sampler" || ParseNumericTypeName(token.text, &type))
+        return true;
+
+    for (const StructDefinition& definition : m_module->structs)
+    {
+        if (definition.name == token.text)
+            return true;
+    }
+    return false;
+}
+
+bool ShaderParser::parseType(ShaderType* out_type)
+{
+    const Token& token = peek();
+    if (token.kind != TokenKind::Identifier)
+        return fail("Expected a type");
+
+    ShaderType type;
+    if (token.text == "void")
+    {
+        type.base = BaseType::Void;
+    }
+    else if (token.text == "Texture2D")
+    {
+        type.base = BaseType::Texture;
+    }
+    else if (token.text == "SamplerState" || token.text == "sampler")
+    {
+        type.base = BaseType::Sampler;
+    }
+    else if (!ParseNumericTypeName(token.text, &type))
+    {
+        for (size_t i = 0; i < m_module->structs.size() && type.base != BaseType::Struct; ++i)
+        {
+            if (m_module->structs[i].name == token.text)
+            {
+                type.base = BaseType::Struct;
+                type.structIndex = static_cast<int>(i);
+            }
+        }
+
+        if (type.base != BaseType::Struct)
+            return fail("Unknown type " + token.text);
+    }
+
+    ++m_position;
+
+    // the format of a texture, as in Texture2D<float4>, does not change how it is sampled
+    if (type.base == BaseType::Texture && accept("<"))
+    {
+        while (peek().kind != TokenKind::End && !accept(">"))
+            ++m_position;
+    }
+
+    *out_type = type;
+    return true;
+}
+
+bool ShaderParser::parseIdentifier(string* out_name)
+{
+    if (peek().kind != TokenKind::Identifier)
+        return fail(peek().kind == TokenKind::End ? "Unexpected end of the file" : "Expected a name before '" + peek().text + "'");
+
+    *out_name = peek().text;
+    ++m_position;
+    return true;
+}
+
+// reads the annotations after a ':', the semantic is kept and registers and pack offsets are skipped
+bool ShaderParser::parseSemantic(string* out_semantic)
+{
+    while (accept(":"))
+    {
+        if (isToken("register") || isToken("packoffset"))
+        {
+            ++m_position;
+            if (!expect("("))
+                return false;
+            while (peek().kind != TokenKind::End && !accept(")"))
+                ++m_position;
+            continue;
+        }
+
+        string semantic;
+        if (!parseIdentifier(&semantic))
+            return false;
+        *out_semantic = NormalizeSemantic(semantic);
+    }
+
+    return true;
+}
+
+// attributes like [unroll] or [loop] are hints, loops are unrolled when their bounds are constant
+void ShaderParser::skipAttributes()
+{
+    while (isToken("["))
+    {
+        int depth = 0;
+        do
+        {
+            if (isToken("["))
+                ++depth;
+            else if (isToken("]"))
+                --depth;
+            ++m_position;
+        } while (depth > 0 && peek().kind != TokenKind::End);
+    }
+}
+
+// skips the storage and interpolation modifiers, which do not change how the CPU evaluates a variable
+bool ShaderParser::skipModifiers(bool* out_isStatic, bool* out_isConst)
+{
+    static const char* MODIFIERS[] = { "static", "const", "uniform", "extern", "inline", "precise", "linear", "centroid",
+        "nointerpolation", "noperspective", "sample", "row_major", "column_major", "volatile" };
+
+    bool isModifier = true;
+    while (isModifier)
+    {
+        isModifier = false;
+        for (const char* modifier : MODIFIERS)
+        {
+            if (accept(modifier))
+            {
+                *out_isStatic = *out_isStatic || std::strcmp(modifier, "static") == 0;
+                *out_isConst = *out_isConst || std::strcmp(modifier, "const") == 0;
+                isModifier = true;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool ShaderParser::parseStruct()
+{
+    ++m_position;
+
+    StructDefinition definition;
+    if (!parseIdentifier(&definition.name) || !expect("{"))
+        return false;
+
+    while (!accept("}"))
+    {
+        if (peek().kind == TokenKind::End)
+            return fail("Missing '}' at the end of struct " + definition.name);
+
+        bool isStatic = false, isConst = false;
+        skipModifiers(&isStatic, &isConst);
+
+        ShaderType type;
+        if (!parseType(&type))
+            return false;
+        if (!IsNumeric(type) && type.base != BaseType::Struct)
+            return fail("Struct members must be numeric or structs");
+
+        do
+        {
+            StructMember member;
+            member.type = type;
+            if (!parseIdentifier(&member.name))
+                return false;
+
+            if (accept("["))
+            {
+                if (peek().kind != TokenKind::Number || !peek().isInteger || peek().value < 1.0f)
+                    return fail("Expected the length of the array");
+                member.type.arrayLength = static_cast<int>(peek().value);
+                ++m_position;
+                if (!expect("]"))
+                    return false;
+            }
+
+            if (!parseSemantic(&member.semantic))
+                return false;
+            definition.members.push_back(member);
+        } while (accept(","));
+
+        if (!expect(";"))
+            return false;
+    }
+
+    if (!expect(";"))
+        return false;
+
+    m_module->structs.push_back(definition);
+    return true;
+}
+
+// a global is a function, a texture, a sampler or a static variable. effect parameters are compiled in as macros,
+// so uniform variables and constant buffers are not supported
+bool ShaderParser::parseGlobal()
+{
+    if (isToken("cbuffer") || isToken("tbuffer"))
+        return fail("Constant buffers are not supported, the effect parameters are compiled in as macros");
+
+    int line = peek().line;
+    bool isStatic = false, isConst = false;
+    skipModifiers(&isStatic, &isConst);
+
+    ShaderType type;
+    if (!parseType(&type))
+        return false;
+
+    if (!isToken("(", 1))
+    {
+        if (type.base == BaseType::Texture || type.base == BaseType::Sampler)
+        {
+            do
+            {
+                string name;
+                if (!parseIdentifier(&name))
+                    return false;
+
+                string semantic;
+                if (!parseSemantic(&semantic))
+                    return false;
+
+                // the state of a sampler is that of the default sampler
+                if (type.base == BaseType::Sampler && isToken("{"))
+                {
+                    while (peek().kind != TokenKind::End && !accept("}"))
+                        ++m_position;
+                }
+
+                (type.base == BaseType::Texture ? m_module->textures : m_module->samplers).push_back(name);
+            } while (accept(","));
+
+            return expect(";");
+        }
+
+        if (!isStatic)
+            return fail("Global variables must be static, the effect parameters are compiled in as macros");
+
+        std::unique_ptr<Statement> statement(new Statement());
+        statement->kind = StatementKind::Declaration;
+        statement->line = line;
+        statement->type = type;
+        statement->isConst = isConst;
+        if (!parseDeclarators(statement.get()))
+            return false;
+
+        m_module->globals.push_back(std::move(statement));
+        return true;
+    }
+
+    string name;
+    if (!parseIdentifier(&name))
+        return false;
+    return parseFunction(type, name);
+}
+
+bool ShaderParser::parseFunction(const ShaderType& returnType, const string& name)
+{
+    FunctionDefinition function;
+    function.name = name;
+    function.returnType = returnType;
+    function.line = peek().line;
+
+    if (!expect("("))
+        return false;
+
+    if (!(isToken("void") && isToken(")", 1) && accept("void")) && !isToken(")"))
+    {
+        do
+        {
+            FunctionParameter parameter;
+            bool isModifier = true;
+            while (isModifier)
+            {
+                isModifier = true;
+                if (accept("in"))
+                    parameter.isIn = true;
+                else if (accept("out"))
+                {
+                    parameter.isIn = false;
+                    parameter.isOut = true;
+                }
+                else if (accept("inout"))
+                {
+                    parameter.isIn = true;
+                    parameter.isOut = true;
+                }
+                else
+                {
+                    bool isStatic = false, isConst = false;
+                    size_t position = m_position;
+                    skipModifiers(&isStatic, &isConst);
+                    isModifier = m_position != position;
+                }
+            }
+
+            if (!parseType(&parameter.type) || !parseIdentifier(&parameter.name))
+                return false;
+
+            if (accept("["))
+            {
+                if (peek().kind != TokenKind::Number || !peek().isInteger || peek().value < 1.0f)
+                    return fail("Expected the length of the array");
+                parameter.type.arrayLength = static_cast<int>(peek().value);
+                ++m_position;
+                if (!expect("]"))
+                    return false;
+            }
+
+            if (!parseSemantic(&parameter.semantic))
+                return false;
+            if (isToken("="))
+                return fail("Default parameter values are not supported");
+
+            function.parameters.push_back(parameter);
+        } while (accept(","));
+    }
+
+    if (!expect(")") || !parseSemantic(&function.returnSemantic))
+        return false;
+
+    // a declaration without a body only announces the function
+    if (accept(";"))
+        return true;
+
+    function.body = parseBlock();
+    if (!function.body)
+        return false;
+
+    m_module->functions.push_back(std::move(function));
+    return true;
+}
+
+bool ShaderParser::parseDeclarators(Statement* statement)
+{
+    do
+    {
+        Declarator declarator;
+        declarator.line = peek().line;
+        if (!parseIdentifier(&declarator.name))
+            return false;
+
+        if (accept("["))
+        {
+            declarator.arrayLength = -1;
+            if (!isToken("]"))
+            {
+                if (peek().kind != TokenKind::Number || !peek().isInteger || peek().value < 1.0f)
+                    return fail("Expected the length of the array");
+                declarator.arrayLength = static_cast<int>(peek().value);
+                ++m_position;
+            }
+            if (!expect("]"))
+                return false;
+        }
+
+        string semantic;
+        if (!parseSemantic(&semantic))
+            return false;
+
+        if (accept("="))
+        {
+            declarator.initializer = parseInitializer();
+            if (!declarator.initializer)
+                return false;
+        }
+
+        statement->declarators.push_back(std::move(declarator));
+    } while (accept(","));
+
+    return expect(";");
+}
+
+std::unique_ptr<Statement> ShaderParser::parseBlock()
+{
+    std::unique_ptr<Statement> block(new Statement());
+    block->kind = StatementKind::Block;
+    block->line = peek().line;
+
+    if (!expect("{"))
+        return nullptr;
+
+    while (!accept("}"))
+    {
+        if (peek().kind == TokenKind::End)
+        {
+            fail("Missing '}'");
+            return nullptr;
+        }
+
+        std::unique_ptr<Statement> statement = parseStatement();
+        if (!statement)
+            return nullptr;
+        block->statements.push_back(std::move(statement));
+    }
+
+    return block;
+}
+
+std::unique_ptr<Statement> ShaderParser::parseDeclaration()
+{
+    std::unique_ptr<Statement> statement(new Statement());
+    statement->kind = StatementKind::Declaration;
+    statement->line = peek().line;
+
+    bool isStatic = false;
+    skipModifiers(&isStatic, &statement->isConst);
+
+    if (!parseType(&statement->type))
+        return nullptr;
+    if (statement->type.base == BaseType::Void || statement->type.base == BaseType::Texture || statement->type.base == BaseType::Sampler)
+    {
+        fail("Local variables must be numeric or structs");
+        return nullptr;
+    }
+
+    if (!parseDeclarators(statement.get()))
+        return nullptr;
+    return statement;
+}
+
+std::unique_ptr<Statement> ShaderParser::parseStatement()
+{
+    skipAttributes();
+
+    if (isToken("{"))
+        return parseBlock();
+
+    std::unique_ptr<Statement> statement(new Statement());
+    statement->line = peek().line;
+
+    if (accept(";"))
+    {
+        statement->kind = StatementKind::Empty;
+        return statement;
+    }
+
+    if (accept("if"))
+    {
+        statement->kind = StatementKind::If;
+        if (!expect("("))
+            return nullptr;
+        statement->expression = parseExpression();
+        if (!statement->expression || !expect(")"))
+            return nullptr;
+
+        statement->body = parseStatement();
+        if (!statement->body)
+            return nullptr;
+
+        if (accept("else"))
+        {
+            statement->elseBody = parseStatement();
+            if (!statement->elseBody)
+                return nullptr;
+        }
+        return statement;
+    }
+
+    if (accept("for"))
+    {
+        statement->kind = StatementKind::For;
+        if (!expect("("))
+            return nullptr;
+
+        if (!isToken(";"))
+        {
+            statement->init = parseStatement();
+            if (!statement->init)
+                return nullptr;
+        }
+        else
+        {
+            ++m_position;
+        }
+
+        if (!isToken(";"))
+        {
+            statement->expression = parseExpression();
+            if (!statement->expression)
+                return nullptr;
+        }
+        if (!expect(";"))
+            return nullptr;
+
+        if (!isToken(")"))
+        {
+            statement->step = parseExpression();
+            if (!statement->step)
+                return nullptr;
+        }
+        if (!expect(")"))
+            return nullptr;
+
+        statement->body = parseStatement();
+        return statement->body ? std::move(statement) : nullptr;
+    }
+
+    if (accept("while"))
+    {
+        statement->kind = StatementKind::While;
+        if (!expect("("))
+            return nullptr;
+        statement->expression = parseExpression();
+        if (!statement->expression || !expect(")"))
+            return nullptr;
+
+        statement->body = parseStatement();
+        return statement->body ? std::move(statement) : nullptr;
+    }
+
+    if (accept("return"))
+    {
+        statement->kind = StatementKind::Return;
+        if (!isToken(";"))
+        {
+            statement->expression = parseExpression();
+            if (!statement->expression)
+                return nullptr;
+        }
+        return expect(";") ? std::move(statement) : nullptr;
+    }
+
+    if (accept("break") || accept("continue"))
+    {
+        statement->kind = m_tokens[m_position - 1].text == "break" ? StatementKind::Break : StatementKind::Continue;
+        return expect(";") ? std::move(statement) : nullptr;
+    }
+
+    if (isToken("do") || isToken("switch") || isToken("discard"))
+    {
+        fail("'" + peek().text + "' is not supported");
+        return nullptr;
+    }
+
+    if (isToken("const") || isToken("static") || (isTypeName(0) && peek(1).kind == TokenKind::Identifier))
+        return parseDeclaration();
+
+    statement->kind = StatementKind::Expression;
+    statement->expression = parseExpression();
+    if (!statement->expression || !expect(";"))
+        return nullptr;
+    return statement;
+}
+
+// a comma separated sequence of expressions evaluates to its last one
+ExpressionPointer ShaderParser::parseExpression()
+{
+    ExpressionPointer expression = parseAssignment();
+
+    while (expression && isToken(","))
+    {
+        ExpressionPointer sequence = makeExpression(ExpressionKind::Binary, ",", peek().line);
+        ++m_position;
+        sequence->operands.push_back(std::move(expression));
+
+        ExpressionPointer next = parseAssignment();
+        if (!next)
+            return nullptr;
+        sequence->operands.push_back(std::move(next));
+        expression = std::move(sequence);
+    }
+
+    return expression;
+}
+
+ExpressionPointer ShaderParser::parseAssignment()
+{
+    static const char* ASSIGNMENT_OPERATORS[] = { "=", "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "<<=", ">>=" };
+
+    ExpressionPointer target = parseTernary();
+    if (!target)
+        return nullptr;
+
+    for (const char* op : ASSIGNMENT_OPERATORS)
+    {
+        if (peek().kind != TokenKind::Punctuator || peek().text != op)
+            continue;
+
+        ExpressionPointer assignment = makeExpression(ExpressionKind::Assignment, op, peek().line);
+        ++m_position;
+
+        ExpressionPointer value = parseAssignment();
+        if (!value)
+            return nullptr;
+
+        assignment->operands.push_back(std::move(target));
+        assignment->operands.push_back(std::move(value));
+        return assignment;
+    }
+
+    return target;
+}
+
+ExpressionPointer ShaderParser::parseTernary()
+{
+    ExpressionPointer condition = parseBinary(1);
+    if (!condition || !isToken("?"))
+        return condition;
+
+    ExpressionPointer ternary = makeExpression(ExpressionKind::Ternary, "?", peek().line);
+    ++m_position;
+
+    ExpressionPointer whenTrue = parseAssignment();
+    if (!whenTrue || !expect(":"))
+        return nullptr;
+    ExpressionPointer whenFalse = parseAssignment();
+    if (!whenFalse)
+        return nullptr;
+
+    ternary->operands.push_back(std::move(condition));
+    ternary->operands.push_back(std::move(whenTrue));
+    ternary->operands.push_back(std::move(whenFalse));
+    return ternary;
+}
+
+ExpressionPointer ShaderParser::parseBinary(int minPrecedence)
+{
+    ExpressionPointer left = parseUnary();
+
+    while (left)
+    {
+        const Token& token = peek();
+        int precedence = token.kind == TokenKind::Punctuator ? GetBinaryPrecedence(token.text) : 0;
+        if (precedence == 0 || precedence < minPrecedence)
+            break;
+
+        ExpressionPointer binary = makeExpression(ExpressionKind::Binary, token.text, token.line);
+        ++m_position;
+
+        ExpressionPointer right = parseBinary(precedence + 1);
+        if (!right)
+            return nullptr;
+
+        binary->operands.push_back(std::move(left));
+        binary->operands.push_back(std::move(right));
+        left = std::move(binary);
+    }
+
+    return left;
+}
+
+ExpressionPointer ShaderParser::parseUnary()
+{
+    const Token& token = peek();
+
+    if (token.kind == TokenKind::Punctuator && (token.text == "-" || token.text == "+" || token.text == "!" || token.text == "~" || token.text == "++" || token.text == "--"))
+    {
+        bool isIncrement = token.text == "++" || token.text == "--";
+        ExpressionPointer unary = makeExpression(isIncrement ? ExpressionKind::Increment : ExpressionKind::Unary, token.text, token.line);
+        unary->isPrefix = true;
+        ++m_position;
+
+        ExpressionPointer operand = parseUnary();
+        if (!operand)
+            return nullptr;
+        unary->operands.push_back(std::move(operand));
+        return unary;
+    }
+
+    // a type between parentheses is a cast
+    if (isToken("(") && isTypeName(1) && isToken(")", 2))
+    {
+        ExpressionPointer cast = makeExpression(ExpressionKind::Cast, "", token.line);
+        ++m_position;
+        if (!parseType(&cast->type))
+            return nullptr;
+        ++m_position;
+
+        ExpressionPointer operand = parseUnary();
+        if (!operand)
+            return nullptr;
+        cast->operands.push_back(std::move(operand));
+        return cast;
+    }
+
+    return parsePostfix();
+}
+
+ExpressionPointer ShaderParser::parsePostfix()
+{
+    ExpressionPointer expression = parsePrimary();
+
+    while (expression)
+    {
+        int line = peek().line;
+
+        if (accept("."))
+        {
+            string name;
+            if (!parseIdentifier(&name))
+                return nullptr;
+
+            ExpressionPointer member = makeExpression(isToken("(") ? ExpressionKind::MethodCall : ExpressionKind::Member, name, line);
+            member->operands.push_back(std::move(expression));
+            if (member->kind == ExpressionKind::MethodCall && !parseArguments(member.get()))
+                return nullptr;
+            expression = std::move(member);
+        }
+        else if (accept("["))
+        {
+            ExpressionPointer index = makeExpression(ExpressionKind::Index, "[]", line);
+            ExpressionPointer indexValue = parseExpression();
+            if (!indexValue || !expect("]"))
+                return nullptr;
+
+            index->operands.push_back(std::move(expression));
+            index->operands.push_back(std::move(indexValue));
+            expression = std::move(index);
+        }
+        else if (isToken("++") || isToken("--"))
+        {
+            ExpressionPointer increment = makeExpression(ExpressionKind::Increment, peek().text, line);
+            ++m_position;
+            increment->operands.push_back(std::move(expression));
+            expression = std::move(increment);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return expression;
+}
+
+bool ShaderParser::parseArguments(Expression* expression)
+{
+    if (!expect("("))
+        return false;
+    if (accept(")"))
+        return true;
+
+    do
+    {
+        ExpressionPointer argument = parseAssignment();
+        if (!argument)
+            return false;
+        expression->operands.push_back(std::move(argument));
+    } while (accept(","));
+
+    return expect(")");
+}
+
+ExpressionPointer ShaderParser::parsePrimary()
+{
+    const Token& token = peek();
+
+    if (token.kind == TokenKind::Number)
+    {
+        ExpressionPointer literal = makeExpression(ExpressionKind::Literal, token.text, token.line);
+        literal->value = token.value;
+        literal->type.base = token.isInteger ? BaseType::Int : BaseType::Float;
+        ++m_position;
+        return literal;
+    }
+
+    if (accept("("))
+    {
+        ExpressionPointer expression = parseExpression();
+        if (!expression || !expect(")"))
+            return nullptr;
+        return expression;
+    }
+
+    if (token.kind != TokenKind::Identifier)
+    {
+        fail(token.kind == TokenKind::End ? "Unexpected end of the file" : "Unexpected '" + token.text + "'");
+        return nullptr;
+    }
+
+    if (token.text == "true" || token.text == "false")
+    {
+        ExpressionPointer literal = makeExpression(ExpressionKind::Literal, token.text, token.line);
+        literal->value = token.text == "true" ? 1.0f : 0.0f;
+        literal->type.base = BaseType::Bool;
+        ++m_position;
+        return literal;
+    }
+
+    ShaderType type;
+    if (ParseNumericTypeName(token.text, &type) && isToken("(", 1))
+    {
+        ExpressionPointer constructor = makeExpression(ExpressionKind::Constructor, token.text, token.line);
+        constructor->type = type;
+        ++m_position;
+        if (!parseArguments(constructor.get()))
+            return nullptr;
+        return constructor;
+    }
+
+    ExpressionPointer expression = makeExpression(isToken("(", 1) ? ExpressionKind::Call : ExpressionKind::Identifier, token.text, token.line);
+    ++m_position;
+    if (expression->kind == ExpressionKind::Call && !parseArguments(expression.get()))
+        return nullptr;
+    return expression;
+}
+
+// initializer lists may nest, their components are flattened in order
+ExpressionPointer ShaderParser::parseInitializer()
+{
+    if (!isToken("{"))
+        return parseAssignment();
+
+    ExpressionPointer list = makeExpression(ExpressionKind::InitializerList, "{}", peek().line);
+    ++m_position;
+
+    while (!accept("}"))
+    {
+        ExpressionPointer element = parseInitializer();
+        if (!element)
+            return nullptr;
+        list->operands.push_back(std::move(element));
+
+        if (!isToken("}") && !expect(","))
+            return nullptr;
+    }
+
+    return list;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// code generator
+
+// returns the number of registers an instruction reads
+static int GetSourceCount(CpuShaderOpcode opcode)
+{
+    switch (opcode)
+    {
+    case CpuShaderOpcode::Jump:
+        return 0;
+    case CpuShaderOpcode::Move:
+    case CpuShaderOpcode::Negate:
+    case CpuShaderOpcode::Not:
+    case CpuShaderOpcode::BitNot:
+    case CpuShaderOpcode::Truncate:
+    case CpuShaderOpcode::Abs:
+    case CpuShaderOpcode::Sign:
+    case CpuShaderOpcode::Floor:
+    case CpuShaderOpcode::Ceil:
+    case CpuShaderOpcode::Frac:
+    case CpuShaderOpcode::Round:
+    case CpuShaderOpcode::Sqrt:
+    case CpuShaderOpcode::Rsqrt:
+    case CpuShaderOpcode::Exp:
+    case CpuShaderOpcode::Exp2:
+    case CpuShaderOpcode::Log:
+    case CpuShaderOpcode::Log2:
+    case CpuShaderOpcode::Sin:
+    case CpuShaderOpcode::Cos:
+    case CpuShaderOpcode::Tan:
+    case CpuShaderOpcode::Asin:
+    case CpuShaderOpcode::Acos:
+    case CpuShaderOpcode::Atan:
+    case CpuShaderOpcode::Saturate:
+    case CpuShaderOpcode::LoopLimit:
+    case CpuShaderOpcode::JumpIfNone:
+        return 1;
+    case CpuShaderOpcode::Select:
+        return 3;
+    default:
+        return 2;
+    }
+}
+
+/**
+ * Lowers the main function of a parsed shader to the bytecode of a CpuShaderProgram.
+ * Every value is a list of registers, one per component of its type in the order of its members, rows and elements.
+ * Functions are inlined where they are called. Control flow runs under a mask register holding the lanes still running
+ * the current statement : both sides of a branch run under their own mask, stores to variables declared outside of
+ * the branch only change the lanes of the mask, and return, break and continue take their lanes out of the masks
+ * until the end of the function, loop or iteration.
+ */
+class ShaderCodeGenerator {
+public:
+    ShaderCodeGenerator(const ShaderModule& module, const string& filePath, CpuShaderProgram* program) : m_module(module), m_filePath(filePath), m_program(program) {}
+
+    /**
+     * Generates the program of main.
+     */
+    bool compile(string* out_error);
+
+private:
+    struct Value {
+        ShaderType type;
+        vector<int> registers;
+    };
+
+    // what an assignment writes : the registers of the components of one or, with a variable index, several alternatives,
+    // each written on the lanes of its condition register, -1 for all lanes
+    struct LValue {
+        ShaderType type;
+        vector<int> registers;
+        vector<int> conditions;
+        int declarationMask = -1;
+    };
+
+    // a variable, with the mask of the lanes running when it was declared, for which its stores need no mask
+    struct Symbol {
+        string name;
+        Value value;
+        int declarationMask = -1;
+        bool isReadOnly = false;
+    };
+
+    // the lanes of a loop that left it, or its current iteration
+    struct LoopFrame {
+        int breakMask = -1;
+        int continueMask = -1;
+    };
+
+    // a function being inlined, its return value and the lanes that already returned
+    struct FunctionFrame {
+        const FunctionDefinition* function = nullptr;
+        Value returnValue;
+        int entryMask = -1;
+        int returnedMask = -1;
+        size_t firstScope = 0;
+        vector<LoopFrame> loops;
+    };
+
+    void fail(int line, const string& message)
+    {
+        if (m_error.empty())
+            m_error = FormatShaderError(m_filePath, line, message);
+    }
+
+    // types
+    int getComponentCount(const ShaderType& type) const;
+    void getComponentBaseTypes(const ShaderType& type, vector<BaseType>* out_bases) const;
+    string getTypeName(const ShaderType& type) const;
+    bool getCommonShape(const ShaderType& a, const ShaderType& b, int line, ShaderType* out_shape);
+
+    // registers and instructions
+    int newRegisters(int count);
+    int getConstantRegister(float value);
+    bool getConstantValue(int reg, float* out_value) const;
+    int emit(CpuShaderOpcode opcode, int a, int b = 0, int c = 0);
+    void emitTo(CpuShaderOpcode opcode, int target, int a, int b = 0, int c = 0);
+    int emitJump(CpuShaderOpcode opcode, int condition);
+    void patchJump(int instructionIndex);
+
+    // values
+    Value makeZeroValue(const ShaderType& type);
+    Value convert(const Value& value, const ShaderType& type, int line);
+    int convertComponent(int reg, BaseType from, BaseType to);
+    int getConditionRegister(const Value& value, int line);
+    Value applyComponentwise(CpuShaderOpcode opcode, const vector<Value>& arguments, BaseType base, int line);
+    int getIndexRegister(const Value& index, int line);
+
+    // scopes
+    void pushScope();
+    void popScope();
+    void declareSymbol(const Symbol& symbol, int line);
+    bool findSymbol(const string& name, Symbol* out_symbol) const;
+    Value declareVariable(const string& name, const ShaderType& type, const Value* initialValue, bool isConst, int line);
+
+    // statements
+    void compileStatement(const Statement& statement);
+    void compileDeclaration(const Statement& statement);
+    void compileIf(const Statement& statement);
+    void compileLoop(const Statement& statement);
+    bool unrollLoop(const Statement& statement);
+    void compileReturn(const Statement& statement);
+    void compileLoopExit(const Statement& statement);
+    int removeExitedLanes(int mask);
+
+    // expressions
+    Value evaluate(const Expression& expression);
+    bool evaluateLValue(const Expression& expression, LValue* out_lvalue);
+    void store(const LValue& lvalue, const Value& value, int line);
+    Value evaluateUnary(const Expression& expression);
+    Value evaluateBinary(const string& op, const Value& left, const Value& right, int line);
+    Value evaluateAssignment(const Expression& expression);
+    Value evaluateIncrement(const Expression& expression);
+    Value evaluateTernary(const Expression& expression);
+    Value evaluateConstructor(const ShaderType& type, const vector<Value>& arguments, int line);
+    Value evaluateInitializer(const Expression& expression, const ShaderType& type);
+    void flattenInitializer(const Expression& expression, vector<int>* out_registers, vector<BaseType>* out_bases);
+    bool getMemberComponents(const ShaderType& type, const string& name, int line, vector<int>* out_indices, ShaderType* out_type);
+    bool getElementType(const ShaderType& type, int line, ShaderType* out_elementType, int* out_elementCount);
+    Value evaluateIndex(const Expression& expression);
+    Value evaluateCall(const Expression& expression);
+    bool evaluateIntrinsic(const string& name, const vector<Value>& arguments, int line, Value* out_value);
+    Value evaluateMethodCall(const Expression& expression);
+    Value inlineFunction(const FunctionDefinition& function, const vector<Value>& arguments, bool isEntryPoint, vector<Value>* out_parameters);
+    void addVaryings(const ShaderType& type, const string& semantic, int firstRegister, int line, vector<CpuShaderVarying>* out_varyings);
+
+    const ShaderModule& m_module;
+    string m_filePath;
+    CpuShaderProgram* m_program;
+    string m_error;
+
+    std::map<uint32_t, int> m_constantRegisters;  // by the bits of their value
+    std::map<int, float> m_constantValues;
+    int m_zeroRegister = 0;
+    int m_currentMask = 0;
+    int m_exitCount = 0;  // returns, breaks and continues generated so far
+
+    vector<vector<Symbol>> m_scopes;
+    std::deque<FunctionFrame> m_frames;  // a deque keeps the frames of the callers in place while a callee is inlined
+    vector<const FunctionDefinition*> m_callStack;
+};
+
+int ShaderCodeGenerator::getComponentCount(const ShaderType& type) const
+{
+    int count = 0;
+    if (type.base == BaseType::Struct)
+    {
+        for (const StructMember& member : m_module.structs[type.structIndex].members)
+            count += getComponentCount(member.type);
+    }
+    else if (IsNumeric(type))
+    {
+        count = type.rows * type.columns;
+    }
+
+    return count * std::max(type.arrayLength, 1);
+}
+
+void ShaderCodeGenerator::getComponentBaseTypes(const ShaderType& type, vector<BaseType>* out_bases) const
+{
+    for (int element = 0; element < std::max(type.arrayLength, 1); ++element)
+    {
+        if (type.base == BaseType::Struct)
+        {
+            for (const StructMember& member : m_module.structs[type.structIndex].members)
+                getComponentBaseTypes(member.type, out_bases);
+        }
+        else
+        {
+            out_bases->insert(out_bases->end(), type.rows * type.columns, type.base);
+        }
+    }
+}
+
+string ShaderCodeGenerator::getTypeName(const ShaderType& type) const
+{
+    static const char* BASE_NAMES[] = { "void", "bool", "int", "uint", "float", "struct", "Texture2D", "SamplerState" };
+
+    string name = type.base == BaseType::Struct ? m_module.structs[type.structIndex].name : BASE_NAMES[static_cast<int>(type.base)];
+    if (type.isMatrix)
+        name += std::to_string(type.rows) + "x" + std::to_string(type.columns);
+    else if (type.columns > 1)
+        name += std::to_string(type.columns);
+    if (type.arrayLength)
+        name += "[" + std::to_string(type.arrayLength) + "]";
+    return name;
+}
+
+// a scalar takes the shape of the other operand, vectors and matrices are truncated to the smaller one
+bool ShaderCodeGenerator::getCommonShape(const ShaderType& a, const ShaderType& b, int line, ShaderType* out_shape)
+{
+    if (!IsNumeric(a) || !IsNumeric(b) || a.arrayLength || b.arrayLength)
+    {
+        fail(line, "Invalid operands " + getTypeName(a) + " and " + getTypeName(b));
+        return false;
+    }
+
+    if (a.rows * a.columns == 1)
+    {
+        *out_shape = b;
+    }
+    else if (b.rows * b.columns == 1)
+    {
+        *out_shape = a;
+    }
+    else if (a.isMatrix != b.isMatrix)
+    {
+        fail(line, "Invalid operands " + getTypeName(a) + " and " + getTypeName(b));
+        return false;
+    }
+    else
+    {
+        *out_shape = a;
+        out_shape->rows = std::min(a.rows, b.rows);
+        out_shape->columns = std::min(a.columns, b.columns);
+    }
+
+    return true;
+}
+
+int ShaderCodeGenerator::newRegisters(int count)
+{
+    int firstRegister = m_program->registerCount;
+    m_program->registerCount += count;
+    return firstRegister;
+}
+
+// constants are kept once per value in registers written when the registers are allocated
+int ShaderCodeGenerator::getConstantRegister(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    auto constant = m_constantRegisters.find(bits);
+    if (constant != m_constantRegisters.end())
+        return constant->second;
+
+    int reg = newRegisters(1);
+    m_constantRegisters[bits] = reg;
+    m_constantValues[reg] = value;
+    m_program->constants.push_back({ reg, value });
+    return reg;
+}
+
+bool ShaderCodeGenerator::getConstantValue(int reg, float* out_value) const
+{
+    auto constant = m_constantValues.find(reg);
+    if (constant == m_constantValues.end())
+        return false;
+
+    *out_value = constant->second;
+    return true;
+}
+
+// operations on constants are folded by running them on a scratch register file, so they give the same result as at run time.
+// adding 0 and multiplying by 1 are skipped
+int ShaderCodeGenerator::emit(CpuShaderOpcode opcode, int a, int b, int c)
+{
+    int sources[3] = { a, b, c };
+    int sourceCount = GetSourceCount(opcode);
+    float values[3] = {};
+    bool isConstant = opcode != CpuShaderOpcode::Sample && opcode != CpuShaderOpcode::Load && opcode != CpuShaderOpcode::LoopLimit;
+
+    for (int i = 0; i < sourceCount; ++i)
+        isConstant = getConstantValue(sources[i], &values[i]) && isConstant;
+
+    if (isConstant)
+    {
+        float registers[4 * CPU_SHADER_LANE_COUNT];
+        for (int i = 0; i < 3; ++i)
+            std::fill(registers + (i + 1) * CPU_SHADER_LANE_COUNT, registers + (i + 2) * CPU_SHADER_LANE_COUNT, values[i]);
+
+        CpuShaderInstruction instruction;
+        instruction.opcode = opcode;
+        instruction.target = 0;
+        instruction.sources[0] = 1;
+        instruction.sources[1] = 2;
+        instruction.sources[2] = 3;
+        RunCpuShaderInstructions(&instruction, 1, registers, CpuShaderTexture());
+        return getConstantRegister(registers[0]);
+    }
+
+    float aValue = 0.0f, bValue = 0.0f;
+    bool isAConstant = sourceCount > 0 && getConstantValue(a, &aValue);
+    bool isBConstant = sourceCount > 1 && getConstantValue(b, &bValue);
+
+    if ((opcode == CpuShaderOpcode::Add || opcode == CpuShaderOpcode::Subtract) && isBConstant && bValue == 0.0f)
+        return a;
+    if (opcode == CpuShaderOpcode::Add && isAConstant && aValue == 0.0f)
+        return b;
+    if ((opcode == CpuShaderOpcode::Multiply || opcode == CpuShaderOpcode::Divide) && isBConstant && bValue == 1.0f)
+        return a;
+    if (opcode == CpuShaderOpcode::Multiply && isAConstant && aValue == 1.0f)
+        return b;
+    if (opcode == CpuShaderOpcode::Select && isAConstant)
+        return aValue != 0.0f ? b : c;
+
+    int target = newRegisters(1);
+    emitTo(opcode, target, a, b, c);
+    return target;
+}
+
+void ShaderCodeGenerator::emitTo(CpuShaderOpcode opcode, int target, int a, int b, int c)
+{
+    CpuShaderInstruction instruction;
+    instruction.opcode = opcode;
+    instruction.target = target;
+    instruction.sources[0] = a;
+    instruction.sources[1] = b;
+    instruction.sources[2] = c;
+    m_program->instructions.push_back(instruction);
+}
+
+int ShaderCodeGenerator::emitJump(CpuShaderOpcode opcode, int condition)
+{
+    emitTo(opcode, 0, condition);
+    return static_cast<int>(m_program->instructions.size()) - 1;
+}
+
+void ShaderCodeGenerator::patchJump(int instructionIndex)
+{
+    m_program->instructions[instructionIndex].target = static_cast<int>(m_program->instructions.size());
+}
+
+ShaderCodeGenerator::Value ShaderCodeGenerator::makeZeroValue(const ShaderType& type)
+{
+    Value value;
+    value.type = type;
+    value.registers.assign(getComponentCount(type), getConstantRegister(0.0f));
+    return value;
+}
+
+// floats become integers by truncation and numbers become booleans by comparison with 0, booleans are already 0 or 1
+int ShaderCodeGenerator::convertComponent(int reg, BaseType from, BaseType to)
+{
+    if (from == to || to == BaseType::Float || (from == BaseType::Bool && to != BaseType::Bool) || (from != BaseType::Float && to != BaseType::Bool))
+        return reg;
+    if (to == BaseType::Bool)
+        return emit(CpuShaderOpcode::NotEqual, reg, getConstantRegister(0.0f));
+    return emit(CpuShaderOpcode::Truncate, reg);
+}
+
+// a scalar is replicated to every component and larger vectors and matrices are truncated, as HLSL does implicitly
+ShaderCodeGenerator::Value ShaderCodeGenerator::convert(const Value& value, const ShaderType& type, int line)
+{
+    if (IsSameType(value.type, type))
+        return value;
+
+    auto failConversion = [&]() {
+        fail(line, "Cannot convert " + getTypeName(value.type) + " to " + getTypeName(type));
+        return makeZeroValue(type);
+    };
+
+    if (!IsNumeric(value.type) || !IsNumeric(type))
+        return failConversion();
+
+    int sourceCount = static_cast<int>(value.registers.size());
+    int targetCount = getComponentCount(type);
+    vector<int> registers;
+
+    if (sourceCount == 1 && !value.type.arrayLength)
+    {
+        registers.assign(targetCount, value.registers[0]);
+    }
+    else if (value.type.arrayLength || type.arrayLength)
+    {
+        if (sourceCount != targetCount)
+            return failConversion();
+        registers = value.registers;
+    }
+    else if (value.type.isMatrix && type.isMatrix)
+    {
+        if (type.rows > value.type.rows || type.columns > value.type.columns)
+            return failConversion();
+        for (int row = 0; row < type.rows; ++row)
+        {
+            for (int column = 0; column < type.columns; ++column)
+                registers.push_back(value.registers[row * value.type.columns + column]);
+        }
+    }
+    else if (targetCount == sourceCount || (targetCount < sourceCount && !value.type.isMatrix && !type.isMatrix))
+    {
+        registers.assign(value.registers.begin(), value.registers.begin() + targetCount);
+    }
+    else
+    {
+        return failConversion();
+    }
+
+    Value converted;
+    converted.type = type;
+    for (int reg : registers)
+        converted.registers.push_back(convertComponent(reg, value.type.base, type.base));
+    return converted;
+}
+
+// the register of a scalar condition, 0 or 1 on every lane
+int ShaderCodeGenerator::getConditionRegister(const Value& value, int line)
+{
+    if (!IsNumeric(value.type) || value.registers.size() != 1)
+    {
+        fail(line, "Conditions must be scalars, not " + getTypeName(value.type));
+        return getConstantRegister(0.0f);
+    }
+    return convertComponent(value.registers[0], value.type.base, BaseType::Bool);
+}
+
+// runs an operation on every component of its arguments converted to a base type and their common shape
+ShaderCodeGenerator::Value ShaderCodeGenerator::applyComponentwise(CpuShaderOpcode opcode, const vector<Value>& arguments, BaseType base, int line)
+{
+    ShaderType shape = arguments[0].type;
+    for (size_t i = 1; i < arguments.size(); ++i)
+    {
+        if (!getCommonShape(shape, arguments[i].type, line, &shape))
+            return makeZeroValue(MakeVectorType(BaseType::Float, 1));
+    }
+    if (!IsNumeric(shape) || shape.arrayLength)
+    {
+        fail(line, "Invalid argument " + getTypeName(shape));
+        return makeZeroValue(MakeVectorType(BaseType::Float, 1));
+    }
+    shape.base = base;
+
+    vector<Value> converted;
+    for (const Value& argument : arguments)
+        converted.push_back(convert(argument, shape, line));
+
+    Value result;
+    result.type = shape;
+    for (int i = 0; i < getComponentCount(shape); ++i)
+    {
+        int sources[3] = {};
+        for (size_t j = 0; j < converted.size() && j < 3; ++j)
+            sources[j] = converted[j].registers[i];
+        result.registers.push_back(emit(opcode, sources[0], sources[1], sources[2]));
+    }
+    return result;
+}
+
+// indices are truncated to integers like the conversion to int
+int ShaderCodeGenerator::getIndexRegister(const Value& index, int line)
+{
+    if (!IsNumeric(index.type) || index.registers.size() != 1)
+    {
+        fail(line, "Indices must be scalars");
+        return getConstantRegister(0.0f);
+    }
+    return convertComponent(index.registers[0], index.type.base, BaseType::Int);
+}
+
+void ShaderCodeGenerator::pushScope()
+{
+    m_scopes.emplace_back();
+}
+
+void ShaderCodeGenerator::popScope()
+{
+    m_scopes.pop_back();
+}
+
+void ShaderCodeGenerator::declareSymbol(const Symbol& symbol, int line)
+{
+    for (const Symbol& other : m_scopes.back())
+    {
+        if (other.name == symbol.name)
+        {
+            fail(line, "Redefinition of " + symbol.name);
+            return;
+        }
+    }
+    m_scopes.back().push_back(symbol);
+}
+
+// a function sees its own scopes and the globals, not the variables of its callers
+bool ShaderCodeGenerator::findSymbol(const string& name, Symbol* out_symbol) const
+{
+    size_t firstScope = m_frames.empty() ? 0 : m_frames.back().firstScope;
+
+    for (size_t scope = m_scopes.size(); scope-- > 0;)
+    {
+        if (scope < firstScope && scope != 0)
+            continue;
+
+        for (const Symbol& symbol : m_scopes[scope])
+        {
+            if (symbol.name == name)
+            {
+                *out_symbol = symbol;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// a constant initialized from constants keeps their registers, other variables get registers of their own
+ShaderCodeGenerator::Value ShaderCodeGenerator::declareVariable(const string& name, const ShaderType& type, const Value* initialValue, bool isConst, int line)
+{
+    Value variable;
+    variable.type = type;
+
+    bool isConstantValue = initialValue && isConst;
+    float constant;
+    for (size_t i = 0; isConstantValue && i < initialValue->registers.size(); ++i)
+        isConstantValue = getConstantValue(initialValue->registers[i], &constant);
+
+    if (isConstantValue)
+    {
+        variable.registers = initialValue->registers;
+    }
+    else
+    {
+        int count = getComponentCount(type);
+        int firstRegister = newRegisters(count);
+        for (int i = 0; i < count; ++i)
+        {
+            variable.registers.push_back(firstRegister + i);
+            if (initialValue)
+                emitTo(CpuShaderOpcode::Move, firstRegister + i, initialValue->registers[i]);
+        }
+    }
+
+    Symbol symbol;
+    symbol.name = name;
+    symbol.value = variable;
+    symbol.declarationMask = m_currentMask;
+    symbol.isReadOnly = isConst;
+    declareSymbol(symbol, line);
+    return variable;
+}
+
+// statements after every lane returned or left the loop are not generated
+void ShaderCodeGenerator::compileStatement(const Statement& statement)
+{
+    if (m_currentMask == m_zeroRegister || !m_error.empty())
+        return;
+
+    switch (statement.kind)
+    {
+    case StatementKind::Block:
+        pushScope();
+        for (const std::unique_ptr<Statement>& child : statement.statements)
+            compileStatement(*child);
+        popScope();
+        break;
+    case StatementKind::Declaration:
+        compileDeclaration(statement);
+        break;
+    case StatementKind::Expression:
+        evaluate(*statement.expression);
+        break;
+    case StatementKind::If:
+        compileIf(statement);
+        break;
+    case StatementKind::For:
+    case StatementKind::While:
+        compileLoop(statement);
+        break;
+    case StatementKind::Return:
+        compileReturn(statement);
+        break;
+    case StatementKind::Break:
+    case StatementKind::Continue:
+        compileLoopExit(statement);
+        break;
+    default:
+        break;
+    }
+}
+
+void ShaderCodeGenerator::compileDeclaration(const Statement& statement)
+{
+    for (const Declarator& declarator : statement.declarators)
+    {
+        ShaderType type = statement.type;
+        type.arrayLength = declarator.arrayLength;
+
+        // unsized arrays take the length of their initializer list
+        if (type.arrayLength < 0)
+        {
+            if (!declarator.initializer || declarator.initializer->kind != ExpressionKind::InitializerList)
+            {
+                fail(declarator.line, "Unsized array " + declarator.name + " needs an initializer list");
+                return;
+            }
+
+            vector<int> registers;
+            vector<BaseType> bases;
+            flattenInitializer(*declarator.initializer, &registers, &bases);
+            ShaderType elementType = type;
+            elementType.arrayLength = 0;
+            type.arrayLength = std::max(1, static_cast<int>(registers.size()) / std::max(getComponentCount(elementType), 1));
+        }
+
+        if (!declarator.initializer)
+        {
+            if (statement.isConst)
+                fail(declarator.line, "Constant " + declarator.name + " needs an initializer");
+            declareVariable(declarator.name, type, nullptr, statement.isConst, declarator.line);
+            continue;
+        }
+
+        Value initialValue = declarator.initializer->kind == ExpressionKind::InitializerList
+            ? evaluateInitializer(*declarator.initializer, type)
+            : convert(evaluate(*declarator.initializer), type, declarator.line);
+        declareVariable(declarator.name, type, &initialValue, statement.isConst, declarator.line);
+    }
+}
+
+// both branches run under their own mask and are jumped over when none of the lanes takes them.
+// a constant condition only generates the branch it takes
+void ShaderCodeGenerator::compileIf(const Statement& statement)
+{
+    int condition = getConditionRegister(evaluate(*statement.expression), statement.line);
+
+    float constant;
+    if (getConstantValue(condition, &constant))
+    {
+        const Statement* branch = constant != 0.0f ? statement.body.get() : statement.elseBody.get();
+        if (branch)
+        {
+            pushScope();
+            compileStatement(*branch);
+            popScope();
+        }
+        return;
+    }
+
+    int savedMask = m_currentMask;
+    int exitCount = m_exitCount;
+
+    m_currentMask = emit(CpuShaderOpcode::And, savedMask, condition);
+    int thenJump = emitJump(CpuShaderOpcode::JumpIfNone, m_currentMask);
+    pushScope();
+    compileStatement(*statement.body);
+    popScope();
+    patchJump(thenJump);
+
+    if (statement.elseBody)
+    {
+        m_currentMask = emit(CpuShaderOpcode::AndNot, savedMask, condition);
+        int elseJump = emitJump(CpuShaderOpcode::JumpIfNone, m_currentMask);
+        pushScope();
+        compileStatement(*statement.elseBody);
+        popScope();
+        patchJump(elseJump);
+    }
+
+    m_currentMask = m_exitCount != exitCount ? removeExitedLanes(savedMask) : savedMask;
+}
+
+// takes the lanes that returned, or left the innermost loop or its iteration, out of a mask
+int ShaderCodeGenerator::removeExitedLanes(int mask)
+{
+    const FunctionFrame& frame = m_frames.back();
+
+    if (frame.returnedMask >= 0)
+        mask = emit(CpuShaderOpcode::AndNot, mask, frame.returnedMask);
+
+    if (!frame.loops.empty())
+    {
+        if (frame.loops.back().breakMask >= 0)
+            mask = emit(CpuShaderOpcode::AndNot, mask, frame.loops.back().breakMask);
+        if (frame.loops.back().continueMask >= 0)
+            mask = emit(CpuShaderOpcode::AndNot, mask, frame.loops.back().continueMask);
+    }
+
+    return mask;
+}
+
+// a loop keeps the lanes still iterating in a mask register : the condition takes lanes out of it at the top of every
+// iteration, and the loop ends when it is empty or after CPU_SHADER_MAX_LOOP_ITERATIONS iterations
+void ShaderCodeGenerator::compileLoop(const Statement& statement)
+{
+    pushScope();
+
+    if (statement.kind == StatementKind::For && unrollLoop(statement))
+    {
+        popScope();
+        return;
+    }
+
+    if (statement.init)
+        compileStatement(*statement.init);
+
+    int savedMask = m_currentMask;
+    int exitCount = m_exitCount;
+
+    LoopFrame loop;
+    FindStatement(*statement.body, false, [&](const Statement& child) {
+        if (child.kind == StatementKind::Break && loop.breakMask < 0)
+            loop.breakMask = newRegisters(1);
+        if (child.kind == StatementKind::Continue && loop.continueMask < 0)
+            loop.continueMask = newRegisters(1);
+        return false;
+    });
+
+    if (loop.breakMask >= 0)
+        emitTo(CpuShaderOpcode::Move, loop.breakMask, m_zeroRegister);
+
+    int loopMask = newRegisters(1);
+    int iterationCount = newRegisters(1);
+    emitTo(CpuShaderOpcode::Move, loopMask, savedMask);
+    emitTo(CpuShaderOpcode::Move, iterationCount, m_zeroRegister);
+
+    int loopTop = static_cast<int>(m_program->instructions.size());
+    m_currentMask = loopMask;
+
+    if (statement.expression)
+        emitTo(CpuShaderOpcode::And, loopMask, loopMask, getConditionRegister(evaluate(*statement.expression), statement.line));
+    emitTo(CpuShaderOpcode::LoopLimit, loopMask, iterationCount);
+    int exitJump = emitJump(CpuShaderOpcode::JumpIfNone, loopMask);
+
+    if (loop.continueMask >= 0)
+        emitTo(CpuShaderOpcode::Move, loop.continueMask, m_zeroRegister);
+
+    m_frames.back().loops.push_back(loop);
+    pushScope();
+    compileStatement(*statement.body);
+    popScope();
+    m_frames.back().loops.pop_back();
+
+    // the lanes that broke out of the loop or returned stop iterating, the ones that continued run the step
+    if (loop.breakMask >= 0)
+        emitTo(CpuShaderOpcode::AndNot, loopMask, loopMask, loop.breakMask);
+    if (m_frames.back().returnedMask >= 0 && m_exitCount != exitCount)
+        emitTo(CpuShaderOpcode::AndNot, loopMask, loopMask, m_frames.back().returnedMask);
+
+    m_currentMask = loopMask;
+    if (statement.step)
+        evaluate(*statement.step);
+
+    emitTo(CpuShaderOpcode::Jump, loopTop, 0);
+    patchJump(exitJump);
+
+    m_currentMask = savedMask;
+    if (m_frames.back().returnedMask >= 0 && m_exitCount != exitCount)
+        m_currentMask = emit(CpuShaderOpcode::AndNot, savedMask, m_frames.back().returnedMask);
+
+    popScope();
+}
+
+// a for loop declaring a counter it compares to a constant and steps by a constant, without changing it in the body,
+// is unrolled with the counter bound to a constant in every copy of the body, so indices using it are constants
+bool ShaderCodeGenerator::unrollLoop(const Statement& statement)
+{
+    const Statement* init = statement.init.get();
+    if (!init || init->kind != StatementKind::Declaration || init->declarators.size() != 1 || !statement.expression || !statement.step)
+        return false;
+
+    const Declarator& counter = init->declarators[0];
+    ShaderType counterType = init->type;
+    float start;
+    if (!IsNumeric(counterType) || counterType.base == BaseType::Bool || counterType.rows * counterType.columns != 1 || counter.arrayLength
+        || !counter.initializer || !EvaluateConstantExpression(*counter.initializer, &start))
+        return false;
+
+    // the condition compares the counter to a constant, on either side
+    const Expression& condition = *statement.expression;
+    if (condition.kind != ExpressionKind::Binary || condition.operands.size() != 2)
+        return false;
+
+    string op = condition.text;
+    float bound;
+    if (condition.operands[0]->kind == ExpressionKind::Identifier && condition.operands[0]->text == counter.name
+        && EvaluateConstantExpression(*condition.operands[1], &bound))
+    {
+    }
+    else if (condition.operands[1]->kind == ExpressionKind::Identifier && condition.operands[1]->text == counter.name
+        && EvaluateConstantExpression(*condition.operands[0], &bound))
+    {
+        op = op == "<" ? ">" : op == ">" ? "<" : op == "<=" ? ">=" : op == ">=" ? "<=" : op;
+    }
+    else
+    {
+        return false;
+    }
+
+    if (op != "<" && op != "<=" && op != ">" && op != ">=" && op != "!=")
+        return false;
+
+    // the step adds or subtracts a constant
+    const Expression& step = *statement.step;
+    float stepValue = 0.0f;
+    if (step.kind == ExpressionKind::Increment && step.operands[0]->kind == ExpressionKind::Identifier && step.operands[0]->text == counter.name)
+    {
+        stepValue = step.text == "++" ? 1.0f : -1.0f;
+    }
+    else if (step.kind == ExpressionKind::Assignment && (step.text == "+=" || step.text == "-=") && step.operands[0]->kind == ExpressionKind::Identifier
+        && step.operands[0]->text == counter.name && EvaluateConstantExpression(*step.operands[1], &stepValue))
+    {
+        stepValue = step.text == "+=" ? stepValue : -stepValue;
+    }
+
+    if (stepValue == 0.0f)
+        return false;
+
+    // the body must not write the counter, nor leave the loop early
+    bool isCounterWritten = FindExpressionInStatement(*statement.body, [&](const Expression& expression) {
+        if ((expression.kind == ExpressionKind::Assignment || expression.kind == ExpressionKind::Increment)
+            && GetRootExpression(*expression.operands[0])->text == counter.name)
+            return true;
+
+        // arguments of calls may be out parameters
+        if (expression.kind == ExpressionKind::Call || expression.kind == ExpressionKind::MethodCall)
+        {
+            for (const ExpressionPointer& argument : expression.operands)
+            {
+                if (GetRootExpression(*argument)->kind == ExpressionKind::Identifier && GetRootExpression(*argument)->text == counter.name)
+                    return true;
+            }
+        }
+        return false;
+    });
+
+    bool isLeftEarly = FindStatement(*statement.body, false, [](const Statement& child) {
+        return child.kind == StatementKind::Break || child.kind == StatementKind::Continue;
+    });
+
+    if (isCounterWritten || isLeftEarly)
+        return false;
+
+    vector<float> values;
+    float value = counterType.base == BaseType::Float ? start : std::trunc(start);
+    while ((op == "<" && value < bound) || (op == "<=" && value <= bound) || (op == ">" && value > bound) || (op == ">=" && value >= bound) || (op == "!=" && value != bound))
+    {
+        values.push_back(value);
+        if (values.size() > CPU_SHADER_MAX_UNROLLED_ITERATIONS)
+            return false;
+        value += counterType.base == BaseType::Float ? stepValue : std::trunc(stepValue);
+    }
+
+    for (float counterValue : values)
+    {
+        pushScope();
+        Symbol symbol;
+        symbol.name = counter.name;
+        symbol.value.type = counterType;
+        symbol.value.registers.push_back(getConstantRegister(counterValue));
+        symbol.declarationMask = m_currentMask;
+        symbol.isReadOnly = true;
+        declareSymbol(symbol, statement.line);
+        compileStatement(*statement.body);
+        popScope();
+    }
+
+    return true;
+}
+
+// the lanes returning store the return value and leave the masks until the end of the function. when all the lanes
+// running the function return, the statements up to its end are not generated
+void ShaderCodeGenerator::compileReturn(const Statement& statement)
+{
+    FunctionFrame& frame = m_frames.back();
+    bool isVoid = frame.function->returnType.base == BaseType::Void;
+
+    if (statement.expression && isVoid)
+    {
+        fail(statement.line, "Function " + frame.function->name + " does not return a value");
+        return;
+    }
+    if (!statement.expression && !isVoid)
+    {
+        fail(statement.line, "Missing return value");
+        return;
+    }
+
+    if (statement.expression)
+    {
+        Value value = evaluate(*statement.expression);
+
+        LValue target;
+        target.type = frame.returnValue.type;
+        target.registers = frame.returnValue.registers;
+        target.conditions.assign(target.registers.size(), -1);
+        target.declarationMask = frame.entryMask;
+        store(target, value, statement.line);
+    }
+
+    if (m_currentMask != frame.entryMask)
+    {
+        emitTo(CpuShaderOpcode::Or, frame.returnedMask, frame.returnedMask, m_currentMask);
+        ++m_exitCount;
+    }
+    m_currentMask = m_zeroRegister;
+}
+
+void ShaderCodeGenerator::compileLoopExit(const Statement& statement)
+{
+    FunctionFrame& frame = m_frames.back();
+    if (frame.loops.empty())
+    {
+        fail(statement.line, string(statement.kind == StatementKind::Break ? "break" : "continue") + " outside of a loop");
+        return;
+    }
+
+    int exitMask = statement.kind == StatementKind::Break ? frame.loops.back().breakMask : frame.loops.back().continueMask;
+    emitTo(CpuShaderOpcode::Or, exitMask, exitMask, m_currentMask);
+    m_currentMask = m_zeroRegister;
+    ++m_exitCount;
+}
+
+ShaderCodeGenerator::Value ShaderCodeGenerator::evaluate(const Expression& expression)
+{
+    if (!m_error.empty())
+        return makeZeroValue(MakeVectorType(BaseType::Float, 1));
+
+    switch (expression.kind)
+    {
+    case ExpressionKind::Literal:
+    {
+        Value value;
+        value.type = MakeVectorType(expression.type.base, 1);
+        value.registers.push_back(getConstantRegister(expression.value));
+        return value;
+    }
+    case ExpressionKind::Identifier:
+    {
+        Symbol symbol;
+        if (!findSymbol(expression.text, &symbol))
+        {
+            fail(expression.line, "Unknown identifier " + expression.text);
+            return makeZeroValue(MakeVectorType(BaseType::Float, 1));
+        }
+        return symbol.value;
+    }
+    case ExpressionKind::Unary:
+        return evaluateUnary(expression);
+    case ExpressionKind::Binary:
+        if (expression.text == ",")
+        {
+            evaluate(*expression.operands[0]);
+            return evaluate(*expression.operands[1]);
+        }
+        return evaluateBinary(expression.text, evaluate(*expression.operands[0]), evaluate(*expression.operands[1]), expression.line);
+    case ExpressionKind::Assignment:
+        return evaluateAssignment(expression);
+    case ExpressionKind::Increment:
+        return evaluateIncrement(expression);
+    case ExpressionKind::Ternary:
+        return evaluateTernary(expression);
+    case ExpressionKind::Call:
+        return evaluateCall(expression);
+    case ExpressionKind::MethodCall:
+        return evaluateMethodCall(expression);
+    case ExpressionKind::Constructor:
+    {
+        vector<Value> arguments;
+        for (const ExpressionPointer& operand : expression.operands)
+            arguments.push_back(evaluate(*operand));
+        return evaluateConstructor(expression.type, arguments, expression.line);
+    }
+    case ExpressionKind::Cast:
+        return convert(evaluate(*expression.operands[0]), expression.type, expression.line);
+    case ExpressionKind::Member:
+    {
+        Value object = evaluate(*expression.operands[0]);
+        vector<int> indices;
+        Value member;
+        if (!getMemberComponents(object.type, expression.text, expression.line, &indices, &member.type))
+            return makeZeroValue(MakeVectorType(BaseType::Float, 1));
+        for (int index : indices)
+            member.registers.push_back(object.registers[index]);
+        return member;
+    }
+    case ExpressionKind::Index:
+        return evaluateIndex(expression);
+    default:
+        fail(expression.line, "Initializer lists are only allowed in declarations");
+        return makeZeroValue(MakeVectorType(BaseType::Float, 1));
+    }
+}
+
+bool ShaderCodeGenerator::evaluateLValue(const Expression& expression, LValue* out_lvalue)
+{
+    if (expression.kind == ExpressionKind::Identifier)
+    {
+        Symbol symbol;
+        if (!findSymbol(expression.text, &symbol))
+        {
+            fail(expression.line, "Unknown identifier " + expression.text);
+            return false;
+        }
+        if (symbol.isReadOnly || (!IsNumeric(symbol.value.type) && symbol.value.type.base != BaseType::Struct))
+        {
+            fail(expression.line, "Cannot assign to " + expression.text);
+            return false;
+        }
+
+        out_lvalue->type = symbol.value.type;
+        out_lvalue->registers = symbol.value.registers;
+        out_lvalue->conditions.assign(out_lvalue->registers.size(), -1);
+        out_lvalue->declarationMask = symbol.declarationMask;
+        return true;
+    }
+
+    if (expression.kind != ExpressionKind::Member && expression.kind != ExpressionKind::Index)
+    {
+        fail(expression.line, "Cannot assign to an expression");
+        return false;
+    }
+
+    LValue object;
+    if (!evaluateLValue(*expression.operands[0], &object))
+        return false;
+
+    int objectCount = getComponentCount(object.type);
+    int alternativeCount = objectCount ? static_cast<int>(object.registers.size()) / objectCount : 0;
+
+    // the indices of the components written, in the components of each alternative, with their conditions
+    vector<vector<int>> selections;
+    vector<int> selectionConditions;
+
+    *out_lvalue = LValue();
+    out_lvalue->declarationMask = object.declarationMask;
+
+    if (expression.kind == ExpressionKind::Member)
+    {
+        vector<int> indices;
+        if (!getMemberComponents(object.type, expression.text, expression.line, &indices, &out_lvalue->type))
+            return false;
+
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            if (std::find(indices.begin() + i + 1, indices.end(), indices[i]) != indices.end())
+            {
+                fail(expression.line, "Repeated component in the assignment to ." + expression.text);
+                return false;
+            }
+        }
+
+        selections.push_back(indices);
+        selectionConditions.push_back(-1);
+    }
+    else
+    {
+        int elementCount;
+        if (!getElementType(object.type, expression.line, &out_lvalue->type, &elementCount))
+            return false;
+
+        int elementSize = getComponentCount(out_lvalue->type);
+        int index = getIndexRegister(evaluate(*expression.operands[1]), expression.line);
+        float constantIndex;
+        bool isConstantIndex = getConstantValue(index, &constantIndex);
+
+        // a variable index writes every element under the condition that the index is its own
+        for (int element = 0; element < elementCount; ++element)
+        {
+            if (isConstantIndex && element != static_cast<int>(constantIndex))
+                continue;
+
+            vector<int> indices;
+            for (int i = 0; i < elementSize; ++i)
+                indices.push_back(element * elementSize + i);
+            selections.push_back(indices);
+            selectionConditions.push_back(isConstantIndex ? -1 : emit(CpuShaderOpcode::Equal, index, getConstantRegister(static_cast<float>(element))));
+        }
+
+        if (selections.empty())
+        {
+            fail(expression.line, "Index out of range");
+            return false;
+        }
+    }
+
+    for (int alternative = 0; alternative < alternativeCount; ++alternative)
+    {
+        for (size_t selection = 0; selection < selections.size(); ++selection)
+        {
+            for (int index : selections[selection])
+            {
+                int objectComponent = alternative * objectCount + index;
+                int condition = object.conditions[objectComponent];
+                int selectionCondition = selectionConditions[selection];
+
+                if (condition >= 0 && selectionCondition >= 0)
+                    condition = emit(CpuShaderOpcode::And, condition, selectionCondition);
+                else if (selectionCondition >= 0)
+                    condition = selectionCondition;
+
+                out_lvalue->registers.push_back(object.registers[objectComponent]);
+                out_lvalue->conditions.push_back(condition);
+            }
+        }
+    }
+
+    return true;
+}
+
+// a store needs no mask when the lanes running are the ones that declared the variable. sources overlapping the
+// registers written, as in v = v.yx, are copied first
+void ShaderCodeGenerator::store(const LValue& lvalue, const Value& value, int line)
+{
+    Value converted = convert(value, lvalue.type, line);
+    size_t componentCount = converted.registers.size();
+    if (componentCount == 0 || m_currentMask == m_zeroRegister)
+        return;
+
+    for (int& source : converted.registers)
+    {
+        if (std::find(lvalue.registers.begin(), lvalue.registers.end(), source) != lvalue.registers.end())
+            source = emit(CpuShaderOpcode::Move, source);
+    }
+
+    int runningMask = m_currentMask == lvalue.declarationMask ? -1 : m_currentMask;
+
+    for (size_t i = 0; i < lvalue.registers.size(); ++i)
+    {
+        int target = lvalue.registers[i];
+        int source = converted.registers[i % componentCount];
+        int mask = runningMask;
+
+        if (lvalue.conditions[i] >= 0)
+            mask = mask < 0 ? lvalue.conditions[i] : emit(CpuShaderOpcode::And, mask, lvalue.conditions[i]);
+
+        if (mask < 0)
+            emitTo(CpuShaderOpcode::Move, target, source);
+        else
+            emitTo(CpuShaderOpcode::Select, target, mask, source, target);
+    }
+}
+
+ShaderCodeGenerator::Value ShaderCodeGenerator::evaluateUnary(const Expression& expression)
+{
+    Value operand = evaluate(*expression.operands[0]);
+    if (!IsNumeric(operand.type) || operand.type.arrayLength)
+    {
+        fail(expression.line, "Invalid operand " + getTypeName(operand.type) + " of " + expression.text);
+        return makeZeroValue(MakeVectorType(BaseType::Float, 1));
+    }
+
+    BaseType base = operand.type.base == BaseType::Bool ? BaseType::Int : operand.type.base;
+
+    if (expression.text == "+")
+        return applyComponentwise(CpuShaderOpcode::Move, { operand }, base, expression.line);
+    if (expression.text == "-")
+        return applyComponentwise(CpuShaderOpcode::Negate, { operand }, base, expression.line);
+    if (expression.text == "!")
+        return applyComponentwise(CpuShaderOpcode::Not, { operand }, BaseType::Bool, expression.line);
+
+    if (base == BaseType::Float)
+    {
+        fail(expression.line, "Bitwise operators need integers");
+        return makeZeroValue(operand.type);
+    }
+    return applyComponentwise(CpuShaderOpcode::BitNot, { operand }, base, expression.line);
+}
+
+// arithmetic is done in float if an operand is a float, then in uint if one is, otherwise in int
+ShaderCodeGenerator::Value ShaderCodeGenerator::evaluateBinary(const string& op, const Value& left, const Value& right, int line)
+{
+    BaseType base = BaseType::Int;
+    if (left.type.base == BaseType::Float || right.type.base == BaseType::Float)
+        base = BaseType::Float;
+    else if (left.type.base == BaseType::Uint || right.type.base == BaseType::Uint)
+        base = BaseType::Uint;
+
+    if (op == "&&" || op == "||")
+        return applyComponentwise(op == "&&" ? CpuShaderOpcode::And : CpuShaderOpcode::Or, { left, right }, BaseType::Bool, line);
+
+    if (op == "<" || op == ">" || op == "<=" || op == ">=" || op == "==" || op == "!=")
+    {
+        // comparisons convert their operands to the common type, and swap them for > and >=
+        ShaderType shape;
+        if (!getCommonShape(left.type, right.type, line, &shape))
+            return makeZeroValue(MakeVectorType(BaseType::Bool, 1));
+        shape.base = base;
+
+        Value a = convert(left, shape, line);
+        Value b = convert(right, shape, line);
+        if (op == ">" || op == ">=")
+            std::swap(a, b);
+
+        CpuShaderOpcode opcode = (op == "<" || op == ">") ? CpuShaderOpcode::Less : (op == "<=" || op == ">=") ? CpuShaderOpcode::LessEqual
+            : op == "==" ? CpuShaderOpcode::Equal : CpuShaderOpcode::NotEqual;
+
+        Value result = applyComponentwise(opcode, { a, b }, base, line);
+        result.type.base = BaseType::Bool;
+        return result;
+    }
+
+    if (op == "&" || op == "|" || op == "^" || op == "<<" || op == ">>")
+    {
+        if (base == BaseType::Float)
+        {
+            fail(line, "Bitwise operators need integers");
+            return makeZeroValue(MakeVectorType(BaseType::Int, 1));
+        }
+
+        CpuShaderOpcode opcode = op == "&" ? CpuShaderOpcode::BitAnd : op == "|" ? CpuShaderOpcode::BitOr : op == "^" ? CpuShaderOpcode::BitXor
+            : op == "<<" ? CpuShaderOpcode::ShiftLeft : CpuShaderOpcode::ShiftRight;
+        return applyComponentwise(opcode, { left, right }, base, line);
+    }
+
+    CpuShaderOpcode opcode = CpuShaderOpcode::Add;
+    if (op == "-")
+        opcode = CpuShaderOpcode::Subtract;
+    else if (op == "*")
+        opcode = CpuShaderOpcode::Multiply;
+    else if (op == "/")
+        opcode = base == BaseType::Float ? CpuShaderOpcode::Divide : CpuShaderOpcode::IntegerDivide;
+    else if (op == "%")
+        opcode = CpuShaderOpcode::Modulo;
+
+    return applyComponentwise(opcode, { left, right }, base, line);
+}
+
+// compound assignments read the target as an expression, then store the result of the operation
+ShaderCodeGenerator::Value ShaderCodeGenerator::evaluateAssignment(const Expression& expression)
+{
+    LValue target;
+    if (!evaluateLValue(*expression.operands[0], &target))
+        return makeZeroValue(MakeVectorType(BaseType::Float, 1));
+
+    Value value = evaluate(*expression.operands[1]);
+    if (expression.text != "=")
+        value = evaluateBinary(expression.text.substr(0, expression.text.size() - 1), evaluate(*expression.operands[0]), value, expression.line);
+
+    value = convert(value, target.type, expression.line);
+    store(target, value, expression.line);
+    return value;
+}
+
+// the value of a postfix increment is copied before the store
+ShaderCodeGenerator::Value ShaderCodeGenerator::evaluateIncrement(const Expression& expression)
+{
+    LValue target;
+    if (!evaluateLValue(*expression.operands[0], &target))
+        return makeZeroValue(MakeVectorType(BaseType::Float, 1));
+
+    Value current = evaluate(*expression.operands[0]);
+    Value one;
+    one.type = MakeVectorType(BaseType::Int, 1);
+    one.registers.push_back(getConstantRegister(1.0f));
+
+    Value updated = convert(evaluateBinary(expression.text == "++" ? "+" : "-", current, one, expression.line), target.type, expression.line);
+    if (expression.isPrefix)
+    {
+        store(target, updated, expression.line);
+        return updated;
+    }
+
+    Value previous = current;
+    for (int& reg : previous.registers)
+        reg = emit(CpuShaderOpcode::Move, reg);
+    store(target, updated, expression.line);
+    return previous;
+}
+
+// both sides are evaluated, as in HLSL, and selected per component
+ShaderCodeGenerator::Value ShaderCodeGenerator::evaluateTernary(const Expression& expression)
+{
+    Value condition = evaluate(*expression.operands[0]);
+    Value whenTrue = evaluate(*expression.operands[1]);
+    Value whenFalse = evaluate(*expression.operands[2]);
+
+    if (whenTrue.type.base == BaseType::Struct || whenTrue.type.arrayLength)
+    {
+        if (!IsSameType(whenTrue.type, whenFalse.type))
+            fail(expression.line, "Both sides of ?: must have the same type");
+        int conditionRegister = getConditionRegister(condition, expression.line);
+
+        Value result;
+        result.type = whenTrue.type;
+        for (size_t i = 0; i < whenTrue.registers.size() && i < whenFalse.registers.size(); ++i)
+            result.registers.push_back(emit(CpuShaderOpcode::Select, conditionRegister, whenTrue.registers[i], whenFalse.registers[i]));
+        return result;
+    }
+
+    BaseType base = whenTrue.type.base == whenFalse.type.base ? whenTrue.type.base
+        : (whenTrue.type.base == BaseType::Float || whenFalse.type.base == BaseType::Float) ? BaseType::Float : BaseType::Int;
+    ShaderType shape;
+    if (!getCommonShape(whenTrue.type, whenFalse.type, expression.line, &shape) || !getCommonShape(shape, condition.type, expression.line, &shape))
+        return makeZeroValue(MakeVectorType(BaseType::Float, 1));
+
+    ShaderType conditionType = shape;
+    conditionType.base = BaseType::Bool;
+    Value conditions = convert(condition, conditionType, expression.line);
+    shape.base = base;
+
+    return applyComponentwise(CpuShaderOpcode::Select, { conditions, convert(whenTrue, shape, expression.line), convert(whenFalse, shape, expression.line) }, base, expression.line);
+}
+
+// constructors take the components of their arguments in order, or replicate a single scalar
+ShaderCodeGenerator::Value ShaderCodeGenerator::evaluateConstructor(const ShaderType& type, const vector<Value>& arguments, int line)
+{
+    if (arguments.size() == 1 && arguments[0].registers.size() == 1)
+        return convert(arguments[0], type, line);
+
+    Value result;
+    result.type = type;
+    for (const Value& argument : arguments)
+    {
+        if (!IsNumeric(argument.type))
+        {
+            fail(line, "Invalid argument " + getTypeName(argument.type) + " of a " + getTypeName(type) + " constructor");
+            return makeZeroValue(type);
+        }
+        for (int reg : argument.registers)
+            result.registers.push_back(convertComponent(reg, argument.type.base, type.base));
+    }
+
+    if (static_cast<int>(result.registers.size()) != getComponentCount(type))
+    {
+        fail(line, "Wrong number of components for a " + getTypeName(type) + " constructor");
+        return makeZeroValue(type);
+    }
+    return result;
+}
+
+void ShaderCodeGenerator::flattenInitializer(const Expression& expression, vector<int>* out_registers, vector<BaseType>* out_bases)
+{
+    if (expression.kind != ExpressionKind::InitializerList)
+    {
+        Value value = evaluate(expression);
+        vector<BaseType> bases;
+        getComponentBaseTypes(value.type, &bases);
+        out_registers->insert(out_registers->end(), value.registers.begin(), value.registers.end());
+        out_bases->insert(out_bases->end(), bases.begin(), bases.end());
+        return;
+    }
+
+    for (const ExpressionPointer& element : expression.operands)
+        flattenInitializer(*element, out_registers, out_bases);
+}
+
+// the components of an initializer list fill the components of the variable in order, converted to their base types
+ShaderCodeGenerator::Value ShaderCodeGenerator::evaluateInitializer(const Expression& expression, const ShaderType& type)
+{
+    vector<int> registers;
+    vector<BaseType> bases;
+    flattenInitializer(expression, &registers, &bases);
+
+    vector<BaseType> targetBases;
+    getComponentBaseTypes(type, &targetBases);
+
+    if (registers.size() != targetBases.size())
+    {
+        fail(expression.line, "Wrong number of components to initialize a " + getTypeName(type));
+        return makeZeroValue(type);
+    }
+
+    Value value;
+    value.type = type;
+    for (size_t i = 0; i < registers.size(); ++i)
+        value.registers.push_back(convertComponent(registers[i], bases[i], targetBases[i]));
+    return value;
+}
+
+// members of structs, swizzles of scalars and vectors like .xy or .rgb, and of matrices like ._m00_m11 or ._11_22
+bool ShaderCodeGenerator::getMemberComponents(const ShaderType& type, const string& name, int line, vector<int>* out_indices, ShaderType* out_type)
+{
+    if (type.base == BaseType::Struct && !type.arrayLength)
+    {
+        int offset = 0;
+        for (const StructMember& member : m_module.structs[type.structIndex].members)
+        {
+            int count = getComponentCount(member.type);
+            if (member.name == name)
+            {
+                for (int i = 0; i < count; ++i)
+                    out_indices->push_back(offset + i);
+                *out_type = member.type;
+                return true;
+            }
+            offset += count;
+        }
+
+        fail(line, getTypeName(type) + " has no member " + name);
+        return false;
+    }
+
+    if (!IsNumeric(type) || type.arrayLength)
+    {
+        fail(line, getTypeName(type) + " has no member " + name);
+        return false;
+    }
+
+    if (type.isMatrix)
+    {
+        size_t i = 0;
+        while (i < name.size())
+        {
+            bool isZeroBased = i + 1 < name.size() && name[i + 1] == 'm';
+            size_t digits = i + (isZeroBased ? 2 : 1);
+            if (name[i] != '_' || digits + 1 >= name.size() || !IsDigit(name[digits]) || !IsDigit(name[digits + 1]))
+            {
+                fail(line, "Invalid matrix swizzle ." + name);
+                return false;
+            }
+
+            int row = name[digits] - (isZeroBased ? '0' : '1');
+            int column = name[digits + 1] - (isZeroBased ? '0' : '1');
+            if (row < 0 || row >= type.rows || column < 0 || column >= type.columns)
+            {
+                fail(line, "Matrix swizzle ." + name + " out of range");
+                return false;
+            }
+
+            out_indices->push_back(row * type.columns + column);
+            i = digits + 2;
+        }
+    }
+    else
+    {
+        const char* componentSets[] = { "xyzw", "rgba" };
+        for (const char* components : componentSets)
+        {
+            out_indices->clear();
+            for (char c : name)
+            {
+                const char* component = std::strchr(components, c);
+                if (!component || component - components >= type.columns)
+                    break;
+                out_indices->push_back(static_cast<int>(component - components));
+            }
+
+            if (out_indices->size() == name.size())
+                break;
+        }
+
+        if (out_indices->size() != name.size())
+        {
+            fail(line, "Invalid swizzle ." + name + " of " + getTypeName(type));
+            return false;
+        }
+    }
+
+    if (out_indices->empty() || out_indices->size() > 4)
+    {
+        fail(line, "Invalid swizzle ." + name);
+        return false;
+    }
+
+    *out_type = MakeVectorType(type.base, static_cast<int>(out_indices->size()));
+    return true;
+}
+
+// arrays are indexed by element, matrices by row and vectors by component
+bool ShaderCodeGenerator::getElementType(const ShaderType& type, int line, ShaderType* out_elementType, int* out_elementCount)
+{
+    *out_elementType = type;
+
+    if (type.arrayLength)
+    {
+        out_elementType->arrayLength = 0;
+        *out_elementCount = type.arrayLength;
+    }
+    else if (IsNumeric(type) && type.isMatrix)
+    {
+        *out_elementType = MakeVectorType(type.base, type.columns);
+        *out_elementCount = type.rows;
+    }
+    else if (IsNumeric(type) && type.columns > 1)
+    {
+        *out_elementType = MakeVectorType(type.base, 1);
+        *out_elementCount = type.columns;
+    }
+    else
+    {
+        fail(line, getTypeName(type) + " cannot be indexed");
+        return false;
+    }
+
+    return true;
+}
+
+// a variable index selects between all the elements, an index out of range reads the first one
+ShaderCodeGenerator::Value ShaderCodeGenerator::evaluateIndex(const Expression& expression)
+{
+    Value object = evaluate(*expression.operands[0]);
+    Value indexValue = evaluate(*expression.operands[1]);
+
+    // indexing a texture with integer coordinates loads a texel
+    if (object.type.base == BaseType::Texture)
+    {
+        Value location = convert(indexValue, MakeVectorType(BaseType::Int, 2), expression.line);
+        Value texel;
+        texel.type = MakeVectorType(BaseType::Float, 4);
+        int firstRegister = newRegisters(4);
+        emitTo(CpuShaderOpcode::Load, firstRegister, location.registers[0], location.registers[1]);
+        for (int i = 0; i < 4; ++i)
+            texel.registers.push_back(firstRegister + i);
+        return texel;
+    }
+
+    Value element;
+    int elementCount;
+    if (!getElementType(object.type, expression.line, &element.type, &elementCount))
+        return makeZeroValue(MakeVectorType(BaseType::Float, 1));
+
+    int elementSize = getComponentCount(element.type);
+    int index = getIndexRegister(indexValue, expression.line);
+
+    float constantIndex;
+    if (getConstantValue(index, &constantIndex))
+    {
+        if (constantIndex < 0.0f || constantIndex >= elementCount)
+        {
+            fail(expression.line, "Index out of range");
+            return makeZeroValue(element.type);
+        }
+        int first = static_cast<int>(constantIndex) * elementSize;
+        element.registers.assign(object.registers.begin() + first, object.registers.begin() + first + elementSize);
+        return element;
+    }
+
+    element.registers.assign(object.registers.begin(), object.registers.begin() + elementSize);
+    for (int e = 1; e < elementCount; ++e)
+    {
+        int isElement = emit(CpuShaderOpcode::Equal, index, getConstantRegister(static_cast<float>(e)));
+        for (int i = 0; i < elementSize; ++i)
+            element.registers[i] = emit(CpuShaderOpcode::Select, isElement, object.registers[e * elementSize + i], element.registers[i]);
+    }
+    return element;
+}
+
+// functions of the shader are inlined, out and inout arguments are stored back after the call
+ShaderCodeGenerator::Value ShaderCodeGenerator::evaluateCall(const Expression& expression)
+{
+    const FunctionDefinition* function = nullptr;
+    for (const FunctionDefinition& candidate : m_module.functions)
+    {
+        if (candidate.name == expression.text && candidate.parameters.size() == expression.operands.size())
+        {
+            function = &candidate;
+            break;
+        }
+    }
+
+    if (!function)
+    {
+        vector<Value> arguments;
+        for (const ExpressionPointer& operand : expression.operands)
+            arguments.push_back(evaluate(*operand));
+
+        Value result;
+        if (!evaluateIntrinsic(expression.text, arguments, expression.line, &result))
+        {
+            fail(expression.line, "Unknown function " + expression.text + " with " + std::to_string(arguments.size()) + " arguments");
+            return makeZeroValue(MakeVectorType(BaseType::Float, 1));
+        }
+        return result;
+    }
+
+    if (std::find(m_callStack.begin(), m_callStack.end(), function) != m_callStack.end())
+    {
+        fail(expression.line, "Recursive call to " + function->name);
+        return makeZeroValue(function->returnType);
+    }
+
+    vector<Value> arguments;
+    vector<LValue> outArguments(function->parameters.size());
+
+    for (size_t i = 0; i < function->parameters.size(); ++i)
+    {
+        const FunctionParameter& parameter = function->parameters[i];
+        if (parameter.isOut && !evaluateLValue(*expression.operands[i], &outArguments[i]))
+            return makeZeroValue(function->returnType);
+
+        if (parameter.isIn)
+        {
+            arguments.push_back(convert(evaluate(*expression.operands[i]), parameter.type, expression.line));
+        }
+        else
+        {
+            Value output;
+            output.type = parameter.type;
+            int firstRegister = newRegisters(getComponentCount(parameter.type));
+            for (int c = 0; c < getComponentCount(parameter.type); ++c)
+                output.registers.push_back(firstRegister + c);
+            arguments.push_back(output);
+        }
+    }
+
+    m_callStack.push_back(function);
+    vector<Value> parameters;
+    Value result = inlineFunction(*function, arguments, false, &parameters);
+    m_callStack.pop_back();
+
+    for (size_t i = 0; i < function->parameters.size(); ++i)
+    {
+        if (function->parameters[i].isOut)
+            store(outArguments[i], parameters[i], expression.line);
+    }
+
+    return result;
+}
+
+// the intrinsics are lowered to operations on the components of their arguments
+bool ShaderCodeGenerator::evaluateIntrinsic(const string& name, const vector<Value>& arguments, int line, Value* out_value)
+{
+    static const std::map<string, CpuShaderOpcode> UNARY_FLOAT_INTRINSICS = { { "sqrt", CpuShaderOpcode::Sqrt }, { "rsqrt", CpuShaderOpcode::Rsqrt },
+        { "exp", CpuShaderOpcode::Exp }, { "exp2", CpuShaderOpcode::Exp2 }, { "log", CpuShaderOpcode::Log }, { "log2", CpuShaderOpcode::Log2 },
+        { "sin", CpuShaderOpcode::Sin }, { "cos", CpuShaderOpcode::Cos }, { "tan", CpuShaderOpcode::Tan }, { "asin", CpuShaderOpcode::Asin },
+        { "acos", CpuShaderOpcode::Acos }, { "atan", CpuShaderOpcode::Atan }, { "floor", CpuShaderOpcode::Floor }, { "ceil", CpuShaderOpcode::Ceil },
+        { "frac", CpuShaderOpcode::Frac }, { "round", CpuShaderOpcode::Round }, { "trunc", CpuShaderOpcode::Truncate }, { "saturate", CpuShaderOpcode::Saturate } };
+
+    static const std::map<string, CpuShaderOpcode> BINARY_FLOAT_INTRINSICS = { { "pow", CpuShaderOpcode::Pow }, { "atan2", CpuShaderOpcode::Atan2 },
+        { "fmod", CpuShaderOpcode::Modulo } };
+
+    static const std::map<string, int> ARGUMENT_COUNTS = { { "abs", 1 }, { "sign", 1 }, { "rcp", 1 }, { "log10", 1 }, { "radians", 1 }, { "degrees", 1 },
+        { "min", 2 }, { "max", 2 }, { "step", 2 }, { "clamp", 3 }, { "lerp", 3 }, { "smoothstep", 3 }, { "mad", 3 }, { "dot", 2 }, { "length", 1 },
+        { "distance", 2 }, { "normalize", 1 }, { "cross", 2 }, { "reflect", 2 }, { "any", 1 }, { "all", 1 }, { "mul", 2 } };
+
+    auto unary = UNARY_FLOAT_INTRINSICS.find(name);
+    auto binary = BINARY_FLOAT_INTRINSICS.find(name);
+    auto argumentCount = ARGUMENT_COUNTS.find(name);
+
+    int expectedCount = unary != UNARY_FLOAT_INTRINSICS.end() ? 1 : binary != BINARY_FLOAT_INTRINSICS.end() ? 2
+        : argumentCount != ARGUMENT_COUNTS.end() ? argumentCount->second : -1;
+    if (expectedCount < 0)
+        return false;
+
+    if (static_cast<int>(arguments.size()) != expectedCount)
+    {
+        fail(line, name + " takes " + std::to_string(expectedCount) + " arguments");
+        *out_value = makeZeroValue(MakeVectorType(BaseType::Float, 1));
+        return true;
+    }
+
+    for (const Value& argument : arguments)
+    {
+        if (!IsNumeric(argument.type) || argument.type.arrayLength)
+        {
+            fail(line, "Invalid argument " + getTypeName(argument.type) + " of " + name);
+            *out_value = makeZeroValue(MakeVectorType(BaseType::Float, 1));
+            return true;
+        }
+    }
+
+    const Value& a = arguments[0];
+    BaseType base = BaseType::Int;
+    for (const Value& argument : arguments)
+    {
+        if (argument.type.base == BaseType::Float)
+            base = BaseType::Float;
+        else if (argument.type.base == BaseType::Uint && base == BaseType::Int)
+            base = BaseType::Uint;
+    }
+
+    auto scalar = [&](int reg) {
+        Value value;
+        value.type = MakeVectorType(BaseType::Float, 1);
+        value.registers.push_back(reg);
+        return value;
+    };
+    auto constant = [&](float value) { return scalar(getConstantRegister(value)); };
+    auto toFloat = [&](const Value& value) {
+        ShaderType type = value.type;
+        type.base = BaseType::Float;
+        return convert(value, type, line);
+    };
+    auto dot = [&](const Value& left, const Value& right) {
+        Value products = applyComponentwise(CpuShaderOpcode::Multiply, { toFloat(left), toFloat(right) }, BaseType::Float, line);
+        int sum = products.registers[0];
+        for (size_t i = 1; i < products.registers.size(); ++i)
+            sum = emit(CpuShaderOpcode::Add, sum, products.registers[i]);
+        return scalar(sum);
+    };
+
+    if (unary != UNARY_FLOAT_INTRINSICS.end())
+        *out_value = applyComponentwise(unary->second, { a }, BaseType::Float, line);
+    else if (binary != BINARY_FLOAT_INTRINSICS.end())
+        *out_value = applyComponentwise(binary->second, arguments, BaseType::Float, line);
+    else if (name == "abs")
+        *out_value = applyComponentwise(CpuShaderOpcode::Abs, { a }, a.type.base == BaseType::Bool ? BaseType::Int : a.type.base, line);
+    else if (name == "sign")
+        *out_value = convert(applyComponentwise(CpuShaderOpcode::Sign, { a }, BaseType::Float, line), [&]() { ShaderType type = a.type; type.base = BaseType::Int; return type; }(), line);
+    else if (name == "rcp")
+        *out_value = applyComponentwise(CpuShaderOpcode::Divide, { constant(1.0f), a }, BaseType::Float, line);
+    else if (name == "log10")
+        *out_value = applyComponentwise(CpuShaderOpcode::Multiply, { applyComponentwise(CpuShaderOpcode::Log, { a }, BaseType::Float, line), constant(0.4342944819f) }, BaseType::Float, line);
+    else if (name == "radians" || name == "degrees")
+        *out_value = applyComponentwise(CpuShaderOpcode::Multiply, { a, constant(name == "radians" ? 0.01745329252f : 57.29577951f) }, BaseType::Float, line);
+    else if (name == "min" || name == "max")
+        *out_value = applyComponentwise(name == "min" ? CpuShaderOpcode::Min : CpuShaderOpcode::Max, arguments, base, line);
+    else if (name == "step")
+        *out_value = toFloat(applyComponentwise(CpuShaderOpcode::LessEqual, arguments, BaseType::Float, line));
+    else if (name == "clamp")
+        *out_value = applyComponentwise(CpuShaderOpcode::Min, { applyComponentwise(CpuShaderOpcode::Max, { a, arguments[1] }, base, line), arguments[2] }, base, line);
+    else if (name == "lerp")
+    {
+        Value difference = applyComponentwise(CpuShaderOpcode::Subtract, { arguments[1], a }, BaseType::Float, line);
+        *out_value = applyComponentwise(CpuShaderOpcode::Add, { a, applyComponentwise(CpuShaderOpcode::Multiply, { difference, arguments[2] }, BaseType::Float, line) }, BaseType::Float, line);
+    }
+    else if (name == "smoothstep")
+    {
+        Value range = applyComponentwise(CpuShaderOpcode::Subtract, { arguments[1], a }, BaseType::Float, line);
+        Value t = applyComponentwise(CpuShaderOpcode::Saturate, { applyComponentwise(CpuShaderOpcode::Divide,
+            { applyComponentwise(CpuShaderOpcode::Subtract, { arguments[2], a }, BaseType::Float, line), range }, BaseType::Float, line) }, BaseType::Float, line);
+        Value slope = applyComponentwise(CpuShaderOpcode::Subtract, { constant(3.0f), applyComponentwise(CpuShaderOpcode::Multiply, { constant(2.0f), t }, BaseType::Float, line) }, BaseType::Float, line);
+        *out_value = applyComponentwise(CpuShaderOpcode::Multiply, { applyComponentwise(CpuShaderOpcode::Multiply, { t, t }, BaseType::Float, line), slope }, BaseType::Float, line);
+    }
+    else if (name == "mad")
+        *out_value = applyComponentwise(CpuShaderOpcode::Add, { applyComponentwise(CpuShaderOpcode::Multiply, { a, arguments[1] }, base, line), arguments[2] }, base, line);
+    else if (name == "dot")
+        *out_value = dot(a, arguments[1]);
+    else if (name == "length")
+        *out_value = applyComponentwise(CpuShaderOpcode::Sqrt, { dot(a, a) }, BaseType::Float, line);
+    else if (name == "distance")
+    {
+        Value difference = applyComponentwise(CpuShaderOpcode::Subtract, arguments, BaseType::Float, line);
+        *out_value = applyComponentwise(CpuShaderOpcode::Sqrt, { dot(difference, difference) }, BaseType::Float, line);
+    }
+    else if (name == "normalize")
+        *out_value = applyComponentwise(CpuShaderOpcode::Multiply, { a, applyComponentwise(CpuShaderOpcode::Rsqrt, { dot(a, a) }, BaseType::Float, line) }, BaseType::Float, line);
+    else if (name == "reflect")
+    {
+        Value twiceDot = applyComponentwise(CpuShaderOpcode::Multiply, { constant(2.0f), dot(arguments[1], a) }, BaseType::Float, line);
+        *out_value = applyComponentwise(CpuShaderOpcode::Subtract, { a, applyComponentwise(CpuShaderOpcode::Multiply, { twiceDot, arguments[1] }, BaseType::Float, line) }, BaseType::Float, line);
+    }
+    else if (name == "cross")
+    {
+        Value u = convert(a, MakeVectorType(BaseType::Float, 3), line);
+        Value v = convert(arguments[1], MakeVectorType(BaseType::Float, 3), line);
+        out_value->type = MakeVectorType(BaseType::Float, 3);
+        out_value->registers.clear();
+        for (int i = 0; i < 3; ++i)
+        {
+            int j = (i + 1) % 3, k = (i + 2) % 3;
+            out_value->registers.push_back(emit(CpuShaderOpcode::Subtract, emit(CpuShaderOpcode::Multiply, u.registers[j], v.registers[k]),
+                emit(CpuShaderOpcode::Multiply, u.registers[k], v.registers[j])));
+        }
+    }
+    else if (name == "any" || name == "all")
+    {
+        ShaderType boolType = a.type;
+        boolType.base = BaseType::Bool;
+        Value conditions = convert(a, boolType, line);
+        int result = conditions.registers[0];
+        for (size_t i = 1; i < conditions.registers.size(); ++i)
+            result = emit(name == "any" ? CpuShaderOpcode::Or : CpuShaderOpcode::And, result, conditions.registers[i]);
+        *out_value = scalar(result);
+        out_value->type.base = BaseType::Bool;
+    }
+    else
+    {
+        // mul multiplies a row vector by a matrix, a matrix by a column vector, or two matrices
+        const Value& b = arguments[1];
+        if (a.registers.size() == 1 || b.registers.size() == 1)
+        {
+            *out_value = applyComponentwise(CpuShaderOpcode::Multiply, arguments, base, line);
+            return true;
+        }
+
+        int aRows = a.type.isMatrix ? a.type.rows : 1;
+        int aColumns = a.type.columns;
+        int bRows = b.type.isMatrix ? b.type.rows : b.type.columns;
+        int bColumns = b.type.isMatrix ? b.type.columns : 1;
+        if (aColumns != bRows)
+        {
+            fail(line, "Invalid operands " + getTypeName(a.type) + " and " + getTypeName(b.type) + " of mul");
+            *out_value = makeZeroValue(MakeVectorType(BaseType::Float, 1));
+            return true;
+        }
+
+        Value left = toFloat(a);
+        Value right = toFloat(b);
+        out_value->registers.clear();
+        for (int row = 0; row < aRows; ++row)
+        {
+            for (int column = 0; column < bColumns; ++column)
+            {
+                int sum = emit(CpuShaderOpcode::Multiply, left.registers[row * aColumns], right.registers[column]);
+                for (int k = 1; k < aColumns; ++k)
+                    sum = emit(CpuShaderOpcode::Add, sum, emit(CpuShaderOpcode::Multiply, left.registers[row * aColumns + k], right.registers[k * bColumns + column]));
+                out_value->registers.push_back(sum);
+            }
+        }
+
+        if (a.type.isMatrix && b.type.isMatrix)
+        {
+            out_value->type = MakeVectorType(BaseType::Float, bColumns);
+            out_value->type.rows = aRows;
+            out_value->type.isMatrix = true;
+        }
+        else
+        {
+            out_value->type = MakeVectorType(BaseType::Float, static_cast<int>(out_value->registers.size()));
+        }
+    }
+
+    return true;
+}
+
+// the methods of the texture : Sample and its variants on the single level of the texture, Load and GetDimensions
+ShaderCodeGenerator::Value ShaderCodeGenerator::evaluateMethodCall(const Expression& expression)
+{
+    Value object = evaluate(*expression.operands[0]);
+    const string& name = expression.text;
+    size_t argumentCount = expression.operands.size() - 1;
+
+    Value result;
+    result.type = MakeVectorType(BaseType::Float, 4);
+
+    if (object.type.base != BaseType::Texture)
+    {
+        fail(expression.line, "Methods are only supported on textures");
+        return makeZeroValue(result.type);
+    }
+
+    auto checkArgumentCount = [&](size_t minCount, size_t maxCount) {
+        if (argumentCount >= minCount && argumentCount <= maxCount)
+            return true;
+        fail(expression.line, "Wrong number of arguments for " + name);
+        return false;
+    };
+
+    if (name == "Sample" || name == "SampleLevel" || name == "SampleBias" || name == "SampleGrad")
+    {
+        if (!checkArgumentCount(name == "Sample" ? 2 : name == "SampleGrad" ? 4 : 3, name == "SampleGrad" ? 4 : 3))
+            return makeZeroValue(result.type);
+        if (name == "Sample" && argumentCount == 3)
+        {
+            fail(expression.line, "Sample offsets are not supported");
+            return makeZeroValue(result.type);
+        }
+
+        if (evaluate(*expression.operands[1]).type.base != BaseType::Sampler)
+        {
+            fail(expression.line, "The first argument of " + name + " must be a sampler");
+            return makeZeroValue(result.type);
+        }
+
+        Value coordinates = convert(evaluate(*expression.operands[2]), MakeVectorType(BaseType::Float, 2), expression.line);
+        for (size_t i = 3; i <= argumentCount; ++i)
+            evaluate(*expression.operands[i]);
+
+        int firstRegister = newRegisters(4);
+        emitTo(CpuShaderOpcode::Sample, firstRegister, coordinates.registers[0], coordinates.registers[1]);
+        for (int i = 0; i < 4; ++i)
+            result.registers.push_back(firstRegister + i);
+        return result;
+    }
+
+    if (name == "Load")
+    {
+        if (!checkArgumentCount(1, 1))
+            return makeZeroValue(result.type);
+
+        Value location = evaluate(*expression.operands[1]);
+        if (!IsNumeric(location.type) || location.registers.size() < 2)
+        {
+            fail(expression.line, "Load takes int3 coordinates");
+            return makeZeroValue(result.type);
+        }
+        ShaderType locationType = location.type;
+        locationType.base = BaseType::Int;
+        location = convert(location, locationType, expression.line);
+
+        int firstRegister = newRegisters(4);
+        emitTo(CpuShaderOpcode::Load, firstRegister, location.registers[0], location.registers[1]);
+        for (int i = 0; i < 4; ++i)
+            result.registers.push_back(firstRegister + i);
+        return result;
+    }
+
+    if (name == "GetDimensions")
+    {
+        // GetDimensions(width, height) or GetDimensions(mipLevel, width, height, levelCount), the texture has a single level
+        if (argumentCount != 2 && argumentCount != 4)
+        {
+            fail(expression.line, "Wrong number of arguments for GetDimensions");
+            return makeZeroValue(result.type);
+        }
+
+        size_t first = argumentCount == 4 ? 2 : 1;
+        if (argumentCount == 4)
+            evaluate(*expression.operands[1]);
+
+        int sizes[] = { m_program->textureWidthRegister, m_program->textureHeightRegister, getConstantRegister(1.0f) };
+        for (size_t i = 0; i + first <= argumentCount; ++i)
+        {
+            LValue target;
+            if (!evaluateLValue(*expression.operands[first + i], &target))
+                return makeZeroValue(result.type);
+
+            Value size;
+            size.type = MakeVectorType(BaseType::Uint, 1);
+            size.registers.push_back(sizes[i]);
+            store(target, size, expression.line);
+        }
+
+        result.type.base = BaseType::Void;
+        result.registers.clear();
+        return result;
+    }
+
+    fail(expression.line, "Unsupported texture method " + name);
+    return makeZeroValue(result.type);
+}
+
+// the parameters of a call are copies of the arguments, those of the entry point are bound to its input registers
+ShaderCodeGenerator::Value ShaderCodeGenerator::inlineFunction(const FunctionDefinition& function, const vector<Value>& arguments, bool isEntryPoint, vector<Value>* out_parameters)
+{
+    FunctionFrame frame;
+    frame.function = &function;
+    frame.entryMask = m_currentMask;
+    frame.firstScope = m_scopes.size();
+    frame.returnValue.type = function.returnType;
+
+    int returnCount = getComponentCount(function.returnType);
+    int firstReturnRegister = newRegisters(returnCount);
+    for (int i = 0; i < returnCount; ++i)
+        frame.returnValue.registers.push_back(firstReturnRegister + i);
+
+    // the lanes that returned are only tracked when a return may leave others running
+    bool hasNestedReturn = false;
+    for (const std::unique_ptr<Statement>& statement : function.body->statements)
+    {
+        hasNestedReturn = hasNestedReturn || (statement->kind != StatementKind::Return
+            && FindStatement(*statement, true, [](const Statement& child) { return child.kind == StatementKind::Return; }));
+    }
+
+    if (hasNestedReturn)
+    {
+        frame.returnedMask = newRegisters(1);
+        emitTo(CpuShaderOpcode::Move, frame.returnedMask, m_zeroRegister);
+    }
+
+    m_frames.push_back(frame);
+    pushScope();
+
+    for (size_t i = 0; i < function.parameters.size(); ++i)
+    {
+        const FunctionParameter& parameter = function.parameters[i];
+        Value value = arguments[i];
+
+        if (isEntryPoint || !parameter.isIn)
+        {
+            Symbol symbol;
+            symbol.name = parameter.name;
+            symbol.value = value;
+            symbol.declarationMask = m_currentMask;
+            declareSymbol(symbol, function.line);
+        }
+        else
+        {
+            value = declareVariable(parameter.name, parameter.type, &value, false, function.line);
+        }
+
+        out_parameters->push_back(value);
+    }
+
+    compileStatement(*function.body);
+
+    popScope();
+    Value result = m_frames.back().returnValue;
+    m_currentMask = m_frames.back().entryMask;
+    m_frames.pop_back();
+    return result;
+}
+
+// a struct has a varying per member, each with its own semantic
+void ShaderCodeGenerator::addVaryings(const ShaderType& type, const string& semantic, int firstRegister, int line, vector<CpuShaderVarying>* out_varyings)
+{
+    if (type.base == BaseType::Struct && !type.arrayLength)
+    {
+        int offset = 0;
+        for (const StructMember& member : m_module.structs[type.structIndex].members)
+        {
+            addVaryings(member.type, member.semantic, firstRegister + offset, line, out_varyings);
+            offset += getComponentCount(member.type);
+        }
+        return;
+    }
+
+    if (!IsNumeric(type) || type.arrayLength || type.isMatrix)
+    {
+        fail(line, "Inputs and outputs of main must be scalars, vectors or structs of them");
+        return;
+    }
+    if (semantic.empty())
+    {
+        fail(line, "Missing semantic of an input or output of main");
+        return;
+    }
+
+    CpuShaderVarying varying;
+    varying.semantic = semantic;
+    varying.firstRegister = firstRegister;
+    varying.componentCount = getComponentCount(type);
+    out_varyings->push_back(varying);
+}
+
+bool ShaderCodeGenerator::compile(string* out_error)
+{
+    m_program->laneMaskRegister = newRegisters(1);
+    m_program->textureWidthRegister = newRegisters(1);
+    m_program->textureHeightRegister = newRegisters(1);
+    m_zeroRegister = getConstantRegister(0.0f);
+    m_currentMask = m_program->laneMaskRegister;
+
+    const FunctionDefinition* main = nullptr;
+    for (const FunctionDefinition& function : m_module.functions)
+    {
+        if (function.name == "main")
+            main = &function;
+    }
+
+    if (!main)
+        fail(1, "Missing main function");
+    if (m_module.textures.size() > 1)
+        fail(1, "Shaders can only sample the image of the effect, a single Texture2D");
+
+    // the globals are the texture, the samplers and the static variables, initialized before main
+    pushScope();
+    for (const string& texture : m_module.textures)
+    {
+        Symbol symbol;
+        symbol.name = texture;
+        symbol.value.type.base = BaseType::Texture;
+        symbol.isReadOnly = true;
+        declareSymbol(symbol, 1);
+    }
+    for (const string& sampler : m_module.samplers)
+    {
+        Symbol symbol;
+        symbol.name = sampler;
+        symbol.value.type.base = BaseType::Sampler;
+        symbol.isReadOnly = true;
+        declareSymbol(symbol, 1);
+    }
+    for (const std::unique_ptr<Statement>& global : m_module.globals)
+        compileStatement(*global);
+
+    if (main && m_error.empty())
+    {
+        vector<Value> arguments;
+        for (const FunctionParameter& parameter : main->parameters)
+        {
+            Value value;
+            value.type = parameter.type;
+            int count = getComponentCount(parameter.type);
+            int firstRegister = newRegisters(count);
+            for (int i = 0; i < count; ++i)
+                value.registers.push_back(firstRegister + i);
+
+            if (parameter.isIn)
+                addVaryings(parameter.type, parameter.semantic, firstRegister, main->line, &m_program->inputs);
+            arguments.push_back(value);
+        }
+
+        vector<Value> parameters;
+        m_callStack.push_back(main);
+        Value result = inlineFunction(*main, arguments, true, &parameters);
+        m_callStack.pop_back();
+
+        if (main->returnType.base != BaseType::Void)
+            addVaryings(main->returnType, main->returnSemantic, result.registers.empty() ? 0 : result.registers[0], main->line, &m_program->outputs);
+
+        for (size_t i = 0; i < main->parameters.size(); ++i)
+        {
+            if (main->parameters[i].isOut)
+                addVaryings(main->parameters[i].type, main->parameters[i].semantic, parameters[i].registers.empty() ? 0 : parameters[i].registers[0], main->line, &m_program->outputs);
+        }
+    }
+
+    popScope();
+
+    if (!m_error.empty())
+    {
+        *out_error = m_error;
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<const CpuShaderProgram> CompileCpuShader(const string& filePath, CpuShaderStage stage, const vector<ShaderMacro>& macros, string* out_error)
+{
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file)
+    {
+        *out_error = "Failed to open shader file " + filePath;
+        return nullptr;
+    }
+
+    std::stringstream source;
+    source << file.rdbuf();
+
+    vector<Token> tokens;
+    ShaderPreprocessor preprocessor(filePath);
+    ShaderModule module;
+    ShaderParser parser(tokens, filePath, &module);
+    std::shared_ptr<CpuShaderProgram> program = std::make_shared<CpuShaderProgram>();
+    program->stage = stage;
+    ShaderCodeGenerator generator(module, filePath, program.get());
+
+    if (!preprocessor.preprocess(source.str(), macros, &tokens, out_error) || !parser.parseModule(out_error) || !generator.compile(out_error))
+        return nullptr;
+
+    return program;
+}
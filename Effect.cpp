@@ -1,6 +1,141 @@
 #include "Effect.h"
+#include "BufferPool.h"
+#include "EffectCache.h"
+#include "Profiler.h"
+#include "RemapTable.h"
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <vector>
 
-bool BaseEffect::ApplyEffectFromRawImageData(unsigned char* imageData, int width, int height, int channels, ShaderManager* shaderManagerRef, string* out_error)
+// formats a parameter value, floats with the given number of significant digits
+static string FormatParameterValue(const EffectParameter& parameter, float value, int precision)
+{
+    std::ostringstream stream;
+    if (parameter.type == EffectParameterType::Float)
+        stream << std::setprecision(precision) << value;
+    else
+        stream << static_cast<int>(value);
+    return stream.str();
+}
+
+string BaseEffect::GetEffectKey() const
+{
+    vector<EffectParameter> parameters = GetParameters();
+
+    string key = GetEffectFileSuffix() + "(";
+    for (size_t i = 0; i < parameters.size(); ++i)
+        key += (i ? "," : "") + FormatParameterValue(parameters[i], GetParameterValue(static_cast<int>(i)), 9);
+    return key + ")";
+}
+
+bool BaseEffect::SetParameter(const string& name, float value, string* out_error)
+{
+    vector<EffectParameter> parameters = GetParameters();
+
+    for (size_t i = 0; i < parameters.size(); ++i)
+    {
+        const EffectParameter& parameter = parameters[i];
+        if (name != parameter.name)
+            continue;
+
+        bool isValidType = parameter.type == EffectParameterType::Float ||
+            (parameter.type == EffectParameterType::Integer && value == std::floor(value)) ||
+            (parameter.type == EffectParameterType::Boolean && (value == 0.0f || value == 1.0f));
+
+        if (!isValidType || !(value >= parameter.minValue && value <= parameter.maxValue))
+        {
+            *out_error = GetEffectFileSuffix() + " parameter " + name + " must be " + (parameter.type == EffectParameterType::Boolean ? "0 or 1" :
+                (parameter.type == EffectParameterType::Integer ? "an integer" : "a number") + string(" between ") + FormatParameterValue(parameter, parameter.minValue, 6)
+                + " and " + FormatParameterValue(parameter, parameter.maxValue, 6));
+            return false;
+        }
+
+        StoreParameterValue(static_cast<int>(i), value);
+        return true;
+    }
+
+    *out_error = "Unknown parameter " + name + " of effect " + GetEffectFileSuffix();
+    return false;
+}
+
+string BaseEffect::GetParameterSuffix() const
+{
+    vector<EffectParameter> parameters = GetParameters();
+
+    string suffix;
+    for (size_t i = 0; i < parameters.size(); ++i)
+    {
+        float value = GetParameterValue(static_cast<int>(i));
+        if (value != parameters[i].defaultValue)
+            suffix += string("-") + parameters[i].name + FormatParameterValue(parameters[i], value, 6);
+    }
+    return suffix;
+}
+
+// camelCase parameter names become UPPER_SNAKE_CASE macros
+vector<ShaderMacro> BaseEffect::GetShaderMacroDefinitions(int pass) const
+{
+    vector<EffectParameter> parameters = GetParameters();
+    vector<ShaderMacro> macros;
+
+    for (size_t i = 0; i < parameters.size(); ++i)
+    {
+        string macroName;
+        for (const char* c = parameters[i].name; *c; ++c)
+        {
+            if (std::isupper(static_cast<unsigned char>(*c)))
+                macroName += '_';
+            macroName += static_cast<char>(std::toupper(static_cast<unsigned char>(*c)));
+        }
+
+        macros.push_back({ macroName, FormatParameterValue(parameters[i], GetParameterValue(static_cast<int>(i)), 9) });
+    }
+
+    if (GetShaderPassCount() > 1)
+        macros.push_back({ "SHADER_PASS", std::to_string(pass) });
+
+    return macros;
+}
+
+// shaders that draw a smaller output centered in the image have its rows moved to the top left region of the image
+static void MoveCenteredOutput(const ImageView& image, int outputWidth, int outputHeight)
+{
+    int width = image.getWidth();
+    int height = image.getHeight();
+    if (outputWidth == width && outputHeight == height)
+        return;
+
+    ImageView output = image.getRegion((width - outputWidth) / 2, (height - outputHeight) / 2, outputWidth, outputHeight);
+
+    for (int y = 0; y < outputHeight; ++y)
+        std::memmove(image.getRow(y), output.getRow(y), output.getRowSize());
+}
+
+#ifdef _WIN32
+// the strings are kept in out_macroStrings while the macros point to them, and the list ends with the null macro D3DCompile expects
+vector<D3D_SHADER_MACRO> BaseEffect::GetShaderMacros(int pass, vector<string>* out_macroStrings) const
+{
+    out_macroStrings->clear();
+    for (const ShaderMacro& macro : GetShaderMacroDefinitions(pass))
+    {
+        out_macroStrings->push_back(macro.name);
+        out_macroStrings->push_back(macro.value);
+    }
+
+    vector<D3D_SHADER_MACRO> macros;
+    for (size_t i = 0; i < out_macroStrings->size(); i += 2)
+        macros.push_back({ (*out_macroStrings)[i].c_str(), (*out_macroStrings)[i + 1].c_str() });
+    macros.push_back({ nullptr, nullptr });
+
+    return macros;
+}
+
+bool BaseEffect::ApplyEffectOnImage(const ImageView& image, ShaderManager* shaderManagerRef, string* out_error) const
 {
     if (!shaderManagerRef) 
     {
@@ -9,27 +144,173 @@ bool BaseEffect::ApplyEffectFromRawImageData(unsigned char* imageData, int width
         return false;
     }
         
+    if (!HasGpuShaders())
+    {
+        *out_error = GetEffectDisplayName() + " only runs on the CPU backend";
+        std::cout << GetEffectDisplayName() << " only runs on the CPU backend";
+        return false;
+    }
 
-    // initialize shader if not initialized (lazy loading)
-    if (!m_areShadersInitialized)
+    PROFILE_SCOPE("effect.gpu");
+
+    // the shaders of each pass are compiled by the shader manager the first time it applies the effect with these parameters,
+    // the parameters are compiled in as macros
+    for (int pass = 0; pass < GetShaderPassCount(); ++pass)
     {
-        LPCWSTR pixelShaderFile = GetPixelShaderFileName();
-        LPCWSTR vertexShaderFile = GetVertexShaderFileName();
-        if (!shaderManagerRef->createShadersFromFiles(pixelShaderFile, vertexShaderFile, &m_vertexShader, &m_pixelShader, out_error))
+        ID3D11VertexShader* vertexShader = nullptr;
+        ID3D11PixelShader* pixelShader = nullptr;
+        vector<string> macroStrings;
+        vector<D3D_SHADER_MACRO> shaderMacros = GetShaderMacros(pass, &macroStrings);
+        if (!shaderManagerRef->getEffectShaders(GetPixelShaderFileName(), GetVertexShaderFileName(), shaderMacros.data(), &vertexShader, &pixelShader, out_error))
+            return false;
+
+        // check shaders valid
+        if (!vertexShader || !pixelShader)
+        {
+            *out_error = "Effect's shaders are invalid";
+            std::cout << "Effect's shaders are invalid";
+            return false;
+        }
+
+        // apply the shader effect on the image using the ShaderManager's GPU API
+        if (!shaderManagerRef->applyShaderOnImage(image, pixelShader, vertexShader, out_error))
             return false;
     }
 
-    // check shaders valid
-    if (!m_vertexShader || !m_pixelShader)
+    int outputWidth, outputHeight;
+    GetOutputDimensions(image.getWidth(), image.getHeight(), &outputWidth, &outputHeight);
+    MoveCenteredOutput(image, outputWidth, outputHeight);
+    return true;
+}
+#endif
+
+// the shaders are compiled for the CPU the first time an effect with these parameters runs them, and kept in the effect cache
+bool BaseEffect::ApplyShadersOnCpu(const ImageView& image, CpuEffectManager* cpuManagerRef, string* out_error) const
+{
+    string vertexShaderFile = std::filesystem::path(GetVertexShaderFileName()).string();
+    string pixelShaderFile = std::filesystem::path(GetPixelShaderFileName()).string();
+
+    for (int pass = 0; pass < GetShaderPassCount(); ++pass)
     {
-        *out_error = "Effect's shaders are invalid";
-        std::cout << "Effect's shaders are invalid";
+        vector<ShaderMacro> shaderMacros = GetShaderMacroDefinitions(pass);
+
+        std::shared_ptr<const CpuShaderProgram> vertexShader = GetCpuShaderProgram(vertexShaderFile, CpuShaderStage::Vertex, shaderMacros, out_error);
+        if (!vertexShader)
+            return false;
+
+        std::shared_ptr<const CpuShaderProgram> pixelShader = GetCpuShaderProgram(pixelShaderFile, CpuShaderStage::Pixel, shaderMacros, out_error);
+        if (!pixelShader)
+            return false;
+
+        if (!ApplyCpuShaders(image, *vertexShader, *pixelShader, cpuManagerRef, out_error))
+            return false;
+    }
+
+    int outputWidth, outputHeight;
+    GetOutputDimensions(image.getWidth(), image.getHeight(), &outputWidth, &outputHeight);
+    MoveCenteredOutput(image, outputWidth, outputHeight);
+    return true;
+}
+
+// applies the effect on the image using the CPU backend
+bool BaseEffect::ApplyEffectOnImage(const ImageView& image, CpuEffectManager* cpuManagerRef, string* out_error) const
+{
+    if (!cpuManagerRef || !cpuManagerRef->isInitialized())
+    {
+        *out_error = "CpuEffectManager reference is null or not initialized";
+        std::cout << "CpuEffectManager reference is null or not initialized";
         return false;
     }
 
-    // apply the shader effect on imageData using the ShaderManager's GPU API
-    if (!shaderManagerRef->applyShaderOnImageData(imageData, width, height, channels, m_pixelShader, m_vertexShader, out_error))
+    if (image.isEmpty() || image.getChannels() < 1 || image.getChannels() > 4)
+    {
+        *out_error = "Invalid image data";
+        std::cout << "Invalid image data";
         return false;
+    }
 
+    PROFILE_SCOPE("effect.cpu");
+
+    // effects without a CPU kernel, and all the effects with shaders when the manager emulates them, run their shaders
+    if (!HasCpuKernel() || (cpuManagerRef->isShaderEmulationEnabled() && HasGpuShaders()))
+        return ApplyShadersOnCpu(image, cpuManagerRef, out_error);
+
+    ApplyCpuEffect(image, cpuManagerRef);
     return true;
 }
+
+// runs the effect's CPU kernel on the image, split into bands of rows processed in parallel by the CpuEffectManager.
+// kernels that sample neighbouring pixels read from a copy of the source image, stencil kernels run on tiles of it
+void BaseEffect::ApplyCpuEffect(const ImageView& image, CpuEffectManager* cpuManagerRef) const
+{
+    int haloSize = GetCpuKernelHaloSize();
+    if (haloSize > 0)
+    {
+        cpuManagerRef->parallelForTiles(image, haloSize, [&](const ImageTile& tile) {
+            ApplyCpuKernel(tile.source, tile.target, tile.innerY, tile.innerY + tile.innerHeight);
+        });
+        return;
+    }
+
+    ImageView source = image;
+    Image sourceCopy;
+
+    if (!IsCpuKernelInPlace())
+    {
+        sourceCopy = Image(image.getWidth(), image.getHeight(), image.getChannels());
+        image.copyTo(sourceCopy.getView());
+        source = sourceCopy.getView();
+    }
+
+    cpuManagerRef->parallelForRows(image.getHeight(), [&](int rowBegin, int rowEnd) {
+        ApplyCpuKernel(source, image, rowBegin, rowEnd);
+    });
+}
+
+void BaseEffect::BuildChannelTables(int channels, ChannelTables* out_tables) const
+{
+    InitializeIdentityTables(out_tables);
+
+    unsigned char colorTable[256];
+    for (int v = 0; v < 256; ++v)
+        colorTable[v] = MapColorValue(static_cast<unsigned char>(v));
+
+    for (int c = 0; c < GetColorChannelCount(channels); ++c)
+        std::copy(colorTable, colorTable + 256, out_tables->begin() + c * 256);
+}
+
+// the tables are built once per channel count and kept in the effect cache, then looked up in place on bands of rows
+void PointEffect::ApplyCpuEffect(const ImageView& image, CpuEffectManager* cpuManagerRef) const
+{
+    int channels = image.getChannels();
+    string key = GetEffectKey() + "#" + std::to_string(channels);
+
+    std::shared_ptr<const ChannelTables> tables = EffectCache::getInstance().getEntry<ChannelTables>(EffectCacheKind::ChannelTables, key, [&]() {
+        std::shared_ptr<ChannelTables> builtTables = std::make_shared<ChannelTables>();
+        BuildChannelTables(channels, builtTables.get());
+        return std::shared_ptr<const ChannelTables>(builtTables);
+    });
+
+    cpuManagerRef->parallelForRows(image.getHeight(), [&](int rowBegin, int rowEnd) {
+        ApplyChannelTablesKernel(image, image, *tables, rowBegin, rowEnd);
+    });
+}
+
+// the table is taken from the effect cache, and the source is copied into packed rows with room for the 4-byte gathers of the remap kernel
+void CoordinateEffect::ApplyCpuEffect(const ImageView& image, CpuEffectManager* cpuManagerRef) const
+{
+    int width = image.getWidth();
+    int height = image.getHeight();
+
+    std::shared_ptr<const RemapTable> table = GetRemapTable(GetEffectKey(), width, height,
+        [&](float x, float y, float* out_x, float* out_y) { MapSourcePosition(x, y, width, height, out_x, out_y); }, cpuManagerRef);
+
+    size_t imageSize = image.getRowSize() * height;
+    PooledBuffer sourceCopy = AcquirePooledBuffer(imageSize + 4);
+    image.copyTo(ImageView(sourceCopy.get(), width, height, image.getChannels()));
+    std::memset(sourceCopy.get() + imageSize, 0, 4);
+
+    cpuManagerRef->parallelForRows(height, [&](int rowBegin, int rowEnd) {
+        ApplyRemapTableKernel(sourceCopy.get(), image, *table, rowBegin, rowEnd);
+    });
+}
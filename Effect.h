@@ -1,16 +1,54 @@
 #pragma once
+#ifdef _WIN32
 #include "ShaderManager.h"
+#endif
+#include "CpuEffectManager.h"
+#include "CpuKernels.h"
+#include "CpuShader.h"
+#include "Image.h"
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
+#include <vector>
 
 using std::string;  // Make string available as 'string'
+using std::vector;  // Make vector available as 'vector'
 
+// how the pixels written by an effect depend on its source image, effect chains fuse the first two kinds
+enum class EffectKind {
+    Point,          // each pixel is a function of the same source pixel, equal for all pixels
+    Coordinate,     // each pixel samples the source at a position that depends only on its own position
+    Neighbourhood   // each pixel depends on several source pixels
+};
+
+// how the value of an effect parameter is read, all values are stored as floats
+enum class EffectParameterType {
+    Float,
+    Integer,    // whole numbers only
+    Boolean     // 0 or 1
+};
+
+// an effect parameter : its name on the command line, in upper snake case the shader macro it is compiled into,
+// and its type, valid range and default value
+struct EffectParameter {
+    const char* name;
+    EffectParameterType type;
+    float minValue;
+    float maxValue;
+    float defaultValue;
+};
+
+// an effect only holds its parameters : the GPU shaders it is compiled into belong to the ShaderManager it is applied with,
+// and the CPU backend keeps its state in the CpuEffectManager. applying an effect does not change it, so once its parameters
+// are set an effect can be applied from several threads at once
 class BaseEffect {
 public:
+    BaseEffect() {}
+
     virtual ~BaseEffect() {}
 
-    bool m_areShadersInitialized = false;
-    ID3D11VertexShader* m_vertexShader;
-    ID3D11PixelShader* m_pixelShader;
+    // Returns a new effect of the same type with the same parameters
+    virtual BaseEffect* CloneEffect() const = 0;
 
     // Returns the display name of the effect
     virtual string GetEffectDisplayName() const = 0;
@@ -18,27 +56,189 @@ public:
     // Returns the file suffix for the effect
     virtual string GetEffectFileSuffix() const = 0;
 
-    // applies this effect on image data buffer
-    bool ApplyEffectFromRawImageData(unsigned char* imageData, int width, int height, int channels, ShaderManager* shaderManagerRef, string* out_error);
+    // Returns how the effect's pixels depend on the source image
+    virtual EffectKind GetEffectKind() const
+    {
+        return EffectKind::Neighbourhood;
+    }
+
+    // For point effects, returns the new value of a color channel value. alpha passes through
+    virtual unsigned char MapColorValue(unsigned char value) const
+    {
+        return value;
+    }
+
+    // Returns true if the effect has shaders to run on the GPU, other effects only run on the CPU
+    virtual bool HasGpuShaders() const
+    {
+        return true;
+    }
+
+    // Returns the size of the image the effect produces from an image of the given size, written in the top left region of the image.
+    // effects that change the size are neighbourhood effects
+    virtual void GetOutputDimensions(int width, int height, int* out_width, int* out_height) const
+    {
+        *out_width = width;
+        *out_height = height;
+    }
+
+    // For point effects, builds the table of every channel of an image with the given channel count.
+    // by default the color channels map through MapColorValue and alpha passes through
+    virtual void BuildChannelTables(int channels, ChannelTables* out_tables) const;
+
+    // For coordinate effects, returns the texel space position of the source sampled for a target position
+    virtual void MapSourcePosition(float x, float y, int width, int height, float* out_x, float* out_y) const
+    {
+        *out_x = x;
+        *out_y = y;
+    }
+
+    // Returns a key equal only for effects of the same type with the same parameters, which the effect cache keeps what the
+    // backends prepare for the effect on : the file suffix and the values of all the parameters
+    string GetEffectKey() const;
+
+    // Returns the schema of the effect's parameters, empty for effects without any
+    virtual vector<EffectParameter> GetParameters() const
+    {
+        return {};
+    }
+
+    // Returns the value of the parameter at the given index of the schema
+    virtual float GetParameterValue(int index) const
+    {
+        return 0.0f;
+    }
+
+    // Sets a parameter by name after checking its type and range. the GPU shaders of the new value are compiled on the next use.
+    // an invalid parameter is only reported through out_error, the caller prints it
+    bool SetParameter(const string& name, float value, string* out_error);
+
+    // Returns the parameters that differ from their defaults as "-name<value>" appended to each other, to tell output files apart
+    string GetParameterSuffix() const;
+
+#ifdef _WIN32
+    // applies this effect on the pixels of an image view using the GPU
+    bool ApplyEffectOnImage(const ImageView& image, ShaderManager* shaderManagerRef, string* out_error) const;
+#endif
+
+    // applies this effect on the pixels of an image view using the CPU
+    bool ApplyEffectOnImage(const ImageView& image, CpuEffectManager* cpuManagerRef, string* out_error) const;
 
 protected:
 
+    // Stores a parameter value already checked against the schema
+    virtual void StoreParameterValue(int index, float value)
+    {
+    }
+
+    // Returns the macros the shaders of a pass are compiled with, one per parameter, so their values are constants of the compiled shaders.
+    // effects drawn in several passes also get SHADER_PASS, the index of the pass
+    vector<ShaderMacro> GetShaderMacroDefinitions(int pass) const;
+
+#ifdef _WIN32
+    // Builds the macros of GetShaderMacroDefinitions for D3DCompile
+    vector<D3D_SHADER_MACRO> GetShaderMacros(int pass, vector<string>* out_macroStrings) const;
+#endif
+
+    // Returns the number of draws of the effect's shaders, each pass drawing over the output of the previous one
+    virtual int GetShaderPassCount() const
+    {
+        return 1;
+    }
+
     // Returns the file of the effect's pixelshader
-    virtual LPCWSTR GetPixelShaderFileName()
+    virtual const wchar_t* GetPixelShaderFileName() const
     {
         return L"shaders/DefaultPixelShader.hlsl";
     }
 
-    // Returns the file of the effect's pixelshader
-    virtual LPCWSTR GetVertexShaderFileName()
+    // Returns the file of the effect's vertexshader
+    virtual const wchar_t* GetVertexShaderFileName() const
     {
         return L"shaders/DefaultVertexShader.hlsl";
     }
+
+    // Returns true if the effect has a CPU kernel, other effects run their shaders on the CPU shader engine
+    virtual bool HasCpuKernel() const
+    {
+        return true;
+    }
+
+    // Runs the effect's shaders on the image with the CPU shader engine, as the GPU backend would draw them
+    bool ApplyShadersOnCpu(const ImageView& image, CpuEffectManager* cpuManagerRef, string* out_error) const;
+
+    // Applies the effect on the CPU, by default runs ApplyCpuKernel on bands of rows in parallel.
+    // effects made of several dependent passes override this instead of ApplyCpuKernel
+    virtual void ApplyCpuEffect(const ImageView& image, CpuEffectManager* cpuManagerRef) const;
+
+    // Returns true if the CPU kernel only reads the pixels it writes, so it can run without a copy of the source
+    virtual bool IsCpuKernelInPlace() const
+    {
+        return false;
+    }
+
+    // Returns how many pixels away from the pixel it writes the CPU kernel reads, for stencil kernels that then run on
+    // cache-sized tiles with a halo of that size. 0 runs the kernel on bands of whole rows
+    virtual int GetCpuKernelHaloSize() const
+    {
+        return 0;
+    }
+
+    // Applies the effect's CPU kernel on the rows [rowBegin, rowEnd) of target, sampling source
+    virtual void ApplyCpuKernel(const ImageView& source, const ImageView& target, int rowBegin, int rowEnd) const
+    {
+    }
+};
+
+/**
+ * Base of the effects that map every 8-bit channel value on its own, like inversion, contrast, gamma, levels and thresholds.
+ * On the CPU their mapping is built into per-channel 256 entry tables, looked up by a single vectorized kernel,
+ * and effect chains compose consecutive point effects into one set of tables.
+ */
+class PointEffect : public BaseEffect {
+public:
+
+    EffectKind GetEffectKind() const override
+    {
+        return EffectKind::Point;
+    }
+
+protected:
+    void ApplyCpuEffect(const ImageView& image, CpuEffectManager* cpuManagerRef) const override;
+};
+
+/**
+ * Base of the effects that only move pixels around, sampling the source at the position given by MapSourcePosition.
+ * On the CPU the mapping is built into a remap table of fixed-point bilinear samples, cached per image size
+ * by the CPU effect manager, so a new warp only has to implement MapSourcePosition.
+ */
+class CoordinateEffect : public BaseEffect {
+public:
+
+    EffectKind GetEffectKind() const override
+    {
+        return EffectKind::Coordinate;
+    }
+
+protected:
+    void ApplyCpuEffect(const ImageView& image, CpuEffectManager* cpuManagerRef) const override;
 };
 
+// default blur radius, the standard deviation in pixels of the gaussian
+#define DEFAULT_BLUR_RADIUS 8.0f
+
 class BlurEffect : public BaseEffect {
 public:
 
+    // radius is the standard deviation in pixels of the gaussian, which the CPU approximates with box blurs
+    // and the GPU samples in a pass over the rows and one over the columns
+    explicit BlurEffect(float radius = DEFAULT_BLUR_RADIUS) : m_radius(radius) {}
+
+    BaseEffect* CloneEffect() const override
+    {
+        return new BlurEffect(*this);
+    }
+
     string GetEffectDisplayName() const override
     {
         return "Blur";
@@ -49,16 +249,50 @@ public:
         return "blur";
     }
 
+    vector<EffectParameter> GetParameters() const override
+    {
+        return { { "radius", EffectParameterType::Float, 0.5f, 100.0f, DEFAULT_BLUR_RADIUS } };
+    }
+
+    float GetParameterValue(int index) const override
+    {
+        return m_radius;
+    }
+
 protected:
-    LPCWSTR GetPixelShaderFileName() override
+    const wchar_t* GetPixelShaderFileName() const override
     {
         return L"shaders/BlurPixelShader.hlsl";
     }
+
+    // the gaussian is separable : the first pass blurs the rows, the second the columns
+    int GetShaderPassCount() const override
+    {
+        return 2;
+    }
+
+    void StoreParameterValue(int index, float value) override
+    {
+        m_radius = value;
+    }
+
+    void ApplyCpuEffect(const ImageView& image, CpuEffectManager* cpuManagerRef) const override
+    {
+        ApplyGaussianBlur(image, m_radius, cpuManagerRef);
+    }
+
+private:
+    float m_radius;
 };
 
-class ColorInversionEffect : public BaseEffect {
+class ColorInversionEffect : public PointEffect {
 public:
 
+    BaseEffect* CloneEffect() const override
+    {
+        return new ColorInversionEffect(*this);
+    }
+
     string GetEffectDisplayName() const override
     {
         return "Color Inversion";
@@ -69,8 +303,14 @@ public:
         return "inverted";
     }
 
+    // 1 - x on the color channels
+    unsigned char MapColorValue(unsigned char value) const override
+    {
+        return 255 - value;
+    }
+
 protected:
-    LPCWSTR GetPixelShaderFileName() override
+    const wchar_t* GetPixelShaderFileName() const override
     {
         return L"shaders/ColorInversionPixelShader.hlsl";
     }
@@ -79,6 +319,11 @@ protected:
 class MirrorEffect : public BaseEffect {
 public:
 
+    BaseEffect* CloneEffect() const override
+    {
+        return new MirrorEffect(*this);
+    }
+
     string GetEffectDisplayName() const override
     {
         return "Mirror";
@@ -89,36 +334,118 @@ public:
         return "mirror";
     }
 
+    EffectKind GetEffectKind() const override
+    {
+        return EffectKind::Coordinate;
+    }
+
+    void MapSourcePosition(float x, float y, int width, int height, float* out_x, float* out_y) const override
+    {
+        MapMirrorSourcePosition(x, y, width, height, out_x, out_y);
+    }
+
 protected:
-    LPCWSTR GetVertexShaderFileName() override
+    const wchar_t* GetVertexShaderFileName() const override
     {
         return L"shaders/MirrorVertexShader.hlsl";
     }
+
+    // rows are reversed in place, without a copy of the source
+    bool IsCpuKernelInPlace() const override
+    {
+        return true;
+    }
+
+    void ApplyCpuKernel(const ImageView& source, const ImageView& target, int rowBegin, int rowEnd) const override
+    {
+        ApplyMirrorKernel(source, target, rowBegin, rowEnd);
+    }
 };
 
+// default shrink factor, as in ShrinkVertexShader.hlsl
+#define DEFAULT_SHRINK_FACTOR 2.0f
+
 class ShrinkEffect : public BaseEffect {
 public:
 
+    // factor is the ratio between the source and the shrunken sizes, at least 1. padded, the shrunken image is centered
+    // in an image of the source size as the GPU effect draws it, otherwise the effect outputs the smaller image
+    explicit ShrinkEffect(float factor = DEFAULT_SHRINK_FACTOR, bool isPadded = true) : m_factor(std::max(factor, 1.0f)), m_isPadded(isPadded) {}
+
+    BaseEffect* CloneEffect() const override
+    {
+        return new ShrinkEffect(*this);
+    }
+
     string GetEffectDisplayName() const override
     {
-        return "Shrink";
+        return m_isPadded ? "Shrink" : "Downscale";
     }
 
     string GetEffectFileSuffix() const override
     {
-        return "shrink";
+        return m_isPadded ? "shrink" : "downscale";
+    }
+
+    // each pixel averages the source area it covers
+    EffectKind GetEffectKind() const override
+    {
+        return EffectKind::Neighbourhood;
+    }
+
+    vector<EffectParameter> GetParameters() const override
+    {
+        return { { "factor", EffectParameterType::Float, 1.0f, 64.0f, DEFAULT_SHRINK_FACTOR } };
+    }
+
+    float GetParameterValue(int index) const override
+    {
+        return m_factor;
+    }
+
+    void GetOutputDimensions(int width, int height, int* out_width, int* out_height) const override
+    {
+        if (m_isPadded)
+            BaseEffect::GetOutputDimensions(width, height, out_width, out_height);
+        else
+            GetShrinkDimensions(width, height, m_factor, out_width, out_height);
     }
 
 protected:
-    LPCWSTR GetVertexShaderFileName() override
+    const wchar_t* GetVertexShaderFileName() const override
     {
         return L"shaders/ShrinkVertexShader.hlsl";
     }
+
+    void StoreParameterValue(int index, float value) override
+    {
+        m_factor = value;
+    }
+
+    void ApplyCpuEffect(const ImageView& image, CpuEffectManager* cpuManagerRef) const override
+    {
+        ApplyAreaShrink(image, m_factor, m_isPadded, cpuManagerRef);
+    }
+
+private:
+    float m_factor;
+    bool m_isPadded;
 };
 
+// default edge threshold on the gradient magnitude of values in [0, 1], as in EdgeDetectionPixelShader.hlsl
+#define DEFAULT_EDGE_THRESHOLD 0.1f
+
 class EdgeDetectionEffect : public BaseEffect {
 public:
 
+    // pixels whose sobel gradient magnitude passes the threshold become white, the others black
+    explicit EdgeDetectionEffect(float threshold = DEFAULT_EDGE_THRESHOLD) : m_threshold(threshold) {}
+
+    BaseEffect* CloneEffect() const override
+    {
+        return new EdgeDetectionEffect(*this);
+    }
+
     string GetEffectDisplayName() const override
     {
         return "Edge Detection";
@@ -129,36 +456,399 @@ public:
         return "edges";
     }
 
+    vector<EffectParameter> GetParameters() const override
+    {
+        return { { "threshold", EffectParameterType::Float, 0.0f, 8.0f, DEFAULT_EDGE_THRESHOLD } };
+    }
+
+    float GetParameterValue(int index) const override
+    {
+        return m_threshold;
+    }
+
 protected:
-    LPCWSTR GetPixelShaderFileName() override
+    const wchar_t* GetPixelShaderFileName() const override
     {
         return L"shaders/EdgeDetectionPixelShader.hlsl";
     }
+
+    void StoreParameterValue(int index, float value) override
+    {
+        m_threshold = value;
+    }
+
+    // the sobel operator reads the 8 neighbours of a pixel
+    int GetCpuKernelHaloSize() const override
+    {
+        return 1;
+    }
+
+    void ApplyCpuKernel(const ImageView& source, const ImageView& target, int rowBegin, int rowEnd) const override
+    {
+        ApplyEdgeDetectionKernel(source, target, m_threshold, rowBegin, rowEnd);
+    }
+
+private:
+    float m_threshold;
 };
 
-class EqualizationEffect : public BaseEffect {
+// default contrast of the equalization's contrast stretch, as in EqualizationPixelShader.hlsl
+#define DEFAULT_CONTRAST 2.0f
+
+class EqualizationEffect : public PointEffect {
 public:
 
+    // the histogram modes depend on the whole image and only run on the CPU, the contrast only applies to the contrast stretch
+    explicit EqualizationEffect(EqualizationMode mode = EqualizationMode::ContrastStretch, float contrast = DEFAULT_CONTRAST) : m_mode(mode), m_contrast(contrast) {}
+
+    BaseEffect* CloneEffect() const override
+    {
+        return new EqualizationEffect(*this);
+    }
+
     string GetEffectDisplayName() const override
     {
-        return "Equalization";
+        switch (m_mode)
+        {
+        case EqualizationMode::Global:
+            return "Histogram Equalization";
+        case EqualizationMode::PerChannel:
+            return "Histogram Equalization (per channel)";
+        case EqualizationMode::Luma:
+            return "Histogram Equalization (luma)";
+        default:
+            return "Equalization";
+        }
     }
 
     string GetEffectFileSuffix() const override
     {
-        return "equalize";
+        switch (m_mode)
+        {
+        case EqualizationMode::Global:
+            return "histeq";
+        case EqualizationMode::PerChannel:
+            return "histeqchannels";
+        case EqualizationMode::Luma:
+            return "histeqluma";
+        default:
+            return "equalize";
+        }
+    }
+
+    EffectKind GetEffectKind() const override
+    {
+        return m_mode == EqualizationMode::ContrastStretch ? EffectKind::Point : EffectKind::Neighbourhood;
+    }
+
+    vector<EffectParameter> GetParameters() const override
+    {
+        if (m_mode != EqualizationMode::ContrastStretch)
+            return {};
+        return { { "contrast", EffectParameterType::Float, 0.0f, 16.0f, DEFAULT_CONTRAST } };
+    }
+
+    float GetParameterValue(int index) const override
+    {
+        return m_contrast;
+    }
+
+    unsigned char MapColorValue(unsigned char value) const override
+    {
+        return StretchContrastValue(value, m_contrast);
+    }
+
+    bool HasGpuShaders() const override
+    {
+        return m_mode == EqualizationMode::ContrastStretch;
     }
 
 protected:
-    LPCWSTR GetPixelShaderFileName() override
+    const wchar_t* GetPixelShaderFileName() const override
     {
         return L"shaders/EqualizationPixelShader.hlsl";
     }
+
+    void StoreParameterValue(int index, float value) override
+    {
+        m_contrast = value;
+    }
+
+    void ApplyCpuEffect(const ImageView& image, CpuEffectManager* cpuManagerRef) const override
+    {
+        if (m_mode == EqualizationMode::ContrastStretch)
+            PointEffect::ApplyCpuEffect(image, cpuManagerRef);
+        else
+            ApplyHistogramEqualization(image, m_mode, cpuManagerRef);
+    }
+
+private:
+    EqualizationMode m_mode;
+    float m_contrast;
 };
 
+// default gamma, as in GammaPixelShader.hlsl
+#define DEFAULT_GAMMA 2.2f
+
+// range of the gamma of the gamma and levels effects, the constructors clamp to it like SetParameter checks it
+#define MIN_GAMMA 0.1f
+#define MAX_GAMMA 10.0f
+
+class GammaEffect : public PointEffect {
+public:
+
+    // values are raised to the power 1 / gamma, gammas above 1 brighten the image
+    explicit GammaEffect(float gamma = DEFAULT_GAMMA) : m_gamma(std::min(std::max(gamma, MIN_GAMMA), MAX_GAMMA)) {}
+
+    BaseEffect* CloneEffect() const override
+    {
+        return new GammaEffect(*this);
+    }
+
+    string GetEffectDisplayName() const override
+    {
+        return "Gamma";
+    }
+
+    string GetEffectFileSuffix() const override
+    {
+        return "gamma";
+    }
+
+    vector<EffectParameter> GetParameters() const override
+    {
+        return { { "gamma", EffectParameterType::Float, MIN_GAMMA, MAX_GAMMA, DEFAULT_GAMMA } };
+    }
+
+    float GetParameterValue(int index) const override
+    {
+        return m_gamma;
+    }
+
+    unsigned char MapColorValue(unsigned char value) const override
+    {
+        return CorrectGammaValue(value, m_gamma);
+    }
+
+protected:
+    const wchar_t* GetPixelShaderFileName() const override
+    {
+        return L"shaders/GammaPixelShader.hlsl";
+    }
+
+    void StoreParameterValue(int index, float value) override
+    {
+        m_gamma = value;
+    }
+
+private:
+    float m_gamma;
+};
+
+// default levels, as in LevelsPixelShader.hlsl
+#define DEFAULT_LEVELS_INPUT_BLACK 16.0f
+#define DEFAULT_LEVELS_INPUT_WHITE 235.0f
+#define DEFAULT_LEVELS_GAMMA 1.0f
+#define DEFAULT_LEVELS_OUTPUT_BLACK 0.0f
+#define DEFAULT_LEVELS_OUTPUT_WHITE 255.0f
+
+class LevelsEffect : public PointEffect {
+public:
+
+    // levels are in 8-bit values, the defaults expand the video range [16, 235] to the full range
+    explicit LevelsEffect(float inputBlack = DEFAULT_LEVELS_INPUT_BLACK, float inputWhite = DEFAULT_LEVELS_INPUT_WHITE, float gamma = DEFAULT_LEVELS_GAMMA,
+        float outputBlack = DEFAULT_LEVELS_OUTPUT_BLACK, float outputWhite = DEFAULT_LEVELS_OUTPUT_WHITE)
+        : m_parameters{ inputBlack, inputWhite, std::min(std::max(gamma, MIN_GAMMA), MAX_GAMMA), outputBlack, outputWhite } {}
+
+    BaseEffect* CloneEffect() const override
+    {
+        return new LevelsEffect(*this);
+    }
+
+    string GetEffectDisplayName() const override
+    {
+        return "Levels";
+    }
+
+    string GetEffectFileSuffix() const override
+    {
+        return "levels";
+    }
+
+    vector<EffectParameter> GetParameters() const override
+    {
+        return {
+            { "inputBlack", EffectParameterType::Integer, 0.0f, 255.0f, DEFAULT_LEVELS_INPUT_BLACK },
+            { "inputWhite", EffectParameterType::Integer, 0.0f, 255.0f, DEFAULT_LEVELS_INPUT_WHITE },
+            { "gamma", EffectParameterType::Float, MIN_GAMMA, MAX_GAMMA, DEFAULT_LEVELS_GAMMA },
+            { "outputBlack", EffectParameterType::Integer, 0.0f, 255.0f, DEFAULT_LEVELS_OUTPUT_BLACK },
+            { "outputWhite", EffectParameterType::Integer, 0.0f, 255.0f, DEFAULT_LEVELS_OUTPUT_WHITE }
+        };
+    }
+
+    float GetParameterValue(int index) const override
+    {
+        const float values[] = { m_parameters.inputBlack, m_parameters.inputWhite, m_parameters.gamma, m_parameters.outputBlack, m_parameters.outputWhite };
+        return values[index];
+    }
+
+    unsigned char MapColorValue(unsigned char value) const override
+    {
+        return AdjustLevelsValue(value, m_parameters);
+    }
+
+protected:
+    const wchar_t* GetPixelShaderFileName() const override
+    {
+        return L"shaders/LevelsPixelShader.hlsl";
+    }
+
+    void StoreParameterValue(int index, float value) override
+    {
+        float* values[] = { &m_parameters.inputBlack, &m_parameters.inputWhite, &m_parameters.gamma, &m_parameters.outputBlack, &m_parameters.outputWhite };
+        *values[index] = value;
+    }
+
+private:
+    LevelsParameters m_parameters;
+};
+
+// default threshold, as in ThresholdPixelShader.hlsl
+#define DEFAULT_THRESHOLD 128
+
+class ThresholdEffect : public PointEffect {
+public:
+
+    // each color channel becomes 255 from the threshold value up and 0 below it
+    explicit ThresholdEffect(int threshold = DEFAULT_THRESHOLD) : m_threshold(threshold) {}
+
+    BaseEffect* CloneEffect() const override
+    {
+        return new ThresholdEffect(*this);
+    }
+
+    string GetEffectDisplayName() const override
+    {
+        return "Threshold";
+    }
+
+    string GetEffectFileSuffix() const override
+    {
+        return "threshold";
+    }
+
+    vector<EffectParameter> GetParameters() const override
+    {
+        return { { "threshold", EffectParameterType::Integer, 0.0f, 256.0f, DEFAULT_THRESHOLD } };
+    }
+
+    float GetParameterValue(int index) const override
+    {
+        return static_cast<float>(m_threshold);
+    }
+
+    unsigned char MapColorValue(unsigned char value) const override
+    {
+        return value >= m_threshold ? 255 : 0;
+    }
+
+protected:
+    const wchar_t* GetPixelShaderFileName() const override
+    {
+        return L"shaders/ThresholdPixelShader.hlsl";
+    }
+
+    void StoreParameterValue(int index, float value) override
+    {
+        m_threshold = static_cast<int>(value);
+    }
+
+private:
+    int m_threshold;
+};
+
+// default fish-eye parameters, as in FishEyePixelShader.hlsl
+#define DEFAULT_FISHEYE_STRENGTH 0.5f
+#define DEFAULT_FISHEYE_CENTER_X 0.5f
+#define DEFAULT_FISHEYE_CENTER_Y 0.5f
+
+class FishEyeEffect : public CoordinateEffect {
+public:
+
+    // strength in [0, 1] scales the field of view of the lens, 0 leaving the image as is. the center is in texture coordinates.
+    // the radial distortion is only evaluated when the remap table of an image size is built
+    explicit FishEyeEffect(float strength = DEFAULT_FISHEYE_STRENGTH, float centerX = DEFAULT_FISHEYE_CENTER_X, float centerY = DEFAULT_FISHEYE_CENTER_Y)
+        : m_parameters{ strength, centerX, centerY } {}
+
+    BaseEffect* CloneEffect() const override
+    {
+        return new FishEyeEffect(*this);
+    }
+
+    string GetEffectDisplayName() const override
+    {
+        return "Fish Eye";
+    }
+
+    string GetEffectFileSuffix() const override
+    {
+        return "fisheye";
+    }
+
+    void MapSourcePosition(float x, float y, int width, int height, float* out_x, float* out_y) const override
+    {
+        MapFishEyeSourcePosition(x, y, width, height, m_parameters, out_x, out_y);
+    }
+
+    vector<EffectParameter> GetParameters() const override
+    {
+        return {
+            { "strength", EffectParameterType::Float, 0.0f, 1.0f, DEFAULT_FISHEYE_STRENGTH },
+            { "centerX", EffectParameterType::Float, -1.0f, 2.0f, DEFAULT_FISHEYE_CENTER_X },
+            { "centerY", EffectParameterType::Float, -1.0f, 2.0f, DEFAULT_FISHEYE_CENTER_Y }
+        };
+    }
+
+    float GetParameterValue(int index) const override
+    {
+        const float values[] = { m_parameters.strength, m_parameters.centerX, m_parameters.centerY };
+        return values[index];
+    }
+
+protected:
+    const wchar_t* GetPixelShaderFileName() const override
+    {
+        return L"shaders/FishEyePixelShader.hlsl";
+    }
+
+    void StoreParameterValue(int index, float value) override
+    {
+        float* values[] = { &m_parameters.strength, &m_parameters.centerX, &m_parameters.centerY };
+        *values[index] = value;
+    }
+
+private:
+    FishEyeParameters m_parameters;
+};
+
+// default waves parameters, as in WavesPixelShader.hlsl
+#define DEFAULT_WAVES_AMPLITUDE 0.1f
+#define DEFAULT_WAVES_FREQUENCY 20.0f
+#define DEFAULT_WAVES_PHASE 0.0f
+
 class WavesEffect : public BaseEffect {
 public:
 
+    // amplitude is in image widths, frequency in radians per image height and phase in radians.
+    // without interpolation the CPU effect shifts rows by whole pixels, making it a plain copy of each row
+    explicit WavesEffect(float amplitude = DEFAULT_WAVES_AMPLITUDE, float frequency = DEFAULT_WAVES_FREQUENCY, float phase = DEFAULT_WAVES_PHASE, bool isInterpolated = true)
+        : m_parameters{ amplitude, frequency, phase, isInterpolated } {}
+
+    BaseEffect* CloneEffect() const override
+    {
+        return new WavesEffect(*this);
+    }
+
     string GetEffectDisplayName() const override
     {
         return "Waves Effect";
@@ -169,9 +859,102 @@ public:
         return "waves";
     }
 
+    EffectKind GetEffectKind() const override
+    {
+        return EffectKind::Coordinate;
+    }
+
+    void MapSourcePosition(float x, float y, int width, int height, float* out_x, float* out_y) const override
+    {
+        MapWavesSourcePosition(x, y, width, height, m_parameters, out_x, out_y);
+    }
+
+    vector<EffectParameter> GetParameters() const override
+    {
+        return {
+            { "amplitude", EffectParameterType::Float, -1.0f, 1.0f, DEFAULT_WAVES_AMPLITUDE },
+            { "frequency", EffectParameterType::Float, 0.0f, 1000.0f, DEFAULT_WAVES_FREQUENCY },
+            { "phase", EffectParameterType::Float, -1000.0f, 1000.0f, DEFAULT_WAVES_PHASE },
+            { "interpolated", EffectParameterType::Boolean, 0.0f, 1.0f, 1.0f }
+        };
+    }
+
+    float GetParameterValue(int index) const override
+    {
+        const float values[] = { m_parameters.amplitude, m_parameters.frequency, m_parameters.phase, m_parameters.isInterpolated ? 1.0f : 0.0f };
+        return values[index];
+    }
+
 protected:
-    LPCWSTR GetPixelShaderFileName() override
+    const wchar_t* GetPixelShaderFileName() const override
     {
         return L"shaders/WavesPixelShader.hlsl";
     }
-};
\ No newline at end of file
+
+    void StoreParameterValue(int index, float value) override
+    {
+        if (index == 3)
+        {
+            m_parameters.isInterpolated = value != 0.0f;
+            return;
+        }
+
+        float* values[] = { &m_parameters.amplitude, &m_parameters.frequency, &m_parameters.phase };
+        *values[index] = value;
+    }
+
+    // rows are copied one at a time before being shifted, which saves a copy of the whole image
+    bool IsCpuKernelInPlace() const override
+    {
+        return true;
+    }
+
+    void ApplyCpuKernel(const ImageView& source, const ImageView& target, int rowBegin, int rowEnd) const override
+    {
+        ApplyWavesKernel(source, target, m_parameters, rowBegin, rowEnd);
+    }
+
+private:
+    WavesParameters m_parameters;
+};
+
+/**
+ * An effect defined by an HLSL pixel shader file of its own, drawn over the quad of the default vertex shader like the other effects.
+ * Its shader may use the subset of HLSL the CPU shader engine handles, it then runs on both backends without a CPU kernel.
+ */
+class ShaderFileEffect : public BaseEffect {
+public:
+
+    // the file name without its extension names the effect and its output files
+    explicit ShaderFileEffect(const string& filePath) : m_filePath(std::filesystem::path(filePath).wstring()), m_name(std::filesystem::path(filePath).stem().string()) {}
+
+    BaseEffect* CloneEffect() const override
+    {
+        return new ShaderFileEffect(*this);
+    }
+
+    string GetEffectDisplayName() const override
+    {
+        return m_name;
+    }
+
+    string GetEffectFileSuffix() const override
+    {
+        return m_name;
+    }
+
+protected:
+    const wchar_t* GetPixelShaderFileName() const override
+    {
+        return m_filePath.c_str();
+    }
+
+    bool HasCpuKernel() const override
+    {
+        return false;
+    }
+
+private:
+    std::wstring m_filePath;
+    string m_name;
+};
@@ -0,0 +1,93 @@
+#include "EffectCache.h"
+
+// names of the kinds in the summary
+static const char* EFFECT_CACHE_KIND_NAMES[] = { "compiled shaders", "channel tables", "remap tables", "CPU shader programs" };
+
+static_assert(sizeof(EFFECT_CACHE_KIND_NAMES) / sizeof(EFFECT_CACHE_KIND_NAMES[0]) == static_cast<size_t>(EffectCacheKind::Count),
+    "every kind of entries needs a name");
+
+EffectCache& EffectCache::getInstance()
+{
+    static EffectCache effectCache;
+    return effectCache;
+}
+
+EffectCache::EffectCache()
+{
+    m_kinds[static_cast<int>(EffectCacheKind::ShaderBytecode)].capacity = EFFECT_CACHE_SHADER_CAPACITY;
+    m_kinds[static_cast<int>(EffectCacheKind::ChannelTables)].capacity = EFFECT_CACHE_CHANNEL_TABLES_CAPACITY;
+    m_kinds[static_cast<int>(EffectCacheKind::RemapTable)].capacity = EFFECT_CACHE_REMAP_TABLE_CAPACITY;
+    m_kinds[static_cast<int>(EffectCacheKind::CpuShaderProgram)].capacity = EFFECT_CACHE_CPU_SHADER_CAPACITY;
+}
+
+std::shared_ptr<const void> EffectCache::findEntry(KindEntries& kindEntries, const string& key)
+{
+    auto entry = kindEntries.index.find(key);
+    if (entry == kindEntries.index.end())
+        return nullptr;
+
+    kindEntries.entries.splice(kindEntries.entries.begin(), kindEntries.entries, entry->second);
+    return entry->second->value;
+}
+
+// the entry is prepared outside the lock, preparing may take long and use the CPU effect manager's threads
+std::shared_ptr<const void> EffectCache::getUntypedEntry(EffectCacheKind kind, const string& key, const std::function<std::shared_ptr<const void>()>& prepare)
+{
+    KindEntries& kindEntries = m_kinds[static_cast<int>(kind)];
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::shared_ptr<const void> value = findEntry(kindEntries, key);
+        if (value)
+        {
+            kindEntries.hitCount.fetch_add(1, std::memory_order_relaxed);
+            return value;
+        }
+    }
+
+    kindEntries.missCount.fetch_add(1, std::memory_order_relaxed);
+
+    std::shared_ptr<const void> preparedValue = prepare();
+    if (!preparedValue)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::shared_ptr<const void> value = findEntry(kindEntries, key);
+    if (value)
+        return value;
+
+    kindEntries.entries.push_front(Entry{ key, preparedValue });
+    kindEntries.index[key] = kindEntries.entries.begin();
+
+    if (kindEntries.entries.size() > kindEntries.capacity)
+    {
+        kindEntries.index.erase(kindEntries.entries.back().key);
+        kindEntries.entries.pop_back();
+    }
+
+    return preparedValue;
+}
+
+EffectCacheStats EffectCache::getStats(EffectCacheKind kind) const
+{
+    const KindEntries& kindEntries = m_kinds[static_cast<int>(kind)];
+
+    EffectCacheStats stats;
+    stats.hitCount = kindEntries.hitCount.load(std::memory_order_relaxed);
+    stats.missCount = kindEntries.missCount.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    stats.entryCount = static_cast<int>(kindEntries.entries.size());
+    return stats;
+}
+
+void EffectCache::printSummary(std::ostream& outputStream) const
+{
+    outputStream << "Effect cache:";
+    for (int i = 0; i < static_cast<int>(EffectCacheKind::Count); ++i)
+    {
+        EffectCacheStats stats = getStats(static_cast<EffectCacheKind>(i));
+        outputStream << (i ? ", " : " ") << EFFECT_CACHE_KIND_NAMES[i] << " " << stats.hitCount << " hits " << stats.missCount << " misses";
+    }
+    outputStream << "." << std::endl;
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+using std::string;  // Make string available as 'string'
+
+// the kinds of state the backends prepare before applying an effect, each kept and counted apart
+enum class EffectCacheKind {
+    ShaderBytecode,  // the HLSL of an effect compiled with its parameters, shared by the devices of every ShaderManager
+    ChannelTables,   // the tables of a point effect for a channel count
+    RemapTable,      // the remap table of coordinate effects for an image size
+    CpuShaderProgram,  // a shader file compiled with its macros for the CPU shader engine
+    Count
+};
+
+// number of compiled shaders the cache keeps
+#define EFFECT_CACHE_SHADER_CAPACITY 256
+
+// number of sets of channel tables the cache keeps, 4 KB each
+#define EFFECT_CACHE_CHANNEL_TABLES_CAPACITY 256
+
+// number of remap tables the cache keeps, a 12 megapixel table takes 72 MB
+#define EFFECT_CACHE_REMAP_TABLE_CAPACITY 4
+
+// number of shader programs compiled for the CPU the cache keeps
+#define EFFECT_CACHE_CPU_SHADER_CAPACITY 256
+
+/**
+ * Counters of a kind of entries of the effect cache since the start of the process.
+ */
+struct EffectCacheStats {
+    long long hitCount = 0;   // lookups served by a prepared entry
+    long long missCount = 0;  // lookups that had to prepare their entry
+    int entryCount = 0;       // entries currently kept
+};
+
+/**
+ * EffectCache keeps what the backends prepare for an effect so it is prepared once per process rather than once per image :
+ * the shaders the GPU backend compiles for the parameters of an effect, the channel tables of the point effects and
+ * the remap tables of the coordinate effects on the CPU, and the shaders compiled for the CPU shader engine.
+ * Entries are keyed by their kind and by a string holding the effect type and its parameters (BaseEffect::GetEffectKey),
+ * plus whatever else they depend on, like the channel count or the image size. Each kind keeps its most recently used
+ * entries up to its capacity, and entries evicted while in use stay alive until released.
+ * The cache is safe to use from several threads, an entry is prepared outside the lock, so two threads missing the same
+ * entry at once both prepare it and the first one is kept.
+ */
+class EffectCache {
+public:
+    /**
+     * Returns the effect cache of the process.
+     */
+    static EffectCache& getInstance();
+
+    /**
+     * Returns the entry of a key, prepared on a miss. An entry that could not be prepared is not kept.
+     *
+     * @param kind The kind of the entry.
+     * @param key Key of the entry, equal only for entries prepared the same way.
+     * @param prepare Prepares the entry on a miss, returns nullptr on failure.
+     * @return The entry, or nullptr if it could not be prepared.
+     */
+    template <typename T>
+    std::shared_ptr<const T> getEntry(EffectCacheKind kind, const string& key, const std::function<std::shared_ptr<const T>()>& prepare)
+    {
+        return std::static_pointer_cast<const T>(getUntypedEntry(kind, key, [&prepare]() -> std::shared_ptr<const void> { return prepare(); }));
+    }
+
+    /**
+     * Returns the counters of a kind of entries.
+     */
+    EffectCacheStats getStats(EffectCacheKind kind) const;
+
+    /**
+     * Prints the hits and misses of every kind of entries.
+     *
+     * @param outputStream The stream to print to.
+     */
+    void printSummary(std::ostream& outputStream) const;
+
+private:
+    EffectCache();
+
+    struct Entry {
+        string key;
+        std::shared_ptr<const void> value;
+    };
+
+    // the entries of a kind, most recently used first, and their index by key
+    struct KindEntries {
+        size_t capacity = 0;
+        std::list<Entry> entries;
+        std::unordered_map<string, std::list<Entry>::iterator> index;
+        std::atomic<long long> hitCount{ 0 };
+        std::atomic<long long> missCount{ 0 };
+    };
+
+    /**
+     * Looks up the entry of a key, marking it as the most recently used. Must be called with the lock held.
+     */
+    std::shared_ptr<const void> findEntry(KindEntries& kindEntries, const string& key);
+
+    std::shared_ptr<const void> getUntypedEntry(EffectCacheKind kind, const string& key, const std::function<std::shared_ptr<const void>()>& prepare);
+
+    mutable std::mutex m_mutex;
+    KindEntries m_kinds[static_cast<int>(EffectCacheKind::Count)];
+};
@@ -0,0 +1,202 @@
+#include "EffectChain.h"
+#include "BufferPool.h"
+#include "Profiler.h"
+#include "RemapTable.h"
+#include <algorithm>
+
+#define MAX_CHANNELS 4
+
+// groups the effects into passes : a neighbourhood effect ends the current fused pass,
+// and a coordinate effect following a point effect that is applied on sampled values starts a new one
+EffectChain::EffectChain(const vector<BaseEffect*>& effects) : m_effects(effects)
+{
+    bool canFuseCoordinates = false;
+
+    for (BaseEffect* effect : effects)
+    {
+        EffectKind kind = effect->GetEffectKind();
+
+        if (kind == EffectKind::Neighbourhood)
+        {
+            FusedPass pass;
+            pass.effects.push_back(effect);
+            pass.neighbourhoodEffect = effect;
+            m_passes.push_back(pass);
+            canFuseCoordinates = false;
+            continue;
+        }
+
+        bool isFusedPassOpen = !m_passes.empty() && !m_passes.back().neighbourhoodEffect;
+        if (!isFusedPassOpen || (kind == EffectKind::Coordinate && !canFuseCoordinates))
+        {
+            FusedPass pass;
+            for (int c = 0; c < MAX_CHANNELS; ++c)
+            {
+                InitializeIdentityTables(&pass.sourceTables[c]);
+                InitializeIdentityTables(&pass.targetTables[c]);
+            }
+            m_passes.push_back(pass);
+            canFuseCoordinates = true;
+        }
+
+        FusedPass& pass = m_passes.back();
+        pass.effects.push_back(effect);
+
+        if (kind == EffectKind::Coordinate)
+        {
+            pass.coordinateEffects.push_back(effect);
+            continue;
+        }
+
+        // point effects compose into the tables of the side of the sampling they are on
+        std::array<ChannelTables, MAX_CHANNELS>& tables = pass.coordinateEffects.empty() ? pass.sourceTables : pass.targetTables;
+        for (int channels = 1; channels <= MAX_CHANNELS; ++channels)
+        {
+            ChannelTables effectTables;
+            effect->BuildChannelTables(channels, &effectTables);
+            ComposeChannelTables(effectTables, channels, &tables[channels - 1]);
+        }
+
+        if (!pass.coordinateEffects.empty())
+            canFuseCoordinates = false;
+    }
+}
+
+string EffectChain::GetEffectChainFileSuffix() const
+{
+    string suffix;
+    for (const BaseEffect* effect : m_effects)
+    {
+        if (!suffix.empty())
+            suffix += "_";
+        suffix += effect->GetEffectFileSuffix() + effect->GetParameterSuffix();
+    }
+    return suffix;
+}
+
+int EffectChain::GetPassCount() const
+{
+    return static_cast<int>(m_passes.size());
+}
+
+void EffectChain::GetOutputDimensions(int width, int height, int* out_width, int* out_height) const
+{
+    for (const BaseEffect* effect : m_effects)
+        effect->GetOutputDimensions(width, height, &width, &height);
+
+    *out_width = width;
+    *out_height = height;
+}
+
+#ifdef _WIN32
+// the GPU applies each effect as its own draw
+bool EffectChain::ApplyEffectChainOnImage(const ImageView& image, ShaderManager* shaderManagerRef, string* out_error) const
+{
+    ImageView region = image;
+    for (BaseEffect* effect : m_effects)
+    {
+        if (!effect->ApplyEffectOnImage(region, shaderManagerRef, out_error))
+            return false;
+
+        int width, height;
+        effect->GetOutputDimensions(region.getWidth(), region.getHeight(), &width, &height);
+        region = region.getRegion(0, 0, width, height);
+    }
+
+    return true;
+}
+#endif
+
+bool EffectChain::ApplyEffectChainOnImage(const ImageView& image, CpuEffectManager* cpuManagerRef, string* out_error) const
+{
+    if (!cpuManagerRef || !cpuManagerRef->isInitialized())
+    {
+        *out_error = "CpuEffectManager reference is null or not initialized";
+        std::cout << "CpuEffectManager reference is null or not initialized";
+        return false;
+    }
+
+    // the effects after one that shrinks the image work on the top left region it wrote
+    ImageView region = image;
+    for (const FusedPass& pass : m_passes)
+    {
+        // a pass of a single effect keeps the effect's own kernel, which is vectorized where the tables are not.
+        // effects emulating their shaders each run their own draw, as on the GPU
+        if (pass.effects.size() == 1 || cpuManagerRef->isShaderEmulationEnabled())
+        {
+            for (const BaseEffect* effect : pass.effects)
+            {
+                if (!effect->ApplyEffectOnImage(region, cpuManagerRef, out_error))
+                    return false;
+
+                int width, height;
+                effect->GetOutputDimensions(region.getWidth(), region.getHeight(), &width, &height);
+                region = region.getRegion(0, 0, width, height);
+            }
+        }
+        else
+        {
+            PROFILE_SCOPE("chain.fusedPass");
+            applyFusedPass(pass, region, cpuManagerRef);
+        }
+    }
+
+    return true;
+}
+
+// a fused pass without coordinate effects is a lookup of the composed tables in place.
+// otherwise the coordinate effects are composed into a remap table, mapping each position through them from the last
+// to the first and clamping between effects like each effect's sampler would. the source tables are looked up into
+// a copy of the source, which the table samples once, and the target tables on the remapped rows
+void EffectChain::applyFusedPass(const FusedPass& pass, const ImageView& image, CpuEffectManager* cpuManagerRef) const
+{
+    int width = image.getWidth();
+    int height = image.getHeight();
+    int channels = image.getChannels();
+
+    const ChannelTables& sourceTables = pass.sourceTables[channels - 1];
+    const ChannelTables& targetTables = pass.targetTables[channels - 1];
+
+    if (pass.coordinateEffects.empty())
+    {
+        ChannelTables tables = sourceTables;
+        ComposeChannelTables(targetTables, channels, &tables);
+
+        cpuManagerRef->parallelForRows(height, [&](int rowBegin, int rowEnd) {
+            ApplyChannelTablesKernel(image, image, tables, rowBegin, rowEnd);
+        });
+        return;
+    }
+
+    string mappingKey;
+    for (const BaseEffect* effect : pass.coordinateEffects)
+        mappingKey += (mappingKey.empty() ? "" : "+") + effect->GetEffectKey();
+
+    std::shared_ptr<const RemapTable> table = GetRemapTable(mappingKey, width, height,
+        [&](float x, float y, float* out_x, float* out_y) {
+            for (size_t i = pass.coordinateEffects.size(); i-- > 0;)
+            {
+                if (i + 1 != pass.coordinateEffects.size())
+                {
+                    x = std::min(std::max(x, 0.5f), width - 0.5f);
+                    y = std::min(std::max(y, 0.5f), height - 0.5f);
+                }
+                pass.coordinateEffects[i]->MapSourcePosition(x, y, width, height, &x, &y);
+            }
+            *out_x = x;
+            *out_y = y;
+        }, cpuManagerRef);
+
+    // packed rows as the remap table expects, with room for the 4-byte gathers of the remap kernel past the last pixel
+    PooledBuffer sourceCopy = AcquirePooledBuffer(image.getRowSize() * height + 4);
+    ImageView sourceView(sourceCopy.get(), width, height, channels);
+
+    cpuManagerRef->parallelForRows(height, [&](int rowBegin, int rowEnd) {
+        ApplyChannelTablesKernel(image, sourceView, sourceTables, rowBegin, rowEnd);
+    });
+
+    cpuManagerRef->parallelForRows(height, [&](int rowBegin, int rowEnd) {
+        ApplyRemapTableKernel(sourceCopy.get(), image, *table, rowBegin, rowEnd);
+        ApplyChannelTablesKernel(image, image, targetTables, rowBegin, rowEnd);
+    });
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "Effect.h"
+#include <array>
+#include <vector>
+
+using std::vector;  // Make vector available as 'vector'
+
+/**
+ * EffectChain applies an ordered list of effects to an image.
+ * On the CPU, consecutive point effects (color inversion, contrast, gamma...) and coordinate effects (mirror, waves)
+ * are fused into a single pass : the coordinate effects are composed into a remap table cached per image size, which samples
+ * the source once, and the point effects are composed into per-channel 256 entry tables applied around the sampling.
+ * Neighbourhood effects (blur, edge detection, shrink) run as separate passes between the fused ones,
+ * and the effects after one that changes the image size work on the new size.
+ */
+class EffectChain {
+public:
+    /**
+     * Creates the chain and plans its fused passes.
+     *
+     * @param effects The effects to apply, in order. The chain does not own them.
+     */
+    explicit EffectChain(const vector<BaseEffect*>& effects);
+
+    /**
+     * Returns the file suffix of the chain, the suffixes of its effects with their non-default parameters joined by underscores.
+     */
+    string GetEffectChainFileSuffix() const;
+
+    /**
+     * Returns the number of passes over the image the chain makes on the CPU.
+     */
+    int GetPassCount() const;
+
+    /**
+     * Returns the size of the image the chain produces from an image of the given size.
+     */
+    void GetOutputDimensions(int width, int height, int* out_width, int* out_height) const;
+
+#ifdef _WIN32
+    /**
+     * Applies the effects one after the other on the GPU.
+     *
+     * @param image The image, overwritten with the result in its top left region of the size given by GetOutputDimensions.
+     * @param shaderManagerRef The shader manager to apply the effects with.
+     * @param out_error A pointer to a string to receive error messages, if any.
+     * @return true if all the effects were applied, false otherwise.
+     */
+    bool ApplyEffectChainOnImage(const ImageView& image, ShaderManager* shaderManagerRef, string* out_error) const;
+#endif
+
+    /**
+     * Applies the effects on the CPU, fusing point and coordinate effects into single passes unless the CPU effect manager
+     * emulates their shaders.
+     * The chain is not modified, so several threads can apply it at the same time.
+     *
+     * @param image The image, overwritten with the result in its top left region of the size given by GetOutputDimensions.
+     * @param cpuManagerRef The CPU effect manager to apply the effects with.
+     * @param out_error A pointer to a string to receive error messages, if any.
+     * @return true if all the effects were applied, false otherwise.
+     */
+    bool ApplyEffectChainOnImage(const ImageView& image, CpuEffectManager* cpuManagerRef, string* out_error) const;
+
+private:
+    // a single pass over the image : either a neighbourhood effect, or fused point and coordinate effects.
+    // point effects before the first coordinate effect are applied on the sampled source texels, the others on the result
+    // the tables are built for every channel count, at index channels - 1
+    struct FusedPass {
+        vector<BaseEffect*> effects;
+        BaseEffect* neighbourhoodEffect = nullptr;
+        vector<const BaseEffect*> coordinateEffects;
+        std::array<ChannelTables, 4> sourceTables;
+        std::array<ChannelTables, 4> targetTables;
+    };
+
+    /**
+     * Applies a pass of fused point and coordinate effects.
+     */
+    void applyFusedPass(const FusedPass& pass, const ImageView& image, CpuEffectManager* cpuManagerRef) const;
+
+    vector<BaseEffect*> m_effects;
+    vector<FusedPass> m_passes;
+};
@@ -0,0 +1,104 @@
+#include "Image.h"
+#include "BufferPool.h"
+#include <algorithm>
+#include <cstring>
+
+static_assert(BUFFER_POOL_ALIGNMENT % IMAGE_ROW_ALIGNMENT == 0, "the buffers of the pool must keep the rows aligned");
+
+#include "stb_image.h"
+#include "stb_image_write.h"
+
+ImageView::ImageView(unsigned char* data, int width, int height, int channels)
+    : ImageView(data, width, height, channels, static_cast<size_t>(width) * channels)
+{
+}
+
+ImageView::ImageView(unsigned char* data, int width, int height, int channels, size_t stride)
+    : m_data(data), m_width(width), m_height(height), m_channels(channels), m_stride(stride)
+{
+}
+
+ImageView ImageView::getRegion(int x, int y, int width, int height) const
+{
+    x = std::min(std::max(x, 0), m_width);
+    y = std::min(std::max(y, 0), m_height);
+    width = std::min(std::max(width, 0), m_width - x);
+    height = std::min(std::max(height, 0), m_height - y);
+
+    return ImageView(getRow(y) + static_cast<size_t>(x) * m_channels, width, height, m_channels, m_stride);
+}
+
+// packed views of the same layout are copied at once
+void ImageView::copyTo(const ImageView& target) const
+{
+    size_t rowSize = getRowSize();
+
+    if (isPacked() && target.isPacked())
+    {
+        std::memcpy(target.getData(), m_data, rowSize * m_height);
+        return;
+    }
+
+    for (int y = 0; y < m_height; ++y)
+        std::memcpy(target.getRow(y), getRow(y), rowSize);
+}
+
+Image::Image(int width, int height, int channels)
+{
+    size_t rowSize = static_cast<size_t>(width) * channels;
+    size_t stride = (rowSize + IMAGE_ROW_ALIGNMENT - 1) / IMAGE_ROW_ALIGNMENT * IMAGE_ROW_ALIGNMENT;
+    unsigned char* data = static_cast<unsigned char*>(BufferPool::getInstance().acquire(stride * height));
+
+    m_view = ImageView(data, width, height, channels, stride);
+}
+
+Image::~Image()
+{
+    release();
+}
+
+Image::Image(Image&& other) noexcept : m_view(other.m_view)
+{
+    other.m_view = ImageView();
+}
+
+Image& Image::operator=(Image&& other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        m_view = other.m_view;
+        other.m_view = ImageView();
+    }
+    return *this;
+}
+
+// stb_image allocates from the buffer pool, so its buffers are released like the others
+Image Image::FromStbiBuffer(unsigned char* data, int width, int height, int channels)
+{
+    Image image;
+    image.m_view = ImageView(data, width, height, channels);
+    return image;
+}
+
+void Image::release()
+{
+    BufferPool::getInstance().release(m_view.getData());
+    m_view = ImageView();
+}
+
+bool LoadImageFile(const string& filePath, Image* out_image)
+{
+    int width, height, channels;
+    unsigned char* data = stbi_load(filePath.c_str(), &width, &height, &channels, 0);
+    if (!data)
+        return false;
+
+    *out_image = Image::FromStbiBuffer(data, width, height, channels);
+    return true;
+}
+
+bool WritePngFile(const string& filePath, const ImageView& image)
+{
+    return stbi_write_png(filePath.c_str(), image.getWidth(), image.getHeight(), image.getChannels(), image.getData(), static_cast<int>(image.getStride())) != 0;
+}
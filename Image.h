@@ -0,0 +1,156 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+using std::string;  // Make string available as 'string'
+
+// alignment in bytes of the rows of the images Image allocates, a cache line and the width of an AVX-512 register
+#define IMAGE_ROW_ALIGNMENT 64
+
+/**
+ * A non-owning view of an interleaved 8-bit image with 1 to 4 channels, whose rows start stride bytes apart.
+ * Views are cheap to copy and pass by value. A region of a view shares the pixels of the image it is taken from,
+ * so effects can work on a part of an image without copying it.
+ */
+class ImageView {
+public:
+    ImageView() {}
+
+    /**
+     * Creates a view of packed rows, stride is width * channels.
+     */
+    ImageView(unsigned char* data, int width, int height, int channels);
+
+    /**
+     * Creates a view of rows starting stride bytes apart, stride is at least width * channels.
+     */
+    ImageView(unsigned char* data, int width, int height, int channels, size_t stride);
+
+    unsigned char* getData() const
+    {
+        return m_data;
+    }
+
+    int getWidth() const
+    {
+        return m_width;
+    }
+
+    int getHeight() const
+    {
+        return m_height;
+    }
+
+    int getChannels() const
+    {
+        return m_channels;
+    }
+
+    // distance in bytes between the starts of two consecutive rows
+    size_t getStride() const
+    {
+        return m_stride;
+    }
+
+    // size in bytes of the pixels of a row, without the padding up to the stride
+    size_t getRowSize() const
+    {
+        return static_cast<size_t>(m_width) * m_channels;
+    }
+
+    unsigned char* getRow(int y) const
+    {
+        return m_data + y * m_stride;
+    }
+
+    bool isEmpty() const
+    {
+        return !m_data || m_width <= 0 || m_height <= 0;
+    }
+
+    // returns true if the rows follow each other without padding, so the pixels are a single range of bytes
+    bool isPacked() const
+    {
+        return m_stride == getRowSize() || m_height == 1;
+    }
+
+    /**
+     * Returns a view of the width x height region whose top left pixel is (x, y), sharing the pixels of this view.
+     * The region is clamped to the view.
+     */
+    ImageView getRegion(int x, int y, int width, int height) const;
+
+    /**
+     * Copies the pixels row by row to a view of the same size and channel count.
+     */
+    void copyTo(const ImageView& target) const;
+
+private:
+    unsigned char* m_data = nullptr;
+    int m_width = 0;
+    int m_height = 0;
+    int m_channels = 0;
+    size_t m_stride = 0;
+};
+
+/**
+ * An image that owns its pixels, in a buffer of the buffer pool. Images allocated here have rows aligned on
+ * IMAGE_ROW_ALIGNMENT bytes, and images adopted from stb_image keep its packed buffer, which stb_image took from the pool.
+ * Images are move-only : the code that processes them takes an ImageView, which does not own the pixels.
+ */
+class Image {
+public:
+    Image() {}
+
+    /**
+     * Allocates an image with uninitialized pixels, its stride is the row size rounded up to IMAGE_ROW_ALIGNMENT.
+     */
+    Image(int width, int height, int channels);
+
+    ~Image();
+
+    Image(const Image&) = delete;
+    Image& operator=(const Image&) = delete;
+
+    Image(Image&& other) noexcept;
+    Image& operator=(Image&& other) noexcept;
+
+    /**
+     * Takes ownership of a buffer returned by stbi_load, without copying it.
+     */
+    static Image FromStbiBuffer(unsigned char* data, int width, int height, int channels);
+
+    const ImageView& getView() const
+    {
+        return m_view;
+    }
+
+    bool isEmpty() const
+    {
+        return m_view.isEmpty();
+    }
+
+private:
+    // releases the pixels and leaves the image empty
+    void release();
+
+    ImageView m_view;
+};
+
+/**
+ * Decodes an image file with stb_image, in the channel count it is stored with.
+ *
+ * @param filePath The image file.
+ * @param out_image Receives the decoded image, which adopts the buffer of stb_image.
+ * @return true if the file was decoded, false otherwise.
+ */
+bool LoadImageFile(const string& filePath, Image* out_image);
+
+/**
+ * Encodes an image view as a PNG file, its rows are read at their stride.
+ *
+ * @param filePath The PNG file to write.
+ * @param image The pixels to encode.
+ * @return true if the file was written, false otherwise.
+ */
+bool WritePngFile(const string& filePath, const ImageView& image);
@@ -0,0 +1,306 @@
+#include "ImagePipeline.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+// default capacity of the queues between the stages, in images
+#define DEFAULT_QUEUE_CAPACITY 4
+
+// number of hardware threads per default encode worker, PNG encoding is usually the slowest stage
+#define HARDWARE_THREADS_PER_ENCODE_WORKER 2
+
+// pixels of the images the effect stage processes at once, past which it waits for an image to finish before taking
+// the next one. an image larger than that is processed alone
+#define MAX_EFFECT_PIXELS_IN_FLIGHT (64ll << 20)
+
+struct ImagePipeline::RunState {
+    RunState(const vector<path>& paths, const vector<EffectChain>& effectChains, const path& folder, int queueCapacity)
+        : imagePaths(paths), chains(effectChains), outputDir(folder),
+          remainingOutputCounts(new std::atomic<int>[paths.size()]),
+          decodedQueue(queueCapacity), processedQueue(queueCapacity)
+    {
+        for (size_t i = 0; i < paths.size(); ++i)
+            remainingOutputCounts[i] = static_cast<int>(effectChains.size());
+    }
+
+    const vector<path>& imagePaths;
+    const vector<EffectChain>& chains;
+    const path& outputDir;
+
+    // output images left to write per source image, an image is processed once it reaches 0
+    std::unique_ptr<std::atomic<int>[]> remainingOutputCounts;
+
+    std::atomic<int> nextImageIndex{ 0 };
+    std::atomic<int> runningDecodeWorkers{ 0 };
+
+    // images submitted to the CPU effect manager and not done yet, and their pixels
+    std::mutex effectJobsMutex;
+    std::condition_variable effectJobsCondition;
+    int runningEffectJobs = 0;
+    long long effectPixelsInFlight = 0;
+
+    BoundedQueue<DecodedImage> decodedQueue;
+    BoundedQueue<ProcessedImage> processedQueue;
+};
+
+// returns the nanoseconds elapsed since the given time
+static long long GetElapsedNanoseconds(std::chrono::steady_clock::time_point startTime)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+ImagePipeline::ImagePipeline(CpuEffectManager* cpuManagerRef, const ImagePipelineOptions& options) : m_cpuManager(cpuManagerRef)
+{
+    int hardwareThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    // an image in flight per thread by default, so every thread has an image of its own when they are small
+    m_decodeWorkerCount = options.decodeWorkerCount > 0 ? options.decodeWorkerCount : 1;
+    m_effectWorkerCount = options.effectWorkerCount > 0 ? options.effectWorkerCount : cpuManagerRef->getThreadCount();
+    m_encodeWorkerCount = options.encodeWorkerCount > 0 ? options.encodeWorkerCount : std::max(1, hardwareThreads / HARDWARE_THREADS_PER_ENCODE_WORKER);
+    m_queueCapacity = options.queueCapacity > 0 ? options.queueCapacity : DEFAULT_QUEUE_CAPACITY;
+}
+
+// starts the workers of all the stages and waits for them. each stage closes the queue it feeds once its
+// last worker is done, which lets the next stage drain the queue and stop
+bool ImagePipeline::run(const vector<path>& imagePaths, const vector<EffectChain>& chains, const path& outputDir)
+{
+    m_processedImageCount = 0;
+    m_writtenImageCount = 0;
+    m_processedPixelCount = 0;
+    m_decodeNanoseconds = 0;
+    m_effectNanoseconds = 0;
+    m_encodeNanoseconds = 0;
+    m_failures.clear();
+
+    std::error_code directoryError;
+    std::filesystem::create_directories(outputDir, directoryError);
+
+    RunState state(imagePaths, chains, outputDir, m_queueCapacity);
+    state.runningDecodeWorkers = m_decodeWorkerCount;
+
+    vector<std::thread> workers;
+    for (int i = 0; i < m_decodeWorkerCount; ++i)
+        workers.emplace_back(&ImagePipeline::decodeWorker, this, std::ref(state));
+    workers.emplace_back(&ImagePipeline::effectWorker, this, std::ref(state));
+    for (int i = 0; i < m_encodeWorkerCount; ++i)
+        workers.emplace_back(&ImagePipeline::encodeWorker, this, std::ref(state));
+
+    for (std::thread& worker : workers)
+        worker.join();
+
+    return m_failures.empty();
+}
+
+// decodes the next image not taken by another decode worker, until none is left
+void ImagePipeline::decodeWorker(RunState& state)
+{
+    int imageCount = static_cast<int>(state.imagePaths.size());
+
+    for (int imageIndex = state.nextImageIndex++; imageIndex < imageCount; imageIndex = state.nextImageIndex++)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+
+        DecodedImage decodedImage;
+        decodedImage.imageIndex = imageIndex;
+        bool isDecoded;
+        {
+            PROFILE_SCOPE("decode");
+            isDecoded = LoadImageFile(state.imagePaths[imageIndex].string(), &decodedImage.image);
+        }
+
+        m_decodeNanoseconds += GetElapsedNanoseconds(startTime);
+
+        if (!isDecoded)
+        {
+            recordFailure(state, imageIndex, "decoding failed");
+            continue;
+        }
+
+        state.decodedQueue.push(std::move(decodedImage));
+    }
+
+    if (--state.runningDecodeWorkers == 0)
+        state.decodedQueue.close();
+}
+
+// submits every decoded image to the scheduler of the CPU effect manager, where its effect chains run as a task.
+// images are admitted while fewer than the effect worker count and the pixel budget are in flight, the thread helps
+// with the queued tasks while it waits for room and for the last images
+void ImagePipeline::effectWorker(RunState& state)
+{
+    DecodedImage decodedImage;
+
+    while (state.decodedQueue.pop(&decodedImage))
+    {
+        long long pixelCount = static_cast<long long>(decodedImage.image.getView().getWidth()) * decodedImage.image.getView().getHeight();
+
+        waitForEffectJobs(state, [&]() {
+            return state.runningEffectJobs == 0 ||
+                   (state.runningEffectJobs < m_effectWorkerCount && state.effectPixelsInFlight + pixelCount <= MAX_EFFECT_PIXELS_IN_FLIGHT);
+        });
+
+        {
+            std::lock_guard<std::mutex> lock(state.effectJobsMutex);
+            state.runningEffectJobs++;
+            state.effectPixelsInFlight += pixelCount;
+        }
+
+        std::shared_ptr<DecodedImage> job = std::make_shared<DecodedImage>(std::move(decodedImage));
+        m_cpuManager->submit([this, &state, job, pixelCount]() {
+            applyEffectChains(state, *job);
+
+            // release the source image before letting the next one in
+            job->image = Image();
+
+            std::lock_guard<std::mutex> lock(state.effectJobsMutex);
+            state.runningEffectJobs--;
+            state.effectPixelsInFlight -= pixelCount;
+            state.effectJobsCondition.notify_all();
+        });
+    }
+
+    waitForEffectJobs(state, [&]() { return state.runningEffectJobs == 0; });
+    state.processedQueue.close();
+}
+
+// a queued task may be the bands of a running image or a whole image, both bring the wait closer to its end
+void ImagePipeline::waitForEffectJobs(RunState& state, const std::function<bool()>& isDone)
+{
+    std::unique_lock<std::mutex> lock(state.effectJobsMutex);
+
+    while (!isDone())
+    {
+        lock.unlock();
+        bool isTaskRun = m_cpuManager->runQueuedTask();
+        lock.lock();
+
+        if (!isTaskRun && !isDone())
+            state.effectJobsCondition.wait(lock);
+    }
+}
+
+// applies every effect chain on a copy of the decoded image
+void ImagePipeline::applyEffectChains(RunState& state, const DecodedImage& decodedImage)
+{
+    const ImageView& source = decodedImage.image.getView();
+
+    for (size_t chainIndex = 0; chainIndex < state.chains.size(); ++chainIndex)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+
+        ProcessedImage processedImage;
+        processedImage.imageIndex = decodedImage.imageIndex;
+        processedImage.chainIndex = static_cast<int>(chainIndex);
+
+        const EffectChain& chain = state.chains[chainIndex];
+        chain.GetOutputDimensions(source.getWidth(), source.getHeight(), &processedImage.width, &processedImage.height);
+
+        string effectError;
+        bool isEffectApplied;
+        {
+            PROFILE_SCOPE("effectChain");
+            processedImage.image = Image(source.getWidth(), source.getHeight(), source.getChannels());
+            source.copyTo(processedImage.image.getView());
+            isEffectApplied = chain.ApplyEffectChainOnImage(processedImage.image.getView(), m_cpuManager, &effectError);
+        }
+
+        m_effectNanoseconds += GetElapsedNanoseconds(startTime);
+
+        if (!isEffectApplied)
+        {
+            recordFailure(state, decodedImage.imageIndex, chain.GetEffectChainFileSuffix() + ": " + effectError);
+            continue;
+        }
+
+        m_processedPixelCount += static_cast<long long>(source.getWidth()) * source.getHeight();
+        state.processedQueue.push(std::move(processedImage));
+    }
+}
+
+// encodes the processed images into the output folder
+void ImagePipeline::encodeWorker(RunState& state)
+{
+    ProcessedImage processedImage;
+
+    while (state.processedQueue.pop(&processedImage))
+    {
+        auto startTime = std::chrono::steady_clock::now();
+        PROFILE_SCOPE("encode");
+
+        const path& imagePath = state.imagePaths[processedImage.imageIndex];
+        const EffectChain& chain = state.chains[processedImage.chainIndex];
+        string newFileName = imagePath.stem().string() + "_" + chain.GetEffectChainFileSuffix() + imagePath.extension().string();
+        path outputPath = state.outputDir / newFileName;
+
+        bool success = WritePngFile(outputPath.string(), processedImage.image.getView().getRegion(0, 0, processedImage.width, processedImage.height));
+
+        m_encodeNanoseconds += GetElapsedNanoseconds(startTime);
+
+        if (!success)
+        {
+            recordFailure(state, processedImage.imageIndex, chain.GetEffectChainFileSuffix() + ": encoding failed");
+            continue;
+        }
+
+        m_writtenImageCount++;
+        if (--state.remainingOutputCounts[processedImage.imageIndex] == 0)
+            m_processedImageCount++;
+    }
+}
+
+void ImagePipeline::recordFailure(RunState& state, int imageIndex, const string& failure)
+{
+    std::lock_guard<std::mutex> lock(m_failuresMutex);
+    m_failures.push_back(state.imagePaths[imageIndex].filename().string() + ": " + failure);
+}
+
+int ImagePipeline::getProcessedImageCount() const
+{
+    return m_processedImageCount;
+}
+
+int ImagePipeline::getWrittenImageCount() const
+{
+    return m_writtenImageCount;
+}
+
+long long ImagePipeline::getProcessedPixelCount() const
+{
+    return m_processedPixelCount;
+}
+
+const vector<string>& ImagePipeline::getFailures() const
+{
+    return m_failures;
+}
+
+double ImagePipeline::getDecodeSeconds() const
+{
+    return m_decodeNanoseconds / 1e9;
+}
+
+double ImagePipeline::getEffectSeconds() const
+{
+    return m_effectNanoseconds / 1e9;
+}
+
+double ImagePipeline::getEncodeSeconds() const
+{
+    return m_encodeNanoseconds / 1e9;
+}
+
+int ImagePipeline::getDecodeWorkerCount() const
+{
+    return m_decodeWorkerCount;
+}
+
+int ImagePipeline::getEffectWorkerCount() const
+{
+    return m_effectWorkerCount;
+}
+
+int ImagePipeline::getEncodeWorkerCount() const
+{
+    return m_encodeWorkerCount;
+}
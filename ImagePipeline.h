@@ -0,0 +1,145 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "BoundedQueue.h"
+#include "EffectChain.h"
+#include "Image.h"
+
+using std::string;  // Make string available as 'string'
+using std::vector;  // Make vector available as 'vector'
+using std::filesystem::path;
+
+/**
+ * Number of workers of each stage of the pipeline and capacity of the queues between them, 0 picks a default.
+ * The effect workers are the images the effect stage processes at once, as tasks of the CPU effect manager.
+ */
+struct ImagePipelineOptions {
+    int decodeWorkerCount = 0;
+    int effectWorkerCount = 0;
+    int encodeWorkerCount = 0;
+    int queueCapacity = 0;
+};
+
+/**
+ * ImagePipeline processes a list of images in three overlapped stages connected by bounded queues :
+ * decode workers load the PNGs, the effect stage submits each image to the work-stealing scheduler of the
+ * CPU effect manager, where a task applies every effect chain on a copy of it while idle threads steal its
+ * bands and tiles, and encode workers write the results back to disk.
+ * Each stage runs while the others wait on I/O or on each other, so the total time approaches the time
+ * of the slowest stage rather than the sum of all of them. The queues bound the number of images in memory.
+ */
+class ImagePipeline {
+public:
+    /**
+     * Creates the pipeline.
+     *
+     * @param cpuManagerRef The initialized CPU effect manager the effects are applied with.
+     * @param options Worker counts of the stages and capacity of the queues.
+     */
+    ImagePipeline(CpuEffectManager* cpuManagerRef, const ImagePipelineOptions& options);
+
+    /**
+     * Processes all the images and waits for the last one to be written.
+     * Output images are named after the source image and the suffix of the effect chain.
+     *
+     * @param imagePaths The images to process.
+     * @param chains The effect chains to apply on every image, each one producing its own output image.
+     * @param outputDir The folder the output images are written to, created if needed.
+     * @return true if every output image was written, false otherwise.
+     */
+    bool run(const vector<path>& imagePaths, const vector<EffectChain>& chains, const path& outputDir);
+
+    /**
+     * Returns the number of images all the effect chains were applied to and written.
+     */
+    int getProcessedImageCount() const;
+
+    /**
+     * Returns the number of output images written.
+     */
+    int getWrittenImageCount() const;
+
+    /**
+     * Returns the number of source pixels processed by the effect chains, counted once per chain.
+     */
+    long long getProcessedPixelCount() const;
+
+    /**
+     * Returns a description of every failure of the last run.
+     */
+    const vector<string>& getFailures() const;
+
+    /**
+     * Returns the time the workers of a stage were busy during the last run, summed over the workers of the stage.
+     */
+    double getDecodeSeconds() const;
+    double getEffectSeconds() const;
+    double getEncodeSeconds() const;
+
+    /**
+     * Returns the number of workers of each stage.
+     */
+    int getDecodeWorkerCount() const;
+    int getEffectWorkerCount() const;
+    int getEncodeWorkerCount() const;
+
+private:
+    // a decoded source image in the buffer of stb_image, shared by all the effect chains applied on it
+    struct DecodedImage {
+        int imageIndex = 0;
+        Image image;
+    };
+
+    // the result of an effect chain in the top left width x height region of its aligned copy of the source, waiting to be encoded
+    struct ProcessedImage {
+        int imageIndex = 0;
+        int chainIndex = 0;
+        Image image;
+        int width = 0;
+        int height = 0;
+    };
+
+    // state of a single run, shared by the workers of all the stages
+    struct RunState;
+
+    void decodeWorker(RunState& state);
+    void effectWorker(RunState& state);
+    void encodeWorker(RunState& state);
+
+    /**
+     * Runs queued tasks of the CPU effect manager, or sleeps, until isDone returns true. isDone is called with the lock of the effect jobs.
+     */
+    void waitForEffectJobs(RunState& state, const std::function<bool()>& isDone);
+
+    /**
+     * Applies every effect chain on a copy of a decoded image and queues the results for encoding.
+     */
+    void applyEffectChains(RunState& state, const DecodedImage& decodedImage);
+
+    /**
+     * Records a failure of the image, which is then not counted as processed.
+     */
+    void recordFailure(RunState& state, int imageIndex, const string& failure);
+
+    CpuEffectManager* m_cpuManager;
+    int m_decodeWorkerCount;
+    int m_effectWorkerCount;
+    int m_encodeWorkerCount;
+    int m_queueCapacity;
+
+    std::atomic<int> m_processedImageCount{ 0 };
+    std::atomic<int> m_writtenImageCount{ 0 };
+    std::atomic<long long> m_processedPixelCount{ 0 };
+    std::atomic<long long> m_decodeNanoseconds{ 0 };
+    std::atomic<long long> m_effectNanoseconds{ 0 };
+    std::atomic<long long> m_encodeNanoseconds{ 0 };
+    std::mutex m_failuresMutex;
+    vector<string> m_failures;
+};
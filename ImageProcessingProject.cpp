@@ -1,26 +1,29 @@
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <sstream>
 #include <vector>
 #include <string>
+#ifdef _WIN32
 #include <windows.h>  // Required for Windows console functions
+#endif
 #include <filesystem>
 
+#include "BufferPool.h"
 #include "Effect.h"
-
-// used for decoding PNG
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-
-// used for encoding PNG
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
+#include "EffectCache.h"
+#include "EffectChain.h"
+#include "ImagePipeline.h"
+#include "Image.h"
+#include "Profiler.h"
 
 using std::string;  // Make string available as 'string'
 using std::vector;  // Make vector available as 'vector'
 using std::filesystem::path;
 namespace fs = std::filesystem;
 
-#define INPUT_IMAGES_FOLDER_PATH "../inputPNG";
-#define OUTPUT_IMAGES_FOLDER_PATH "../outputPNG";
+#define INPUT_IMAGES_FOLDER_PATH "../inputPNG"
+#define OUTPUT_IMAGES_FOLDER_PATH "../outputPNG"
 
 #define WELCOME_MESSAGE "Welcome to the PNG Processing Application!\n"\
                         "This application allows you to apply effects to images.\n"\
@@ -40,12 +43,86 @@ namespace fs = std::filesystem;
 #define ENDING_MESSAGE_ERORR "Image processing failed...\n"\
                              "Press ENTER to create a new image or press ESC to close application.\n"
 
-ShaderManager* m_shaderManager = new ShaderManager();
+#define CPU_BACKEND_ARGUMENT "--cpu"
+
+// runs the HLSL shaders of the effects on the CPU shader engine instead of their CPU kernels, implies the CPU backend
+#define CPU_SHADERS_ARGUMENT "--cpu-shaders"
+
+// profiling arguments, --profile prints the time spent in each stage on exit and --trace also writes a Chrome trace file
+#define PROFILE_ARGUMENT "--profile"
+#define TRACE_ARGUMENT "--trace"
+
+// batch mode arguments, batch mode always runs on the CPU backend
+#define BATCH_MODE_ARGUMENT "--batch"
+#define INPUT_FOLDER_ARGUMENT "--input"
+#define OUTPUT_FOLDER_ARGUMENT "--output"
+#define EFFECTS_ARGUMENT "--effects"
+#define THREADS_ARGUMENT "--threads"
+#define DECODE_THREADS_ARGUMENT "--decode-threads"
+#define EFFECT_THREADS_ARGUMENT "--effect-threads"
+#define ENCODE_THREADS_ARGUMENT "--encode-threads"
+#define QUEUE_SIZE_ARGUMENT "--queue-size"
+#define POOL_SIZE_ARGUMENT "--pool-size"
+
+// prints the parameters of every effect and exits
+#define LIST_PARAMETERS_ARGUMENT "--list-parameters"
+
+// effects in the effects argument are separated by commas, effects joined by '+' are applied one after the other
+#define EFFECT_LIST_SEPARATOR ','
+#define EFFECT_CHAIN_SEPARATOR '+'
+#define ALL_EFFECTS_NAME "all"
+
+// effects ending with this extension are HLSL pixel shader files, run by a ShaderFileEffect
+#define SHADER_FILE_EXTENSION ".hlsl"
+
+// parameters follow their effect as effect:name=value:name=value
+#define EFFECT_PARAMETER_SEPARATOR ':'
+#define EFFECT_PARAMETER_VALUE_SEPARATOR '='
+
+#define BATCH_USAGE_MESSAGE "Usage: ImageProcessingProject --batch [--input <folder>] [--output <folder>]\n"\
+                            "                              [--effects <effect,effect+effect,...|all>] [--threads <count>]\n"\
+                            "                              [--decode-threads <count>] [--effect-threads <count>]\n"\
+                            "                              [--encode-threads <count>] [--queue-size <images>]\n"\
+                            "                              [--pool-size <MB>]\n"\
+                            "                              [--cpu-shaders] [--profile] [--trace <file>] [--list-parameters]\n"\
+                            "Effects: blur, inverted, mirror, shrink, downscale, edges, equalize, histeq, histeqchannels, histeqluma,\n"\
+                            "         gamma, levels, threshold, waves, fisheye.\n"\
+                            "Effects joined by '+' are applied one after the other into a single output image.\n"\
+                            "Effect parameters are set as effect:name=value:name=value, --list-parameters lists them.\n"\
+                            "An effect may also be an HLSL pixel shader file, like shaders/MyEffect.hlsl.\n"\
+                            "--cpu-shaders runs the HLSL shaders of the effects on the CPU instead of their CPU kernels.\n"
+
+#ifdef _WIN32
+// created when effects run on the GPU backend
+ShaderManager* m_shaderManager = nullptr;
+#endif
+
+// set when effects run on the CPU backend instead of the GPU
+CpuEffectManager* m_cpuManager = nullptr;
+
+// creates every effect with its default parameters
+static vector<BaseEffect*> CreateEffects() {
+    return {
+        new BlurEffect(),
+        new ColorInversionEffect(),
+        new MirrorEffect(),
+        new ShrinkEffect(),
+        new ShrinkEffect(DEFAULT_SHRINK_FACTOR, false),
+        new EdgeDetectionEffect(),
+        new EqualizationEffect(),
+        new EqualizationEffect(EqualizationMode::Global),
+        new EqualizationEffect(EqualizationMode::PerChannel),
+        new EqualizationEffect(EqualizationMode::Luma),
+        new GammaEffect(),
+        new LevelsEffect(),
+        new ThresholdEffect(),
+        new WavesEffect(),
+        new FishEyeEffect()
+    };
+}
 
 // initailizes the lists of effects and images
-static void InitializeLists(vector<path>& images, vector<BaseEffect*>& effects) {
-
-    string inputImagesPath = INPUT_IMAGES_FOLDER_PATH;
+static void InitializeLists(const path& inputImagesPath, vector<path>& images, vector<BaseEffect*>& effects) {
 
     // Clear any existing entries in images
     images.clear();
@@ -61,20 +138,12 @@ static void InitializeLists(vector<path>& images, vector<BaseEffect*>& effects)
         it++;
     }
 
-    // Initialize effects
-    effects = {
-        new BlurEffect(),
-        new ColorInversionEffect(),
-        new MirrorEffect(),
-        new ShrinkEffect(),
-        new EdgeDetectionEffect(),
-        new EqualizationEffect(),
-        new WavesEffect()
-    };
+    effects = CreateEffects();
 
 }
 
 
+#ifdef _WIN32
 // displays options menu with one highlighted option
 static void DisplayMenu(const vector<string>& options, int highlight, const string& instruction) 
 {
@@ -213,10 +282,35 @@ static bool PromptEndingScreen(bool isSuccess) {
     }
 }
 
+#endif
+
+#ifdef _WIN32
+// writes the manipulated image to the output folder, named after the source image and the effect suffix
+static bool WriteOutputImage(const path& imagePath, const string& effectSuffix, const path& outputDir, const ImageView& image) {
+
+    // Construct the output file name/path
+    path fileName = imagePath.stem();
+    string newFileName = fileName.string() + "_" + effectSuffix + imagePath.extension().string();
+    path outputPath = outputDir / newFileName;
+
+    // Ensure the output directory exists
+    std::error_code directoryError;
+    fs::create_directories(outputDir, directoryError);
+
+    // encodes the manipulated PNG back to disk
+    PROFILE_SCOPE("encode");
+    bool success = WritePngFile(outputPath.string(), image);
+
+    if (!success) {
+        std::cout << "Error saving image: " << outputPath << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
 // applies the seceted effect to the selected image
 static bool ApplyEffectToImage(path imagePath, BaseEffect* effect) {
-    int width, height, channels;
-    
 
     if (!fs::exists(imagePath)){
         std::cout << "Invalid image path: " << imagePath << std::endl;
@@ -224,44 +318,36 @@ static bool ApplyEffectToImage(path imagePath, BaseEffect* effect) {
     }
 
     // decode the PNG
-    unsigned char* imageData = stbi_load(imagePath.string().c_str(), &width, &height, &channels, 0);
+    Image image;
+    bool isDecoded;
+    {
+        PROFILE_SCOPE("decode");
+        isDecoded = LoadImageFile(imagePath.string(), &image);
+    }
   
-    if (!imageData) {
+    if (!isDecoded) {
         std::cout << "Error loading image: " << imagePath << std::endl;
         return false;
     }
 
     string* effectError = new string("OK");
 
-    // Apply Effect on imageData
-    if (!effect->ApplyEffectFromRawImageData(imageData, width, height, channels, m_shaderManager, effectError))
+    // Apply Effect on the image, on the selected backend
+    const ImageView& imageView = image.getView();
+    bool isEffectApplied = m_cpuManager ?
+        effect->ApplyEffectOnImage(imageView, m_cpuManager, effectError) :
+        effect->ApplyEffectOnImage(imageView, m_shaderManager, effectError);
+
+    if (!isEffectApplied)
     {
         std::cout << "Error applying effect to image data: /n" << *effectError << std::endl;
         return false;
     }
-    
-    // Construct the output file name/path
-    path outputDir = OUTPUT_IMAGES_FOLDER_PATH; 
-    path fileName = imagePath.stem();
-    string newFileName = fileName.string() + "_" + effect->GetEffectFileSuffix() + imagePath.extension().string();
-    path outputPath = outputDir / newFileName;
-
-    // Ensure the output directory exists
-    create_directories(outputDir);
-
-    // encodes the manipulated PNG back to disk
-    int success = stbi_write_png(outputPath.string().c_str(), width, height, channels, imageData, width * channels);
-
-    if (!success) {
-        std::cout << "Error saving image: " << outputPath << std::endl;
-        stbi_image_free(imageData);
-        return false;
-    }
 
-    // Free the image memory
-    stbi_image_free(imageData);
-
-    return true;
+    // the image memory is freed with the image
+    int outputWidth, outputHeight;
+    effect->GetOutputDimensions(imageView.getWidth(), imageView.getHeight(), &outputWidth, &outputHeight);
+    return WriteOutputImage(imagePath, effect->GetEffectFileSuffix(), OUTPUT_IMAGES_FOLDER_PATH, imageView.getRegion(0, 0, outputWidth, outputHeight));
 }
 
 // striginfy the image names
@@ -285,23 +371,385 @@ static vector<string> convertEffectsToStrings(vector<BaseEffect*> Effects) {
 
     return effectNames;
 }
+#endif
+
+// initializes the CPU backend, used when requested or when no Direct3D device is available
+static bool InitializeCpuBackend(int threadCount, string* out_error) {
+    m_cpuManager = new CpuEffectManager();
+    return m_cpuManager->initializeCpuEffectManager(threadCount, out_error);
+}
+
+// options of a batch run, parsed from the command line
+struct BatchOptions {
+    path inputFolder = INPUT_IMAGES_FOLDER_PATH;
+    path outputFolder = OUTPUT_IMAGES_FOLDER_PATH;
+    string effectList = ALL_EFFECTS_NAME;
+    int threadCount = 0;
+    long long bufferPoolMegabytes = -1;  // idle buffers the buffer pool keeps, -1 for its default
+    bool isShaderEmulationEnabled = false;
+    ImagePipelineOptions pipelineOptions;
+};
+
+// parses a count argument, 0 meaning the default
+static bool ParseCountArgument(const string& value, int* out_count) {
+    char* valueEnd = nullptr;
+    long count = std::strtol(value.c_str(), &valueEnd, 10);
+    if (value.empty() || *valueEnd != '\0' || count < 0 || count > 1024)
+        return false;
+
+    *out_count = static_cast<int>(count);
+    return true;
+}
+
+// parses the batch mode arguments, returns false on an unknown argument or a missing value
+static bool ParseBatchOptions(int argc, char* argv[], BatchOptions* out_options, string* out_error) {
+
+    for (int i = 1; i < argc; ++i) {
+        string argument = argv[i];
+
+        if (argument == BATCH_MODE_ARGUMENT || argument == CPU_BACKEND_ARGUMENT || argument == PROFILE_ARGUMENT || argument == LIST_PARAMETERS_ARGUMENT)
+            continue;
+
+        if (argument == CPU_SHADERS_ARGUMENT) {
+            out_options->isShaderEmulationEnabled = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            *out_error = "Missing value for argument " + argument;
+            return false;
+        }
+
+        string value = argv[++i];
+
+        if (argument == TRACE_ARGUMENT) {
+            continue;
+        }
+        else if (argument == INPUT_FOLDER_ARGUMENT) {
+            out_options->inputFolder = value;
+        }
+        else if (argument == OUTPUT_FOLDER_ARGUMENT) {
+            out_options->outputFolder = value;
+        }
+        else if (argument == EFFECTS_ARGUMENT) {
+            out_options->effectList = value;
+        }
+        else if (argument == THREADS_ARGUMENT || argument == DECODE_THREADS_ARGUMENT || argument == EFFECT_THREADS_ARGUMENT ||
+                 argument == ENCODE_THREADS_ARGUMENT || argument == QUEUE_SIZE_ARGUMENT) {
+            int* count = &out_options->threadCount;
+            if (argument == DECODE_THREADS_ARGUMENT)
+                count = &out_options->pipelineOptions.decodeWorkerCount;
+            else if (argument == EFFECT_THREADS_ARGUMENT)
+                count = &out_options->pipelineOptions.effectWorkerCount;
+            else if (argument == ENCODE_THREADS_ARGUMENT)
+                count = &out_options->pipelineOptions.encodeWorkerCount;
+            else if (argument == QUEUE_SIZE_ARGUMENT)
+                count = &out_options->pipelineOptions.queueCapacity;
+
+            if (!ParseCountArgument(value, count)) {
+                *out_error = "Invalid count for " + argument + ": " + value;
+                return false;
+            }
+        }
+        else if (argument == POOL_SIZE_ARGUMENT) {
+            char* valueEnd = nullptr;
+            out_options->bufferPoolMegabytes = std::strtoll(value.c_str(), &valueEnd, 10);
+            if (value.empty() || *valueEnd != '\0' || out_options->bufferPoolMegabytes < 0 || out_options->bufferPoolMegabytes > 1048576) {
+                *out_error = "Invalid size for " + argument + ": " + value;
+                return false;
+            }
+        }
+        else {
+            *out_error = "Unknown argument " + argument;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// parses a parameter value, booleans may also be written true or false
+static bool ParseParameterValue(const string& value, float* out_value) {
+    if (value == "true" || value == "false") {
+        *out_value = value == "true" ? 1.0f : 0.0f;
+        return true;
+    }
+
+    char* valueEnd = nullptr;
+    *out_value = std::strtof(value.c_str(), &valueEnd);
+    return !value.empty() && *valueEnd == '\0';
+}
+
+// looks an effect up by its file suffix. an effect with parameters is a copy of it with the parameters set, added to the effects.
+// a shader file is a new effect of its own, added to the effects, and has no parameters
+static BaseEffect* ParseEffect(const string& effectToken, vector<BaseEffect*>* effects, string* out_error) {
+    string shaderFileExtension = SHADER_FILE_EXTENSION;
+    if (effectToken.size() > shaderFileExtension.size() && effectToken.compare(effectToken.size() - shaderFileExtension.size(), string::npos, shaderFileExtension) == 0) {
+        if (!fs::is_regular_file(effectToken)) {
+            *out_error = "Shader file not found: " + effectToken;
+            return nullptr;
+        }
+
+        BaseEffect* shaderFileEffect = new ShaderFileEffect(effectToken);
+        effects->push_back(shaderFileEffect);
+        return shaderFileEffect;
+    }
+
+    std::stringstream tokenStream(effectToken);
+    string effectName;
+    std::getline(tokenStream, effectName, EFFECT_PARAMETER_SEPARATOR);
+
+    BaseEffect* foundEffect = nullptr;
+    for (BaseEffect* effect : *effects) {
+        if (effect->GetEffectFileSuffix() == effectName && effect->GetParameterSuffix().empty()) {
+            foundEffect = effect;
+            break;
+        }
+    }
+
+    if (!foundEffect) {
+        *out_error = "Unknown effect: " + effectName;
+        return nullptr;
+    }
+
+    string parameterToken;
+    BaseEffect* parameterizedEffect = nullptr;
+
+    while (std::getline(tokenStream, parameterToken, EFFECT_PARAMETER_SEPARATOR)) {
+        size_t valueSeparator = parameterToken.find(EFFECT_PARAMETER_VALUE_SEPARATOR);
+        float value;
+        if (valueSeparator == string::npos || !ParseParameterValue(parameterToken.substr(valueSeparator + 1), &value)) {
+            *out_error = "Invalid parameter " + parameterToken + " of effect " + effectName;
+            delete parameterizedEffect;
+            return nullptr;
+        }
+
+        if (!parameterizedEffect)
+            parameterizedEffect = foundEffect->CloneEffect();
+
+        if (!parameterizedEffect->SetParameter(parameterToken.substr(0, valueSeparator), value, out_error)) {
+            delete parameterizedEffect;
+            return nullptr;
+        }
+    }
+
+    if (!parameterizedEffect)
+        return foundEffect;
+
+    effects->push_back(parameterizedEffect);
+    return parameterizedEffect;
+}
+
+// splits the effect list into chains of effects, looked up by their file suffix
+static bool ParseEffectChains(const string& effectList, vector<BaseEffect*>* effects, vector<EffectChain>* out_chains, string* out_error) {
+
+    if (effectList == ALL_EFFECTS_NAME) {
+        for (BaseEffect* effect : *effects)
+            out_chains->push_back(EffectChain({ effect }));
+        return true;
+    }
+
+    std::stringstream listStream(effectList);
+    string chainName;
+
+    while (std::getline(listStream, chainName, EFFECT_LIST_SEPARATOR)) {
+        std::stringstream chainStream(chainName);
+        string effectToken;
+        vector<BaseEffect*> chainEffects;
+
+        while (std::getline(chainStream, effectToken, EFFECT_CHAIN_SEPARATOR)) {
+            BaseEffect* effect = ParseEffect(effectToken, effects, out_error);
+            if (!effect)
+                return false;
+            chainEffects.push_back(effect);
+        }
+
+        if (chainEffects.empty()) {
+            *out_error = "Empty effect in list: " + effectList;
+            return false;
+        }
+        out_chains->push_back(EffectChain(chainEffects));
+    }
+
+    if (out_chains->empty()) {
+        *out_error = "No effects requested";
+        return false;
+    }
+
+    return true;
+}
+
+// prints the parameters of every effect, with their type, range and default value
+static void PrintEffectParameters() {
+    const char* typeNames[] = { "float", "integer", "boolean" };
+
+    for (BaseEffect* effect : CreateEffects()) {
+        vector<EffectParameter> parameters = effect->GetParameters();
+        std::cout << effect->GetEffectFileSuffix() << (parameters.empty() ? ": no parameters" : ":") << std::endl;
+
+        for (const EffectParameter& parameter : parameters) {
+            std::cout << "    " << parameter.name << " (" << typeNames[static_cast<int>(parameter.type)] << ", " << parameter.minValue
+                      << " to " << parameter.maxValue << ", default " << parameter.defaultValue << ")" << std::endl;
+        }
+        delete effect;
+    }
+}
+
+// processes every image of the input folder with every requested effect, without any console UI.
+// decoding, effects and encoding run as overlapped stages of the image pipeline, and the images and their
+// bands are spread over the threads of the CPU backend by its scheduler
+static int RunBatchMode(int argc, char* argv[]) {
+
+    string errorString;
+    BatchOptions options;
+
+    if (!ParseBatchOptions(argc, argv, &options, &errorString)) {
+        std::cout << "ERROR: " << errorString << std::endl << BATCH_USAGE_MESSAGE;
+        return -1;
+    }
+
+    if (!fs::is_directory(options.inputFolder)) {
+        std::cout << "ERROR: Invalid input folder: " << options.inputFolder << std::endl;
+        return -1;
+    }
+
+    vector<path> imagePaths;
+    vector<BaseEffect*> effects;
+    InitializeLists(options.inputFolder, imagePaths, effects);
+
+    vector<EffectChain> chains;
+    if (!ParseEffectChains(options.effectList, &effects, &chains, &errorString)) {
+        std::cout << "ERROR: " << errorString << std::endl << BATCH_USAGE_MESSAGE;
+        return -1;
+    }
+
+    if (!InitializeCpuBackend(options.threadCount, &errorString)) {
+        std::cout << "ERROR: " << errorString << std::endl;
+        return -1;
+    }
+
+    m_cpuManager->setShaderEmulation(options.isShaderEmulationEnabled);
+
+    if (options.bufferPoolMegabytes >= 0)
+        BufferPool::getInstance().setCapacity(static_cast<size_t>(options.bufferPoolMegabytes) << 20);
+
+    ImagePipeline pipeline(m_cpuManager, options.pipelineOptions);
+    auto startTime = std::chrono::steady_clock::now();
+
+    bool isSuccess = pipeline.run(imagePaths, chains, options.outputFolder);
+
+    double elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    for (const string& failure : pipeline.getFailures())
+        std::cout << "FAILED " << failure << std::endl;
+
+    std::cout << "Processed " << pipeline.getProcessedImageCount() << " of " << imagePaths.size() << " images with "
+              << chains.size() << " effects on " << m_cpuManager->getThreadCount() << " threads." << std::endl;
+    std::cout << "Wrote " << pipeline.getWrittenImageCount() << " images, " << pipeline.getFailures().size() << " failures, in "
+              << elapsedSeconds << " s (" << (elapsedSeconds > 0 ? pipeline.getProcessedPixelCount() / elapsedSeconds / 1e6 : 0.0)
+              << " MP/s)." << std::endl;
+    std::cout << "Stage busy time: decode " << pipeline.getDecodeSeconds() << " s on " << pipeline.getDecodeWorkerCount()
+              << " workers, effects " << pipeline.getEffectSeconds() << " s on " << pipeline.getEffectWorkerCount()
+              << " workers, encode " << pipeline.getEncodeSeconds() << " s on " << pipeline.getEncodeWorkerCount() << " workers." << std::endl;
+
+    BufferPoolStats poolStats = BufferPool::getInstance().getStats();
+    std::cout << "Buffer pool: " << poolStats.hitCount << " of " << poolStats.acquireCount << " buffers reused ("
+              << (poolStats.acquireCount > 0 ? 100.0 * poolStats.hitCount / poolStats.acquireCount : 0.0) << "%), peak "
+              << poolStats.peakBytes / 1e6 << " MB." << std::endl;
+
+    return isSuccess ? 0 : 1;
+}
+
+// enables the profiler when requested, and returns the path of the trace file to write, if any
+static string InitializeProfiler(int argc, char* argv[]) {
+    string tracePath;
+
+    for (int i = 1; i < argc; ++i) {
+        string argument = argv[i];
+        if (argument == PROFILE_ARGUMENT) {
+            Profiler::getInstance().setEnabled(true);
+        }
+        else if (argument == TRACE_ARGUMENT && i + 1 < argc) {
+            Profiler::getInstance().setEnabled(true);
+            tracePath = argv[++i];
+        }
+    }
+
+    return tracePath;
+}
+
+// prints the time spent in each stage and the hits of the effect cache, and writes the trace file, when profiling
+static void ReportProfiler(const string& tracePath) {
+    if (!Profiler::getInstance().isEnabled())
+        return;
+
+    Profiler::getInstance().printSummary(std::cout);
+    EffectCache::getInstance().printSummary(std::cout);
+
+    string traceError;
+    if (!tracePath.empty() && Profiler::getInstance().writeChromeTrace(tracePath, &traceError))
+        std::cout << "Trace written to " << tracePath << std::endl;
+}
 
 // the entry point of the application
-int main() {
+int main(int argc, char* argv[]) {
+
+    string tracePath = InitializeProfiler(argc, argv);
+
+    for (int i = 1; i < argc; ++i) {
+        if (string(argv[i]) == LIST_PARAMETERS_ARGUMENT) {
+            PrintEffectParameters();
+            return 0;
+        }
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        if (string(argv[i]) == BATCH_MODE_ARGUMENT) {
+            int exitCode = RunBatchMode(argc, argv);
+            ReportProfiler(tracePath);
+            return exitCode;
+        }
+    }
 
+#ifdef _WIN32
     string* errorString = new string("OK");
 
-    // init shader manager
-    m_shaderManager = new ShaderManager();
-    if (!m_shaderManager->initalizeShaderManager(errorString))
+    bool isCpuBackendRequested = false;
+    bool isShaderEmulationRequested = false;
+    for (int i = 1; i < argc; ++i) {
+        if (string(argv[i]) == CPU_BACKEND_ARGUMENT)
+            isCpuBackendRequested = true;
+        if (string(argv[i]) == CPU_SHADERS_ARGUMENT)
+            isShaderEmulationRequested = true;
+    }
+
+    if (isCpuBackendRequested || isShaderEmulationRequested)
     {
-        std::cout << "ERROR: "  << errorString;
-        return -1;
+        if (!InitializeCpuBackend(0, errorString))
+        {
+            std::cout << "ERROR: " << *errorString;
+            return -1;
+        }
+        m_cpuManager->setShaderEmulation(isShaderEmulationRequested);
+    }
+    else
+    {
+        // init shader manager, fall back to the CPU backend without a GPU
+        m_shaderManager = new ShaderManager();
+        if (!m_shaderManager->initalizeShaderManager(errorString))
+        {
+            std::cout << "Direct3D is unavailable, effects will run on the CPU." << std::endl;
+            if (!InitializeCpuBackend(0, errorString))
+            {
+                std::cout << "ERROR: " << *errorString;
+                return -1;
+            }
+        }
     }
 
     vector<path> imagePaths;
     vector<BaseEffect*> effects;
-    InitializeLists(imagePaths, effects);
+    InitializeLists(INPUT_IMAGES_FOLDER_PATH, imagePaths, effects);
 
     // prompt welcome screen on start
     PromptWelcomeScreen();
@@ -322,5 +770,12 @@ int main() {
         resumeAppFlag = PromptEndingScreen(isSuccess);
     }
 
+    ReportProfiler(tracePath);
+
     return 1;
+#else
+    // the interactive menus use the Windows console, other platforms only have the batch mode
+    std::cout << BATCH_USAGE_MESSAGE;
+    return -1;
+#endif
 }
@@ -0,0 +1,73 @@
+#include "PixelFormat.h"
+#include <cstring>
+
+// value of channel c of an RGBA pixel for a source pixel of the given channel count
+template <int Channels>
+static inline unsigned char GetRgbaValue(const unsigned char* pixel, int c)
+{
+    if (Channels == 4)
+        return pixel[c];
+    if (c == 3)
+        return (Channels == 2) ? pixel[1] : 255;
+    return (Channels == 3) ? pixel[c] : pixel[0];
+}
+
+template <int Channels>
+static void ExpandPixels(const unsigned char* sourceData, unsigned char* rgbaData, size_t pixelCount)
+{
+    for (size_t p = 0; p < pixelCount; ++p)
+    {
+        const unsigned char* pixel = sourceData + p * Channels;
+        for (int c = 0; c < 4; ++c)
+            rgbaData[p * 4 + c] = GetRgbaValue<Channels>(pixel, c);
+    }
+}
+
+// the gray of 1 and 2 channel images is read back from red, their alpha from alpha
+template <int Channels>
+static void PackPixels(const unsigned char* rgbaData, unsigned char* targetData, int pixelCount)
+{
+    for (int p = 0; p < pixelCount; ++p)
+    {
+        const unsigned char* rgba = rgbaData + p * 4;
+        for (int c = 0; c < Channels; ++c)
+            targetData[p * Channels + c] = (Channels == 2 && c == 1) ? rgba[3] : rgba[c];
+    }
+}
+
+void ExpandPixelsToRgba(const ImageView& source, unsigned char* rgbaData)
+{
+    int width = source.getWidth();
+    size_t rgbaRowSize = static_cast<size_t>(width) * 4;
+
+    DispatchChannelCount(source.getChannels(), [&](auto channelCount) {
+        constexpr int Channels = decltype(channelCount)::value;
+
+        for (int y = 0; y < source.getHeight(); ++y)
+        {
+            unsigned char* rgbaRow = rgbaData + y * rgbaRowSize;
+            if (Channels == 4)
+                std::memcpy(rgbaRow, source.getRow(y), rgbaRowSize);
+            else
+                ExpandPixels<Channels>(source.getRow(y), rgbaRow, width);
+        }
+    });
+}
+
+void PackRgbaRows(const unsigned char* rgbaData, size_t rowPitch, const ImageView& target)
+{
+    int width = target.getWidth();
+
+    DispatchChannelCount(target.getChannels(), [&](auto channelCount) {
+        constexpr int Channels = decltype(channelCount)::value;
+
+        for (int y = 0; y < target.getHeight(); ++y)
+        {
+            const unsigned char* sourceRow = rgbaData + y * rowPitch;
+            if (Channels == 4)
+                std::memcpy(target.getRow(y), sourceRow, target.getRowSize());
+            else
+                PackPixels<Channels>(sourceRow, target.getRow(y), width);
+        }
+    });
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "Image.h"
+#include <cstddef>
+#include <type_traits>
+
+/*
+    Pixel layouts of the images : interleaved 8-bit values with 1 to 4 channels, as returned by stbi_load.
+    Kernels with a per-pixel loop over the channels are templated on the channel count and instantiated
+    for the 4 layouts, DispatchChannelCount picks the instantiation once per image so the inner loops are unrolled
+    and grayscale and RGB images are processed without expanding them to RGBA.
+*/
+
+/**
+ * Calls kernel with the channel count as a compile-time constant, std::integral_constant<int, channels>.
+ * A generic lambda reads it back as decltype(channelCount)::value.
+ *
+ * @param channels The number of channels of the image, 1 to 4.
+ * @param kernel A callable taking a std::integral_constant<int, N> for N in [1, 4].
+ */
+template <typename Kernel>
+inline void DispatchChannelCount(int channels, Kernel&& kernel)
+{
+    switch (channels)
+    {
+    case 1:
+        kernel(std::integral_constant<int, 1>());
+        break;
+    case 2:
+        kernel(std::integral_constant<int, 2>());
+        break;
+    case 3:
+        kernel(std::integral_constant<int, 3>());
+        break;
+    default:
+        kernel(std::integral_constant<int, 4>());
+        break;
+    }
+}
+
+// expands an image to packed rows in the RGBA layout of the GPU textures : gray is replicated to red, green and blue,
+// a missing alpha is opaque. 4 channel pixels are copied
+void ExpandPixelsToRgba(const ImageView& source, unsigned char* rgbaData);
+
+// packs the rows of RGBA pixels, rowPitch bytes apart, back to the layout of the image :
+// gray is read from red, and alpha from alpha
+void PackRgbaRows(const unsigned char* rgbaData, size_t rowPitch, const ImageView& target);
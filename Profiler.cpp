@@ -0,0 +1,130 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+
+Profiler& Profiler::getInstance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler() : m_startTime(std::chrono::steady_clock::now())
+{
+}
+
+void Profiler::setEnabled(bool isEnabled)
+{
+    m_isEnabled.store(isEnabled, std::memory_order_relaxed);
+}
+
+// the buffer is shared with the profiler, so the events of threads that exited are kept
+Profiler::ThreadEvents& Profiler::getThreadEvents()
+{
+    thread_local std::shared_ptr<ThreadEvents> threadEvents;
+
+    if (!threadEvents)
+    {
+        threadEvents = std::make_shared<ThreadEvents>();
+
+        std::lock_guard<std::mutex> lock(m_threadsMutex);
+        threadEvents->threadIndex = static_cast<int>(m_threads.size());
+        m_threads.push_back(threadEvents);
+    }
+
+    return *threadEvents;
+}
+
+void Profiler::recordStage(const char* stageName, std::chrono::steady_clock::time_point startTime, std::chrono::steady_clock::time_point endTime)
+{
+    StageEvent event;
+    event.stageName = stageName;
+    event.startNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(startTime - m_startTime).count();
+    event.durationNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count();
+
+    ThreadEvents& threadEvents = getThreadEvents();
+    std::lock_guard<std::mutex> lock(threadEvents.mutex);
+    threadEvents.events.push_back(event);
+}
+
+// aggregates the events of all the threads by stage name
+void Profiler::printSummary(std::ostream& outputStream)
+{
+    struct StageCounters {
+        long long count = 0;
+        long long totalNanoseconds = 0;
+        long long maxNanoseconds = 0;
+    };
+    std::map<string, StageCounters> stages;
+
+    {
+        std::lock_guard<std::mutex> threadsLock(m_threadsMutex);
+        for (const std::shared_ptr<ThreadEvents>& threadEvents : m_threads)
+        {
+            std::lock_guard<std::mutex> lock(threadEvents->mutex);
+            for (const StageEvent& event : threadEvents->events)
+            {
+                StageCounters& counters = stages[event.stageName];
+                counters.count++;
+                counters.totalNanoseconds += event.durationNanoseconds;
+                counters.maxNanoseconds = std::max(counters.maxNanoseconds, event.durationNanoseconds);
+            }
+        }
+    }
+
+    std::ios_base::fmtflags previousFlags = outputStream.flags();
+    outputStream << std::fixed << std::setprecision(3);
+    outputStream << std::left << std::setw(28) << "stage" << std::right << std::setw(10) << "count" << std::setw(14) << "total ms"
+                 << std::setw(12) << "avg ms" << std::setw(12) << "max ms" << std::endl;
+
+    for (const auto& stage : stages)
+    {
+        const StageCounters& counters = stage.second;
+        outputStream << std::left << std::setw(28) << stage.first << std::right << std::setw(10) << counters.count
+                     << std::setw(14) << counters.totalNanoseconds / 1e6 << std::setw(12) << counters.totalNanoseconds / 1e6 / counters.count
+                     << std::setw(12) << counters.maxNanoseconds / 1e6 << std::endl;
+    }
+
+    outputStream.flags(previousFlags);
+}
+
+// complete ("X") events with microsecond times, one trace thread per recording thread
+bool Profiler::writeChromeTrace(const string& tracePath, string* out_error)
+{
+    std::ofstream traceFile(tracePath);
+    if (!traceFile)
+    {
+        *out_error = "Can not open trace file " + tracePath;
+        std::cout << "Can not open trace file " << tracePath;
+        return false;
+    }
+
+    traceFile << std::fixed << std::setprecision(3);
+    traceFile << "{\"traceEvents\":[\n";
+
+    bool isFirstEvent = true;
+    std::lock_guard<std::mutex> threadsLock(m_threadsMutex);
+    for (const std::shared_ptr<ThreadEvents>& threadEvents : m_threads)
+    {
+        std::lock_guard<std::mutex> lock(threadEvents->mutex);
+        for (const StageEvent& event : threadEvents->events)
+        {
+            traceFile << (isFirstEvent ? "" : ",\n") << "{\"name\":\"" << event.stageName << "\",\"cat\":\"stage\",\"ph\":\"X\",\"ts\":"
+                      << event.startNanoseconds / 1e3 << ",\"dur\":" << event.durationNanoseconds / 1e3
+                      << ",\"pid\":1,\"tid\":" << threadEvents->threadIndex << "}";
+            isFirstEvent = false;
+        }
+    }
+
+    traceFile << "\n]}\n";
+
+    if (!traceFile)
+    {
+        *out_error = "Writing trace file " + tracePath + " failed";
+        std::cout << "Writing trace file " << tracePath << " failed";
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using std::string;  // Make string available as 'string'
+using std::vector;  // Make vector available as 'vector'
+
+/**
+ * Profiler collects the time spent in each stage of the image processing (decoding, texture creation,
+ * draws, read backs, CPU passes, encoding...) measured by the PROFILE_SCOPE probes.
+ * Every thread records its probes into its own buffer, which are aggregated into per-stage counters
+ * and can be written as a Chrome trace (chrome://tracing or https://ui.perfetto.dev).
+ * While disabled, a probe costs a single relaxed atomic load. Defining DISABLE_PROFILER removes the probes.
+ */
+class Profiler {
+public:
+    /**
+     * Returns the profiler of the process.
+     */
+    static Profiler& getInstance();
+
+    /**
+     * Enables or disables the recording of the probes.
+     */
+    void setEnabled(bool isEnabled);
+
+    /**
+     * Returns true if the probes are recorded.
+     */
+    bool isEnabled() const
+    {
+        return m_isEnabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Records a probe on the calling thread.
+     *
+     * @param stageName Name of the stage, must outlive the profiler (a string literal).
+     * @param startTime Time the stage started at.
+     * @param endTime Time the stage ended at.
+     */
+    void recordStage(const char* stageName, std::chrono::steady_clock::time_point startTime, std::chrono::steady_clock::time_point endTime);
+
+    /**
+     * Prints the count, total, average and maximal time of every stage recorded so far.
+     *
+     * @param outputStream The stream to print to.
+     */
+    void printSummary(std::ostream& outputStream);
+
+    /**
+     * Writes all the probes recorded so far as Chrome trace events.
+     *
+     * @param tracePath Path of the JSON file to write.
+     * @param out_error A pointer to a string to receive error messages, if any.
+     * @return true if the file was written, false otherwise.
+     */
+    bool writeChromeTrace(const string& tracePath, string* out_error);
+
+private:
+    Profiler();
+
+    struct StageEvent {
+        const char* stageName;
+        long long startNanoseconds;
+        long long durationNanoseconds;
+    };
+
+    // the events of a single thread. only that thread appends to it, the mutex is for reading while it runs
+    struct ThreadEvents {
+        int threadIndex = 0;
+        std::mutex mutex;
+        vector<StageEvent> events;
+    };
+
+    /**
+     * Returns the buffer of the calling thread, registering it on first use.
+     */
+    ThreadEvents& getThreadEvents();
+
+    std::atomic<bool> m_isEnabled{ false };
+    std::chrono::steady_clock::time_point m_startTime;
+    std::mutex m_threadsMutex;
+    vector<std::shared_ptr<ThreadEvents>> m_threads;
+};
+
+/**
+ * Measures the scope it lives in and records it when destroyed, if the profiler was enabled when created.
+ */
+class ProfilerScope {
+public:
+    explicit ProfilerScope(const char* stageName)
+        : m_stageName(Profiler::getInstance().isEnabled() ? stageName : nullptr)
+    {
+        if (m_stageName)
+            m_startTime = std::chrono::steady_clock::now();
+    }
+
+    ~ProfilerScope()
+    {
+        if (m_stageName)
+            Profiler::getInstance().recordStage(m_stageName, m_startTime, std::chrono::steady_clock::now());
+    }
+
+    ProfilerScope(const ProfilerScope&) = delete;
+    ProfilerScope& operator=(const ProfilerScope&) = delete;
+
+private:
+    const char* m_stageName;
+    std::chrono::steady_clock::time_point m_startTime;
+};
+
+#define PROFILER_CONCATENATE_INNER(a, b) a##b
+#define PROFILER_CONCATENATE(a, b) PROFILER_CONCATENATE_INNER(a, b)
+
+// measures the rest of the enclosing scope as the given stage
+#ifdef DISABLE_PROFILER
+#define PROFILE_SCOPE(stageName)
+#else
+#define PROFILE_SCOPE(stageName) ProfilerScope PROFILER_CONCATENATE(profilerScope, __LINE__)(stageName)
+#endif
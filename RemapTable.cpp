@@ -0,0 +1,98 @@
+#include "RemapTable.h"
+#include "EffectCache.h"
+#include "Profiler.h"
+#include "SimdKernels.h"
+#include <algorithm>
+
+// full weight of the right or bottom texel
+#define REMAP_WEIGHT_ONE 128
+
+// returns the index of the left (top) texel of a sample position along an axis of the given size and the weight of the next one.
+// with a single texel, the index is 0 and the weight does not matter since the next texel is the same one
+static void GetRemapAxisSample(float position, int size, int* out_index, unsigned char* out_weight)
+{
+    float texel = position - 0.5f;
+
+    // past the first texel center the conversion truncates like floor
+    if (size == 1 || !(texel > 0.0f))
+    {
+        *out_index = 0;
+        *out_weight = 0;
+    }
+    else if (texel >= size - 1)
+    {
+        *out_index = size - 2;
+        *out_weight = REMAP_WEIGHT_ONE;
+    }
+    else
+    {
+        int index = static_cast<int>(texel);
+        *out_index = index;
+        *out_weight = static_cast<unsigned char>((texel - index) * REMAP_WEIGHT_ONE + 0.5f);
+    }
+}
+
+void BuildRemapTable(int width, int height, const SourcePositionMapping& mapping, CpuEffectManager* cpuManagerRef, RemapTable* out_table)
+{
+    PROFILE_SCOPE("remap.buildTable");
+
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    out_table->width = width;
+    out_table->height = height;
+    out_table->sourcePixels.resize(pixelCount);
+    out_table->weights.resize(2 * pixelCount);
+
+    cpuManagerRef->parallelForRows(height, [&](int rowBegin, int rowEnd) {
+        for (int y = rowBegin; y < rowEnd; ++y)
+        {
+            int* sourcePixels = out_table->sourcePixels.data() + static_cast<size_t>(y) * width;
+            unsigned char* weights = out_table->weights.data() + 2 * static_cast<size_t>(y) * width;
+
+            for (int x = 0; x < width; ++x)
+            {
+                float sourceX, sourceY;
+                mapping(x + 0.5f, y + 0.5f, &sourceX, &sourceY);
+
+                int sourceColumn, sourceRow;
+                GetRemapAxisSample(sourceX, width, &sourceColumn, &weights[2 * x]);
+                GetRemapAxisSample(sourceY, height, &sourceRow, &weights[2 * x + 1]);
+                sourcePixels[x] = sourceRow * width + sourceColumn;
+            }
+        }
+    });
+}
+
+// a band of a packed target is remapped at once, padded rows one by one
+void ApplyRemapTableKernel(const unsigned char* sourceData, const ImageView& target, const RemapTable& table, int rowBegin, int rowEnd)
+{
+    int channels = target.getChannels();
+    int rightOffset = table.width > 1 ? 1 : 0;
+    int belowOffset = table.height > 1 ? table.width : 0;
+
+    auto remapRows = [&](int firstRow, int rowCount) {
+        size_t firstPixel = static_cast<size_t>(firstRow) * table.width;
+        RemapPixels(sourceData, target.getRow(firstRow), table.sourcePixels.data() + firstPixel, table.weights.data() + 2 * firstPixel,
+            rowCount * table.width, channels, rightOffset, belowOffset);
+    };
+
+    if (target.isPacked())
+    {
+        remapRows(rowBegin, rowEnd - rowBegin);
+        return;
+    }
+
+    for (int y = rowBegin; y < rowEnd; ++y)
+        remapRows(y, 1);
+}
+
+// the table is built by the first image of a size, the key holds the size on top of the mapping
+std::shared_ptr<const RemapTable> GetRemapTable(const string& mappingKey, int width, int height, const SourcePositionMapping& mapping, CpuEffectManager* cpuManagerRef)
+{
+    string key = mappingKey + "@" + std::to_string(width) + "x" + std::to_string(height);
+
+    return EffectCache::getInstance().getEntry<RemapTable>(EffectCacheKind::RemapTable, key, [&]() {
+        std::shared_ptr<RemapTable> table = std::make_shared<RemapTable>();
+        BuildRemapTable(width, height, mapping, cpuManagerRef, table.get());
+        return std::shared_ptr<const RemapTable>(table);
+    });
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CpuEffectManager.h"
+#include "Image.h"
+
+using std::string;  // Make string available as 'string'
+using std::vector;  // Make vector available as 'vector'
+
+// maps a target position to the texel space position of the source it samples
+typedef std::function<void(float x, float y, float* out_x, float* out_y)> SourcePositionMapping;
+
+/**
+ * RemapTable is a coordinate mapping of an image size turned into fixed-point bilinear samples :
+ * for every target pixel, the index of the top-left source texel and 7-bit horizontal and vertical weights in [0, 128].
+ * Clamping is resolved when the table is built, so the right and bottom texels always exist and applying the table
+ * is a gather with the same arithmetic for every pixel.
+ */
+struct RemapTable {
+    int width = 0;
+    int height = 0;
+    vector<int> sourcePixels;
+    vector<unsigned char> weights;  // horizontal then vertical weight of each pixel
+};
+
+/**
+ * Builds the remap table of a mapping for an image of the given size, with the rows split over the CPU effect manager.
+ * Samples are clamped to the pixel centers of the edges like the D3D sampler.
+ */
+void BuildRemapTable(int width, int height, const SourcePositionMapping& mapping, CpuEffectManager* cpuManagerRef, RemapTable* out_table);
+
+/**
+ * Writes the rows [rowBegin, rowEnd) of target by applying the table to sourceData, which must be another buffer holding
+ * the packed rows of an image of the table's size and the target's channels, with at least 3 readable bytes past its last pixel.
+ * The table indexes the source pixels of packed rows, so the source is packed while the target may be any view.
+ */
+void ApplyRemapTableKernel(const unsigned char* sourceData, const ImageView& target, const RemapTable& table, int rowBegin, int rowEnd);
+
+/**
+ * Returns the remap table of a mapping for an image size from the effect cache, building it on a miss,
+ * so the images of a batch with the same size share their table.
+ *
+ * @param mappingKey Key identifying the mapping, equal only for mappings that map every position the same way.
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param mapping The mapping, only called on a miss.
+ * @param cpuManagerRef The CPU effect manager to build the table with.
+ */
+std::shared_ptr<const RemapTable> GetRemapTable(const string& mappingKey, int width, int height, const SourcePositionMapping& mapping, CpuEffectManager* cpuManagerRef);
@@ -1,4 +1,10 @@
 #include "ShaderManager.h"
+#include "BufferPool.h"
+#include "EffectCache.h"
+#include "PixelFormat.h"
+#include "Profiler.h"
+#include <memory>
+#include <vector>
 
 // Define vertex structure with texture coordinates
 struct Vertex
@@ -24,11 +30,14 @@ D3D11_INPUT_ELEMENT_DESC inputLayout[] =
     { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
 };
 
-bool m_isManagerInitialized = false;
+ShaderManager::ShaderManager()
+{
+}
 
-ID3D11Device* m_device = nullptr;
-ID3D11DeviceContext* m_deviceContext = nullptr;
-D3D_FEATURE_LEVEL m_deviceFeatureLevel;
+ShaderManager::~ShaderManager()
+{
+    releaseAllD3DMembers();
+}
 
 // initialize the shader manager by creating device and device context from D3D
 bool ShaderManager::initalizeShaderManager(string* out_error)
@@ -83,8 +92,7 @@ bool ShaderManager::initializeVertices(string* out_error)
     initData.pSysMem = RECT_QUAD_VERTICES;
 
     // create a buffer for the vertices
-    ID3D11Buffer* vertexBuffer = nullptr;
-    hr = m_device->CreateBuffer(&bufferDesc, &initData, &vertexBuffer);
+    hr = m_device->CreateBuffer(&bufferDesc, &initData, &m_vertexBuffer);
 
     // Check for failure in device creation.
     if (FAILED(hr)) {
@@ -96,135 +104,145 @@ bool ShaderManager::initializeVertices(string* out_error)
     // Bind vertex buffer to context
     UINT stride = sizeof(Vertex);
     UINT offset = 0;
-    m_deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+    m_deviceContext->IASetVertexBuffers(0, 1, &m_vertexBuffer, &stride, &offset);
 
     return true;
 }
 
-// compiles shaders from files, then creates both pixel shaders and vertex shader.
-// Also creates the input layout of vertex shader
-bool ShaderManager::createShadersFromFiles(LPCWSTR pixelShaderFileName, LPCWSTR vertexShaderFileName, ID3D11VertexShader** out_vertexShader, ID3D11PixelShader** out_pixelShader, string* out_error)
+// compiled code of the vertex and pixel shaders of an effect, shared through the effect cache by the devices of every ShaderManager
+struct ShaderBytecode
 {
-    HRESULT hr;
-    ID3DBlob* errorBlob = nullptr;
-
-    ID3D11VertexShader* vertexShader;
-    ID3D11PixelShader* pixelShader;
-
-    //////////////////////// Create Vertex Shader ////////////////////////
+    std::vector<unsigned char> vertexShaderCode;
+    std::vector<unsigned char> pixelShaderCode;
+};
 
-    ID3DBlob* vertexShaderCompiledCodeBlock = nullptr;
-    ID3D11InputLayout* pVertexInputLayout = nullptr;
+// compiles the main function of a shader file for a shader model, the compile errors go to the debugger output
+static bool CompileShaderFile(LPCWSTR shaderFileName, const D3D_SHADER_MACRO* shaderMacros, const char* target, std::vector<unsigned char>* out_code)
+{
+    ID3DBlob* compiledCodeBlock = nullptr;
+    ID3DBlob* errorBlob = nullptr;
 
-    // Compile vertex shader from file
-    hr = D3DCompileFromFile(
-        vertexShaderFileName, // Updated Filename
-        nullptr,                    // Optional macros
+    HRESULT hr = D3DCompileFromFile(
+        shaderFileName,             // Shader file name
+        shaderMacros,               // Optional macros
         nullptr,                    // Optional include files
-        "main",                   // Entry point
-        "vs_5_0",                   // Target shader model
+        "main",                     // Entry point
+        target,                     // Target shader model
         0,                          // Shader compile options
         0,                          // Effect compile options
-        &vertexShaderCompiledCodeBlock,           // Double pointer to the compiled shader
+        &compiledCodeBlock,         // Double pointer to the compiled shader
         &errorBlob);                // Pointer to a blob that stores all compile errors and warnings
 
-    // Check for errors
-    if (FAILED(hr)) 
+    if (errorBlob)
     {
-        if (errorBlob) {
+        if (FAILED(hr))
             OutputDebugStringA((char*)errorBlob->GetBufferPointer());
-            errorBlob->Release();
+        errorBlob->Release();
+    }
+
+    if (FAILED(hr))
+    {
+        if (compiledCodeBlock) compiledCodeBlock->Release();
+        return false;
+    }
+
+    const unsigned char* code = static_cast<const unsigned char*>(compiledCodeBlock->GetBufferPointer());
+    out_code->assign(code, code + compiledCodeBlock->GetBufferSize());
+    compiledCodeBlock->Release();
+    return true;
+}
+
+// takes the compiled shaders of the effect from the effect cache, compiling them on a miss, then creates both pixel shaders and
+// vertex shader on the device. Also creates the input layout of vertex shader
+bool ShaderManager::createShadersFromFiles(LPCWSTR pixelShaderFileName, LPCWSTR vertexShaderFileName, const D3D_SHADER_MACRO* shaderMacros, const string& shadersKey, ID3D11VertexShader** out_vertexShader, ID3D11PixelShader** out_pixelShader, string* out_error)
+{
+    HRESULT hr;
+
+    //////////////////////// Compile Shaders ////////////////////////
+
+    string compileError;
+    std::shared_ptr<const ShaderBytecode> bytecode = EffectCache::getInstance().getEntry<ShaderBytecode>(EffectCacheKind::ShaderBytecode, shadersKey, [&]() {
+        PROFILE_SCOPE("gpu.compileShaders");
+        std::shared_ptr<ShaderBytecode> compiledShaders = std::make_shared<ShaderBytecode>();
+
+        if (!CompileShaderFile(vertexShaderFileName, shaderMacros, "vs_5_0", &compiledShaders->vertexShaderCode))
+        {
+            compileError = "Failed to compile vertex shader.";
+            return std::shared_ptr<const ShaderBytecode>();
         }
 
-        if (vertexShaderCompiledCodeBlock) vertexShaderCompiledCodeBlock->Release();
+        if (!CompileShaderFile(pixelShaderFileName, shaderMacros, "ps_5_0", &compiledShaders->pixelShaderCode))
+        {
+            compileError = "Failed to compile pixel shader.";
+            return std::shared_ptr<const ShaderBytecode>();
+        }
+
+        return std::shared_ptr<const ShaderBytecode>(compiledShaders);
+    });
 
-        out_error = new string("Failed to compile vertex shader.");
-        std::cout << "Failed to compile vertex shader.";
+    if (!bytecode)
+    {
+        *out_error = compileError;
+        std::cout << compileError;
         return false;
     }
 
-    // create vertex input layout
-    hr = m_device->CreateInputLayout(
-        inputLayout, // Pointer to an array of D3D11_INPUT_ELEMENT_DESC structures that describe the elements of the vertex input layout.
-        ARRAYSIZE(inputLayout), // Number of elements in the inputLayout array. This tells Direct3D how many input elements are being defined.
-        vertexShaderCompiledCodeBlock->GetBufferPointer(), // Pointer to the compiled vertex shader bytecode. This includes the input signature that the shader expects.
-        vertexShaderCompiledCodeBlock->GetBufferSize(), // Size of the shader bytecode. This helps Direct3D verify that the input layout matches the shader's input signature.
-        &pVertexInputLayout // Address of a pointer to an ID3D11InputLayout interface. On successful execution, this will point to the created input layout object.
-    );
-    if (FAILED(hr)) {
-        if (vertexShaderCompiledCodeBlock) vertexShaderCompiledCodeBlock->Release();
+    const std::vector<unsigned char>& vertexShaderCode = bytecode->vertexShaderCode;
+    const std::vector<unsigned char>& pixelShaderCode = bytecode->pixelShaderCode;
 
-        out_error = new string("Failed to create vertex shader input layout.");
-        std::cout << "Failed to create vertex shader input layout.";
-        return false;
+    //////////////////////// Create Vertex Shader ////////////////////////
+
+    // create vertex input layout, all the vertex shaders take the vertices of the quad so the first one's is kept for all
+    if (!m_vertexInputLayout)
+    {
+        hr = m_device->CreateInputLayout(
+            inputLayout, // Pointer to an array of D3D11_INPUT_ELEMENT_DESC structures that describe the elements of the vertex input layout.
+            ARRAYSIZE(inputLayout), // Number of elements in the inputLayout array. This tells Direct3D how many input elements are being defined.
+            vertexShaderCode.data(), // Pointer to the compiled vertex shader bytecode. This includes the input signature that the shader expects.
+            vertexShaderCode.size(), // Size of the shader bytecode. This helps Direct3D verify that the input layout matches the shader's input signature.
+            &m_vertexInputLayout // Address of a pointer to an ID3D11InputLayout interface. On successful execution, this will point to the created input layout object.
+        );
+        if (FAILED(hr)) {
+            *out_error = "Failed to create vertex shader input layout.";
+            std::cout << "Failed to create vertex shader input layout.";
+            return false;
+        }
     }
 
+    ID3D11VertexShader* vertexShader = nullptr;
+    ID3D11PixelShader* pixelShader = nullptr;
+
     // Create the vertex shader object from the compiled shader bytecode
     hr = m_device->CreateVertexShader(
-        vertexShaderCompiledCodeBlock->GetBufferPointer(),
-        vertexShaderCompiledCodeBlock->GetBufferSize(),
+        vertexShaderCode.data(),
+        vertexShaderCode.size(),
         nullptr,
         &vertexShader);
 
     if (FAILED(hr)) 
     {
-        if (vertexShaderCompiledCodeBlock) vertexShaderCompiledCodeBlock->Release();
-        if (pVertexInputLayout) pVertexInputLayout->Release();
         if (vertexShader) vertexShader->Release();
 
-        out_error = new string("Failed to create vertex shader.");
+        *out_error = "Failed to create vertex shader.";
         std::cout << "Failed to create vertex shader.";
         return false;
     }
 
     //////////////////////// Create Pixel Shader ////////////////////////
 
-    ID3DBlob* pixelShaderCompiledCodeBlock = nullptr;
-
-    hr = D3DCompileFromFile(
-        pixelShaderFileName, // Updated Filename
-        nullptr,                    // Optional macros
-        nullptr,                    // Optional include files
-        "main",                   // Entry point
-        "ps_5_0",                   // Target shader model
-        0,                          // Shader compile options
-        0,                          // Effect compile options
-        &pixelShaderCompiledCodeBlock,           // Double pointer to the compiled shader
-        &errorBlob);                // Pointer to a blob that stores all compile errors and warnings
-
-    if (FAILED(hr)) 
-    {
-        if (errorBlob) {
-            OutputDebugStringA((char*)errorBlob->GetBufferPointer());
-            errorBlob->Release();
-        }
-
-        if (vertexShaderCompiledCodeBlock) vertexShaderCompiledCodeBlock->Release();
-        if (pVertexInputLayout) pVertexInputLayout->Release();
-        if (vertexShader) vertexShader->Release();
-        if (pixelShaderCompiledCodeBlock) pixelShaderCompiledCodeBlock->Release();
-
-        out_error = new string("Failed to compile pixel shader.");
-        std::cout << "Failed to compile pixel shader.";
-        return false;
-    }
-
     // Create the pixel shader object from the compiled shader bytecode
     hr = m_device->CreatePixelShader(
-        pixelShaderCompiledCodeBlock->GetBufferPointer(),
-        pixelShaderCompiledCodeBlock->GetBufferSize(),
+        pixelShaderCode.data(),
+        pixelShaderCode.size(),
         nullptr,
         &pixelShader);
 
     if (FAILED(hr)) 
     {
-        if (vertexShaderCompiledCodeBlock) vertexShaderCompiledCodeBlock->Release();
-        if (pVertexInputLayout) pVertexInputLayout->Release();
         if (vertexShader) vertexShader->Release();
-        if (pixelShaderCompiledCodeBlock) pixelShaderCompiledCodeBlock->Release();
         if (pixelShader) pixelShader->Release();
 
-        out_error = new string("Failed to create pixel shader.");
+        *out_error = "Failed to create pixel shader.";
         std::cout << "Failed to create pixel shader.";
         return false;
     }
@@ -232,10 +250,7 @@ bool ShaderManager::createShadersFromFiles(LPCWSTR pixelShaderFileName, LPCWSTR
     //////////////////////////////////////////////////////////////////////
 
     // Bind vertex shader input layout to device context
-    m_deviceContext->IASetInputLayout(pVertexInputLayout);
-
-    if (pixelShaderCompiledCodeBlock) pixelShaderCompiledCodeBlock->Release();
-    if (vertexShaderCompiledCodeBlock) vertexShaderCompiledCodeBlock->Release();
+    m_deviceContext->IASetInputLayout(m_vertexInputLayout);
 
     *out_pixelShader = pixelShader;
     *out_vertexShader = vertexShader;
@@ -243,13 +258,26 @@ bool ShaderManager::createShadersFromFiles(LPCWSTR pixelShaderFileName, LPCWSTR
     return true;
 }
 
-// recieves image data buffer, and shaders (pixel and vertex) to use to apply effect on the shader.
-// this method intializes tje shader manager if first time, then creates the GPU textures requires to perform the shader operation.
-// At the end it overrides the imageData with new data recieved from the GPU texture.
-bool ShaderManager::applyShaderOnImageData(unsigned char* imageData, int width, int height, int channels, ID3D11PixelShader* pixelShader, ID3D11VertexShader* vertexShader, string* out_error)
+// the key of the shaders of an effect : both file names, which are ASCII paths, and every macro with its value
+static string GetEffectShadersKey(LPCWSTR pixelShaderFileName, LPCWSTR vertexShaderFileName, const D3D_SHADER_MACRO* shaderMacros)
 {
-    HRESULT hr;
+    string key;
+    for (LPCWSTR c = pixelShaderFileName; *c; ++c)
+        key += static_cast<char>(*c);
+    key += "|";
+    for (LPCWSTR c = vertexShaderFileName; *c; ++c)
+        key += static_cast<char>(*c);
+
+    for (const D3D_SHADER_MACRO* macro = shaderMacros; macro && macro->Name; ++macro)
+        key += string("|") + macro->Name + "=" + (macro->Definition ? macro->Definition : "");
+
+    return key;
+}
 
+// effects with the same files and parameters share their shaders, an effect whose parameters changed gets new ones.
+// the shader objects belong to the device, the compiled code they are created from is shared by every manager
+bool ShaderManager::getEffectShaders(LPCWSTR pixelShaderFileName, LPCWSTR vertexShaderFileName, const D3D_SHADER_MACRO* shaderMacros, ID3D11VertexShader** out_vertexShader, ID3D11PixelShader** out_pixelShader, string* out_error)
+{
     if (!m_isManagerInitialized)
     {
         // initialize shader manager
@@ -257,73 +285,78 @@ bool ShaderManager::applyShaderOnImageData(unsigned char* imageData, int width,
             return false; // init falied
     }
 
-    // init render viewport to size of texture
-    initializeViewport(width, height);
+    string key = GetEffectShadersKey(pixelShaderFileName, vertexShaderFileName, shaderMacros);
 
-    ID3D11Texture2D* sourceTexture = nullptr;
-    ID3D11Texture2D* renderTargetTexture = nullptr;
-    ID3D11Texture2D* stagingTexture = nullptr;
+    auto shaders = m_effectShaders.find(key);
+    if (shaders == m_effectShaders.end())
+    {
+        PROFILE_SCOPE("gpu.createShaders");
+        EffectShaders effectShaders;
+        if (!createShadersFromFiles(pixelShaderFileName, vertexShaderFileName, shaderMacros, key, &effectShaders.vertexShader, &effectShaders.pixelShader, out_error))
+            return false;
 
-    // create the 2D textures required to apply effect
-    if (!create2DTextures(imageData, width, height, &sourceTexture, &renderTargetTexture, &stagingTexture, out_error))
+        shaders = m_effectShaders.emplace(key, effectShaders).first;
+    }
+
+    *out_vertexShader = shaders->second.vertexShader;
+    *out_pixelShader = shaders->second.pixelShader;
+    return true;
+}
+
+// recieves image data buffer, and shaders (pixel and vertex) to use to apply effect on the shader.
+// this method intializes tje shader manager if first time, then creates the GPU textures requires to perform the shader operation.
+// At the end it overrides the pixels of the image with new data recieved from the GPU texture.
+bool ShaderManager::applyShaderOnImage(const ImageView& image, ID3D11PixelShader* pixelShader, ID3D11VertexShader* vertexShader, string* out_error)
+{
+    if (!m_isManagerInitialized)
     {
-        releaseAllD3DMembers();
-        return false;
+        // initialize shader manager
+        if (!initalizeShaderManager(out_error))
+            return false; // init falied
     }
 
-    // apply source texture as shader resource view of context (input texture)
-    ID3D11ShaderResourceView* sourceTextureView = nullptr;
-    hr = m_device->CreateShaderResourceView(sourceTexture, nullptr, &sourceTextureView);
-    if (FAILED(hr)) 
+    // init render viewport to size of texture
+    initializeViewport(image.getWidth(), image.getHeight());
+
+    // upload the image to the source texture, the textures are only created when the image size changes
     {
-        if (sourceTexture) sourceTexture->Release();
-        if (renderTargetTexture) renderTargetTexture->Release();
-        if (stagingTexture) stagingTexture->Release();
-        releaseAllD3DMembers();
-        return false;
+        PROFILE_SCOPE("gpu.createTextures");
+        if (!prepare2DTextures(image, out_error))
+        {
+            releaseAllD3DMembers();
+            return false;
+        }
     }
-    ID3D11ShaderResourceView* views[] = { sourceTextureView };
+
+    // apply source texture as shader resource view of context (input texture)
+    ID3D11ShaderResourceView* views[] = { m_sourceTextureView };
     m_deviceContext->PSSetShaderResources(0, 1, views);
 
     // apply render target as render target view of context (output texture)
-    ID3D11RenderTargetView* renderTargetView = nullptr;
-    hr = m_device->CreateRenderTargetView(renderTargetTexture, nullptr, &renderTargetView);
-    if (FAILED(hr)) 
-    {
-        if (sourceTexture) sourceTexture->Release();
-        if (renderTargetTexture) renderTargetTexture->Release();
-        if (stagingTexture) stagingTexture->Release();
-        releaseAllD3DMembers();
-        return false;
-    }
-    m_deviceContext->OMSetRenderTargets(1, &renderTargetView, nullptr); // Assuming no depth stencil
+    m_deviceContext->OMSetRenderTargets(1, &m_renderTargetView, nullptr); // Assuming no depth stencil
 
 
     // apply shaders to context
     m_deviceContext->PSSetShader(pixelShader, nullptr, 0);
     m_deviceContext->VSSetShader(vertexShader, nullptr, 0);
 
-    // draw shader onto render target texture using the 4 vertices of the Quad rectangle
-    m_deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-    m_deviceContext->Draw(sizeof(RECT_QUAD_VERTICES), 0); // Drawing 4 vertices, using a triangle strip to form a quad.
+    // draw shader onto render target texture using the 4 vertices of the Quad rectangle.
+    // the draw is only submitted here, the GPU time shows up in the read back that waits for it
+    {
+        PROFILE_SCOPE("gpu.draw");
+        m_deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+        m_deviceContext->Draw(sizeof(RECT_QUAD_VERTICES), 0); // Drawing 4 vertices, using a triangle strip to form a quad.
+    }
 
 
-    // copy render target texture to staging texture and then override imageData data block with rendered pixels on the staging texture
-    if (!copyRenderTargetToImageData(imageData, width, height, channels, renderTargetTexture, stagingTexture, out_error))
+    // copy render target texture to staging texture and then override the image rows with rendered pixels on the staging texture
+    PROFILE_SCOPE("gpu.readback");
+    if (!copyRenderTargetToImage(image, m_renderTargetTexture, m_stagingTexture, out_error))
     {
-        if (sourceTexture) sourceTexture->Release();
-        if (renderTargetTexture) renderTargetTexture->Release();
-        if (stagingTexture) stagingTexture->Release();
-
         releaseAllD3DMembers();
         return false;
     }
 
-
-    if (sourceTexture) sourceTexture->Release();
-    if (renderTargetTexture) renderTargetTexture->Release();
-    if (stagingTexture) stagingTexture->Release();
-
     return true;
 }
 
@@ -338,8 +371,8 @@ void ShaderManager::initializeViewport(int width, int height)
     m_deviceContext->RSSetViewports(1, &viewport);
 }
 
-// copies row by row the data from the render target GPU texture to the CPU in the targetImageDataBlock memory buffer.
-bool ShaderManager::copyRenderTargetToImageData(unsigned char* targetImageDataBlock, int width, int height, int channels, ID3D11Texture2D* renderTargetTexture, ID3D11Texture2D* stagingTexture, string* out_error)
+// copies row by row the data from the render target GPU texture to the CPU in the rows of the image.
+bool ShaderManager::copyRenderTargetToImage(const ImageView& image, ID3D11Texture2D* renderTargetTexture, ID3D11Texture2D* stagingTexture, string* out_error)
 {
     HRESULT hr;
     D3D11_MAPPED_SUBRESOURCE mappedResource;
@@ -356,32 +389,99 @@ bool ShaderManager::copyRenderTargetToImageData(unsigned char* targetImageDataBl
         return false;
     }
     
-    // Set targetImageDataBlock as initial destination row for the copying process
-    unsigned char* destRow = targetImageDataBlock;
-
     // Set the mapped staging texture data as initial source row for the copying process
     const unsigned char* sourceRow = reinterpret_cast<const unsigned char*>(mappedResource.pData);
 
-    size_t rowWidth = width * channels; // Assuming 4 channels (RGBA) for simplicity
-    
-    // memory copy each row according to the texture
-    for (int i = 0; i < height ; ++i) {
-        memcpy(destRow, sourceRow, rowWidth);
+    // the staging texture is RGBA, its rows are packed back to the channels of the image. Use RowPitch to move to the next row in the source data
+    PackRgbaRows(sourceRow, mappedResource.RowPitch, image);
+
+    m_deviceContext->Unmap(stagingTexture, 0);
+
+    return true;
+}
+
+// D3D11 has no 24-bit format, images with less than 4 channels are expanded to packed RGBA in a buffer of the pool for the upload.
+// RGBA images are uploaded from their own rows
+static D3D11_SUBRESOURCE_DATA GetTextureUploadData(const ImageView& image, PooledBuffer* out_rgbaData)
+{
+    D3D11_SUBRESOURCE_DATA subResourceData = {};
+
+    if (image.getChannels() == 4)
+    {
+        subResourceData.pSysMem = image.getData();                             // Pointer to the initialization data.
+        subResourceData.SysMemPitch = static_cast<UINT>(image.getStride());   // The distance (in bytes) from the beginning of one line of a texture to the next line.
+        return subResourceData;
+    }
+
+    *out_rgbaData = AcquirePooledBuffer(static_cast<size_t>(image.getWidth()) * image.getHeight() * 4);
+    ExpandPixelsToRgba(image, out_rgbaData->get());
+
+    subResourceData.pSysMem = out_rgbaData->get();
+    subResourceData.SysMemPitch = static_cast<UINT>(image.getWidth() * 4);
+    return subResourceData;
+}
+
+// the textures and their views are kept for the next image. an image of the same size is uploaded into the source texture,
+// the render target is entirely overwritten by the draw and the staging texture by the copy
+bool ShaderManager::prepare2DTextures(const ImageView& image, string* out_error)
+{
+    if (m_sourceTexture && image.getWidth() == m_textureWidth && image.getHeight() == m_textureHeight)
+    {
+        PooledBuffer rgbaData;
+        D3D11_SUBRESOURCE_DATA subResourceData = GetTextureUploadData(image, &rgbaData);
+        m_deviceContext->UpdateSubresource(m_sourceTexture, 0, nullptr, subResourceData.pSysMem, subResourceData.SysMemPitch, 0);
+        return true;
+    }
 
-        destRow += rowWidth;
-        sourceRow += mappedResource.RowPitch; // Use RowPitch to move to the next row in the source data
+    release2DTextures();
+
+    // create the 2D textures required to apply effect
+    if (!create2DTextures(image, &m_sourceTexture, &m_renderTargetTexture, &m_stagingTexture, out_error))
+        return false;
+
+    HRESULT hr = m_device->CreateShaderResourceView(m_sourceTexture, nullptr, &m_sourceTextureView);
+    if (SUCCEEDED(hr))
+        hr = m_device->CreateRenderTargetView(m_renderTargetTexture, nullptr, &m_renderTargetView);
+
+    if (FAILED(hr))
+    {
+        release2DTextures();
+
+        *out_error = "Failed to create the texture views.";
+        std::cout << "Failed to create the texture views.";
+        return false;
     }
 
+    m_textureWidth = image.getWidth();
+    m_textureHeight = image.getHeight();
     return true;
 }
 
+// releases the textures kept for the last image size
+void ShaderManager::release2DTextures()
+{
+    if (m_sourceTextureView) m_sourceTextureView->Release();
+    if (m_renderTargetView) m_renderTargetView->Release();
+    if (m_sourceTexture) m_sourceTexture->Release();
+    if (m_renderTargetTexture) m_renderTargetTexture->Release();
+    if (m_stagingTexture) m_stagingTexture->Release();
+
+    m_sourceTextureView = nullptr;
+    m_renderTargetView = nullptr;
+    m_sourceTexture = nullptr;
+    m_renderTargetTexture = nullptr;
+    m_stagingTexture = nullptr;
+    m_textureWidth = 0;
+    m_textureHeight = 0;
+}
+
 /* 
     create the 3 GPU textures that are required for the rendering process :
-    sourceTexture - input recieved from imageData.
+    sourceTexture - input recieved from the image.
     renderTargetTexture - output of the shader after drawing.
     stagingTexture - the Texture the can be offloaded from the GPU and copied by the CPU 
 */
-bool ShaderManager::create2DTextures(unsigned char* imageData, int width, int height, ID3D11Texture2D** out_sourceTexture, ID3D11Texture2D** out_renderTargetTexture, ID3D11Texture2D** out_stagingTexture, string* out_error)
+bool ShaderManager::create2DTextures(const ImageView& image, ID3D11Texture2D** out_sourceTexture, ID3D11Texture2D** out_renderTargetTexture, ID3D11Texture2D** out_stagingTexture, string* out_error)
 {
     HRESULT hr;
 
@@ -391,8 +491,8 @@ bool ShaderManager::create2DTextures(unsigned char* imageData, int width, int he
 
     // Describtion of all textures
     D3D11_TEXTURE2D_DESC textureDesc = {};
-    textureDesc.Width = width;                       // Texture width.
-    textureDesc.Height = height;                     // Texture height.
+    textureDesc.Width = image.getWidth();            // Texture width.
+    textureDesc.Height = image.getHeight();          // Texture height.
     textureDesc.MipLevels = 1;                       // Number of mipmap levels.
     textureDesc.ArraySize = 1;                       // Number of textures in the texture array.
     textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM; // Pixel format of the texture.
@@ -400,13 +500,12 @@ bool ShaderManager::create2DTextures(unsigned char* imageData, int width, int he
     textureDesc.Usage = D3D11_USAGE_DEFAULT;         // Specify how the texture is to be read from and written to.
     
 
-    D3D11_SUBRESOURCE_DATA subResourceData = {};
-    subResourceData.SysMemPitch = width * 4; // The distance (in bytes) from the beginning of one line of a texture to the next line.
+    PooledBuffer rgbaData;
+    D3D11_SUBRESOURCE_DATA subResourceData = GetTextureUploadData(image, &rgbaData);
 
     //////////////////////// Create Source Texture ////////////////////////
 
     // Provide initial data to populate the source texture.
-    subResourceData.pSysMem = imageData;                // Pointer to the initialization data.
     textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE; // Bind the texture to the shader resource.
 
     // Create the source texture from the provided data.
@@ -475,6 +574,20 @@ bool ShaderManager::create2DTextures(unsigned char* imageData, int width, int he
 // release all GPU resources stores as members in the shader manager
 void ShaderManager::releaseAllD3DMembers()
 {
+    release2DTextures();
+
+    for (auto& shaders : m_effectShaders)
+    {
+        if (shaders.second.vertexShader) shaders.second.vertexShader->Release();
+        if (shaders.second.pixelShader) shaders.second.pixelShader->Release();
+    }
+    m_effectShaders.clear();
+
+    if (m_vertexInputLayout) m_vertexInputLayout->Release();
+    if (m_vertexBuffer) m_vertexBuffer->Release();
+    m_vertexInputLayout = nullptr;
+    m_vertexBuffer = nullptr;
+
     if (m_deviceContext) m_deviceContext->Release();
     if (m_device) m_device->Release();
 
@@ -5,7 +5,9 @@
 #include <DirectXMath.h>
 #include <iostream> // Include this for std::cout and std::cin
 #include <windows.h> // Ensure you have this for GetConsoleWindow()
+#include <map>
 #include <string>
+#include "Image.h"
 
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "dxgi.lib")
@@ -17,9 +19,22 @@ using std::string;  // Make string available as 'string'
  * ShaderManager is responsible for managing shaders and applying them to image data.
  * It handles the initialization of the Direct3D environment, creation of shaders,
  * and applying these shaders to perform image effects.
+ * Each ShaderManager is an execution context with its own device, device context, compiled shaders and textures,
+ * nothing is shared between instances. A device context is not thread-safe, so a ShaderManager is used by one thread
+ * at a time and threads processing images concurrently each create their own.
  */
 class ShaderManager {
 public:
+    ShaderManager();
+
+    /**
+     * Releases the device and every resource created on it.
+     */
+    ~ShaderManager();
+
+    ShaderManager(const ShaderManager&) = delete;
+    ShaderManager& operator=(const ShaderManager&) = delete;
+
     /**
      * Initializes the Shader Manager.
      *
@@ -29,32 +44,52 @@ public:
     bool initalizeShaderManager(string* out_error);
 
     /**
-     * Creates vertex and pixel shaders from specified files.
+     * Returns the shaders of an effect, compiled from its files with its macros the first time they are requested.
+     * The shaders are owned by the manager and stay valid until it is released.
      *
-     * @param vertexShaderFile Path to the vertex shader file.
      * @param pixelShaderFile Path to the pixel shader file.
-     * @param vertexShader Pointer to the created vertex shader.
-     * @param pixelShader Pointer to the created pixel shader.
+     * @param vertexShaderFile Path to the vertex shader file.
+     * @param shaderMacros Macros both shaders are compiled with, ended by a null macro, or nullptr.
+     * @param out_vertexShader Receives the vertex shader.
+     * @param out_pixelShader Receives the pixel shader.
      * @param out_error A pointer to a string to receive error messages, if any.
-     * @return true if the shaders are created successfully, false otherwise.
+     * @return true if the shaders are available, false otherwise.
      */
-    bool createShadersFromFiles(LPCWSTR vertexShaderFile, LPCWSTR pixelShaderFile, ID3D11VertexShader** vertexShader, ID3D11PixelShader** pixelShader, string* out_error);
+    bool getEffectShaders(LPCWSTR pixelShaderFile, LPCWSTR vertexShaderFile, const D3D_SHADER_MACRO* shaderMacros, ID3D11VertexShader** out_vertexShader, ID3D11PixelShader** out_pixelShader, string* out_error);
 
     /**
-     * Applies a shader to the given image data.
+     * Applies a shader to the given image, overwritten with the rendered pixels.
      *
-     * @param imageData Pointer to the image data.
-     * @param width Width of the image.
-     * @param height Height of the image.
-     * @param outputTexture The texture containing the processed image.
+     * @param image The pixels to process, rows are uploaded and read back at the stride of the view.
      * @param pixelShader The pixel shader to apply.
      * @param vertexShader The vertex shader to apply.
      * @param out_error A pointer to a string to receive error messages, if any.
      * @return true if the shader is applied successfully, false otherwise.
      */
-    bool applyShaderOnImageData(unsigned char* imageData, int width, int height, int channels, ID3D11PixelShader* pixelShader, ID3D11VertexShader* vertexShader, string* out_error);
+    bool applyShaderOnImage(const ImageView& image, ID3D11PixelShader* pixelShader, ID3D11VertexShader* vertexShader, string* out_error);
 
 private:
+    // the shaders of an effect, compiled for its parameters
+    struct EffectShaders {
+        ID3D11VertexShader* vertexShader = nullptr;
+        ID3D11PixelShader* pixelShader = nullptr;
+    };
+
+    /**
+     * Creates vertex and pixel shaders from specified files, and the input layout of the quad's vertices for the first vertex shader.
+     * The files are compiled once per process, the compiled code is kept in the effect cache.
+     *
+     * @param pixelShaderFile Path to the pixel shader file.
+     * @param vertexShaderFile Path to the vertex shader file.
+     * @param shaderMacros Macros both shaders are compiled with, ended by a null macro, or nullptr.
+     * @param shadersKey Key of the files and macros in the effect cache.
+     * @param vertexShader Pointer to the created vertex shader.
+     * @param pixelShader Pointer to the created pixel shader.
+     * @param out_error A pointer to a string to receive error messages, if any.
+     * @return true if the shaders are created successfully, false otherwise.
+     */
+    bool createShadersFromFiles(LPCWSTR pixelShaderFile, LPCWSTR vertexShaderFile, const D3D_SHADER_MACRO* shaderMacros, const string& shadersKey, ID3D11VertexShader** vertexShader, ID3D11PixelShader** pixelShader, string* out_error);
+
     /**
      * Initializes the viewport for rendering.
      *
@@ -74,33 +109,62 @@ private:
     /**
      * Creates 2D textures for the image and shader processing.
      *
-     * @param imageData Pointer to the image data.
-     * @param width Width of the image.
-     * @param height Height of the image.
+     * @param image The image to upload, images with less than 4 channels are expanded to RGBA.
      * @param out_sourceTexture Pointer to the input texture created.
      * @param out_renderTargetTexture Pointer to the output texture created.
      * @param out_stagingTexture Pointer to an texture that can be read by the CPU
      * @param out_error A pointer to a string to receive error messages, if any.
      * @return true if textures are created successfully, false otherwise.
      */
-    bool create2DTextures(unsigned char* imageData, int width, int height, ID3D11Texture2D** out_sourceTexture, ID3D11Texture2D** out_renderTargetTexture, ID3D11Texture2D** out_stagingTexture, string* out_error);
+    bool create2DTextures(const ImageView& image, ID3D11Texture2D** out_sourceTexture, ID3D11Texture2D** out_renderTargetTexture, ID3D11Texture2D** out_stagingTexture, string* out_error);
+
+    /**
+     * Uploads the image to the source texture. The textures are created for the first image and when the image size changes,
+     * the images of the same size reuse them.
+     *
+     * @param image The image to upload.
+     * @param out_error A pointer to a string to receive error messages, if any.
+     * @return true if the textures hold the image, false otherwise.
+     */
+    bool prepare2DTextures(const ImageView& image, string* out_error);
+
+    /**
+     * Releases the textures of the last image size and their views.
+     */
+    void release2DTextures();
 
     /**
      * Copies the rendered image from the render target to the image data buffer.
      *
-     * @param imageData Pointer to the image data buffer to receive the processed image.
-     * @param width Width of the image.
-     * @param height Height of the image.
-     * @param channels The length of a single pixel size in bytes
+     * @param image The image to receive the processed pixels, the RGBA render target is packed back to its channels.
      * @param outputTexture The texture containing the processed image.
      * @param intermediateTexture An intermediate texture used in processing, if applicable.
      * @param errorMessage A pointer to a string to receive error messages, if any.
      * @return true if the image data is successfully copied, false otherwise.
      */
-    bool copyRenderTargetToImageData(unsigned char* imageData, int width, int height, int channels, ID3D11Texture2D* outputTexture, ID3D11Texture2D* intermediateTexture, string* errorMessage);
+    bool copyRenderTargetToImage(const ImageView& image, ID3D11Texture2D* outputTexture, ID3D11Texture2D* intermediateTexture, string* errorMessage);
 
     /**
      * Releases all Direct3D resources held by the ShaderManager.
      */
     void releaseAllD3DMembers();
+
+    bool m_isManagerInitialized = false;
+    ID3D11Device* m_device = nullptr;
+    ID3D11DeviceContext* m_deviceContext = nullptr;
+    D3D_FEATURE_LEVEL m_deviceFeatureLevel = D3D_FEATURE_LEVEL_11_0;
+    ID3D11Buffer* m_vertexBuffer = nullptr;
+    ID3D11InputLayout* m_vertexInputLayout = nullptr;
+
+    // shaders of the effects applied with this manager, by file names and macros
+    std::map<string, EffectShaders> m_effectShaders;
+
+    // textures of the last image size and their views, reused by the next images of that size
+    ID3D11Texture2D* m_sourceTexture = nullptr;
+    ID3D11Texture2D* m_renderTargetTexture = nullptr;
+    ID3D11Texture2D* m_stagingTexture = nullptr;
+    ID3D11ShaderResourceView* m_sourceTextureView = nullptr;
+    ID3D11RenderTargetView* m_renderTargetView = nullptr;
+    int m_textureWidth = 0;
+    int m_textureHeight = 0;
 };
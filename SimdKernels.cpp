@@ -0,0 +1,1089 @@
+#include "SimdKernels.h"
+#include "CpuFeatures.h"
+#include "PixelFormat.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+#define MAX_CHANNELS 4
+
+// mask of the color bytes in 4 consecutive image bytes, alpha is the last channel of 2 and 4 channel images.
+// the pattern repeats every 4 bytes for 1, 2 and 4 channels, 3 channel images have no alpha
+static unsigned int GetColorByteMask(int channels)
+{
+    switch (channels)
+    {
+    case 2:
+        return 0x00FF00FFu;
+    case 4:
+        return 0x00FFFFFFu;
+    default:
+        return 0xFFFFFFFFu;
+    }
+}
+
+// true if byte 'index' of a pixel range is a color byte
+static inline bool IsColorByte(unsigned int colorByteMask, size_t index)
+{
+    return ((colorByteMask >> ((index & 3) * 8)) & 0xFF) != 0;
+}
+
+//////////////////////// Scalar ////////////////////////
+
+static void InvertColorBytesScalar(const unsigned char* sourceData, unsigned char* targetData, size_t byteBegin, size_t byteCount, unsigned int colorByteMask)
+{
+    for (size_t i = byteBegin; i < byteCount; ++i)
+        targetData[i] = IsColorByte(colorByteMask, i) ? 255 - sourceData[i] : sourceData[i];
+}
+
+static void StretchContrastBytesScalar(const unsigned char* sourceData, unsigned char* targetData, size_t byteBegin, size_t byteCount, unsigned int colorByteMask)
+{
+    for (size_t i = byteBegin; i < byteCount; ++i)
+        targetData[i] = IsColorByte(colorByteMask, i) ? static_cast<unsigned char>(std::min(std::max(2 * sourceData[i] - 128, 0), 255)) : sourceData[i];
+}
+
+static void DetectSobelEdgesRowScalar(const short* aboveRow, const short* currentRow, const short* belowRow, unsigned char* edgeMask, int pixelBegin, int width, int squaredThreshold)
+{
+    for (int x = pixelBegin; x < width; ++x)
+    {
+        int gx = (aboveRow[x + 1] - aboveRow[x - 1]) + 2 * (currentRow[x + 1] - currentRow[x - 1]) + (belowRow[x + 1] - belowRow[x - 1]);
+        int gy = (belowRow[x - 1] + 2 * belowRow[x] + belowRow[x + 1]) - (aboveRow[x - 1] + 2 * aboveRow[x] + aboveRow[x + 1]);
+        edgeMask[x] = gx * gx + gy * gy > squaredThreshold ? 255 : 0;
+    }
+}
+
+static void InterpolateBytesScalar(const unsigned char* leftData, const unsigned char* rightData, unsigned char* targetData, size_t byteBegin, size_t byteCount, int rightWeight)
+{
+    int leftWeight = 256 - rightWeight;
+    for (size_t i = byteBegin; i < byteCount; ++i)
+        targetData[i] = static_cast<unsigned char>((leftData[i] * leftWeight + rightData[i] * rightWeight + 128) >> 8);
+}
+
+// reverses the pixels [pixelBegin, pixelEnd) of a row in place by swapping them from both ends
+static void ReversePixelsScalar(unsigned char* rowData, int pixelBegin, int pixelEnd, int channels)
+{
+    for (int left = pixelBegin, right = pixelEnd - 1; left < right; ++left, --right)
+    {
+        for (int c = 0; c < channels; ++c)
+            std::swap(rowData[left * channels + c], rowData[right * channels + c]);
+    }
+}
+
+template <int Channels>
+static void DownsamplePixels2x2(const unsigned char* topRow, const unsigned char* bottomRow, unsigned char* targetRow, int pixelBegin, int targetWidth)
+{
+    for (int x = pixelBegin; x < targetWidth; ++x)
+    {
+        const unsigned char* top = topRow + 2 * x * Channels;
+        const unsigned char* bottom = bottomRow + 2 * x * Channels;
+        for (int c = 0; c < Channels; ++c)
+            targetRow[x * Channels + c] = static_cast<unsigned char>((top[c] + top[c + Channels] + bottom[c] + bottom[c + Channels] + 2) >> 2);
+    }
+}
+
+static void DownsampleRow2x2Scalar(const unsigned char* topRow, const unsigned char* bottomRow, unsigned char* targetRow, int pixelBegin, int targetWidth, int channels)
+{
+    DispatchChannelCount(channels, [&](auto channelCount) {
+        DownsamplePixels2x2<decltype(channelCount)::value>(topRow, bottomRow, targetRow, pixelBegin, targetWidth);
+    });
+}
+
+// whole pixels with a fixed channel count, the table of each channel stays in a register
+template <int Channels>
+static void ApplyChannelTablesToPixels(const unsigned char* sourceData, unsigned char* targetData, size_t pixelCount, const unsigned char* tables)
+{
+    for (size_t p = 0; p < pixelCount; ++p)
+    {
+        for (int c = 0; c < Channels; ++c)
+            targetData[p * Channels + c] = tables[c * 256 + sourceData[p * Channels + c]];
+    }
+}
+
+// byteBegin may fall inside a pixel, the bytes up to the next pixel and after the last whole pixel are looked up one by one
+static void ApplyChannelTablesScalar(const unsigned char* sourceData, unsigned char* targetData, size_t byteBegin, size_t byteCount, int channels, const unsigned char* tables)
+{
+    size_t i = byteBegin;
+    for (; i < byteCount && i % channels != 0; ++i)
+        targetData[i] = tables[(i % channels) * 256 + sourceData[i]];
+
+    size_t pixelCount = (byteCount - i) / channels;
+    DispatchChannelCount(channels, [&](auto channelCount) {
+        ApplyChannelTablesToPixels<decltype(channelCount)::value>(sourceData + i, targetData + i, pixelCount, tables);
+    });
+
+    for (i += pixelCount * channels; i < byteCount; ++i)
+        targetData[i] = tables[(i % channels) * 256 + sourceData[i]];
+}
+
+// 7-bit weights : the rows are blended in 8.7 fixed point and the vertical blend is a rounding multiply by the weight
+// in 1/32768, as pmulhrsw computes it. a full weight of 128 is 32767 there, which stays within half a level
+static inline int RemapValue(int topLeft, int topRight, int bottomLeft, int bottomRight, int horizontalWeight, int verticalWeight)
+{
+    int top = (topLeft << 7) + (topRight - topLeft) * horizontalWeight;
+    int bottom = (bottomLeft << 7) + (bottomRight - bottomLeft) * horizontalWeight;
+    int verticalFactor = std::min(verticalWeight << 8, 32767);
+    int blended = top + (((bottom - top) * verticalFactor + (1 << 14)) >> 15);
+    return (blended + 64) >> 7;
+}
+
+template <int Channels>
+static void RemapPixelsOfChannels(const unsigned char* sourceData, unsigned char* targetData, const int* sourcePixels, const unsigned char* weights,
+    int pixelBegin, int pixelCount, int rightOffset, int belowOffset)
+{
+    for (int i = pixelBegin; i < pixelCount; ++i)
+    {
+        const unsigned char* topLeft = sourceData + static_cast<size_t>(sourcePixels[i]) * Channels;
+        const unsigned char* topRight = topLeft + rightOffset * Channels;
+        const unsigned char* bottomLeft = topLeft + static_cast<size_t>(belowOffset) * Channels;
+        const unsigned char* bottomRight = bottomLeft + rightOffset * Channels;
+
+        for (int c = 0; c < Channels; ++c)
+        {
+            targetData[i * Channels + c] = static_cast<unsigned char>(
+                RemapValue(topLeft[c], topRight[c], bottomLeft[c], bottomRight[c], weights[2 * i], weights[2 * i + 1]));
+        }
+    }
+}
+
+static void RemapPixelsScalar(const unsigned char* sourceData, unsigned char* targetData, const int* sourcePixels, const unsigned char* weights,
+    int pixelBegin, int pixelCount, int channels, int rightOffset, int belowOffset)
+{
+    DispatchChannelCount(channels, [&](auto channelCount) {
+        RemapPixelsOfChannels<decltype(channelCount)::value>(sourceData, targetData, sourcePixels, weights, pixelBegin, pixelCount, rightOffset, belowOffset);
+    });
+}
+
+#ifdef SIMD_X86
+
+//////////////////////// SSE2 ////////////////////////
+
+SIMD_TARGET("sse2")
+static void InvertColorBytesSse2(const unsigned char* sourceData, unsigned char* targetData, size_t byteCount, unsigned int colorByteMask)
+{
+    // inverting a byte is a xor with 0xFF, xoring alpha bytes with 0 keeps them
+    const __m128i colorMask = _mm_set1_epi32(static_cast<int>(colorByteMask));
+
+    size_t i = 0;
+    for (; i + 16 <= byteCount; i += 16)
+    {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceData + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(targetData + i), _mm_xor_si128(pixels, colorMask));
+    }
+
+    InvertColorBytesScalar(sourceData, targetData, i, byteCount, colorByteMask);
+}
+
+SIMD_TARGET("sse2")
+static void StretchContrastBytesSse2(const unsigned char* sourceData, unsigned char* targetData, size_t byteCount, unsigned int colorByteMask)
+{
+    // 2x - 128 = 2 * (x - 64), both steps saturating
+    const __m128i colorMask = _mm_set1_epi32(static_cast<int>(colorByteMask));
+    const __m128i quarter = _mm_set1_epi8(64);
+
+    size_t i = 0;
+    for (; i + 16 <= byteCount; i += 16)
+    {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceData + i));
+        __m128i shifted = _mm_subs_epu8(pixels, quarter);
+        __m128i stretched = _mm_adds_epu8(shifted, shifted);
+        __m128i result = _mm_or_si128(_mm_and_si128(colorMask, stretched), _mm_andnot_si128(colorMask, pixels));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(targetData + i), result);
+    }
+
+    StretchContrastBytesScalar(sourceData, targetData, i, byteCount, colorByteMask);
+}
+
+SIMD_TARGET("sse2")
+static void DetectSobelEdgesRowSse2(const short* aboveRow, const short* currentRow, const short* belowRow, unsigned char* edgeMask, int width, int squaredThreshold)
+{
+    const __m128i threshold = _mm_set1_epi32(squaredThreshold);
+
+    // 8 pixels per iteration, gradients fit in 16 bits and their squared magnitude in 32 bits
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i aboveLeft = _mm_loadu_si128(reinterpret_cast<const __m128i*>(aboveRow + x - 1));
+        __m128i aboveCenter = _mm_loadu_si128(reinterpret_cast<const __m128i*>(aboveRow + x));
+        __m128i aboveRight = _mm_loadu_si128(reinterpret_cast<const __m128i*>(aboveRow + x + 1));
+        __m128i currentLeft = _mm_loadu_si128(reinterpret_cast<const __m128i*>(currentRow + x - 1));
+        __m128i currentRight = _mm_loadu_si128(reinterpret_cast<const __m128i*>(currentRow + x + 1));
+        __m128i belowLeft = _mm_loadu_si128(reinterpret_cast<const __m128i*>(belowRow + x - 1));
+        __m128i belowCenter = _mm_loadu_si128(reinterpret_cast<const __m128i*>(belowRow + x));
+        __m128i belowRight = _mm_loadu_si128(reinterpret_cast<const __m128i*>(belowRow + x + 1));
+
+        __m128i currentDifference = _mm_sub_epi16(currentRight, currentLeft);
+        __m128i gx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(aboveRight, aboveLeft), _mm_sub_epi16(belowRight, belowLeft)), _mm_add_epi16(currentDifference, currentDifference));
+
+        __m128i aboveSum = _mm_add_epi16(_mm_add_epi16(aboveLeft, aboveRight), _mm_add_epi16(aboveCenter, aboveCenter));
+        __m128i belowSum = _mm_add_epi16(_mm_add_epi16(belowLeft, belowRight), _mm_add_epi16(belowCenter, belowCenter));
+        __m128i gy = _mm_sub_epi16(belowSum, aboveSum);
+
+        // interleaved (gx, gy) pairs multiplied by themselves and added give gx^2 + gy^2
+        __m128i lowPairs = _mm_unpacklo_epi16(gx, gy);
+        __m128i highPairs = _mm_unpackhi_epi16(gx, gy);
+        __m128i lowEdges = _mm_cmpgt_epi32(_mm_madd_epi16(lowPairs, lowPairs), threshold);
+        __m128i highEdges = _mm_cmpgt_epi32(_mm_madd_epi16(highPairs, highPairs), threshold);
+
+        __m128i edges = _mm_packs_epi16(_mm_packs_epi32(lowEdges, highEdges), _mm_setzero_si128());
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(edgeMask + x), edges);
+    }
+
+    DetectSobelEdgesRowScalar(aboveRow, currentRow, belowRow, edgeMask, x, width, squaredThreshold);
+}
+
+SIMD_TARGET("sse2")
+static void InterpolateBytesSse2(const unsigned char* leftData, const unsigned char* rightData, unsigned char* targetData, size_t byteCount, int rightWeight)
+{
+    // the weighted sum is at most 255 * 256 + 128, so it fits unsigned 16-bit lanes
+    const __m128i leftWeight = _mm_set1_epi16(static_cast<short>(256 - rightWeight));
+    const __m128i rightWeights = _mm_set1_epi16(static_cast<short>(rightWeight));
+    const __m128i rounding = _mm_set1_epi16(128);
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 16 <= byteCount; i += 16)
+    {
+        __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(leftData + i));
+        __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rightData + i));
+
+        __m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(left, zero), leftWeight), _mm_mullo_epi16(_mm_unpacklo_epi8(right, zero), rightWeights));
+        __m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(left, zero), leftWeight), _mm_mullo_epi16(_mm_unpackhi_epi8(right, zero), rightWeights));
+        low = _mm_srli_epi16(_mm_add_epi16(low, rounding), 8);
+        high = _mm_srli_epi16(_mm_add_epi16(high, rounding), 8);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(targetData + i), _mm_packus_epi16(low, high));
+    }
+
+    InterpolateBytesScalar(leftData, rightData, targetData, i, byteCount, rightWeight);
+}
+
+// reverses the 16-bit words of a vector
+SIMD_TARGET("sse2")
+static inline __m128i ReverseWordsSse2(__m128i value)
+{
+    value = _mm_shuffle_epi32(value, _MM_SHUFFLE(0, 1, 2, 3));
+    value = _mm_shufflelo_epi16(value, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_shufflehi_epi16(value, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+// swaps 16-byte blocks from both ends of the row towards its middle, reversing the pixels of each block.
+// the pixels left in the middle are reversed one by one
+SIMD_TARGET("sse2")
+static void ReversePixelsSse2(unsigned char* rowData, int width, int channels)
+{
+    if (channels == 3)
+    {
+        ReversePixelsScalar(rowData, 0, width, channels);
+        return;
+    }
+
+    int blockPixels = 16 / channels;
+    int left = 0;
+    int right = width;
+
+    for (; right - left >= 2 * blockPixels; left += blockPixels, right -= blockPixels)
+    {
+        __m128i* leftBlock = reinterpret_cast<__m128i*>(rowData + left * channels);
+        __m128i* rightBlock = reinterpret_cast<__m128i*>(rowData + (right - blockPixels) * channels);
+        __m128i leftPixels = _mm_loadu_si128(leftBlock);
+        __m128i rightPixels = _mm_loadu_si128(rightBlock);
+
+        if (channels == 4)
+        {
+            leftPixels = _mm_shuffle_epi32(leftPixels, _MM_SHUFFLE(0, 1, 2, 3));
+            rightPixels = _mm_shuffle_epi32(rightPixels, _MM_SHUFFLE(0, 1, 2, 3));
+        }
+        else
+        {
+            leftPixels = ReverseWordsSse2(leftPixels);
+            rightPixels = ReverseWordsSse2(rightPixels);
+
+            // single bytes also swap within each word
+            if (channels == 1)
+            {
+                leftPixels = _mm_or_si128(_mm_slli_epi16(leftPixels, 8), _mm_srli_epi16(leftPixels, 8));
+                rightPixels = _mm_or_si128(_mm_slli_epi16(rightPixels, 8), _mm_srli_epi16(rightPixels, 8));
+            }
+        }
+
+        _mm_storeu_si128(leftBlock, rightPixels);
+        _mm_storeu_si128(rightBlock, leftPixels);
+    }
+
+    ReversePixelsScalar(rowData, left, right, channels);
+}
+
+//////////////////////// SSSE3 ////////////////////////
+
+// 3 channel pixels do not divide a vector, so blocks of 5 pixels are swapped with 16-byte loads and stores.
+// the 16th byte of the left block belongs to the next pixel and the 1st byte of the right block to the
+// previous one, both are written back unchanged
+SIMD_TARGET("ssse3")
+static void ReverseRgbPixelsSsse3(unsigned char* rowData, int width)
+{
+    const __m128i rightToLeft = _mm_setr_epi8(13, 14, 15, 10, 11, 12, 7, 8, 9, 4, 5, 6, 1, 2, 3, -1);
+    const __m128i leftToRight = _mm_setr_epi8(-1, 12, 13, 14, 9, 10, 11, 6, 7, 8, 3, 4, 5, 0, 1, 2);
+    const __m128i keepLastByte = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, -1);
+    const __m128i keepFirstByte = _mm_setr_epi8(-1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+
+    int left = 0;
+    int right = width;
+
+    // the 16 bytes of both blocks must not overlap
+    for (; 3 * (right - left) >= 32; left += 5, right -= 5)
+    {
+        unsigned char* leftBlock = rowData + left * 3;
+        unsigned char* rightBlock = rowData + right * 3 - 16;
+        __m128i leftPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(leftBlock));
+        __m128i rightPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rightBlock));
+
+        __m128i newLeft = _mm_or_si128(_mm_shuffle_epi8(rightPixels, rightToLeft), _mm_and_si128(leftPixels, keepLastByte));
+        __m128i newRight = _mm_or_si128(_mm_shuffle_epi8(leftPixels, leftToRight), _mm_and_si128(rightPixels, keepFirstByte));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(leftBlock), newLeft);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rightBlock), newRight);
+    }
+
+    ReversePixelsScalar(rowData, left, right, 3);
+}
+
+// byte shuffles reverse 1 channel blocks in one instruction, 2 and 4 channel blocks are as fast with SSE2
+// byte order that puts the same channel of two horizontally adjacent pixels next to each other, per channel count.
+// pmaddubsw with ones then adds each pair into a 16-bit lane. 3 channel pixels use the first 12 bytes only
+static __m128i GetPairChannelsShuffle(int channels)
+{
+    switch (channels)
+    {
+    case 2:
+        return _mm_setr_epi8(0, 2, 1, 3, 4, 6, 5, 7, 8, 10, 9, 11, 12, 14, 13, 15);
+    case 3:
+        return _mm_setr_epi8(0, 3, 1, 4, 2, 5, 6, 9, 7, 10, 8, 11, -1, -1, -1, -1);
+    case 4:
+        return _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15);
+    default:
+        return _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    }
+}
+
+// sums of the channels of the 2x2 blocks in 16 source bytes of both rows
+SIMD_TARGET("ssse3")
+static inline __m128i SumBlocks2x2Ssse3(const unsigned char* top, const unsigned char* bottom, __m128i pairChannels)
+{
+    const __m128i ones = _mm_set1_epi8(1);
+    __m128i topPairs = _mm_maddubs_epi16(_mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(top)), pairChannels), ones);
+    __m128i bottomPairs = _mm_maddubs_epi16(_mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom)), pairChannels), ones);
+    return _mm_add_epi16(topPairs, bottomPairs);
+}
+
+// every 16 source bytes give 8 target bytes (6 for 3 channels), two such halves are rounded and packed per iteration
+SIMD_TARGET("ssse3")
+static void DownsampleRow2x2Ssse3(const unsigned char* topRow, const unsigned char* bottomRow, unsigned char* targetRow, int targetWidth, int channels)
+{
+    const __m128i pairChannels = GetPairChannelsShuffle(channels);
+    const __m128i rounding = _mm_set1_epi16(2);
+
+    // 3 channels use 12 of every 16 loaded bytes, the last load reads 4 bytes past the 24 used ones
+    int sourceBytesPerHalf = channels == 3 ? 12 : 16;
+    int targetBytesPerIteration = sourceBytesPerHalf;
+    int targetPixelsPerIteration = targetBytesPerIteration / channels;
+    const __m128i compactRgb = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1);
+
+    int x = 0;
+    for (; (x + targetPixelsPerIteration) * 2 * channels + (16 - sourceBytesPerHalf) <= 2 * targetWidth * channels; x += targetPixelsPerIteration)
+    {
+        const unsigned char* top = topRow + 2 * x * channels;
+        const unsigned char* bottom = bottomRow + 2 * x * channels;
+
+        __m128i low = _mm_srli_epi16(_mm_add_epi16(SumBlocks2x2Ssse3(top, bottom, pairChannels), rounding), 2);
+        __m128i high = _mm_srli_epi16(_mm_add_epi16(SumBlocks2x2Ssse3(top + sourceBytesPerHalf, bottom + sourceBytesPerHalf, pairChannels), rounding), 2);
+        __m128i averages = _mm_packus_epi16(low, high);
+
+        unsigned char* target = targetRow + x * channels;
+        if (channels == 3)
+        {
+            averages = _mm_shuffle_epi8(averages, compactRgb);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(target), averages);
+            int lastBytes = _mm_cvtsi128_si32(_mm_srli_si128(averages, 8));
+            std::memcpy(target + 8, &lastBytes, 4);
+        }
+        else
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(target), averages);
+        }
+    }
+
+    DownsampleRow2x2Scalar(topRow, bottomRow, targetRow, x, targetWidth, channels);
+}
+
+SIMD_TARGET("ssse3")
+static void ReversePixelsSsse3(unsigned char* rowData, int width, int channels)
+{
+    if (channels == 3)
+    {
+        ReverseRgbPixelsSsse3(rowData, width);
+        return;
+    }
+
+    if (channels != 1)
+    {
+        ReversePixelsSse2(rowData, width, channels);
+        return;
+    }
+
+    const __m128i reverseBytes = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+
+    int left = 0;
+    int right = width;
+
+    for (; right - left >= 32; left += 16, right -= 16)
+    {
+        __m128i* leftBlock = reinterpret_cast<__m128i*>(rowData + left);
+        __m128i* rightBlock = reinterpret_cast<__m128i*>(rowData + right - 16);
+        __m128i leftPixels = _mm_loadu_si128(leftBlock);
+        __m128i rightPixels = _mm_loadu_si128(rightBlock);
+        _mm_storeu_si128(leftBlock, _mm_shuffle_epi8(rightPixels, reverseBytes));
+        _mm_storeu_si128(rightBlock, _mm_shuffle_epi8(leftPixels, reverseBytes));
+    }
+
+    ReversePixelsScalar(rowData, left, right, channels);
+}
+
+//////////////////////// AVX2 ////////////////////////
+
+SIMD_TARGET("avx2")
+static void InvertColorBytesAvx2(const unsigned char* sourceData, unsigned char* targetData, size_t byteCount, unsigned int colorByteMask)
+{
+    const __m256i colorMask = _mm256_set1_epi32(static_cast<int>(colorByteMask));
+
+    size_t i = 0;
+    for (; i + 32 <= byteCount; i += 32)
+    {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sourceData + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(targetData + i), _mm256_xor_si256(pixels, colorMask));
+    }
+
+    InvertColorBytesScalar(sourceData, targetData, i, byteCount, colorByteMask);
+}
+
+SIMD_TARGET("avx2")
+static void StretchContrastBytesAvx2(const unsigned char* sourceData, unsigned char* targetData, size_t byteCount, unsigned int colorByteMask)
+{
+    const __m256i colorMask = _mm256_set1_epi32(static_cast<int>(colorByteMask));
+    const __m256i quarter = _mm256_set1_epi8(64);
+
+    size_t i = 0;
+    for (; i + 32 <= byteCount; i += 32)
+    {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sourceData + i));
+        __m256i shifted = _mm256_subs_epu8(pixels, quarter);
+        __m256i stretched = _mm256_adds_epu8(shifted, shifted);
+        __m256i result = _mm256_blendv_epi8(pixels, stretched, colorMask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(targetData + i), result);
+    }
+
+    StretchContrastBytesScalar(sourceData, targetData, i, byteCount, colorByteMask);
+}
+
+SIMD_TARGET("avx2")
+static void DetectSobelEdgesRowAvx2(const short* aboveRow, const short* currentRow, const short* belowRow, unsigned char* edgeMask, int width, int squaredThreshold)
+{
+    const __m256i threshold = _mm256_set1_epi32(squaredThreshold);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        __m256i aboveLeft = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(aboveRow + x - 1));
+        __m256i aboveCenter = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(aboveRow + x));
+        __m256i aboveRight = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(aboveRow + x + 1));
+        __m256i currentLeft = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(currentRow + x - 1));
+        __m256i currentRight = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(currentRow + x + 1));
+        __m256i belowLeft = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(belowRow + x - 1));
+        __m256i belowCenter = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(belowRow + x));
+        __m256i belowRight = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(belowRow + x + 1));
+
+        __m256i currentDifference = _mm256_sub_epi16(currentRight, currentLeft);
+        __m256i gx = _mm256_add_epi16(_mm256_add_epi16(_mm256_sub_epi16(aboveRight, aboveLeft), _mm256_sub_epi16(belowRight, belowLeft)), _mm256_add_epi16(currentDifference, currentDifference));
+
+        __m256i aboveSum = _mm256_add_epi16(_mm256_add_epi16(aboveLeft, aboveRight), _mm256_add_epi16(aboveCenter, aboveCenter));
+        __m256i belowSum = _mm256_add_epi16(_mm256_add_epi16(belowLeft, belowRight), _mm256_add_epi16(belowCenter, belowCenter));
+        __m256i gy = _mm256_sub_epi16(belowSum, aboveSum);
+
+        __m256i lowPairs = _mm256_unpacklo_epi16(gx, gy);
+        __m256i highPairs = _mm256_unpackhi_epi16(gx, gy);
+        __m256i lowEdges = _mm256_cmpgt_epi32(_mm256_madd_epi16(lowPairs, lowPairs), threshold);
+        __m256i highEdges = _mm256_cmpgt_epi32(_mm256_madd_epi16(highPairs, highPairs), threshold);
+
+        // packing works within 128-bit lanes, the first quadword of each lane holds 8 pixels in order
+        __m256i edges = _mm256_packs_epi16(_mm256_packs_epi32(lowEdges, highEdges), _mm256_setzero_si256());
+        edges = _mm256_permute4x64_epi64(edges, 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(edgeMask + x), _mm256_castsi256_si128(edges));
+    }
+
+    DetectSobelEdgesRowScalar(aboveRow, currentRow, belowRow, edgeMask, x, width, squaredThreshold);
+}
+
+SIMD_TARGET("avx2")
+static void InterpolateBytesAvx2(const unsigned char* leftData, const unsigned char* rightData, unsigned char* targetData, size_t byteCount, int rightWeight)
+{
+    // unpack and pack both work within 128-bit lanes, so the bytes come back in order
+    const __m256i leftWeight = _mm256_set1_epi16(static_cast<short>(256 - rightWeight));
+    const __m256i rightWeights = _mm256_set1_epi16(static_cast<short>(rightWeight));
+    const __m256i rounding = _mm256_set1_epi16(128);
+    const __m256i zero = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 32 <= byteCount; i += 32)
+    {
+        __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(leftData + i));
+        __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rightData + i));
+
+        __m256i low = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(left, zero), leftWeight), _mm256_mullo_epi16(_mm256_unpacklo_epi8(right, zero), rightWeights));
+        __m256i high = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(left, zero), leftWeight), _mm256_mullo_epi16(_mm256_unpackhi_epi8(right, zero), rightWeights));
+        low = _mm256_srli_epi16(_mm256_add_epi16(low, rounding), 8);
+        high = _mm256_srli_epi16(_mm256_add_epi16(high, rounding), 8);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(targetData + i), _mm256_packus_epi16(low, high));
+    }
+
+    InterpolateBytesScalar(leftData, rightData, targetData, i, byteCount, rightWeight);
+}
+
+// 8 bytes per gather from 32-bit copies of the tables. a byte's table starts at channel * 256, the channel of the first byte
+// of each gather is its phase. the 4 gathers of an iteration are packed to bytes in lane order and put back in order with a permute
+SIMD_TARGET("avx2")
+static void ApplyChannelTablesAvx2(const unsigned char* sourceData, unsigned char* targetData, size_t byteCount, int channels, const unsigned char* tables)
+{
+    alignas(32) int wideTables[MAX_CHANNELS * 256];
+    for (int i = 0; i < channels * 256; ++i)
+        wideTables[i] = tables[i];
+
+    __m256i phaseOffsets[MAX_CHANNELS];
+    for (int phase = 0; phase < channels; ++phase)
+    {
+        alignas(32) int offsets[8];
+        for (int j = 0; j < 8; ++j)
+            offsets[j] = ((phase + j) % channels) * 256;
+        phaseOffsets[phase] = _mm256_load_si256(reinterpret_cast<const __m256i*>(offsets));
+    }
+
+    const int phaseStep = 8 % channels;
+    const __m256i dwordOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    int phase = 0;
+
+    size_t i = 0;
+    for (; i + 32 <= byteCount; i += 32)
+    {
+        __m256i values[4];
+        for (int k = 0; k < 4; ++k)
+        {
+            __m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(sourceData + i + 8 * k)));
+            values[k] = _mm256_i32gather_epi32(wideTables, _mm256_add_epi32(indices, phaseOffsets[phase]), 4);
+
+            phase += phaseStep;
+            if (phase >= channels)
+                phase -= channels;
+        }
+
+        __m256i bytes = _mm256_packus_epi16(_mm256_packus_epi32(values[0], values[1]), _mm256_packus_epi32(values[2], values[3]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(targetData + i), _mm256_permutevar8x32_epi32(bytes, dwordOrder));
+    }
+
+    ApplyChannelTablesScalar(sourceData, targetData, i, byteCount, channels, tables);
+}
+
+// blends the 16-bit texel values of 4 pixels with their weights replicated over the 4 words of each pixel, as RemapValue
+SIMD_TARGET("avx2")
+static inline __m256i RemapWordsAvx2(__m256i topLeft, __m256i topRight, __m256i bottomLeft, __m256i bottomRight, __m256i horizontalWeights, __m256i verticalFactors)
+{
+    __m256i top = _mm256_add_epi16(_mm256_slli_epi16(topLeft, 7), _mm256_mullo_epi16(_mm256_sub_epi16(topRight, topLeft), horizontalWeights));
+    __m256i bottom = _mm256_add_epi16(_mm256_slli_epi16(bottomLeft, 7), _mm256_mullo_epi16(_mm256_sub_epi16(bottomRight, bottomLeft), horizontalWeights));
+    __m256i blended = _mm256_add_epi16(top, _mm256_mulhrs_epi16(_mm256_sub_epi16(bottom, top), verticalFactors));
+    return _mm256_srli_epi16(_mm256_add_epi16(blended, _mm256_set1_epi16(64)), 7);
+}
+
+// 8 pixels per iteration, the 4 texels of each are gathered as 32-bit values and widened to words, pixels 0, 1, 4, 5 in the low
+// halves of the lanes and 2, 3, 6, 7 in the high ones. pixels of less than 4 channels are compacted in each lane and
+// stored with 16-byte writes, which the next iteration overwrites, so the loop stops before they pass the last pixel
+SIMD_TARGET("avx2")
+static void RemapPixelsAvx2(const unsigned char* sourceData, unsigned char* targetData, const int* sourcePixels, const unsigned char* weights,
+    int pixelCount, int channels, int rightOffset, int belowOffset)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i channelCount = _mm256_set1_epi32(channels);
+    const __m256i rightBytes = _mm256_set1_epi32(rightOffset * channels);
+    const __m256i belowBytes = _mm256_set1_epi32(belowOffset * channels);
+    const __m256i maxVerticalFactor = _mm256_set1_epi16(32767);
+
+    const __m256i lowHorizontal = _mm256_setr_epi8(0, 1, 0, 1, 0, 1, 0, 1, 4, 5, 4, 5, 4, 5, 4, 5, 0, 1, 0, 1, 0, 1, 0, 1, 4, 5, 4, 5, 4, 5, 4, 5);
+    const __m256i lowVertical = _mm256_setr_epi8(2, 3, 2, 3, 2, 3, 2, 3, 6, 7, 6, 7, 6, 7, 6, 7, 2, 3, 2, 3, 2, 3, 2, 3, 6, 7, 6, 7, 6, 7, 6, 7);
+    const __m256i highHorizontal = _mm256_setr_epi8(8, 9, 8, 9, 8, 9, 8, 9, 12, 13, 12, 13, 12, 13, 12, 13, 8, 9, 8, 9, 8, 9, 8, 9, 12, 13, 12, 13, 12, 13, 12, 13);
+    const __m256i highVertical = _mm256_setr_epi8(10, 11, 10, 11, 10, 11, 10, 11, 14, 15, 14, 15, 14, 15, 14, 15, 10, 11, 10, 11, 10, 11, 10, 11, 14, 15, 14, 15, 14, 15, 14, 15);
+
+    __m256i compactPixels = zero;
+    if (channels == 1)
+        compactPixels = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    else if (channels == 2)
+        compactPixels = _mm256_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1, 0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+    else if (channels == 3)
+        compactPixels = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1, 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    const int* sourceInts = reinterpret_cast<const int*>(sourceData);
+
+    int i = 0;
+    for (; i + 8 <= pixelCount && (channels == 4 || (i + 4) * channels + 16 <= pixelCount * channels); i += 8)
+    {
+        __m256i topLeftOffsets = _mm256_mullo_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(sourcePixels + i)), channelCount);
+        __m256i bottomLeftOffsets = _mm256_add_epi32(topLeftOffsets, belowBytes);
+
+        __m256i topLeft = _mm256_i32gather_epi32(sourceInts, topLeftOffsets, 1);
+        __m256i topRight = _mm256_i32gather_epi32(sourceInts, _mm256_add_epi32(topLeftOffsets, rightBytes), 1);
+        __m256i bottomLeft = _mm256_i32gather_epi32(sourceInts, bottomLeftOffsets, 1);
+        __m256i bottomRight = _mm256_i32gather_epi32(sourceInts, _mm256_add_epi32(bottomLeftOffsets, rightBytes), 1);
+
+        __m256i pixelWeights = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + 2 * i)));
+        __m256i lowFactors = _mm256_min_epu16(_mm256_slli_epi16(_mm256_shuffle_epi8(pixelWeights, lowVertical), 8), maxVerticalFactor);
+        __m256i highFactors = _mm256_min_epu16(_mm256_slli_epi16(_mm256_shuffle_epi8(pixelWeights, highVertical), 8), maxVerticalFactor);
+
+        __m256i low = RemapWordsAvx2(_mm256_unpacklo_epi8(topLeft, zero), _mm256_unpacklo_epi8(topRight, zero), _mm256_unpacklo_epi8(bottomLeft, zero),
+            _mm256_unpacklo_epi8(bottomRight, zero), _mm256_shuffle_epi8(pixelWeights, lowHorizontal), lowFactors);
+        __m256i high = RemapWordsAvx2(_mm256_unpackhi_epi8(topLeft, zero), _mm256_unpackhi_epi8(topRight, zero), _mm256_unpackhi_epi8(bottomLeft, zero),
+            _mm256_unpackhi_epi8(bottomRight, zero), _mm256_shuffle_epi8(pixelWeights, highHorizontal), highFactors);
+
+        __m256i pixels = _mm256_packus_epi16(low, high);
+        unsigned char* target = targetData + i * channels;
+
+        if (channels == 4)
+        {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(target), pixels);
+        }
+        else
+        {
+            pixels = _mm256_shuffle_epi8(pixels, compactPixels);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(target), _mm256_castsi256_si128(pixels));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(target + 4 * channels), _mm256_extracti128_si256(pixels, 1));
+        }
+    }
+
+    RemapPixelsScalar(sourceData, targetData, sourcePixels, weights, i, pixelCount, channels, rightOffset, belowOffset);
+}
+
+// pmaddubsw and packus work within 128-bit lanes, the packed quadwords are put back in order with a permute.
+// 3 channel pixels do not divide a lane, they use the SSSE3 version
+SIMD_TARGET("avx2")
+static void DownsampleRow2x2Avx2(const unsigned char* topRow, const unsigned char* bottomRow, unsigned char* targetRow, int targetWidth, int channels)
+{
+    if (channels == 3)
+    {
+        DownsampleRow2x2Ssse3(topRow, bottomRow, targetRow, targetWidth, channels);
+        return;
+    }
+
+    const __m128i pairChannelsLane = GetPairChannelsShuffle(channels);
+    const __m256i pairChannels = _mm256_setr_m128i(pairChannelsLane, pairChannelsLane);
+    const __m256i ones = _mm256_set1_epi8(1);
+    const __m256i rounding = _mm256_set1_epi16(2);
+
+    auto sumBlocks = [&](const unsigned char* top, const unsigned char* bottom) SIMD_TARGET("avx2") {
+        __m256i topPairs = _mm256_maddubs_epi16(_mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(top)), pairChannels), ones);
+        __m256i bottomPairs = _mm256_maddubs_epi16(_mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(bottom)), pairChannels), ones);
+        return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(topPairs, bottomPairs), rounding), 2);
+    };
+
+    int targetPixelsPerIteration = 32 / channels;
+
+    int x = 0;
+    for (; x + targetPixelsPerIteration <= targetWidth; x += targetPixelsPerIteration)
+    {
+        const unsigned char* top = topRow + 2 * x * channels;
+        const unsigned char* bottom = bottomRow + 2 * x * channels;
+
+        __m256i averages = _mm256_packus_epi16(sumBlocks(top, bottom), sumBlocks(top + 32, bottom + 32));
+        averages = _mm256_permute4x64_epi64(averages, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(targetRow + x * channels), averages);
+    }
+
+    DownsampleRow2x2Scalar(topRow, bottomRow, targetRow, x, targetWidth, channels);
+}
+
+// byte shuffles stay within 128-bit lanes, so 1 and 2 channel blocks are reversed in each lane before the lanes are swapped.
+// 3 channel pixels do not divide a lane, they use the SSSE3 version
+SIMD_TARGET("avx2")
+static void ReversePixelsAvx2(unsigned char* rowData, int width, int channels)
+{
+    if (channels == 3)
+    {
+        ReverseRgbPixelsSsse3(rowData, width);
+        return;
+    }
+
+    const __m256i reverseBytes = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                                  15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    const __m256i reverseWords = _mm256_setr_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1,
+                                                  14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+    const __m256i reverseDoublewords = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m256i laneShuffle = channels == 1 ? reverseBytes : reverseWords;
+
+    int blockPixels = 32 / channels;
+    int left = 0;
+    int right = width;
+
+    for (; right - left >= 2 * blockPixels; left += blockPixels, right -= blockPixels)
+    {
+        __m256i* leftBlock = reinterpret_cast<__m256i*>(rowData + left * channels);
+        __m256i* rightBlock = reinterpret_cast<__m256i*>(rowData + (right - blockPixels) * channels);
+        __m256i leftPixels = _mm256_loadu_si256(leftBlock);
+        __m256i rightPixels = _mm256_loadu_si256(rightBlock);
+
+        if (channels == 4)
+        {
+            leftPixels = _mm256_permutevar8x32_epi32(leftPixels, reverseDoublewords);
+            rightPixels = _mm256_permutevar8x32_epi32(rightPixels, reverseDoublewords);
+        }
+        else
+        {
+            leftPixels = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(leftPixels, laneShuffle), _MM_SHUFFLE(1, 0, 3, 2));
+            rightPixels = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(rightPixels, laneShuffle), _MM_SHUFFLE(1, 0, 3, 2));
+        }
+
+        _mm256_storeu_si256(leftBlock, rightPixels);
+        _mm256_storeu_si256(rightBlock, leftPixels);
+    }
+
+    ReversePixelsScalar(rowData, left, right, channels);
+}
+
+//////////////////////// AVX-512 ////////////////////////
+
+// 64-bit lane masks are only available on x64
+#ifdef SIMD_X64
+
+SIMD_TARGET("avx512f,avx512bw")
+static void InvertColorBytesAvx512(const unsigned char* sourceData, unsigned char* targetData, size_t byteCount, unsigned int colorByteMask)
+{
+    const __m512i colorMask = _mm512_set1_epi32(static_cast<int>(colorByteMask));
+
+    size_t i = 0;
+    for (; i + 64 <= byteCount; i += 64)
+    {
+        __m512i pixels = _mm512_loadu_si512(sourceData + i);
+        _mm512_storeu_si512(targetData + i, _mm512_xor_si512(pixels, colorMask));
+    }
+
+    // the tail is handled with a masked load and store instead of the scalar loop
+    if (i < byteCount)
+    {
+        __mmask64 tailMask = (1ULL << (byteCount - i)) - 1;
+        __m512i pixels = _mm512_maskz_loadu_epi8(tailMask, sourceData + i);
+        _mm512_mask_storeu_epi8(targetData + i, tailMask, _mm512_xor_si512(pixels, colorMask));
+    }
+}
+
+SIMD_TARGET("avx512f,avx512bw")
+static void StretchContrastBytesAvx512(const unsigned char* sourceData, unsigned char* targetData, size_t byteCount, unsigned int colorByteMask)
+{
+    const __mmask64 colorMask = _mm512_test_epi8_mask(_mm512_set1_epi32(static_cast<int>(colorByteMask)), _mm512_set1_epi32(-1));
+    const __m512i quarter = _mm512_set1_epi8(64);
+
+    size_t i = 0;
+    for (; i + 64 <= byteCount; i += 64)
+    {
+        __m512i pixels = _mm512_loadu_si512(sourceData + i);
+        __m512i shifted = _mm512_subs_epu8(pixels, quarter);
+        _mm512_storeu_si512(targetData + i, _mm512_mask_adds_epu8(pixels, colorMask, shifted, shifted));
+    }
+
+    if (i < byteCount)
+    {
+        __mmask64 tailMask = (1ULL << (byteCount - i)) - 1;
+        __m512i pixels = _mm512_maskz_loadu_epi8(tailMask, sourceData + i);
+        __m512i shifted = _mm512_subs_epu8(pixels, quarter);
+        _mm512_mask_storeu_epi8(targetData + i, tailMask, _mm512_mask_adds_epu8(pixels, colorMask, shifted, shifted));
+    }
+}
+
+// vpermi2b looks 64 bytes up in 128 byte tables, so each 256 entry table is looked up in its two halves and bit 7 of the
+// values picks the half. channels with equal tables are looked up together and identity tables keep the source bytes.
+// the lanes of each table in a 64-byte block depend on the channel of its first byte, its phase, as in the AVX2 version
+SIMD_TARGET("avx512f,avx512bw,avx512vbmi")
+static void ApplyChannelTablesAvx512Vbmi(const unsigned char* sourceData, unsigned char* targetData, size_t byteCount, int channels, const unsigned char* tables)
+{
+    int tableCount = 0;
+    const unsigned char* distinctTables[MAX_CHANNELS];
+    int channelTableIndices[MAX_CHANNELS];
+
+    for (int c = 0; c < channels; ++c)
+    {
+        const unsigned char* table = tables + c * 256;
+
+        bool isIdentity = true;
+        for (int v = 0; v < 256 && isIdentity; ++v)
+            isIdentity = table[v] == v;
+
+        channelTableIndices[c] = -1;
+        if (isIdentity)
+            continue;
+
+        for (int t = 0; t < tableCount && channelTableIndices[c] < 0; ++t)
+        {
+            if (std::memcmp(distinctTables[t], table, 256) == 0)
+                channelTableIndices[c] = t;
+        }
+
+        if (channelTableIndices[c] < 0)
+        {
+            distinctTables[tableCount] = table;
+            channelTableIndices[c] = tableCount++;
+        }
+    }
+
+    __m512i tableQuarters[MAX_CHANNELS][4];
+    for (int t = 0; t < tableCount; ++t)
+    {
+        for (int q = 0; q < 4; ++q)
+            tableQuarters[t][q] = _mm512_loadu_si512(distinctTables[t] + 64 * q);
+    }
+
+    __mmask64 tableLanes[MAX_CHANNELS][MAX_CHANNELS] = {};
+    for (int phase = 0; phase < channels; ++phase)
+    {
+        for (int j = 0; j < 64; ++j)
+        {
+            int tableIndex = channelTableIndices[(phase + j) % channels];
+            if (tableIndex >= 0)
+                tableLanes[phase][tableIndex] |= 1ull << j;
+        }
+    }
+
+    const int phaseStep = 64 % channels;
+    int phase = 0;
+
+    size_t i = 0;
+    for (; i + 64 <= byteCount; i += 64)
+    {
+        __m512i values = _mm512_loadu_si512(sourceData + i);
+        __mmask64 isHighHalf = _mm512_movepi8_mask(values);
+        __m512i result = values;
+
+        for (int t = 0; t < tableCount; ++t)
+        {
+            __m512i lowHalf = _mm512_permutex2var_epi8(tableQuarters[t][0], values, tableQuarters[t][1]);
+            __m512i highHalf = _mm512_permutex2var_epi8(tableQuarters[t][2], values, tableQuarters[t][3]);
+            result = _mm512_mask_blend_epi8(tableLanes[phase][t], result, _mm512_mask_blend_epi8(isHighHalf, lowHalf, highHalf));
+        }
+
+        _mm512_storeu_si512(targetData + i, result);
+
+        phase += phaseStep;
+        if (phase >= channels)
+            phase -= channels;
+    }
+
+    ApplyChannelTablesScalar(sourceData, targetData, i, byteCount, channels, tables);
+}
+
+#endif // SIMD_X64
+
+#endif // SIMD_X86
+
+//////////////////////// Dispatch ////////////////////////
+
+typedef void (*PointBytesKernel)(const unsigned char* sourceData, unsigned char* targetData, size_t byteCount, unsigned int colorByteMask);
+typedef void (*SobelEdgesRowKernel)(const short* aboveRow, const short* currentRow, const short* belowRow, unsigned char* edgeMask, int width, int squaredThreshold);
+typedef void (*ReversePixelsKernel)(unsigned char* rowData, int width, int channels);
+typedef void (*RemapPixelsKernel)(const unsigned char* sourceData, unsigned char* targetData, const int* sourcePixels, const unsigned char* weights,
+    int pixelCount, int channels, int rightOffset, int belowOffset);
+typedef void (*ChannelTablesKernel)(const unsigned char* sourceData, unsigned char* targetData, size_t byteCount, int channels, const unsigned char* tables);
+typedef void (*DownsampleRow2x2Kernel)(const unsigned char* topRow, const unsigned char* bottomRow, unsigned char* targetRow, int targetWidth, int channels);
+typedef void (*InterpolateBytesKernel)(const unsigned char* leftData, const unsigned char* rightData, unsigned char* targetData, size_t byteCount, int rightWeight);
+
+static void InvertColorBytesFallback(const unsigned char* sourceData, unsigned char* targetData, size_t byteCount, unsigned int colorByteMask)
+{
+    InvertColorBytesScalar(sourceData, targetData, 0, byteCount, colorByteMask);
+}
+
+static void StretchContrastBytesFallback(const unsigned char* sourceData, unsigned char* targetData, size_t byteCount, unsigned int colorByteMask)
+{
+    StretchContrastBytesScalar(sourceData, targetData, 0, byteCount, colorByteMask);
+}
+
+static void DetectSobelEdgesRowFallback(const short* aboveRow, const short* currentRow, const short* belowRow, unsigned char* edgeMask, int width, int squaredThreshold)
+{
+    DetectSobelEdgesRowScalar(aboveRow, currentRow, belowRow, edgeMask, 0, width, squaredThreshold);
+}
+
+static void ReversePixelsFallback(unsigned char* rowData, int width, int channels)
+{
+    ReversePixelsScalar(rowData, 0, width, channels);
+}
+
+static void DownsampleRow2x2Fallback(const unsigned char* topRow, const unsigned char* bottomRow, unsigned char* targetRow, int targetWidth, int channels)
+{
+    DownsampleRow2x2Scalar(topRow, bottomRow, targetRow, 0, targetWidth, channels);
+}
+
+static void ApplyChannelTablesFallback(const unsigned char* sourceData, unsigned char* targetData, size_t byteCount, int channels, const unsigned char* tables)
+{
+    ApplyChannelTablesScalar(sourceData, targetData, 0, byteCount, channels, tables);
+}
+
+static void RemapPixelsFallback(const unsigned char* sourceData, unsigned char* targetData, const int* sourcePixels, const unsigned char* weights,
+    int pixelCount, int channels, int rightOffset, int belowOffset)
+{
+    RemapPixelsScalar(sourceData, targetData, sourcePixels, weights, 0, pixelCount, channels, rightOffset, belowOffset);
+}
+
+static void InterpolateBytesFallback(const unsigned char* leftData, const unsigned char* rightData, unsigned char* targetData, size_t byteCount, int rightWeight)
+{
+    InterpolateBytesScalar(leftData, rightData, targetData, 0, byteCount, rightWeight);
+}
+
+// the kernels of the widest instruction set available
+struct SimdKernelTable
+{
+    const char* instructionSetName;
+    PointBytesKernel invertColorBytes;
+    PointBytesKernel stretchContrastBytes;
+    SobelEdgesRowKernel detectSobelEdgesRow;
+    InterpolateBytesKernel interpolateBytes;
+    ReversePixelsKernel reversePixels;
+    DownsampleRow2x2Kernel downsampleRow2x2;
+    ChannelTablesKernel applyChannelTables;
+    RemapPixelsKernel remapPixels;
+};
+
+// starts from the scalar kernels, each supported instruction set replaces the kernels it implements
+static SimdKernelTable SelectSimdKernels()
+{
+    SimdKernelTable kernels = { "Scalar", InvertColorBytesFallback, StretchContrastBytesFallback, DetectSobelEdgesRowFallback, InterpolateBytesFallback, ReversePixelsFallback, DownsampleRow2x2Fallback, ApplyChannelTablesFallback, RemapPixelsFallback };
+
+#ifdef SIMD_X86
+    const CpuFeatures& features = GetCpuFeatures();
+
+    if (features.hasSse2)
+    {
+        kernels.instructionSetName = "SSE2";
+        kernels.invertColorBytes = InvertColorBytesSse2;
+        kernels.stretchContrastBytes = StretchContrastBytesSse2;
+        kernels.detectSobelEdgesRow = DetectSobelEdgesRowSse2;
+        kernels.interpolateBytes = InterpolateBytesSse2;
+        kernels.reversePixels = ReversePixelsSse2;
+    }
+
+    if (features.hasSsse3)
+    {
+        kernels.reversePixels = ReversePixelsSsse3;
+        kernels.downsampleRow2x2 = DownsampleRow2x2Ssse3;
+    }
+
+    if (features.hasAvx2)
+    {
+        kernels.instructionSetName = "AVX2";
+        kernels.invertColorBytes = InvertColorBytesAvx2;
+        kernels.stretchContrastBytes = StretchContrastBytesAvx2;
+        kernels.detectSobelEdgesRow = DetectSobelEdgesRowAvx2;
+        kernels.interpolateBytes = InterpolateBytesAvx2;
+        kernels.reversePixels = ReversePixelsAvx2;
+        kernels.downsampleRow2x2 = DownsampleRow2x2Avx2;
+        kernels.applyChannelTables = ApplyChannelTablesAvx2;
+        kernels.remapPixels = RemapPixelsAvx2;
+    }
+
+#ifdef SIMD_X64
+    // the AVX-512 kernels are picked with the VBMI table lookup only, so the reported instruction set is the one
+    // every point effect runs with. processors without VBMI keep the AVX2 kernels
+    if (features.hasAvx512bw && features.hasAvx512vbmi)
+    {
+        kernels.instructionSetName = "AVX-512";
+        kernels.invertColorBytes = InvertColorBytesAvx512;
+        kernels.stretchContrastBytes = StretchContrastBytesAvx512;
+        kernels.applyChannelTables = ApplyChannelTablesAvx512Vbmi;
+    }
+#endif
+#endif
+
+    return kernels;
+}
+
+static const SimdKernelTable& GetSimdKernels()
+{
+    static const SimdKernelTable kernels = SelectSimdKernels();
+    return kernels;
+}
+
+const char* GetSimdInstructionSetName()
+{
+    return GetSimdKernels().instructionSetName;
+}
+
+void DetectSobelEdgesRow(const short* aboveRow, const short* currentRow, const short* belowRow, unsigned char* edgeMask, int width, int squaredThreshold)
+{
+    GetSimdKernels().detectSobelEdgesRow(aboveRow, currentRow, belowRow, edgeMask, width, squaredThreshold);
+}
+
+void InterpolateBytes(const unsigned char* leftData, const unsigned char* rightData, unsigned char* targetData, size_t byteCount, int rightWeight)
+{
+    GetSimdKernels().interpolateBytes(leftData, rightData, targetData, byteCount, rightWeight);
+}
+
+void ReversePixels(unsigned char* rowData, int width, int channels)
+{
+    GetSimdKernels().reversePixels(rowData, width, channels);
+}
+
+void DownsampleRow2x2(const unsigned char* topRow, const unsigned char* bottomRow, unsigned char* targetRow, int targetWidth, int channels)
+{
+    GetSimdKernels().downsampleRow2x2(topRow, bottomRow, targetRow, targetWidth, channels);
+}
+
+// the tables of a point operation : color channels mapped by colorTable, alpha kept
+static bool IsColorTable(const unsigned char* tables, int channels, const unsigned char* colorTable)
+{
+    static const unsigned char* identityTable = [] {
+        static unsigned char table[256];
+        for (int v = 0; v < 256; ++v)
+            table[v] = static_cast<unsigned char>(v);
+        return table;
+    }();
+
+    unsigned int colorByteMask = GetColorByteMask(channels);
+    for (int c = 0; c < channels; ++c)
+    {
+        const unsigned char* expectedTable = IsColorByte(colorByteMask, c) ? colorTable : identityTable;
+        if (std::memcmp(tables + c * 256, expectedTable, 256) != 0)
+            return false;
+    }
+    return true;
+}
+
+// inversion and the default contrast stretch are computed with byte arithmetic, faster than any lookup
+void ApplyChannelTables(const unsigned char* sourceData, unsigned char* targetData, size_t byteCount, int channels, const unsigned char* tables)
+{
+    static const unsigned char* invertTable = [] {
+        static unsigned char table[256];
+        for (int v = 0; v < 256; ++v)
+            table[v] = static_cast<unsigned char>(255 - v);
+        return table;
+    }();
+    static const unsigned char* stretchContrastTable = [] {
+        static unsigned char table[256];
+        for (int v = 0; v < 256; ++v)
+            table[v] = static_cast<unsigned char>(std::min(std::max(2 * v - 128, 0), 255));
+        return table;
+    }();
+
+    const SimdKernelTable& kernels = GetSimdKernels();
+
+    if (IsColorTable(tables, channels, invertTable))
+        kernels.invertColorBytes(sourceData, targetData, byteCount, GetColorByteMask(channels));
+    else if (IsColorTable(tables, channels, stretchContrastTable))
+        kernels.stretchContrastBytes(sourceData, targetData, byteCount, GetColorByteMask(channels));
+    else
+        kernels.applyChannelTables(sourceData, targetData, byteCount, channels, tables);
+}
+
+void RemapPixels(const unsigned char* sourceData, unsigned char* targetData, const int* sourcePixels, const unsigned char* weights, int pixelCount, int channels, int rightOffset, int belowOffset)
+{
+    GetSimdKernels().remapPixels(sourceData, targetData, sourcePixels, weights, pixelCount, channels, rightOffset, belowOffset);
+}
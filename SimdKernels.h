@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+
+/*
+    Hand-vectorized 8-bit kernels of the CPU backend.
+    Each kernel has a scalar fallback and versions for some of SSE2, SSSE3, AVX2 and AVX-512, the widest version the
+    processor supports is picked once on first use.
+    Point kernels work on a contiguous range of interleaved pixels starting at a pixel boundary,
+    so a band of rows is processed with a single call. sourceData may be equal to targetData.
+*/
+
+// returns the name of the instruction set the SIMD kernels run with
+const char* GetSimdInstructionSetName();
+
+// sobel operator on a row of luma values, using the rows above and below it. each luma row is padded with one value on both sides.
+// edgeMask receives 255 where gx^2 + gy^2 > squaredThreshold and 0 elsewhere
+void DetectSobelEdgesRow(const short* aboveRow, const short* currentRow, const short* belowRow, unsigned char* edgeMask, int width, int squaredThreshold);
+
+// linear interpolation between two byte ranges, (left * (256 - rightWeight) + right * rightWeight + 128) >> 8 for every byte.
+// rightWeight is in [0, 256)
+void InterpolateBytes(const unsigned char* leftData, const unsigned char* rightData, unsigned char* targetData, size_t byteCount, int rightWeight);
+
+// reverses the order of the pixels of a row in place, the bytes of each pixel keep their order
+void ReversePixels(unsigned char* rowData, int width, int channels);
+
+// averages the 2x2 pixel blocks of two source rows of 2 * targetWidth pixels into targetWidth pixels, (a + b + c + d + 2) >> 2
+void DownsampleRow2x2(const unsigned char* topRow, const unsigned char* bottomRow, unsigned char* targetRow, int targetWidth, int channels);
+
+// looks every byte up in the 256 entry table of its channel, tables holds channels consecutive tables.
+// tables inverting the color channels or stretching their contrast by 2 around the middle are applied without a lookup
+void ApplyChannelTables(const unsigned char* sourceData, unsigned char* targetData, size_t byteCount, int channels, const unsigned char* tables);
+
+// bilinear remap : target pixel i blends the source pixels sourcePixels[i], + rightOffset, + belowOffset and + both offsets
+// with the 7-bit horizontal and vertical weights weights[2 * i] and weights[2 * i + 1] in [0, 128].
+// sourceData must have 3 readable bytes past its last pixel
+void RemapPixels(const unsigned char* sourceData, unsigned char* targetData, const int* sourcePixels, const unsigned char* weights, int pixelCount, int channels, int rightOffset, int belowOffset);
@@ -0,0 +1,19 @@
+// the stb implementations are compiled once here, so every executable of the solution can link them
+#include "BufferPool.h"
+
+// decoded images and the buffers of the decoder and of the encoder come from the buffer pool
+#define STBI_MALLOC(size) BufferPool::getInstance().acquire(size)
+#define STBI_REALLOC(buffer, size) BufferPool::getInstance().resize(buffer, size)
+#define STBI_FREE(buffer) BufferPool::getInstance().release(buffer)
+
+#define STBIW_MALLOC(size) BufferPool::getInstance().acquire(size)
+#define STBIW_REALLOC(buffer, size) BufferPool::getInstance().resize(buffer, size)
+#define STBIW_FREE(buffer) BufferPool::getInstance().release(buffer)
+
+// used for decoding PNG
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+// used for encoding PNG
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
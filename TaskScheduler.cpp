@@ -0,0 +1,208 @@
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <random>
+
+// the scheduler the calling thread is a worker of, and its index there
+thread_local const TaskScheduler* t_workerScheduler = nullptr;
+thread_local int t_workerIndex = 0;
+
+// shared state of a single parallelFor call.
+// held by shared pointer since helper tasks may be taken after the call already returned
+struct ParallelForState
+{
+    std::function<void(int)> task;
+    int taskCount = 0;
+    std::atomic<int> nextIndex{ 0 };
+    std::atomic<int> remainingCount{ 0 };
+    std::mutex doneMutex;
+    std::condition_variable doneCondition;
+};
+
+// claims task indices one by one until none are left
+static void RunParallelForTasks(ParallelForState& state)
+{
+    while (true)
+    {
+        int index = state.nextIndex.fetch_add(1);
+        if (index >= state.taskCount)
+            return;
+
+        state.task(index);
+
+        // last finished task wakes up the calling thread
+        if (state.remainingCount.fetch_sub(1) == 1)
+        {
+            std::lock_guard<std::mutex> lock(state.doneMutex);
+            state.doneCondition.notify_all();
+        }
+    }
+}
+
+TaskScheduler::TaskScheduler(int threadCount)
+{
+    // the calling thread is one of the working threads, the workers get a queue each and the other threads share the last one
+    int workerCount = std::max(0, threadCount - 1);
+    for (int i = 0; i <= workerCount; ++i)
+        m_queues.emplace_back(new TaskQueue());
+
+    for (int i = 0; i < workerCount; ++i)
+        m_workers.emplace_back(&TaskScheduler::workerLoop, this, i);
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_isStopping = true;
+    }
+    m_sleepCondition.notify_all();
+
+    for (std::thread& worker : m_workers)
+        worker.join();
+}
+
+int TaskScheduler::getThreadCount() const
+{
+    return static_cast<int>(m_workers.size()) + 1;
+}
+
+int TaskScheduler::getQueueIndex() const
+{
+    return t_workerScheduler == this ? t_workerIndex : static_cast<int>(m_workers.size());
+}
+
+// a worker about to sleep counts itself before checking for tasks, so a push either sees it sleeping or is seen by it
+void TaskScheduler::push(std::function<void()> task)
+{
+    TaskQueue& queue = *m_queues[getQueueIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    m_queuedTaskCount.fetch_add(1);
+
+    if (m_sleepingWorkerCount.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_sleepCondition.notify_one();
+    }
+}
+
+// the victims are visited from a random one, so the thieves spread over the queues instead of all emptying the same one
+bool TaskScheduler::takeTask(int queueIndex, std::function<void()>* out_task)
+{
+    if (m_queuedTaskCount.load() == 0)
+        return false;
+
+    if (queueIndex < static_cast<int>(m_workers.size()))
+    {
+        TaskQueue& queue = *m_queues[queueIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            *out_task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            m_queuedTaskCount.fetch_sub(1);
+            return true;
+        }
+    }
+
+    thread_local std::minstd_rand random(std::random_device{}());
+    int queueCount = static_cast<int>(m_queues.size());
+    int firstVictim = static_cast<int>(random() % queueCount);
+
+    for (int i = 0; i < queueCount; ++i)
+    {
+        int victimIndex = (firstVictim + i) % queueCount;
+        if (victimIndex == queueIndex && queueIndex < static_cast<int>(m_workers.size()))
+            continue;
+
+        TaskQueue& victim = *m_queues[victimIndex];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            *out_task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            m_queuedTaskCount.fetch_sub(1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// splits the indices between the caller and up to (threadCount - 1) helper tasks pushed to the caller's queue, where idle
+// workers steal them. the caller only waits for tasks that are already running on other threads, so nested calls cannot deadlock
+void TaskScheduler::parallelFor(int taskCount, const std::function<void(int)>& task)
+{
+    if (taskCount <= 0)
+        return;
+
+    // no need to involve the workers for a single task
+    if (taskCount == 1 || m_workers.empty())
+    {
+        for (int i = 0; i < taskCount; ++i)
+            task(i);
+        return;
+    }
+
+    std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+    state->task = task;
+    state->taskCount = taskCount;
+    state->remainingCount = taskCount;
+
+    int helperCount = std::min(static_cast<int>(m_workers.size()), taskCount - 1);
+    for (int i = 0; i < helperCount; ++i)
+        push([state]() { RunParallelForTasks(*state); });
+
+    RunParallelForTasks(*state);
+
+    // wait for the tasks still running on the workers
+    std::unique_lock<std::mutex> lock(state->doneMutex);
+    state->doneCondition.wait(lock, [&state]() { return state->remainingCount.load() == 0; });
+}
+
+void TaskScheduler::submit(std::function<void()> task)
+{
+    if (m_workers.empty())
+    {
+        task();
+        return;
+    }
+
+    push(std::move(task));
+}
+
+bool TaskScheduler::runQueuedTask()
+{
+    std::function<void()> task;
+    if (!takeTask(getQueueIndex(), &task))
+        return false;
+
+    task();
+    return true;
+}
+
+void TaskScheduler::workerLoop(int workerIndex)
+{
+    t_workerScheduler = this;
+    t_workerIndex = workerIndex;
+
+    while (true)
+    {
+        std::function<void()> task;
+        if (takeTask(workerIndex, &task))
+        {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleepingWorkerCount.fetch_add(1);
+        m_sleepCondition.wait(lock, [this]() { return m_isStopping.load() || m_queuedTaskCount.load() > 0; });
+        m_sleepingWorkerCount.fetch_sub(1);
+
+        if (m_isStopping.load() && m_queuedTaskCount.load() == 0)
+            return;
+    }
+}
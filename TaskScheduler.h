@@ -0,0 +1,105 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * TaskScheduler runs the tasks of the CPU backend on a fixed set of worker threads with work stealing.
+ * Every worker has its own deque of tasks : it pushes the tasks it spawns at the back and pops them from the back,
+ * so nested work stays on the thread whose caches hold its data, while idle workers steal the oldest tasks from the
+ * front of the deque of a random victim. Threads outside the scheduler push their tasks to a shared deque the workers
+ * steal from as well.
+ * Whole images and the bands and tiles of an image are tasks of the same scheduler, so a worker done with a small image
+ * picks up the bands of a large one instead of waiting for the next image.
+ * The calling thread always takes part in the work of its parallelFor, so parallelFor can be called concurrently
+ * from several threads and from inside another parallelFor.
+ */
+class TaskScheduler {
+public:
+    /**
+     * Creates the scheduler.
+     *
+     * @param threadCount Total number of threads working on a parallelFor, including the caller.
+     */
+    explicit TaskScheduler(int threadCount);
+
+    /**
+     * Runs the queued tasks, then stops and joins all worker threads.
+     */
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    /**
+     * Returns the number of threads working on a parallelFor, including the caller.
+     */
+    int getThreadCount() const;
+
+    /**
+     * Runs task(index) for every index in [0, taskCount) and returns once all of them finished.
+     *
+     * @param taskCount Number of task indices to run.
+     * @param task The task to run for each index.
+     */
+    void parallelFor(int taskCount, const std::function<void(int)>& task);
+
+    /**
+     * Queues a task to run on a worker thread and returns without waiting for it.
+     * The task runs on the calling thread when the scheduler has no worker threads.
+     *
+     * @param task The task to run, which reports its own completion.
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * Steals a queued task and runs it on the calling thread, for threads waiting on submitted tasks.
+     *
+     * @return true if a task was run, false if no task was queued.
+     */
+    bool runQueuedTask();
+
+private:
+    // tasks of a worker, or of the threads outside the scheduler for the last one
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    /**
+     * Returns the index of the queue of the calling thread : its worker index, or the shared queue's.
+     */
+    int getQueueIndex() const;
+
+    /**
+     * Adds a task to the queue of the calling thread and wakes up a sleeping worker.
+     */
+    void push(std::function<void()> task);
+
+    /**
+     * Takes a task from the back of the queue of the calling thread, or else from the front of the queue of another thread.
+     *
+     * @param queueIndex The queue of the calling thread.
+     * @param out_task Receives the task.
+     * @return true if a task was taken, false if every queue is empty.
+     */
+    bool takeTask(int queueIndex, std::function<void()>* out_task);
+
+    /**
+     * Main loop of a worker thread, runs its tasks and steals others until the scheduler is stopped.
+     */
+    void workerLoop(int workerIndex);
+
+    std::vector<std::unique_ptr<TaskQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+    std::atomic<int> m_queuedTaskCount{ 0 };
+    std::atomic<int> m_sleepingWorkerCount{ 0 };
+    std::mutex m_sleepMutex;
+    std::condition_variable m_sleepCondition;
+    std::atomic<bool> m_isStopping{ false };
+};
@@ -0,0 +1,520 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Effect.h"
+#include "SimdKernels.h"
+
+#include "stb_image.h"
+#include "stb_image_write.h"
+
+using std::string;  // Make string available as 'string'
+using std::vector;  // Make vector available as 'vector'
+
+/*
+    Benchmark of the CPU backend.
+    Runs every effect, PNG decoding and PNG encoding on deterministic synthetic images of several
+    resolutions and channel counts, and writes the median and 95th percentile times and the
+    megapixels per second of each case to a JSON file. Given a baseline file written by a previous
+    run, flags the cases whose median time grew by more than a threshold and exits with 1.
+*/
+
+#define ITERATIONS_ARGUMENT "--iterations"
+#define THREADS_ARGUMENT "--threads"
+#define RESOLUTIONS_ARGUMENT "--resolutions"
+#define CHANNELS_ARGUMENT "--channels"
+#define OUTPUT_ARGUMENT "--output"
+#define BASELINE_ARGUMENT "--baseline"
+#define THRESHOLD_ARGUMENT "--threshold"
+
+#define DEFAULT_ITERATIONS 10
+#define DEFAULT_RESOLUTIONS "640x480,1920x1080,3840x2160"
+#define DEFAULT_CHANNELS "3,4"
+#define DEFAULT_OUTPUT_PATH "benchmark.json"
+
+// median time growth in percent above which a case is a regression
+#define DEFAULT_REGRESSION_THRESHOLD 10.0
+
+// untimed runs before the measured iterations, to warm up caches and the scheduler
+#define WARMUP_ITERATIONS 1
+
+#define DECODE_CASE_NAME "decode"
+#define ENCODE_CASE_NAME "encode"
+
+#define USAGE_MESSAGE "Usage: Benchmark [--iterations <count>] [--threads <count>] [--resolutions <WxH,...>]\n"\
+                      "                 [--channels <count,...>] [--output <file>] [--baseline <file>] [--threshold <percent>]\n"
+
+struct BenchmarkOptions {
+    int iterations = DEFAULT_ITERATIONS;
+    int threadCount = 0;
+    string resolutions = DEFAULT_RESOLUTIONS;
+    string channels = DEFAULT_CHANNELS;
+    string outputPath = DEFAULT_OUTPUT_PATH;
+    string baselinePath;
+    double regressionThreshold = DEFAULT_REGRESSION_THRESHOLD;
+};
+
+// the measured times of one case, an operation on one image size
+struct BenchmarkResult {
+    string caseName;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    double medianMilliseconds = 0;
+    double p95Milliseconds = 0;
+    double megapixelsPerSecond = 0;
+
+    // set when a baseline has the same case
+    bool hasBaseline = false;
+    double baselineMedianMilliseconds = 0;
+    double changePercent = 0;
+    bool isRegression = false;
+};
+
+static bool ParseOptions(int argc, char* argv[], BenchmarkOptions* out_options, string* out_error)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        string argument = argv[i];
+
+        if (i + 1 >= argc)
+        {
+            *out_error = "Missing value for argument " + argument;
+            return false;
+        }
+
+        string value = argv[++i];
+        char* valueEnd = nullptr;
+
+        if (argument == ITERATIONS_ARGUMENT || argument == THREADS_ARGUMENT)
+        {
+            long count = std::strtol(value.c_str(), &valueEnd, 10);
+            bool isIterations = argument == ITERATIONS_ARGUMENT;
+            if (value.empty() || *valueEnd != '\0' || count < (isIterations ? 1 : 0) || count > 100000)
+            {
+                *out_error = "Invalid count for " + argument + ": " + value;
+                return false;
+            }
+            (isIterations ? out_options->iterations : out_options->threadCount) = static_cast<int>(count);
+        }
+        else if (argument == THRESHOLD_ARGUMENT)
+        {
+            double threshold = std::strtod(value.c_str(), &valueEnd);
+            if (value.empty() || *valueEnd != '\0' || threshold < 0)
+            {
+                *out_error = "Invalid threshold: " + value;
+                return false;
+            }
+            out_options->regressionThreshold = threshold;
+        }
+        else if (argument == RESOLUTIONS_ARGUMENT)
+        {
+            out_options->resolutions = value;
+        }
+        else if (argument == CHANNELS_ARGUMENT)
+        {
+            out_options->channels = value;
+        }
+        else if (argument == OUTPUT_ARGUMENT)
+        {
+            out_options->outputPath = value;
+        }
+        else if (argument == BASELINE_ARGUMENT)
+        {
+            out_options->baselinePath = value;
+        }
+        else
+        {
+            *out_error = "Unknown argument " + argument;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// parses "640x480,1920x1080" into a list of sizes
+static bool ParseResolutions(const string& resolutions, vector<std::pair<int, int>>* out_sizes, string* out_error)
+{
+    std::stringstream listStream(resolutions);
+    string resolution;
+
+    while (std::getline(listStream, resolution, ','))
+    {
+        int width = 0, height = 0;
+        char separator = 0;
+        std::stringstream resolutionStream(resolution);
+        if (!(resolutionStream >> width >> separator >> height) || separator != 'x' || width <= 0 || height <= 0)
+        {
+            *out_error = "Invalid resolution: " + resolution;
+            return false;
+        }
+        out_sizes->push_back({ width, height });
+    }
+
+    return !out_sizes->empty();
+}
+
+// parses "3,4" into a list of channel counts
+static bool ParseChannels(const string& channels, vector<int>* out_channels, string* out_error)
+{
+    std::stringstream listStream(channels);
+    string channelCount;
+
+    while (std::getline(listStream, channelCount, ','))
+    {
+        int count = std::atoi(channelCount.c_str());
+        if (count < 1 || count > 4)
+        {
+            *out_error = "Invalid channel count: " + channelCount;
+            return false;
+        }
+        out_channels->push_back(count);
+    }
+
+    return !out_channels->empty();
+}
+
+// fills an image with smooth gradients, shapes and a little noise, so it has edges and compresses like a photo.
+// the image only depends on its size, so runs are comparable
+static Image GenerateSyntheticImage(int width, int height, int channels)
+{
+    Image image(width, height, channels);
+    unsigned int noiseState = 12345u;
+
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            unsigned char* pixel = image.getView().getRow(y) + x * channels;
+
+            float u = static_cast<float>(x) / width;
+            float v = static_cast<float>(y) / height;
+            bool isInsideCircle = (u - 0.5f) * (u - 0.5f) + (v - 0.5f) * (v - 0.5f) < 0.09f;
+            bool isChecker = ((x / 64) + (y / 64)) % 2 == 0;
+
+            for (int c = 0; c < channels; ++c)
+            {
+                noiseState = noiseState * 1664525u + 1013904223u;
+                int noise = static_cast<int>(noiseState >> 28) - 8;
+                float gradient = c % 3 == 0 ? u : (c % 3 == 1 ? v : 1.0f - u * v);
+                int value = static_cast<int>(gradient * 200.0f) + (isInsideCircle ? 40 : 0) + (isChecker ? 10 : 0) + noise;
+                pixel[c] = static_cast<unsigned char>(std::min(std::max(value, 0), 255));
+            }
+
+            // varying alpha for the channel counts that have one
+            if (channels == 2 || channels == 4)
+                pixel[channels - 1] = static_cast<unsigned char>(255 - (x * 64) / width);
+        }
+    }
+
+    return image;
+}
+
+// returns the value at the given percentile of the times
+static double GetPercentile(vector<double> times, double percentile)
+{
+    std::sort(times.begin(), times.end());
+    size_t index = static_cast<size_t>(std::ceil(percentile / 100.0 * times.size())) - 1;
+    return times[std::min(index, times.size() - 1)];
+}
+
+// times an operation for the requested iterations after the warmup ones, prepare runs untimed before each of them
+template <typename Prepare, typename Operation>
+static vector<double> MeasureIterations(int iterations, Prepare prepare, Operation operation)
+{
+    vector<double> times;
+
+    for (int i = 0; i < WARMUP_ITERATIONS + iterations; ++i)
+    {
+        prepare();
+
+        auto startTime = std::chrono::steady_clock::now();
+        operation();
+        double elapsedMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+        if (i >= WARMUP_ITERATIONS)
+            times.push_back(elapsedMilliseconds);
+    }
+
+    return times;
+}
+
+static BenchmarkResult CreateResult(const string& caseName, int width, int height, int channels, const vector<double>& times)
+{
+    BenchmarkResult result;
+    result.caseName = caseName;
+    result.width = width;
+    result.height = height;
+    result.channels = channels;
+    result.medianMilliseconds = GetPercentile(times, 50.0);
+    result.p95Milliseconds = GetPercentile(times, 95.0);
+    result.megapixelsPerSecond = result.medianMilliseconds > 0 ? width * static_cast<double>(height) / 1000.0 / result.medianMilliseconds : 0.0;
+    return result;
+}
+
+// appends the bytes written by stbi_write_png_to_func to a vector
+static void AppendToVector(void* context, void* data, int size)
+{
+    vector<unsigned char>* encodedData = static_cast<vector<unsigned char>*>(context);
+    unsigned char* bytes = static_cast<unsigned char*>(data);
+    encodedData->insert(encodedData->end(), bytes, bytes + size);
+}
+
+// runs the decode, encode and effect cases on one image size
+static bool RunImageCases(int width, int height, int channels, int iterations, const vector<BaseEffect*>& effects,
+    CpuEffectManager* cpuManager, vector<BenchmarkResult>* out_results, string* out_error)
+{
+    Image sourceImage = GenerateSyntheticImage(width, height, channels);
+    Image image(width, height, channels);
+    const ImageView& source = sourceImage.getView();
+    int stride = static_cast<int>(source.getStride());
+
+    vector<unsigned char> encodedData;
+    vector<double> times = MeasureIterations(iterations,
+        [&] { encodedData.clear(); },
+        [&] { stbi_write_png_to_func(AppendToVector, &encodedData, width, height, channels, source.getData(), stride); });
+    out_results->push_back(CreateResult(ENCODE_CASE_NAME, width, height, channels, times));
+
+    bool isDecoded = true;
+    times = MeasureIterations(iterations,
+        [] {},
+        [&] {
+            int decodedWidth, decodedHeight, decodedChannels;
+            unsigned char* decodedData = stbi_load_from_memory(encodedData.data(), static_cast<int>(encodedData.size()), &decodedWidth, &decodedHeight, &decodedChannels, 0);
+            isDecoded = isDecoded && decodedData;
+            stbi_image_free(decodedData);
+        });
+
+    if (!isDecoded)
+    {
+        *out_error = "Decoding the encoded synthetic image failed";
+        return false;
+    }
+    out_results->push_back(CreateResult(DECODE_CASE_NAME, width, height, channels, times));
+
+    for (BaseEffect* effect : effects)
+    {
+        bool isApplied = true;
+        times = MeasureIterations(iterations,
+            [&] { source.copyTo(image.getView()); },
+            [&] { isApplied = isApplied && effect->ApplyEffectOnImage(image.getView(), cpuManager, out_error); });
+
+        if (!isApplied)
+            return false;
+
+        out_results->push_back(CreateResult(effect->GetEffectFileSuffix(), width, height, channels, times));
+    }
+
+    return true;
+}
+
+// returns the value of a key of a flat JSON object written on a single line, or an empty string
+static string FindJsonValue(const string& line, const string& key)
+{
+    string quotedKey = "\"" + key + "\":";
+    size_t keyPosition = line.find(quotedKey);
+    if (keyPosition == string::npos)
+        return "";
+
+    size_t valueBegin = line.find_first_not_of(" \"", keyPosition + quotedKey.size());
+    size_t valueEnd = line.find_first_of(",\"}", valueBegin);
+    if (valueBegin == string::npos || valueEnd == string::npos)
+        return "";
+
+    return line.substr(valueBegin, valueEnd - valueBegin);
+}
+
+// reads the results of a file written by a previous run, one result object per line
+static bool ReadBaseline(const string& baselinePath, vector<BenchmarkResult>* out_results, string* out_error)
+{
+    std::ifstream baselineFile(baselinePath);
+    if (!baselineFile)
+    {
+        *out_error = "Can not open baseline file " + baselinePath;
+        return false;
+    }
+
+    string line;
+    while (std::getline(baselineFile, line))
+    {
+        string caseName = FindJsonValue(line, "case");
+        if (caseName.empty())
+            continue;
+
+        BenchmarkResult result;
+        result.caseName = caseName;
+        result.width = std::atoi(FindJsonValue(line, "width").c_str());
+        result.height = std::atoi(FindJsonValue(line, "height").c_str());
+        result.channels = std::atoi(FindJsonValue(line, "channels").c_str());
+        result.medianMilliseconds = std::atof(FindJsonValue(line, "median_ms").c_str());
+        out_results->push_back(result);
+    }
+
+    return true;
+}
+
+// compares the results with the baseline ones of the same case, returns the number of regressions
+static int CompareWithBaseline(vector<BenchmarkResult>& results, const vector<BenchmarkResult>& baselineResults, double regressionThreshold)
+{
+    int regressionCount = 0;
+
+    for (BenchmarkResult& result : results)
+    {
+        for (const BenchmarkResult& baselineResult : baselineResults)
+        {
+            if (baselineResult.caseName != result.caseName || baselineResult.width != result.width ||
+                baselineResult.height != result.height || baselineResult.channels != result.channels ||
+                baselineResult.medianMilliseconds <= 0)
+                continue;
+
+            result.hasBaseline = true;
+            result.baselineMedianMilliseconds = baselineResult.medianMilliseconds;
+            result.changePercent = (result.medianMilliseconds / baselineResult.medianMilliseconds - 1.0) * 100.0;
+            result.isRegression = result.changePercent > regressionThreshold;
+            if (result.isRegression)
+                regressionCount++;
+            break;
+        }
+    }
+
+    return regressionCount;
+}
+
+// writes the results as JSON, one result object per line so baselines can be read back without a JSON library
+static bool WriteResults(const string& outputPath, const vector<BenchmarkResult>& results, int iterations, int threadCount, string* out_error)
+{
+    std::ofstream outputFile(outputPath);
+    if (!outputFile)
+    {
+        *out_error = "Can not open output file " + outputPath;
+        return false;
+    }
+
+    outputFile << std::fixed << std::setprecision(3);
+    outputFile << "{\n";
+    outputFile << "  \"instruction_set\": \"" << GetSimdInstructionSetName() << "\",\n";
+    outputFile << "  \"threads\": " << threadCount << ",\n";
+    outputFile << "  \"iterations\": " << iterations << ",\n";
+    outputFile << "  \"results\": [\n";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchmarkResult& result = results[i];
+        outputFile << "    {\"case\": \"" << result.caseName << "\", \"width\": " << result.width << ", \"height\": " << result.height
+                   << ", \"channels\": " << result.channels << ", \"median_ms\": " << result.medianMilliseconds
+                   << ", \"p95_ms\": " << result.p95Milliseconds << ", \"megapixels_per_second\": " << result.megapixelsPerSecond;
+
+        if (result.hasBaseline)
+        {
+            outputFile << ", \"baseline_median_ms\": " << result.baselineMedianMilliseconds << ", \"change_percent\": " << result.changePercent
+                       << ", \"regression\": " << (result.isRegression ? "true" : "false");
+        }
+
+        outputFile << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+
+    outputFile << "  ]\n";
+    outputFile << "}\n";
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    string errorString;
+    BenchmarkOptions options;
+    vector<std::pair<int, int>> sizes;
+    vector<int> channelCounts;
+
+    if (!ParseOptions(argc, argv, &options, &errorString) ||
+        !ParseResolutions(options.resolutions, &sizes, &errorString) ||
+        !ParseChannels(options.channels, &channelCounts, &errorString))
+    {
+        std::cout << "ERROR: " << errorString << std::endl << USAGE_MESSAGE;
+        return -1;
+    }
+
+    CpuEffectManager cpuManager;
+    if (!cpuManager.initializeCpuEffectManager(options.threadCount, &errorString))
+    {
+        std::cout << "ERROR: " << errorString << std::endl;
+        return -1;
+    }
+
+    vector<BaseEffect*> effects = {
+        new BlurEffect(),
+        new ColorInversionEffect(),
+        new MirrorEffect(),
+        new ShrinkEffect(),
+        new ShrinkEffect(DEFAULT_SHRINK_FACTOR, false),
+        new EdgeDetectionEffect(),
+        new EqualizationEffect(),
+        new EqualizationEffect(EqualizationMode::Global),
+        new EqualizationEffect(EqualizationMode::PerChannel),
+        new EqualizationEffect(EqualizationMode::Luma),
+        new GammaEffect(),
+        new LevelsEffect(),
+        new ThresholdEffect(),
+        new WavesEffect(),
+        new FishEyeEffect()
+    };
+
+    std::cout << "Running on " << cpuManager.getThreadCount() << " threads with " << GetSimdInstructionSetName() << " kernels." << std::endl;
+
+    vector<BenchmarkResult> results;
+    for (const std::pair<int, int>& size : sizes)
+    {
+        for (int channels : channelCounts)
+        {
+            if (!RunImageCases(size.first, size.second, channels, options.iterations, effects, &cpuManager, &results, &errorString))
+            {
+                std::cout << "ERROR: " << errorString << std::endl;
+                return -1;
+            }
+        }
+    }
+
+    int regressionCount = 0;
+    if (!options.baselinePath.empty())
+    {
+        vector<BenchmarkResult> baselineResults;
+        if (!ReadBaseline(options.baselinePath, &baselineResults, &errorString))
+        {
+            std::cout << "ERROR: " << errorString << std::endl;
+            return -1;
+        }
+        regressionCount = CompareWithBaseline(results, baselineResults, options.regressionThreshold);
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    for (const BenchmarkResult& result : results)
+    {
+        std::cout << std::left << std::setw(10) << result.caseName << std::right << std::setw(6) << result.width << "x" << std::left << std::setw(6) << result.height
+                  << result.channels << "ch  median " << std::right << std::setw(9) << result.medianMilliseconds << " ms  p95 " << std::setw(9) << result.p95Milliseconds
+                  << " ms  " << std::setw(9) << result.megapixelsPerSecond << " MP/s";
+        if (result.hasBaseline)
+            std::cout << "  " << std::showpos << result.changePercent << std::noshowpos << "%" << (result.isRegression ? "  REGRESSION" : "");
+        std::cout << std::endl;
+    }
+
+    if (!WriteResults(options.outputPath, results, options.iterations, cpuManager.getThreadCount(), &errorString))
+    {
+        std::cout << "ERROR: " << errorString << std::endl;
+        return -1;
+    }
+
+    if (regressionCount > 0)
+    {
+        std::cout << regressionCount << " cases are more than " << options.regressionThreshold << "% slower than the baseline." << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
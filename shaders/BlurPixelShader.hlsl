@@ -2,6 +2,16 @@
 Texture2D shaderTexture : register(t0);
 SamplerState samplerState : register(s0);
 
+// parameters of the effect, defined by the effect when it compiles the shader
+#ifndef RADIUS
+#define RADIUS 8.0
+#endif
+
+// the gaussian is separable, pass 0 blurs the rows and pass 1 the columns of its output
+#ifndef SHADER_PASS
+#define SHADER_PASS 0
+#endif
+
 struct PSInput
 {
     float4 Pos : SV_POSITION;
@@ -10,24 +20,33 @@ struct PSInput
 
 float4 main(PSInput input) : SV_Target
 {
-    // Define the blur size, decrease to intesify blur
-    float2 blurSize = float2(1.0 / 60, 1.0 / 60); 
+    // one texel along the direction of the pass for the actual texture size
+    uint textureWidth, textureHeight;
+    shaderTexture.GetDimensions(textureWidth, textureHeight);
+#if SHADER_PASS == 0
+    float2 texelStep = float2(1.0 / textureWidth, 0.0);
+#else
+    float2 texelStep = float2(0.0, 1.0 / textureHeight);
+#endif
+
+    // gaussian of standard deviation RADIUS pixels, like the CPU blur, cut at 3 deviations
+    const int tapCount = (int)ceil(3.0 * RADIUS);
+    const float weightScale = -0.5 / (RADIUS * RADIUS);
 
-    // Sample the original pixel and its neighbors
     float4 color = shaderTexture.Sample(samplerState, input.TexCoord);
+    float totalWeight = 1.0;
 
-    // Accumulate colors of neighboring pixels
-    for (int x = -1; x <= 1; ++x)
+    // each side reads two neighbouring texels with a single bilinear sample placed between them by their weights
+    for (int offset = 1; offset <= tapCount; offset += 2)
     {
-        for (int y = -1; y <= 1; ++y)
-        {
-            float2 sampleCoord = input.TexCoord + float2(x, y) * blurSize;
-            color += shaderTexture.Sample(samplerState, sampleCoord);
-        }
-    }
+        float nearWeight = exp(offset * offset * weightScale);
+        float farWeight = offset < tapCount ? exp((offset + 1) * (offset + 1) * weightScale) : 0.0;
+        float pairWeight = nearWeight + farWeight;
+        float2 pairOffset = (offset + farWeight / pairWeight) * texelStep;
 
-    // Average the colors (the original pixel is also part of the accumulation)
-    color /= 9.0;
+        color += pairWeight * (shaderTexture.Sample(samplerState, input.TexCoord + pairOffset) + shaderTexture.Sample(samplerState, input.TexCoord - pairOffset));
+        totalWeight += 2.0 * pairWeight;
+    }
 
-    return color;
+    return color / totalWeight;
 }
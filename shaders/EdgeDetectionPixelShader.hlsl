@@ -1,6 +1,11 @@
 Texture2D shaderTexture : register(t0);
 SamplerState samplerState : register(s0);
 
+// parameters of the effect, defined by the effect when it compiles the shader
+#ifndef THRESHOLD
+#define THRESHOLD 0.1
+#endif
+
 struct PSInput
 {
     float4 Pos : SV_POSITION;
@@ -9,10 +14,12 @@ struct PSInput
 
 float4 main(PSInput input) : SV_Target
 {
-    float edgeDetectionThreshold = 0.1;
+    float edgeDetectionThreshold = THRESHOLD;
 
-    // Hardcoded texel size for demonstration. Adjust based on actual texture dimensions.
-    float2 texelSize = float2(0.001f, 0.001f); // Example texel size, replace with your actual values
+    // Texel size of the actual texture, so neighbours are one pixel apart for any image size
+    uint textureWidth, textureHeight;
+    shaderTexture.GetDimensions(textureWidth, textureHeight);
+    float2 texelSize = float2(1.0f / textureWidth, 1.0f / textureHeight);
 
     float gx = 0.0;
     float gy = 0.0;
@@ -1,6 +1,11 @@
 Texture2D shaderTexture : register(t0);
 SamplerState samplerState : register(s0);
 
+// parameters of the effect, defined by the effect when it compiles the shader
+#ifndef CONTRAST
+#define CONTRAST 2.0
+#endif
+
 struct PSInput
 {
     float4 Pos : SV_POSITION;
@@ -20,6 +25,6 @@ float4 AdjustContrast(float4 color, float contrast)
 float4 main(PSInput input) : SV_Target
 {
     float4 texColor = shaderTexture.Sample(samplerState, input.TexCoord);
-    float contrast = 2; // contrast value; adjust as needed for your use case
+    float contrast = CONTRAST;
     return AdjustContrast(texColor, contrast);
 }
@@ -0,0 +1,37 @@
+Texture2D shaderTexture : register(t0);
+SamplerState samplerState : register(s0);
+
+// parameters of the effect, defined by the effect when it compiles the shader
+#ifndef STRENGTH
+#define STRENGTH 0.5
+#endif
+#ifndef CENTER_X
+#define CENTER_X 0.5
+#endif
+#ifndef CENTER_Y
+#define CENTER_Y 0.5
+#endif
+
+struct PSInput
+{
+    float4 Pos : SV_POSITION;
+    float2 TexCoord : TEXCOORD0;
+};
+
+float4 main(PSInput input) : SV_Target
+{
+    float strength = STRENGTH; // in [0, 1]
+    float2 center = float2(CENTER_X, CENTER_Y);
+    float maxAngle = 1.5; // as FISHEYE_MAX_ANGLE, below pi / 2 where the tangent diverges
+
+    // equidistant fish-eye over a rectilinear image, a radius of 0.5 from the center stays in place
+    float lensAngle = saturate(strength) * maxAngle;
+    float2 offset = input.TexCoord - center;
+    float radius = length(offset) / 0.5;
+
+    float scale = 1.0;
+    if (lensAngle > 0.0 && radius > 0.0)
+        scale = tan(min(radius * lensAngle, maxAngle)) / (tan(lensAngle) * radius);
+
+    return shaderTexture.Sample(samplerState, center + offset * scale);
+}
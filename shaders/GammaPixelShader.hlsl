@@ -0,0 +1,20 @@
+Texture2D shaderTexture : register(t0);
+SamplerState samplerState : register(s0);
+
+// parameters of the effect, defined by the effect when it compiles the shader
+#ifndef GAMMA
+#define GAMMA 2.2
+#endif
+
+struct PSInput
+{
+    float4 Pos : SV_POSITION;
+    float2 TexCoord : TEXCOORD0;
+};
+
+float4 main(PSInput input) : SV_Target
+{
+    float4 texColor = shaderTexture.Sample(samplerState, input.TexCoord);
+    float gamma = GAMMA; // above 1 brightens the image
+    return float4(pow(texColor.rgb, 1.0 / gamma), texColor.a);
+}
@@ -0,0 +1,41 @@
+Texture2D shaderTexture : register(t0);
+SamplerState samplerState : register(s0);
+
+// parameters of the effect, defined by the effect when it compiles the shader
+#ifndef INPUT_BLACK
+#define INPUT_BLACK 16
+#endif
+#ifndef INPUT_WHITE
+#define INPUT_WHITE 235
+#endif
+#ifndef GAMMA
+#define GAMMA 1.0
+#endif
+#ifndef OUTPUT_BLACK
+#define OUTPUT_BLACK 0
+#endif
+#ifndef OUTPUT_WHITE
+#define OUTPUT_WHITE 255
+#endif
+
+struct PSInput
+{
+    float4 Pos : SV_POSITION;
+    float2 TexCoord : TEXCOORD0;
+};
+
+float4 main(PSInput input) : SV_Target
+{
+    float4 texColor = shaderTexture.Sample(samplerState, input.TexCoord);
+
+    // levels are in 8-bit values, the defaults expand the video range [16, 235] to the full range
+    float inputBlack = INPUT_BLACK / 255.0;
+    float inputWhite = INPUT_WHITE / 255.0;
+    float gamma = GAMMA;
+    float outputBlack = OUTPUT_BLACK / 255.0;
+    float outputWhite = OUTPUT_WHITE / 255.0;
+
+    float3 normalized = saturate((texColor.rgb - inputBlack) / max(inputWhite - inputBlack, 1.0 / 255.0));
+    float3 adjusted = outputBlack + pow(normalized, 1.0 / gamma) * (outputWhite - outputBlack);
+    return float4(adjusted, texColor.a);
+}
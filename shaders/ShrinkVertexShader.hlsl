@@ -1,3 +1,8 @@
+// parameters of the effect, defined by the effect when it compiles the shader
+#ifndef FACTOR
+#define FACTOR 2.0
+#endif
+
 struct VSInput
 {
     float4 Pos : POSITION;
@@ -16,10 +21,10 @@ VSOutput main(VSInput input)
     output.Pos = input.Pos;
 
     // Calculate the offset to keep the texture centered after scaling
-    float2 centerOffset = 0.5 - (0.5 * 2);
+    float2 centerOffset = 0.5 - (0.5 * FACTOR);
 
     // Apply the scaling and re-center the texture
-    output.TexCoord = (input.TexCoord * 2) + centerOffset;
+    output.TexCoord = (input.TexCoord * FACTOR) + centerOffset;
 
     return output;
 }
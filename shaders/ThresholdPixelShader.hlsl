@@ -0,0 +1,20 @@
+Texture2D shaderTexture : register(t0);
+SamplerState samplerState : register(s0);
+
+// parameters of the effect, defined by the effect when it compiles the shader
+#ifndef THRESHOLD
+#define THRESHOLD 128
+#endif
+
+struct PSInput
+{
+    float4 Pos : SV_POSITION;
+    float2 TexCoord : TEXCOORD0;
+};
+
+float4 main(PSInput input) : SV_Target
+{
+    float4 texColor = shaderTexture.Sample(samplerState, input.TexCoord);
+    float threshold = THRESHOLD / 255.0; // in 8-bit values
+    return float4(step(threshold, texColor.rgb), texColor.a);
+}
@@ -2,6 +2,20 @@
 Texture2D shaderTexture : register(t0);
 SamplerState samplerState : register(s0);
 
+// parameters of the effect, defined by the effect when it compiles the shader
+#ifndef AMPLITUDE
+#define AMPLITUDE 0.1
+#endif
+#ifndef FREQUENCY
+#define FREQUENCY 20.0
+#endif
+#ifndef PHASE
+#define PHASE 0.0
+#endif
+#ifndef INTERPOLATED
+#define INTERPOLATED 1
+#endif
+
 struct PSInput
 {
     float4 Pos : SV_POSITION;
@@ -10,8 +24,15 @@ struct PSInput
 
 float4 main(PSInput input) : SV_Target
 {
-    shaderTexture.Sample(samplerState, input.TexCoord);
-    float waveShift = sin(input.TexCoord.y * 20) * 0.1;
+    float waveShift = sin(input.TexCoord.y * FREQUENCY + PHASE) * AMPLITUDE;
+
+#if !INTERPOLATED
+    // whole pixel shifts, as the CPU effect without interpolation
+    uint textureWidth, textureHeight;
+    shaderTexture.GetDimensions(textureWidth, textureHeight);
+    waveShift = round(waveShift * textureWidth) / textureWidth;
+#endif
+
     float4 texColor = shaderTexture.Sample(samplerState, float2(input.TexCoord.x + waveShift, input.TexCoord.y));
     return float4(texColor[0], texColor[1], texColor[2], texColor[3]);
 